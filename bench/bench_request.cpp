@@ -0,0 +1,70 @@
+#include <benchmark/benchmark.h>
+#include "arena.h"
+#include "http_request.h"
+#include "request_framer.h"
+#include "request_parser.h"
+
+#include <string>
+
+namespace {
+
+// What a browser sends for a page load, and what an API client sends
+const std::string kBrowserRequest =
+    "GET /products/list?page=2&sort=price HTTP/1.1\r\n"
+    "Host: shop.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Cookie: session=4f2a9c1e7b3d; theme=dark; consent=1\r\n"
+    "Referer: https://shop.example.com/\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+const std::string kApiRequest =
+    "POST /api/orders HTTP/1.1\r\n"
+    "Host: api.example.com\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 24\r\n"
+    "\r\n"
+    "{\"item\":42,\"quantity\":3}";
+
+void BM_RequestParserHead(benchmark::State& state) {
+    RequestParser parser;
+    for (auto _ : state) {
+        parser.reset();
+        benchmark::DoNotOptimize(parser.parse(kBrowserRequest));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * kBrowserRequest.size()));
+}
+BENCHMARK(BM_RequestParserHead);
+
+void BM_HttpRequestParse(benchmark::State& state) {
+    const std::string& raw = state.range(0) == 0 ? kBrowserRequest : kApiRequest;
+    for (auto _ : state) {
+        HttpRequest request;
+        benchmark::DoNotOptimize(request.parse(raw));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * raw.size()));
+}
+BENCHMARK(BM_HttpRequestParse)->Arg(0)->Arg(1)->ArgNames({"api"});
+
+// The connection path: framed from the receive buffer, headers in the arena
+void BM_FrameRequestIntoArena(benchmark::State& state) {
+    RequestFramer framer;
+    Arena arena;
+    std::string buffer;
+    for (auto _ : state) {
+        buffer = kBrowserRequest;
+        framer.frame(buffer);
+        {
+            HttpRequest request(&arena);
+            benchmark::DoNotOptimize(framer.takeRequest(buffer, request));
+        }
+        arena.reset();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * kBrowserRequest.size()));
+}
+BENCHMARK(BM_FrameRequestIntoArena);
+
+} // namespace
@@ -0,0 +1,37 @@
+#include <benchmark/benchmark.h>
+#include "http_response.h"
+
+#include <string>
+
+namespace {
+
+HttpResponse makeResponse(size_t body_size) {
+    HttpResponse response;
+    response.setJsonContent(std::string(body_size, 'x'));
+    response.setHeader("Cache-Control", "public, max-age=60");
+    response.setHeader("X-Request-Id", "9b1c2d3e-4f5a-6b7c-8d9e-0f1a2b3c4d5e");
+    response.enableCors();
+    return response;
+}
+
+void BM_HttpResponseToString(benchmark::State& state) {
+    HttpResponse response = makeResponse(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(response.toString());
+    }
+}
+BENCHMARK(BM_HttpResponseToString)->Arg(64)->Arg(16 * 1024)->ArgNames({"body"});
+
+// What the connection sends: the head into a reused buffer, the body apart
+void BM_SerializeHeadToReusedBuffer(benchmark::State& state) {
+    HttpResponse response = makeResponse(64);
+    std::string head;
+    for (auto _ : state) {
+        head.clear();
+        response.serializeHeadTo(head);
+        benchmark::DoNotOptimize(head.data());
+    }
+}
+BENCHMARK(BM_SerializeHeadToReusedBuffer);
+
+} // namespace
@@ -0,0 +1,42 @@
+#include <benchmark/benchmark.h>
+#include "router.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// A REST API's worth of routes, one resource family after another
+void addRoutes(Router& router, int resources) {
+    int32_t value = 0;
+    for (int i = 0; i < resources; ++i) {
+        std::string base = "/api/v1/resource" + std::to_string(i);
+        router.add(HttpRequest::Method::GET, base, value++);
+        router.add(HttpRequest::Method::GET, base + "/:id", value++);
+        router.add(HttpRequest::Method::GET, base + "/:id/items/:item", value++);
+        router.add(HttpRequest::Method::POST, base, value++);
+    }
+    router.add(HttpRequest::Method::GET, "/static/*path", value++);
+}
+
+void BM_RouterFind(benchmark::State& state) {
+    Router router;
+    addRoutes(router, static_cast<int>(state.range(0)));
+    const std::vector<std::string> paths = {
+        "/api/v1/resource7",
+        "/api/v1/resource3/12345",
+        "/api/v1/resource9/12345/items/678",
+        "/static/css/site.css",
+        "/not/routed",
+    };
+
+    Router::Match match;
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(router.find(HttpRequest::Method::GET, paths[next], match));
+        next = next + 1 == paths.size() ? 0 : next + 1;
+    }
+}
+BENCHMARK(BM_RouterFind)->Arg(10)->Arg(100)->ArgNames({"resources"});
+
+} // namespace
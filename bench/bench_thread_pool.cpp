@@ -0,0 +1,52 @@
+#include <benchmark/benchmark.h>
+#include "thread_pool.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// Enqueue from outside the pool (as the event loop does) and wait for the
+// batch, so the figure covers the hand-off as well as the enqueue
+void BM_ThreadPoolEnqueue(benchmark::State& state) {
+    ThreadPool pool(static_cast<size_t>(state.range(0)));
+    pool.start();
+    constexpr int kBatch = 1024;
+    std::atomic<int> done{0};
+    for (auto _ : state) {
+        done.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < kBatch; ++i) {
+            pool.enqueue([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while (done.load(std::memory_order_acquire) < kBatch) {
+            std::this_thread::yield();
+        }
+    }
+    pool.stop();
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBatch));
+}
+BENCHMARK(BM_ThreadPoolEnqueue)->Arg(1)->Arg(4)->ArgNames({"threads"})->UseRealTime();
+
+// Tasks spawning tasks stay on the worker's own deque
+void BM_ThreadPoolEnqueueFromWorker(benchmark::State& state) {
+    ThreadPool pool(4);
+    pool.start();
+    constexpr int kBatch = 1024;
+    std::atomic<int> done{0};
+    for (auto _ : state) {
+        done.store(0, std::memory_order_relaxed);
+        pool.enqueue([&pool, &done]() {
+            for (int i = 0; i < kBatch; ++i) {
+                pool.enqueue([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+        while (done.load(std::memory_order_acquire) < kBatch) {
+            std::this_thread::yield();
+        }
+    }
+    pool.stop();
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBatch));
+}
+BENCHMARK(BM_ThreadPoolEnqueueFromWorker)->UseRealTime();
+
+} // namespace
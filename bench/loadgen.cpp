@@ -0,0 +1,858 @@
+// HTTP/1.1 load generator for the server (or anything else speaking HTTP/1.1).
+//
+// Closed loop (the default): every connection sends its next request as
+// soon as the previous response is in, so the offered load follows the
+// server's pace. Open loop (--rate): requests are scheduled at a fixed
+// overall rate whether or not the server keeps up, and each one's latency
+// is measured from when it was due rather than when a connection got round
+// to sending it, so a stalling server shows up in the tail instead of
+// slowing the schedule down (coordinated omission).
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef ENABLE_SSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+#include "metrics.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    std::string method = "GET";
+    std::string path = "/";
+    std::vector<std::string> headers;
+    std::string body;
+    int connections = 16;
+    int threads = 2;
+    double duration_seconds = 10;
+    double warmup_seconds = 1;
+    double rate = 0; // requests/s over all threads; 0 = closed loop
+    bool keep_alive = true;
+    bool tls = false;
+    std::string json_file;
+    std::string label;
+};
+
+// Per-thread tallies, summed at the end; latencies go to one shared
+// histogram, whose updates are sharded per thread already
+struct Tally {
+    uint64_t completed = 0;
+    uint64_t errors = 0;
+    uint64_t connects = 0;
+    uint64_t tls_resumed = 0;
+    uint64_t bytes = 0;
+    uint64_t status_classes[5] = {};
+    uint64_t max_latency_us = 0;
+
+    void add(const Tally& other) {
+        completed += other.completed;
+        errors += other.errors;
+        connects += other.connects;
+        tls_resumed += other.tls_resumed;
+        bytes += other.bytes;
+        for (size_t i = 0; i < 5; ++i) {
+            status_classes[i] += other.status_classes[i];
+        }
+        max_latency_us = std::max(max_latency_us, other.max_latency_us);
+    }
+};
+
+// Frames one response: Content-Length, chunked or close-delimited
+class ResponseReader {
+public:
+    enum class Status { NEED_MORE, COMPLETE, ERROR };
+
+    void reset(bool head_request) {
+        head_request_ = head_request;
+        head_length_ = 0;
+        status_ = 0;
+        close_ = false;
+        chunked_ = false;
+        until_close_ = false;
+        content_length_ = 0;
+        chunk_pos_ = 0;
+    }
+
+    Status feed(const std::string& data, bool at_eof) {
+        if (head_length_ == 0) {
+            size_t end = data.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                return at_eof ? Status::ERROR : Status::NEED_MORE;
+            }
+            head_length_ = end + 4;
+            if (!parseHead(std::string_view(data).substr(0, head_length_))) {
+                return Status::ERROR;
+            }
+            chunk_pos_ = head_length_;
+        }
+
+        if (head_request_ || status_ < 200 || status_ == 204 || status_ == 304) {
+            until_close_ = false; // no body, so framing it does not close
+            return Status::COMPLETE;
+        }
+        if (chunked_) {
+            return scanChunks(data, at_eof);
+        }
+        if (until_close_) {
+            return at_eof ? Status::COMPLETE : Status::NEED_MORE;
+        }
+        if (data.size() >= head_length_ + content_length_) {
+            return Status::COMPLETE;
+        }
+        return at_eof ? Status::ERROR : Status::NEED_MORE;
+    }
+
+    int getStatus() const { return status_; }
+    // The server will close (or did not offer to keep) the connection
+    bool closes() const { return close_ || until_close_; }
+
+private:
+    bool head_request_ = false;
+    size_t head_length_ = 0;
+    int status_ = 0;
+    bool close_ = false;
+    bool chunked_ = false;
+    bool until_close_ = false;
+    size_t content_length_ = 0;
+    size_t chunk_pos_ = 0; // next chunk-size line
+
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+
+    static bool containsIgnoreCase(std::string_view haystack, std::string_view needle) {
+        for (size_t i = 0; i + needle.size() <= haystack.size(); ++i) {
+            if (equalsIgnoreCase(haystack.substr(i, needle.size()), needle)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseHead(std::string_view head) {
+        // "HTTP/1.x NNN ..."
+        if (head.size() < 12 || head.substr(0, 7) != "HTTP/1.") {
+            return false;
+        }
+        status_ = std::atoi(std::string(head.substr(9, 3)).c_str());
+        bool http10 = head[7] == '0';
+        bool has_length = false;
+        bool keep_alive = false;
+
+        size_t line = head.find("\r\n") + 2;
+        while (line < head.size()) {
+            size_t end = head.find("\r\n", line);
+            std::string_view field = head.substr(line, end - line);
+            line = end + 2;
+            size_t colon = field.find(':');
+            if (colon == std::string_view::npos) {
+                continue;
+            }
+            std::string_view name = field.substr(0, colon);
+            std::string_view value = field.substr(colon + 1);
+            if (equalsIgnoreCase(name, "Content-Length")) {
+                content_length_ = std::strtoull(std::string(value).c_str(), nullptr, 10);
+                has_length = true;
+            } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+                chunked_ = containsIgnoreCase(value, "chunked");
+            } else if (equalsIgnoreCase(name, "Connection")) {
+                close_ = containsIgnoreCase(value, "close");
+                keep_alive = containsIgnoreCase(value, "keep-alive");
+            }
+        }
+        close_ = close_ || (http10 && !keep_alive);
+        until_close_ = !chunked_ && !has_length;
+        return status_ >= 100 && status_ <= 599;
+    }
+
+    Status scanChunks(const std::string& data, bool at_eof) {
+        while (true) {
+            size_t line_end = data.find("\r\n", chunk_pos_);
+            if (line_end == std::string::npos) {
+                break;
+            }
+            size_t size = std::strtoull(data.c_str() + chunk_pos_, nullptr, 16);
+            if (size == 0) {
+                // Last chunk, then trailers up to an empty line
+                size_t trailers = line_end + 2;
+                if (data.size() >= trailers + 2 &&
+                    (data.compare(trailers, 2, "\r\n") == 0 || data.find("\r\n\r\n", trailers) != std::string::npos)) {
+                    return Status::COMPLETE;
+                }
+                break;
+            }
+            if (data.size() < line_end + 2 + size + 2) {
+                break;
+            }
+            chunk_pos_ = line_end + 2 + size + 2;
+        }
+        return at_eof ? Status::ERROR : Status::NEED_MORE;
+    }
+};
+
+#ifdef ENABLE_SSL
+SSL_CTX* g_tls_context = nullptr;
+#endif
+
+// One client connection, driven by its thread's epoll loop
+class Client {
+public:
+    enum class Result { PENDING, COMPLETE, FAILED };
+
+    Client(const Options& options, const sockaddr_storage& address, socklen_t address_length,
+           const std::string& request)
+        : options_(options), address_(address), address_length_(address_length), request_(request) {}
+
+    ~Client() {
+        disconnect();
+#ifdef ENABLE_SSL
+        if (session_) {
+            SSL_SESSION_free(session_);
+        }
+#endif
+    }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    // Begin a request counted from `started`; connects first if needed
+    Result start(int epoll_fd, Clock::time_point started, Tally& tally) {
+        started_ = started;
+        out_offset_ = 0;
+        input_.clear();
+        reader_.reset(options_.method == "HEAD");
+        if (fd_ < 0) {
+            if (!connect(epoll_fd, tally)) {
+                return Result::FAILED;
+            }
+        } else {
+            phase_ = Phase::SENDING;
+        }
+        return drive(0, tally);
+    }
+
+    // Progress on a readiness event (edge-triggered: each step runs until
+    // it would block)
+    Result drive(uint32_t events, Tally& tally) {
+        while (true) {
+            switch (phase_) {
+                case Phase::IDLE:
+                    return Result::PENDING;
+                case Phase::CONNECTING: {
+                    if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                        return Result::PENDING;
+                    }
+                    int error = 0;
+                    socklen_t length = sizeof(error);
+                    getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length);
+                    if (error != 0) {
+                        return fail();
+                    }
+                    phase_ = options_.tls ? Phase::HANDSHAKE : Phase::SENDING;
+                    break;
+                }
+                case Phase::HANDSHAKE: {
+                    int step = handshake(tally);
+                    if (step <= 0) {
+                        return step < 0 ? fail() : Result::PENDING;
+                    }
+                    phase_ = Phase::SENDING;
+                    break;
+                }
+                case Phase::SENDING: {
+                    int step = send();
+                    if (step <= 0) {
+                        return step < 0 ? fail() : Result::PENDING;
+                    }
+                    phase_ = Phase::READING;
+                    break;
+                }
+                case Phase::READING:
+                    return receive(tally);
+            }
+        }
+    }
+
+    Clock::time_point getStarted() const { return started_; }
+    int getStatus() const { return reader_.getStatus(); }
+    int getFd() const { return fd_; }
+
+private:
+    enum class Phase { IDLE, CONNECTING, HANDSHAKE, SENDING, READING };
+
+    const Options& options_;
+    sockaddr_storage address_;
+    socklen_t address_length_;
+    const std::string& request_;
+
+    int fd_ = -1;
+    Phase phase_ = Phase::IDLE;
+    Clock::time_point started_;
+    size_t out_offset_ = 0;
+    std::string input_;
+    ResponseReader reader_;
+#ifdef ENABLE_SSL
+    SSL* ssl_ = nullptr;
+    SSL_SESSION* session_ = nullptr; // offered again on reconnects
+#endif
+
+    bool connect(int epoll_fd, Tally& tally) {
+        fd_ = socket(address_.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0) {
+            return false;
+        }
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (::connect(fd_, reinterpret_cast<const sockaddr*>(&address_), address_length_) < 0 &&
+            errno != EINPROGRESS) {
+            disconnect();
+            return false;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = this;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd_, &event) < 0) {
+            disconnect();
+            return false;
+        }
+        ++tally.connects;
+        phase_ = Phase::CONNECTING;
+        return true;
+    }
+
+    // Closing the descriptor also takes it out of the epoll set
+    void disconnect() {
+#ifdef ENABLE_SSL
+        if (ssl_) {
+            // TLS 1.3 tickets come after the handshake, so the session is
+            // only worth keeping once a response has been read. Freeing a
+            // connection that was not shut down would spoil the session.
+            SSL_SESSION* session = SSL_get_session(ssl_);
+            if (session && SSL_SESSION_is_resumable(session)) {
+                if (session_) {
+                    SSL_SESSION_free(session_);
+                }
+                session_ = SSL_get1_session(ssl_);
+            }
+            SSL_shutdown(ssl_);
+            SSL_free(ssl_);
+            ssl_ = nullptr;
+        }
+#endif
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+        phase_ = Phase::IDLE;
+    }
+
+    Result fail() {
+        disconnect();
+        return Result::FAILED;
+    }
+
+    // 1 when done, 0 when it must wait for the socket, -1 on failure
+    int handshake(Tally& tally) {
+#ifdef ENABLE_SSL
+        if (!ssl_) {
+            ssl_ = SSL_new(g_tls_context);
+            SSL_set_fd(ssl_, fd_);
+            SSL_set_tlsext_host_name(ssl_, options_.host.c_str());
+            if (session_) {
+                SSL_set_session(ssl_, session_);
+            }
+        }
+        int result = SSL_connect(ssl_);
+        if (result == 1) {
+            if (SSL_session_reused(ssl_)) {
+                ++tally.tls_resumed;
+            }
+            return 1;
+        }
+        int error = SSL_get_error(ssl_, result);
+        return error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE ? 0 : -1;
+#else
+        (void)tally;
+        return -1;
+#endif
+    }
+
+    int send() {
+        while (out_offset_ < request_.size()) {
+            const char* data = request_.data() + out_offset_;
+            size_t size = request_.size() - out_offset_;
+#ifdef ENABLE_SSL
+            if (ssl_) {
+                int written = SSL_write(ssl_, data, static_cast<int>(size));
+                if (written <= 0) {
+                    int error = SSL_get_error(ssl_, written);
+                    return error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE ? 0 : -1;
+                }
+                out_offset_ += static_cast<size_t>(written);
+                continue;
+            }
+#endif
+            ssize_t written = ::send(fd_, data, size, MSG_NOSIGNAL);
+            if (written < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+            }
+            out_offset_ += static_cast<size_t>(written);
+        }
+        return 1;
+    }
+
+    Result receive(Tally& tally) {
+        char buffer[16384];
+        bool at_eof = false;
+        while (true) {
+            ssize_t received;
+#ifdef ENABLE_SSL
+            if (ssl_) {
+                int result = SSL_read(ssl_, buffer, sizeof(buffer));
+                if (result <= 0) {
+                    int error = SSL_get_error(ssl_, result);
+                    if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+                        break;
+                    }
+                    if (error != SSL_ERROR_ZERO_RETURN && error != SSL_ERROR_SYSCALL) {
+                        return fail();
+                    }
+                    at_eof = true;
+                    break;
+                }
+                received = result;
+            } else
+#endif
+            {
+                received = recv(fd_, buffer, sizeof(buffer), 0);
+                if (received < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        break;
+                    }
+                    return fail();
+                }
+                if (received == 0) {
+                    at_eof = true;
+                    break;
+                }
+            }
+            input_.append(buffer, static_cast<size_t>(received));
+        }
+
+        switch (reader_.feed(input_, at_eof)) {
+            case ResponseReader::Status::NEED_MORE:
+                return Result::PENDING;
+            case ResponseReader::Status::ERROR:
+                return fail();
+            case ResponseReader::Status::COMPLETE:
+                break;
+        }
+        tally.bytes += input_.size();
+        if (!options_.keep_alive || reader_.closes() || at_eof) {
+            disconnect();
+        } else {
+            phase_ = Phase::IDLE;
+        }
+        return Result::COMPLETE;
+    }
+};
+
+std::string buildRequest(const Options& options) {
+    std::string request = options.method + " " + options.path + " HTTP/1.1\r\n";
+    request += "Host: " + options.host + "\r\n";
+    request += "User-Agent: httpserver-loadgen\r\n";
+    for (const auto& header : options.headers) {
+        request += header + "\r\n";
+    }
+    if (!options.body.empty()) {
+        request += "Content-Length: " + std::to_string(options.body.size()) + "\r\n";
+    }
+    request += options.keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    request += "\r\n";
+    request += options.body;
+    return request;
+}
+
+// One thread's share of the connections (and of the open-loop rate)
+void runWorker(const Options& options, const sockaddr_storage& address, socklen_t address_length,
+               const std::string& request, int connections, double rate, Clock::time_point begin,
+               Clock::time_point measure_from, Clock::time_point end, metrics::LatencyHistogram& latency,
+               Tally& tally) {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<Client*> idle;
+    for (int i = 0; i < connections; ++i) {
+        clients.push_back(std::make_unique<Client>(options, address, address_length, request));
+        idle.push_back(clients.back().get());
+    }
+
+    // Open loop: requests fall due every `interval`, waiting here for a free
+    // connection when all are busy
+    bool open_loop = rate > 0;
+    auto interval = open_loop ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate))
+                              : Clock::duration::zero();
+    Clock::time_point next_due = begin;
+    std::deque<Clock::time_point> backlog;
+    int timer_fd = -1; // steady_clock is CLOCK_MONOTONIC
+    if (open_loop) {
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+    }
+
+    // A connection that failed (refused, reset) waits a millisecond before
+    // its next attempt rather than spinning
+    std::vector<Client*> retrying;
+    Clock::time_point retry_at;
+    auto finish = [&](Client* client, Client::Result result, Clock::time_point now) {
+        if (result == Client::Result::PENDING) {
+            return;
+        }
+        bool counted = client->getStarted() >= measure_from;
+        if (result == Client::Result::FAILED) {
+            if (counted) {
+                ++tally.errors;
+            }
+            if (retrying.empty()) {
+                retry_at = now + std::chrono::milliseconds(1);
+            }
+            retrying.push_back(client);
+            return;
+        }
+        if (counted) {
+            auto micros = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(now - client->getStarted()).count());
+            latency.record(micros);
+            tally.max_latency_us = std::max(tally.max_latency_us, micros);
+            ++tally.completed;
+            int status_class = client->getStatus() / 100;
+            if (status_class >= 1 && status_class <= 5) {
+                ++tally.status_classes[status_class - 1];
+            }
+        }
+        idle.push_back(client);
+    };
+
+    epoll_event events[256];
+    while (true) {
+        Clock::time_point now = Clock::now();
+        if (now >= end) {
+            break;
+        }
+
+        // Hand out work to idle connections
+        std::vector<Client*> starting;
+        starting.swap(idle);
+        if (!retrying.empty() && now >= retry_at) {
+            starting.insert(starting.end(), retrying.begin(), retrying.end());
+            retrying.clear();
+        }
+        if (open_loop) {
+            while (next_due <= now) {
+                backlog.push_back(next_due);
+                next_due += interval;
+            }
+        }
+        for (Client* client : starting) {
+            Clock::time_point started = now;
+            if (open_loop) {
+                if (backlog.empty()) {
+                    idle.push_back(client);
+                    continue;
+                }
+                started = backlog.front();
+                backlog.pop_front();
+            }
+            finish(client, client->start(epoll_fd, started, tally), Clock::now());
+        }
+
+        // The open-loop schedule runs off a timerfd, since epoll_wait()'s
+        // millisecond timeout is too coarse for it; spinning instead would
+        // take the CPU from a server on the same machine
+        int timeout_ms = retrying.empty() ? 100 : 1;
+        if (open_loop) {
+            auto due = std::chrono::duration_cast<std::chrono::nanoseconds>(next_due.time_since_epoch()).count();
+            itimerspec spec{};
+            spec.it_value.tv_sec = static_cast<time_t>(due / 1000000000);
+            spec.it_value.tv_nsec = static_cast<long>(due % 1000000000);
+            timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+        } else if (!idle.empty() && retrying.empty()) {
+            timeout_ms = 0;
+        }
+
+        int count = epoll_wait(epoll_fd, events, 256, timeout_ms);
+        now = Clock::now();
+        for (int i = 0; i < count; ++i) {
+            auto* client = static_cast<Client*>(events[i].data.ptr);
+            if (!client) {
+                uint64_t expirations;
+                ssize_t drained = read(timer_fd, &expirations, sizeof(expirations));
+                (void)drained;
+                continue;
+            }
+            finish(client, client->drive(events[i].events, tally), now);
+        }
+    }
+
+    clients.clear();
+    if (timer_fd >= 0) {
+        close(timer_fd);
+    }
+    close(epoll_fd);
+}
+
+bool resolve(const Options& options, sockaddr_storage& address, socklen_t& address_length) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(options.host.c_str(), std::to_string(options.port).c_str(), &hints, &result) != 0 || !result) {
+        return false;
+    }
+    std::memcpy(&address, result->ai_addr, result->ai_addrlen);
+    address_length = static_cast<socklen_t>(result->ai_addrlen);
+    freeaddrinfo(result);
+    return true;
+}
+
+std::string jsonEscape(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  --host <host>         Server host (default: 127.0.0.1)\n";
+    std::cout << "  --port <port>         Server port (default: 8080)\n";
+    std::cout << "  --method <method>     Request method (default: GET)\n";
+    std::cout << "  --path <path>         Request target (default: /)\n";
+    std::cout << "  --header <field>      Extra request header, e.g. \"Accept: */*\" (repeatable)\n";
+    std::cout << "  --body <data>         Request body, sent with a Content-Length\n";
+    std::cout << "  --connections <n>     Concurrent connections (default: 16)\n";
+    std::cout << "  --threads <n>         Client threads sharing the connections (default: 2)\n";
+    std::cout << "  --duration <s>        Measured run time (default: 10)\n";
+    std::cout << "  --warmup <s>          Unmeasured lead-in (default: 1)\n";
+    std::cout << "  --rate <req/s>        Open loop at this overall rate (default: closed loop)\n";
+    std::cout << "  --no-keepalive        A new connection for every request\n";
+    std::cout << "  --tls                 HTTPS (certificates are not verified)\n";
+    std::cout << "  --json <file>         Also write the results as JSON (\"-\" for stdout)\n";
+    std::cout << "  --label <text>        Recorded in the JSON output, e.g. a release tag\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--host" && i + 1 < argc) {
+            options.host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.port = std::stoi(argv[++i]);
+        } else if (arg == "--method" && i + 1 < argc) {
+            options.method = argv[++i];
+        } else if (arg == "--path" && i + 1 < argc) {
+            options.path = argv[++i];
+        } else if (arg == "--header" && i + 1 < argc) {
+            options.headers.push_back(argv[++i]);
+        } else if (arg == "--body" && i + 1 < argc) {
+            options.body = argv[++i];
+        } else if (arg == "--connections" && i + 1 < argc) {
+            options.connections = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--duration" && i + 1 < argc) {
+            options.duration_seconds = std::stod(argv[++i]);
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            options.warmup_seconds = std::stod(argv[++i]);
+        } else if (arg == "--rate" && i + 1 < argc) {
+            options.rate = std::stod(argv[++i]);
+        } else if (arg == "--no-keepalive") {
+            options.keep_alive = false;
+        } else if (arg == "--tls") {
+            options.tls = true;
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.json_file = argv[++i];
+        } else if (arg == "--label" && i + 1 < argc) {
+            options.label = argv[++i];
+        } else if (arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    options.threads = std::min(options.threads, options.connections);
+
+    std::signal(SIGPIPE, SIG_IGN);
+    if (options.tls) {
+#ifdef ENABLE_SSL
+        g_tls_context = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_verify(g_tls_context, SSL_VERIFY_NONE, nullptr);
+        SSL_CTX_set_session_cache_mode(g_tls_context, SSL_SESS_CACHE_CLIENT);
+        static const unsigned char kAlpn[] = "\x08http/1.1";
+        SSL_CTX_set_alpn_protos(g_tls_context, kAlpn, sizeof(kAlpn) - 1);
+#else
+        std::cerr << "--tls needs a build with ENABLE_SSL\n";
+        return 1;
+#endif
+    }
+
+    sockaddr_storage address{};
+    socklen_t address_length = 0;
+    if (!resolve(options, address, address_length)) {
+        std::cerr << "Cannot resolve " << options.host << "\n";
+        return 1;
+    }
+
+    std::string request = buildRequest(options);
+    metrics::LatencyHistogram latency;
+    std::vector<Tally> tallies(static_cast<size_t>(options.threads));
+    std::vector<std::thread> threads;
+
+    auto begin = Clock::now();
+    auto measure_from = begin + std::chrono::duration_cast<Clock::duration>(
+                                    std::chrono::duration<double>(options.warmup_seconds));
+    auto end = measure_from + std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::duration<double>(options.duration_seconds));
+    for (int t = 0; t < options.threads; ++t) {
+        int connections = options.connections / options.threads + (t < options.connections % options.threads ? 1 : 0);
+        threads.emplace_back(runWorker, std::cref(options), std::cref(address), address_length, std::cref(request),
+                             connections, options.rate / options.threads, begin, measure_from, end,
+                             std::ref(latency), std::ref(tallies[static_cast<size_t>(t)]));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    Tally total;
+    for (const auto& tally : tallies) {
+        total.add(tally);
+    }
+    metrics::LatencyHistogram::Snapshot snapshot = latency.snapshot();
+    double seconds = options.duration_seconds > 0 ? options.duration_seconds : 1;
+    double throughput = static_cast<double>(total.completed) / seconds;
+    double mean_us = snapshot.count > 0 ? static_cast<double>(snapshot.sum_us) / static_cast<double>(snapshot.count) : 0;
+    const std::pair<const char*, double> quantiles[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}};
+
+    std::printf("%s %s://%s:%d%s, %d connections on %d threads, %s, %s\n", options.method.c_str(),
+                options.tls ? "https" : "http", options.host.c_str(), options.port, options.path.c_str(),
+                options.connections, options.threads,
+                options.rate > 0 ? ("open loop at " + std::to_string(static_cast<long long>(options.rate)) + " req/s").c_str()
+                                 : "closed loop",
+                options.keep_alive ? "keep-alive" : "a connection per request");
+    std::printf("  requests:   %llu in %.1f s, %.0f req/s, %llu errors\n",
+                static_cast<unsigned long long>(total.completed), seconds, throughput,
+                static_cast<unsigned long long>(total.errors));
+    std::printf("  latency:    mean %.0f us", mean_us);
+    for (const auto& quantile : quantiles) {
+        std::printf(", %s %llu us", quantile.first,
+                    static_cast<unsigned long long>(snapshot.percentile(quantile.second)));
+    }
+    std::printf(", max %llu us\n", static_cast<unsigned long long>(total.max_latency_us));
+    std::printf("  responses:  1xx %llu, 2xx %llu, 3xx %llu, 4xx %llu, 5xx %llu\n",
+                static_cast<unsigned long long>(total.status_classes[0]),
+                static_cast<unsigned long long>(total.status_classes[1]),
+                static_cast<unsigned long long>(total.status_classes[2]),
+                static_cast<unsigned long long>(total.status_classes[3]),
+                static_cast<unsigned long long>(total.status_classes[4]));
+    std::printf("  connections: %llu opened", static_cast<unsigned long long>(total.connects));
+    if (options.tls) {
+        std::printf(", %llu TLS sessions resumed", static_cast<unsigned long long>(total.tls_resumed));
+    }
+    std::printf("\n");
+
+    if (!options.json_file.empty()) {
+        std::ostringstream json;
+        json << "{\"label\":\"" << jsonEscape(options.label) << "\",\"timestamp\":" << std::time(nullptr)
+             << ",\"target\":{\"method\":\"" << jsonEscape(options.method) << "\",\"url\":\""
+             << (options.tls ? "https" : "http") << "://" << jsonEscape(options.host) << ":" << options.port
+             << jsonEscape(options.path) << "\"},\"config\":{\"connections\":" << options.connections
+             << ",\"threads\":" << options.threads << ",\"duration_s\":" << options.duration_seconds
+             << ",\"warmup_s\":" << options.warmup_seconds << ",\"mode\":\""
+             << (options.rate > 0 ? "open" : "closed") << "\",\"rate\":" << options.rate
+             << ",\"keep_alive\":" << (options.keep_alive ? "true" : "false")
+             << ",\"tls\":" << (options.tls ? "true" : "false") << "},\"requests\":" << total.completed
+             << ",\"errors\":" << total.errors << ",\"requests_per_second\":" << throughput
+             << ",\"bytes\":" << total.bytes << ",\"connections_opened\":" << total.connects
+             << ",\"tls_resumed\":" << total.tls_resumed << ",\"latency_us\":{\"mean\":" << mean_us;
+        for (const auto& quantile : quantiles) {
+            json << ",\"" << quantile.first << "\":" << snapshot.percentile(quantile.second);
+        }
+        json << ",\"max\":" << total.max_latency_us << "},\"status\":{";
+        for (size_t i = 0; i < 5; ++i) {
+            json << (i ? "," : "") << "\"" << i + 1 << "xx\":" << total.status_classes[i];
+        }
+        json << "}}\n";
+
+        if (options.json_file == "-") {
+            std::cout << json.str();
+        } else {
+            std::ofstream file(options.json_file);
+            file << json.str();
+            if (!file) {
+                std::cerr << "Cannot write " << options.json_file << "\n";
+                return 1;
+            }
+        }
+    }
+
+#ifdef ENABLE_SSL
+    if (g_tls_context) {
+        SSL_CTX_free(g_tls_context);
+    }
+#endif
+    return total.completed > 0 ? 0 : 1;
+}
@@ -12,6 +12,52 @@ print_error() {
     echo -e "\033[0;31m[ERROR]\033[0m $1"
 }
 
+# Build profile (see the WASM_* options in CMakeLists.txt)
+WASM_PROFILE="SPEED"
+WASM_SIMD="ON"
+WASM_EXCEPTIONS="ON"
+WASM_THREADS="OFF"
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --size)
+            WASM_PROFILE="SIZE"
+            shift
+            ;;
+        --speed)
+            WASM_PROFILE="SPEED"
+            shift
+            ;;
+        --no-simd)
+            WASM_SIMD="OFF"
+            shift
+            ;;
+        --no-exceptions)
+            WASM_EXCEPTIONS="OFF"
+            shift
+            ;;
+        --threads)
+            WASM_THREADS="ON"
+            shift
+            ;;
+        --help)
+            echo "Usage: $0 [options]"
+            echo "Options:"
+            echo "  --speed          Optimize for speed, -O3 (default)"
+            echo "  --size           Optimize for module size, -Oz with emmalloc"
+            echo "  --no-simd        Build without -msimd128, for runtimes lacking wasm SIMD"
+            echo "  --no-exceptions  Build with -fno-exceptions; a throwing handler aborts"
+            echo "  --threads        Worker mode: answer requests in parallel on pthreads (needs SharedArrayBuffer)"
+            echo "  --help           Show this help message"
+            exit 0
+            ;;
+        *)
+            print_error "Unknown option: $1"
+            exit 1
+            ;;
+    esac
+done
+
 # Check if Emscripten is available
 if ! command -v emcmake &> /dev/null; then
     print_error "Emscripten not found!"
@@ -26,7 +72,7 @@ if ! command -v emcmake &> /dev/null; then
     exit 1
 fi
 
-print_status "Building for WebAssembly..."
+print_status "Building for WebAssembly (profile: $WASM_PROFILE, SIMD: $WASM_SIMD, exceptions: $WASM_EXCEPTIONS, threads: $WASM_THREADS)..."
 
 # Create WebAssembly build directory
 mkdir -p build-wasm
@@ -34,7 +80,9 @@ cd build-wasm
 
 # Configure for WebAssembly
 print_status "Configuring with Emscripten..."
-emcmake cmake -DBUILD_WASM=ON -DENABLE_SSL=OFF -DBUILD_TESTS=OFF -DCMAKE_BUILD_TYPE=Release ..
+emcmake cmake -DBUILD_WASM=ON -DENABLE_SSL=OFF -DBUILD_TESTS=OFF -DCMAKE_BUILD_TYPE=Release \
+    -DWASM_PROFILE="$WASM_PROFILE" -DWASM_SIMD="$WASM_SIMD" -DWASM_EXCEPTIONS="$WASM_EXCEPTIONS" \
+    -DWASM_THREADS="$WASM_THREADS" ..
 
 # Build
 print_status "Building WebAssembly module..."
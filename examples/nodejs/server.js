@@ -0,0 +1,206 @@
+// Node.js front end for the WebAssembly build. Requests that arrive in the
+// same turn of the event loop are answered together with one
+// handle_request_batch() call, written into and read out of buffers this
+// file owns in the module's linear memory. A module built with
+// WASM_THREADS=ON answers them on its own pthreads instead (WasmWorkers).
+const http = require('http');
+const HttpServerModule = require('./httpserver.js');
+
+const PORT = Number(process.env.PORT) || 3000;
+const MAX_BATCH = 64;
+const INITIAL_CAPACITY = 256 * 1024;
+const WORKERS = Number(process.env.WASM_WORKERS) || 4;
+
+// Fields Node sets itself for the connection it manages
+const HOP_BY_HOP = new Set(['connection', 'keep-alive', 'transfer-encoding']);
+
+class WasmBatcher {
+  constructor(module) {
+    this.module = module;
+    this.inCapacity = 0;
+    this.outCapacity = 0;
+    this.requestLengths = module._malloc(MAX_BATCH * 4);
+    this.responseLengths = module._malloc(MAX_BATCH * 4);
+    this.reserveInput(INITIAL_CAPACITY);
+    this.reserveOutput(INITIAL_CAPACITY);
+  }
+
+  reserveInput(size) {
+    if (size > this.inCapacity) {
+      if (this.inCapacity) this.module._free(this.input);
+      this.inCapacity = Math.max(size, this.inCapacity * 2);
+      this.input = this.module._malloc(this.inCapacity);
+    }
+  }
+
+  reserveOutput(size) {
+    if (size > this.outCapacity) {
+      if (this.outCapacity) this.module._free(this.output);
+      this.outCapacity = Math.max(size, this.outCapacity * 2);
+      this.output = this.module._malloc(this.outCapacity);
+    }
+  }
+
+  // Raw requests (Buffers, at most MAX_BATCH) in, raw responses out
+  handle(requests) {
+    const M = this.module;
+    this.reserveInput(requests.reduce((total, request) => total + request.length, 0));
+    let offset = 0;
+    requests.forEach((request, i) => {
+      M.HEAPU8.set(request, this.input + offset);
+      M.HEAPU32[(this.requestLengths >> 2) + i] = request.length;
+      offset += request.length;
+    });
+
+    const responses = [];
+    let next = 0;
+    let position = this.input;
+    while (next < requests.length) {
+      const written = M._handle_request_batch(position, this.requestLengths + next * 4, requests.length - next,
+                                              this.output, this.outCapacity, this.responseLengths);
+      let outOffset = 0;
+      for (let i = 0; i < written; ++i) {
+        const length = M.HEAPU32[(this.responseLengths >> 2) + i];
+        responses.push(Buffer.from(M.HEAPU8.subarray(this.output + outOffset, this.output + outOffset + length)));
+        outOffset += length;
+        position += requests[next + i].length;
+      }
+      next += written;
+
+      if (next < requests.length) {
+        // This one did not fit: grow the output buffer and collect it
+        const length = M.HEAPU32[(this.responseLengths >> 2) + written];
+        this.reserveOutput(length);
+        M._take_response(this.output, this.outCapacity);
+        responses.push(Buffer.from(M.HEAPU8.subarray(this.output, this.output + length)));
+        position += requests[next].length;
+        next += 1;
+      }
+    }
+    return responses;
+  }
+}
+
+// Worker mode: each request is copied into linear memory and submitted to
+// the module's ring; this thread only waits on the completion counter and
+// collects whatever the workers have finished.
+class WasmWorkers {
+  constructor(module, count) {
+    this.module = module;
+    this.count = module._start_workers(count);
+    this.counter = module._completion_counter() >> 2;
+    this.records = module._malloc(MAX_BATCH * 12);
+    this.inFlight = new Map();
+    this.backlog = [];
+    this.nextTag = 0;
+    this.wait();
+  }
+
+  // `callback` gets the raw response
+  submit(raw, callback) {
+    const M = this.module;
+    const request = { tag: this.nextTag, pointer: M._malloc(raw.length), length: raw.length, callback };
+    this.nextTag = (this.nextTag + 1) >>> 0;
+    M.HEAPU8.set(raw, request.pointer);
+    if (this.backlog.length || !this.trySubmit(request)) {
+      this.backlog.push(request);
+    }
+  }
+
+  trySubmit(request) {
+    if (!this.module._submit_request(request.pointer, request.length, request.tag)) return false;
+    this.inFlight.set(request.tag, request);
+    return true;
+  }
+
+  drain() {
+    const M = this.module;
+    let polled;
+    do {
+      polled = M._poll_responses(this.records, MAX_BATCH);
+      for (let i = 0; i < polled; ++i) {
+        const [tag, pointer, length] = M.HEAPU32.subarray((this.records >> 2) + i * 3, (this.records >> 2) + i * 3 + 3);
+        const request = this.inFlight.get(tag);
+        this.inFlight.delete(tag);
+        M._free(request.pointer);
+        request.callback(Buffer.from(M.HEAPU8.subarray(pointer, pointer + length)));
+      }
+      // Responses collected make room in the ring
+      while (this.backlog.length && this.trySubmit(this.backlog[0])) this.backlog.shift();
+    } while (polled === MAX_BATCH);
+  }
+
+  wait() {
+    const counter = new Int32Array(this.module.HEAPU8.buffer);
+    const seen = Atomics.load(counter, this.counter);
+    this.drain();
+    const result = Atomics.waitAsync(counter, this.counter, seen);
+    if (result.async) {
+      result.value.then(() => this.wait());
+    } else {
+      setImmediate(() => this.wait()); // more finished meanwhile
+    }
+  }
+}
+
+function serializeRequest(req, body) {
+  let head = `${req.method} ${req.url} HTTP/1.1\r\n`;
+  for (let i = 0; i < req.rawHeaders.length; i += 2) {
+    head += `${req.rawHeaders[i]}: ${req.rawHeaders[i + 1]}\r\n`;
+  }
+  return Buffer.concat([Buffer.from(head + '\r\n', 'latin1'), body]);
+}
+
+function sendResponse(res, raw) {
+  const headEnd = raw.indexOf('\r\n\r\n');
+  const lines = raw.toString('latin1', 0, headEnd).split('\r\n');
+  const status = parseInt(lines[0].split(' ')[1], 10);
+  const headers = [];
+  for (const line of lines.slice(1)) {
+    const colon = line.indexOf(':');
+    const name = line.slice(0, colon);
+    if (!HOP_BY_HOP.has(name.toLowerCase())) {
+      headers.push(name, line.slice(colon + 1).trim());
+    }
+  }
+  res.writeHead(status, headers);
+  res.end(raw.subarray(headEnd + 4));
+}
+
+HttpServerModule().then((module) => {
+  if (module._start_workers) {
+    const workers = new WasmWorkers(module, WORKERS);
+    http.createServer((req, res) => {
+      const chunks = [];
+      req.on('data', (chunk) => chunks.push(chunk));
+      req.on('end', () => {
+        workers.submit(serializeRequest(req, Buffer.concat(chunks)), (raw) => sendResponse(res, raw));
+      });
+    }).listen(PORT, () => {
+      console.log(`WebAssembly HTTP server listening on http://localhost:${PORT} (${workers.count} workers)`);
+    });
+    return;
+  }
+
+  const batcher = new WasmBatcher(module);
+  let pending = [];
+
+  const flush = () => {
+    const batch = pending.splice(0, MAX_BATCH);
+    const responses = batcher.handle(batch.map((entry) => entry.raw));
+    batch.forEach((entry, i) => sendResponse(entry.res, responses[i]));
+    if (pending.length) setImmediate(flush);
+  };
+
+  http.createServer((req, res) => {
+    const chunks = [];
+    req.on('data', (chunk) => chunks.push(chunk));
+    req.on('end', () => {
+      if (pending.push({ raw: serializeRequest(req, Buffer.concat(chunks)), res }) === 1) {
+        setImmediate(flush);
+      }
+    });
+  }).listen(PORT, () => {
+    console.log(`WebAssembly HTTP server listening on http://localhost:${PORT}`);
+  });
+});
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "http_request.h"
+
+// Per-request access log. The server fills in an Entry for every request
+// once its response is built. Sampled entries are formatted as JSON lines
+// or fixed-layout binary records, without allocating, straight into the
+// async logger's ring, which writes them to the access log file.
+class AccessLog {
+public:
+    enum class Format {
+        JSON_LINES,
+        BINARY
+    };
+
+    struct Entry {
+        HttpRequest::Method method = HttpRequest::Method::UNKNOWN;
+        std::string_view path;
+        std::string_view version;
+        int status = 0;
+        uint64_t bytes = 0;      // response body
+        uint64_t latency_us = 0; // request framed until its response was built
+        std::string_view client_address;
+        bool tls = false;
+        bool tls_resumed = false;
+    };
+
+    // Binary records, all integers little-endian:
+    //   0  u16  record size (header and path)
+    //   2  u8   layout version (kBinaryVersion)
+    //   3  u8   method (HttpRequest::Method)
+    //   4  u16  status
+    //   6  u8   flags (kFlagTls, kFlagTlsResumed)
+    //   7  u8   reserved
+    //   8  u64  timestamp, microseconds since the epoch
+    //   16 u64  bytes
+    //   24 u32  latency in microseconds, saturated
+    //   28 u8[4] client IPv4 address, network order (zero if not IPv4)
+    //   32 u16  path length
+    //   34 u8[6] reserved
+    //   40      path
+    static constexpr size_t kBinaryHeaderSize = 40;
+    static constexpr uint8_t kBinaryVersion = 1;
+    static constexpr uint8_t kFlagTls = 1;
+    static constexpr uint8_t kFlagTlsResumed = 2;
+    // Longer paths are cut off in both formats
+    static constexpr size_t kMaxPathSize = 2048;
+
+    AccessLog();
+
+    // Write about `sample_rate` (0..1] of all requests in `format`
+    void enable(Format format, double sample_rate);
+    void disable();
+    bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+    Format getFormat() const { return format_.load(std::memory_order_relaxed); }
+
+    // Whether the request about to be served gets an entry; decided up front
+    // so unsampled requests cost nothing more
+    bool sample() const;
+    void write(const Entry& entry) const;
+
+    // The record for `entry` at `out`, which must have room for
+    // maxRecordSize(entry, format); returns its size
+    static size_t maxRecordSize(const Entry& entry, Format format);
+    static size_t formatJson(const Entry& entry, uint64_t timestamp_ms, char* out);
+    static size_t formatBinary(const Entry& entry, uint64_t timestamp_us, char* out);
+
+private:
+    std::atomic<bool> enabled_;
+    std::atomic<Format> format_;
+    // A request is sampled when a random 64-bit draw falls below this
+    std::atomic<uint64_t> sample_threshold_;
+};
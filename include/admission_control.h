@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Connection admission shared by all listener shards: a global cap on open
+// connections and an optional cap per client address. Limits are meant to
+// be configured before the server starts. Thread-safe.
+class AdmissionControl {
+public:
+    AdmissionControl();
+
+    // 0 disables a limit
+    void setMaxConnections(size_t max_connections) { max_connections_ = max_connections; }
+    void setMaxConnectionsPerClient(size_t max_per_client) { max_per_client_ = max_per_client; }
+    size_t getMaxConnections() const { return max_connections_; }
+    size_t getMaxConnectionsPerClient() const { return max_per_client_; }
+
+    // Reserve a slot for a new connection from `client`. Every successful
+    // call must be paired with release() for the same client.
+    bool tryAdmit(const std::string& client);
+    void release(const std::string& client);
+
+    size_t getActiveConnections() const { return active_.load(std::memory_order_relaxed); }
+    size_t getActiveConnections(const std::string& client) const;
+    // Connections refused by either limit
+    uint64_t getRejectedCount() const { return rejected_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<size_t> max_connections_;
+    std::atomic<size_t> max_per_client_;
+    std::atomic<size_t> active_;
+    std::atomic<uint64_t> rejected_;
+
+    // Only maintained while a per-client limit is set
+    mutable std::mutex clients_mutex_;
+    std::unordered_map<std::string, size_t> clients_;
+};
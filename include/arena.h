@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+// Monotonic arena for the lifetime of one request on a connection. Memory
+// is handed out by bumping a pointer through a chain of blocks and is never
+// freed piecemeal; reset() rewinds to the first block in O(1) and keeps the
+// blocks for the next request, so a keep-alive connection stops calling
+// malloc once its arena has grown to fit its requests. Anything allocated
+// from the arena must be gone (or have let go of its memory) before reset().
+// Used by one thread at a time.
+class Arena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kDefaultBlockSize = 8 * 1024;
+    // Blocks, beyond the first, kept across reset(); an unusually large
+    // request should not pin its memory to the connection forever
+    static constexpr size_t kMaxRetainedBlocks = 8;
+
+    explicit Arena(size_t block_size = kDefaultBlockSize);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void reset();
+
+    // Bytes handed out since the last reset, and bytes held in blocks
+    size_t getUsed() const { return used_; }
+    size_t getCapacity() const { return capacity_; }
+
+private:
+    struct Block {
+        Block* next;
+        size_t size; // usable bytes following the header
+    };
+
+    size_t block_size_;
+    Block* first_;
+    Block* current_;
+    char* cursor_;
+    char* end_;
+    size_t used_;
+    size_t capacity_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    void* allocateFromNextBlock(size_t bytes, size_t alignment);
+    static char* dataOf(Block* block) { return reinterpret_cast<char*>(block + 1); }
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "compression.h"
+#include "file_cache.h"
+
+// True if an If-None-Match value lists `etag` (or is "*"). Uses the weak
+// comparison RFC 9110 prescribes for If-None-Match, so W/ prefixes are ignored.
+bool etagMatches(std::string_view if_none_match, std::string_view etag);
+
+// A static file held in memory with everything a response needs: the bytes,
+// precompressed variants and the validators for conditional requests.
+struct Asset {
+    struct Variant {
+        std::shared_ptr<const std::string> body; // null if the coding is not offered
+        std::string etag;                        // quoted strong validator of `body`
+    };
+
+    std::string path;
+    std::string content_type;
+    std::string last_modified; // IMF-fixdate
+    time_t modified_time = 0;
+    Variant variants[compression::kEncodingCount]; // indexed by compression::Encoding
+
+    const Variant& variant(compression::Encoding encoding) const {
+        return variants[static_cast<size_t>(encoding)];
+    }
+
+    // Best variant the client accepts; IDENTITY when nothing else is
+    compression::Encoding selectEncoding(std::string_view accept_encoding) const;
+
+    // True if any variant matches, so a client revalidating a gzip copy
+    // still gets a 304
+    bool matchesEtag(std::string_view if_none_match) const;
+
+    bool hasCompressedVariants() const {
+        return variant(compression::Encoding::GZIP).body || variant(compression::Encoding::BROTLI).body;
+    }
+
+    size_t memoryUsage() const;
+};
+
+// Bounded-memory LRU of small static files keyed by path. Assets are built
+// from files opened through a FileCache, which already revalidates against
+// the disk; an asset is rebuilt whenever the file it came from no longer
+// matches (different inode, size or mtime). Thread-safe.
+class AssetCache {
+public:
+    static constexpr size_t kDefaultMaxBytes = 64 * 1024 * 1024;
+    static constexpr size_t kDefaultMaxAssetSize = 1024 * 1024;
+    // Smaller bodies gain nothing from compression
+    static constexpr size_t kMinCompressSize = 256;
+
+    explicit AssetCache(size_t max_bytes = kDefaultMaxBytes, size_t max_asset_size = kDefaultMaxAssetSize);
+
+    // nullptr if the file is larger than the asset limit or cannot be read;
+    // such files should be sent from disk instead
+    std::shared_ptr<const Asset> get(const std::shared_ptr<const CachedFile>& file);
+
+    void clear();
+    size_t size() const;
+    size_t getMemoryUsage() const;
+    size_t getMaxAssetSize() const { return max_asset_size_; }
+
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const Asset> asset;
+        uint64_t device;
+        uint64_t inode;
+        size_t size;
+        int64_t mtime_ns;
+        std::list<std::string>::iterator lru_position;
+    };
+
+    size_t max_bytes_;
+    size_t max_asset_size_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // most recently used first
+    size_t memory_usage_;
+    uint64_t hits_;
+    uint64_t misses_;
+
+    static std::shared_ptr<const Asset> build(const CachedFile& file);
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+    void evictOverflow();
+};
+
+// Compressed copies of files too large to be assets, made the first time a
+// coding is asked for and then shared by every response sending them, so a
+// popular file is compressed once rather than per request. Bounded-memory
+// LRU keyed by path and coding; like AssetCache it rebuilds an entry once
+// the file no longer matches. A file that would not shrink, or whose
+// compressed form would outgrow the entry limit, is remembered as such and
+// keeps being sent from disk. Thread-safe.
+class CompressedFileCache {
+public:
+    static constexpr size_t kDefaultMaxBytes = 64 * 1024 * 1024;
+    static constexpr size_t kDefaultMaxEntrySize = 16 * 1024 * 1024;
+    // Files are read and compressed this much at a time
+    static constexpr size_t kReadChunkSize = 64 * 1024;
+
+    explicit CompressedFileCache(size_t max_bytes = kDefaultMaxBytes, size_t max_entry_size = kDefaultMaxEntrySize);
+
+    // `file` in `encoding`; nullptr if the coding is unavailable, the file
+    // cannot be read or compressing it does not pay
+    std::shared_ptr<const std::string> get(const std::shared_ptr<const CachedFile>& file,
+                                           compression::Encoding encoding);
+
+    void clear();
+    size_t size() const;
+    size_t getMemoryUsage() const;
+
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const std::string> body; // null: sent uncompressed
+        uint64_t device;
+        uint64_t inode;
+        size_t size;
+        int64_t mtime_ns;
+        std::list<std::string>::iterator lru_position;
+    };
+
+    size_t max_bytes_;
+    size_t max_entry_size_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // most recently used first
+    size_t memory_usage_;
+    uint64_t hits_;
+    uint64_t misses_;
+
+    std::shared_ptr<const std::string> build(const CachedFile& file, compression::Encoding encoding) const;
+    static size_t memoryUsage(const std::string& key, const Entry& entry);
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+    void evictOverflow();
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "compression.h"
+
+// Response body produced while it is being sent. The handler's producer
+// writes to it from any thread; the event loop owning the connection takes
+// whatever has been written each time the socket (or HTTP/2 flow control)
+// can accept more. Writers block once kHighWaterMark bytes are waiting, so
+// a fast producer is paced by the client rather than buffering the whole
+// body, and time to first byte no longer depends on its size. Thread-safe.
+class BodyStream {
+public:
+    static constexpr size_t kHighWaterMark = 256 * 1024;
+
+    enum class State {
+        OPEN,
+        ENDED,  // closed by the producer, everything taken
+        FAILED  // the producer gave up; the client must not see a complete body
+    };
+
+    // Asks the loop to come and take(); called with the stream's lock held,
+    // so it must only hand off (post to the loop). Not called again until
+    // take() has run, and never after abort().
+    using Notify = std::function<void()>;
+
+    explicit BodyStream(Notify notify);
+
+    BodyStream(const BodyStream&) = delete;
+    BodyStream& operator=(const BodyStream&) = delete;
+
+    // Producer side. Queue `data`, waiting while the high-water mark is
+    // exceeded; false once the stream has been closed or the client has gone
+    // away, after which nothing more is sent.
+    bool write(std::string_view data);
+    // One server-sent event (text/event-stream): optional `event` and `id`
+    // fields, then `data` with each of its lines as a data field
+    bool sendEvent(std::string_view data, std::string_view event = {}, std::string_view id = {});
+    // End the body; later writes fail
+    void close();
+    // End it abnormally (the producer hit an error): the response is cut
+    // off rather than finished
+    void fail();
+    // False once closed, failed or aborted
+    bool isOpen() const;
+
+    // Compress the body with `encoding` from here on. Each take() flushes
+    // the compressor, so a piece is never held back waiting for more (an
+    // event goes out as soon as it is sent) at some cost in ratio. Call
+    // before the first write; false if the coding cannot be started.
+    bool encode(compression::Encoding encoding);
+
+    // Connection side. Move everything written so far onto the end of
+    // `out`, compressed if encode() was called, and report whether more is
+    // to come.
+    State take(std::string& out);
+    // Something to take, or the end of the body
+    bool isReady() const;
+    // The client has gone away or the server is stopping: writers waiting
+    // on backpressure wake up and every write from now on fails
+    void abort();
+
+    // Event formatting used by sendEvent(), for callers batching events
+    static void appendEvent(std::string& out, std::string_view data, std::string_view event = {},
+                            std::string_view id = {});
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable drained_;
+    std::string pending_;
+    Notify notify_;
+    bool notified_;
+    bool closed_;
+    bool failed_;
+    bool aborted_;
+    // Set once by encode(), then used only by the taking side
+    std::unique_ptr<compression::Compressor> encoder_;
+    bool encoder_finished_;
+
+    void notifyLocked();
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Content-coding helpers. gzip needs zlib (HAVE_ZLIB), br the brotli encoder
+// (HAVE_BROTLI) and zstd libzstd (HAVE_ZSTD); unavailable codings simply
+// report failure so callers fall back to the identity encoding.
+namespace compression {
+
+enum class Encoding {
+    IDENTITY,
+    GZIP,
+    BROTLI,
+    ZSTD
+};
+
+constexpr size_t kEncodingCount = 4;
+
+bool isAvailable(Encoding encoding);
+
+// Token used in Content-Encoding / Accept-Encoding ("gzip", "br", "zstd")
+std::string_view name(Encoding encoding);
+
+// Compress `input` into `output` (replacing its contents) at the best ratio
+// the coding offers; asset compression happens once per file, so speed is
+// secondary. Returns false if the coding is unavailable or fails.
+bool compress(Encoding encoding, std::string_view input, std::string& output);
+
+// Text-like media types worth compressing (images and video already are)
+bool isCompressibleType(std::string_view content_type);
+
+// Weight the client gives a coding in an Accept-Encoding value (0 = refused)
+double acceptWeight(std::string_view accept_encoding, Encoding encoding);
+
+// Best available coding for compressing a response on the fly; IDENTITY
+// when the client accepts none
+Encoding negotiate(std::string_view accept_encoding);
+
+// Streaming compressor for responses built per request. Levels favour speed
+// over ratio (gzip 6, br 5, zstd 3). Setting up a context is costly (zlib's
+// deflate state alone is about 256 KiB), so each thread keeps one per coding
+// and rewinds it between bodies; see forThread().
+class Compressor {
+public:
+    explicit Compressor(Encoding encoding);
+    ~Compressor();
+
+    Compressor(const Compressor&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+
+    Encoding getEncoding() const { return encoding_; }
+
+    // Start a new stream, abandoning any unfinished one
+    bool begin();
+    // Compress `input`, appending whatever output is ready to `output`
+    bool update(std::string_view input, std::string& output);
+    // Append everything given so far, complete enough for the client to
+    // decode, without ending the stream (costs some ratio; for streamed
+    // bodies whose pieces must not wait)
+    bool flush(std::string& output);
+    // Append the rest of the stream to `output` and end it
+    bool finish(std::string& output);
+
+    // This thread's compressor for `encoding`; nullptr if unavailable
+    static Compressor* forThread(Encoding encoding);
+
+private:
+    Encoding encoding_;
+    void* state_; // z_stream, BrotliEncoderState or ZSTD_CCtx
+
+    enum class Mode {
+        PROCESS,
+        FLUSH,
+        FINISH
+    };
+
+    bool run(std::string_view input, std::string& output, Mode mode);
+    void release();
+};
+
+} // namespace compression
@@ -0,0 +1,198 @@
+#pragma once
+
+#ifndef BUILD_WASM
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "arena.h"
+#include "body_stream.h"
+#include "file_cache.h"
+#include "http2_session.h"
+#include "http_request.h"
+#include "http_response.h"
+#include "request_framer.h"
+#include "timer_wheel.h"
+
+#ifdef ENABLE_SSL
+#include "ssl_server.h"
+#endif
+
+// Per-client state owned by the event loop. The socket is non-blocking; all
+// methods are called from the loop thread only.
+class Connection {
+public:
+    enum class State {
+        READING,
+        PROCESSING,
+        WRITING,
+        CLOSING, // last response sent during a 0-RTT handshake; finishing it first
+        CLOSED
+    };
+
+    Connection(int socket, const std::string& remote_address, size_t max_body_size);
+    ~Connection();
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    int getSocket() const { return socket_; }
+    const std::string& getRemoteAddress() const { return remote_address_; }
+
+    State getState() const { return state_; }
+    void setState(State state) { state_ = state; }
+    bool isClosed() const { return state_ == State::CLOSED; }
+
+#ifdef ENABLE_SSL
+    // Speak TLS on this connection; takes ownership of `ssl`. The handshake
+    // is driven from readAvailable(), and reads and writes go through the
+    // TLS layer (or the kernel, once kTLS has taken over the socket).
+    void enableTls(SslServer& tls, SSL* ssl);
+#endif
+    bool isHandshaking() const { return handshaking_; }
+    // TLS can need the other readiness to make progress: a read that must
+    // first flush handshake data, or a write waiting on the peer's Finished
+    bool readWantsWrite() const { return read_wants_write_; }
+    bool writeWantsRead() const { return write_wants_read_; }
+    // Whether the next `length` bytes taken from the input buffer include
+    // any that arrived as TLS 1.3 early data
+    bool takeEarlyData(size_t length);
+    // Protocol the client and server agreed on through ALPN; empty for
+    // plaintext connections and clients that offered none
+    std::string_view getAlpnProtocol() const;
+    bool isTls() const;
+    // Whether the TLS handshake resumed an earlier session
+    bool isTlsResumed() const;
+
+    // Once set, the connection speaks HTTP/2: the session consumes the input
+    // buffer and its frames go out through the head buffer
+    void enableHttp2(std::unique_ptr<Http2Session> session) { http2_ = std::move(session); }
+    Http2Session* getHttp2() const { return http2_.get(); }
+
+    // Read until the kernel buffer is drained. Returns false on socket error.
+    bool readAvailable();
+    bool isPeerClosed() const { return peer_closed_; }
+    std::string& getInputBuffer() { return input_buffer_; }
+    RequestFramer& getFramer() { return framer_; }
+
+    // The HTTP/1.x request being served and its response, both allocated
+    // from the connection's arena. nextRequest() destroys the previous pair,
+    // rewinds the arena and starts a fresh one, so a keep-alive connection
+    // reuses the same memory for every request. Like the head buffer, the
+    // pair belongs to the worker while the connection is PROCESSING; nothing
+    // built from them may outlive the next call.
+    HttpRequest& nextRequest();
+    HttpRequest& getRequest() { return *request_; }
+    HttpResponse& getResponse() { return *response_; }
+
+    // Responses are written as two pieces: a head serialized into a buffer
+    // that is reused across responses, and the body, which is sent as its own
+    // iovec instead of being copied behind the head. The head buffer may be
+    // filled by the worker building the response while the connection is
+    // PROCESSING; otherwise only the loop thread touches it.
+    std::string& getHeadBuffer() { return head_buffer_; }
+    void queueBody(std::string body);
+    // Shared bodies (cached assets) are sent in place and never copied
+    void queueBody(std::shared_ptr<const std::string> body);
+    // A file body follows the head and is sent with sendfile(2)
+    void queueFile(std::shared_ptr<const CachedFile> file);
+    // A streamed body (HTTP/1.x) follows the head piece by piece as its
+    // producer writes it; the loop moves each batch into the body buffer
+    // once the previous one has gone out, framed as a chunk when `chunked`.
+    // Aborted when the connection closes.
+    void setBodyStream(std::shared_ptr<BodyStream> stream, bool chunked) {
+        body_stream_ = std::move(stream);
+        body_stream_chunked_ = chunked;
+    }
+    BodyStream* getBodyStream() const { return body_stream_.get(); }
+    bool isBodyStreamChunked() const { return body_stream_chunked_; }
+
+    // Write as much as the socket accepts. Returns false on socket error.
+    bool flushOutput();
+    bool hasPendingOutput() const {
+        return head_offset_ < head_buffer_.size() || body_offset_ < body_.size() ||
+               (file_body_ && file_offset_ < file_body_->getSize());
+    }
+
+    // Keep-alive bookkeeping
+    bool isKeepAlive() const { return keep_alive_; }
+    // HTTP/1.x requests taken off this connection so far
+    uint64_t getRequestCount() const { return request_count_; }
+    void countRequest() { ++request_count_; }
+    void setKeepAlive(bool keep_alive) { keep_alive_ = keep_alive; }
+    std::chrono::steady_clock::time_point getLastActivity() const { return last_activity_; }
+    void touch() { last_activity_ = std::chrono::steady_clock::now(); }
+
+    // Timeout bookkeeping. The timer sits in the owning loop's wheel, tagged
+    // with the socket. The request clock starts when the first byte of a
+    // request arrives (at accept for the first one) and also marks the start
+    // of the body-rate window, which the loop moves on at each rate check.
+    TimerWheel::Timer& getTimer() { return timer_; }
+    uint64_t getBytesReceived() const { return bytes_received_; }
+    std::chrono::steady_clock::time_point getRequestStart() const { return request_start_; }
+    void startRequestClock();
+    std::chrono::steady_clock::time_point getRateMark() const { return rate_mark_; }
+    uint64_t getRateMarkBytes() const { return rate_mark_bytes_; }
+    void markRate(std::chrono::steady_clock::time_point now) {
+        rate_mark_ = now;
+        rate_mark_bytes_ = bytes_received_;
+    }
+
+    void close();
+
+private:
+    int socket_;
+    std::string remote_address_;
+    State state_;
+    bool peer_closed_;
+    bool keep_alive_;
+    uint64_t request_count_;
+    std::chrono::steady_clock::time_point last_activity_;
+    TimerWheel::Timer timer_;
+    uint64_t bytes_received_;
+    std::chrono::steady_clock::time_point request_start_;
+    std::chrono::steady_clock::time_point rate_mark_;
+    uint64_t rate_mark_bytes_;
+
+    std::string input_buffer_;
+    RequestFramer framer_;
+    Arena arena_; // declared before the objects living in it
+    std::optional<HttpRequest> request_;
+    std::optional<HttpResponse> response_;
+    std::string head_buffer_;
+    size_t head_offset_;
+    std::string body_buffer_;
+    std::shared_ptr<const std::string> shared_body_;
+    std::string_view body_; // body_buffer_ or *shared_body_
+    size_t body_offset_;
+    std::shared_ptr<const CachedFile> file_body_;
+    size_t file_offset_;
+    std::shared_ptr<BodyStream> body_stream_;
+    bool body_stream_chunked_;
+    std::unique_ptr<Http2Session> http2_;
+
+    bool handshaking_;
+    bool early_data_open_;
+    bool read_wants_write_;
+    bool write_wants_read_;
+    size_t early_bytes_; // leading bytes of input_buffer_ that came as 0-RTT data
+#ifdef ENABLE_SSL
+    SslServer* tls_;
+    SSL* ssl_;
+    std::chrono::steady_clock::time_point handshake_started_;
+
+    bool readTls();
+    bool flushBuffersTls();
+    bool flushFileTls();
+#endif
+
+    void receive(const char* data, size_t length);
+    bool flushBuffers();
+    bool flushFile();
+};
+
+#endif // BUILD_WASM
@@ -0,0 +1,66 @@
+#pragma once
+
+#ifndef BUILD_WASM
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Single-threaded epoll reactor. All registration calls and callbacks run on
+// the thread executing run(); other threads hand work over with post().
+class EventLoop {
+public:
+    using EventCallback = std::function<void(uint32_t events)>;
+    using Functor = std::function<void()>;
+
+    EventLoop();
+    ~EventLoop();
+
+    // Descriptor registration
+    bool add(int fd, uint32_t events, EventCallback callback);
+    bool modify(int fd, uint32_t events);
+    void remove(int fd);
+
+    // Loop lifecycle
+    void run();
+    void stop();
+    bool isRunning() const { return is_running_; }
+    bool isInLoopThread() const { return loop_thread_ == std::this_thread::get_id(); }
+
+    // Run a functor on the loop thread (thread-safe)
+    void post(Functor functor);
+
+    // Invoke a functor periodically on the loop thread
+    bool runEvery(int interval_ms, Functor functor);
+
+private:
+    struct Handler {
+        int fd;
+        EventCallback callback;
+        bool active;
+    };
+
+    int epoll_fd_;
+    int wakeup_fd_;
+    std::atomic<bool> is_running_;
+    std::atomic<bool> quit_;
+    std::thread::id loop_thread_;
+
+    std::unordered_map<int, std::unique_ptr<Handler>> handlers_;
+    std::vector<std::unique_ptr<Handler>> retired_handlers_;
+
+    std::vector<int> timer_fds_;
+
+    std::mutex pending_mutex_;
+    std::vector<Functor> pending_functors_;
+
+    void wakeup();
+    void runPendingFunctors();
+};
+
+#endif // BUILD_WASM
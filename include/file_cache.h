@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// A regular file opened for reading together with the metadata captured when
+// it was opened. Shared between the cache and responses still sending it; the
+// descriptor is closed when the last owner lets go.
+class CachedFile {
+public:
+    ~CachedFile();
+
+    CachedFile(const CachedFile&) = delete;
+    CachedFile& operator=(const CachedFile&) = delete;
+
+    // nullptr unless `path` names a readable regular file
+    static std::shared_ptr<const CachedFile> open(const std::string& path);
+
+    int getFd() const { return fd_; }
+    const std::string& getPath() const { return path_; }
+    size_t getSize() const { return size_; }
+    int64_t getModifiedTimeNs() const { return mtime_ns_; }
+    uint64_t getDevice() const { return device_; }
+    uint64_t getInode() const { return inode_; }
+
+    // Append `length` bytes starting at `offset` to `out` (pread, so the file
+    // position is never shared between threads)
+    bool readInto(std::string& out, size_t offset, size_t length) const;
+    // Into caller memory of at least `length` bytes
+    bool readInto(char* out, size_t offset, size_t length) const;
+
+    // True if the file on disk is still the one this object refers to
+    bool matchesDisk() const;
+
+private:
+    CachedFile(int fd, const std::string& path);
+
+    int fd_;
+    std::string path_;
+    size_t size_;
+    int64_t mtime_ns_;
+    uint64_t device_;
+    uint64_t inode_;
+};
+
+// Bounded LRU of open files keyed by path. Within `revalidate_after` of the
+// last check a hit costs no system call; after that a stat() confirms the
+// entry still matches the file on disk before it is reused. Thread-safe.
+class FileCache {
+public:
+    static constexpr size_t kDefaultCapacity = 256;
+    static constexpr std::chrono::milliseconds kDefaultRevalidateAfter{1000};
+
+    explicit FileCache(size_t capacity = kDefaultCapacity,
+                       std::chrono::milliseconds revalidate_after = kDefaultRevalidateAfter);
+
+    std::shared_ptr<const CachedFile> open(const std::string& path);
+
+    void clear();
+    void setCapacity(size_t capacity);
+    size_t size() const;
+
+    // Lookups answered from the cache without opening the file
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const CachedFile> file;
+        std::chrono::steady_clock::time_point checked_at;
+        std::list<std::string>::iterator lru_position;
+    };
+
+    size_t capacity_;
+    std::chrono::milliseconds revalidate_after_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // most recently used first
+    uint64_t hits_;
+    uint64_t misses_;
+
+    void evictOverflow();
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "request_parser.h"
+
+// Well-known header names, resolved once when a field is stored so that
+// lookups by id are a single array index
+enum class HeaderId : uint8_t {
+    HOST,
+    CONNECTION,
+    CONTENT_LENGTH,
+    CONTENT_TYPE,
+    TRANSFER_ENCODING,
+    KEEP_ALIVE,
+    ACCEPT,
+    ACCEPT_ENCODING,
+    CONTENT_ENCODING,
+    USER_AGENT,
+    DATE,
+    SERVER,
+    CACHE_CONTROL,
+    ETAG,
+    IF_NONE_MATCH,
+    IF_MODIFIED_SINCE,
+    LAST_MODIFIED,
+    EXPECT,
+    UPGRADE,
+    COOKIE,
+    AUTHORIZATION,
+    ORIGIN,
+    LOCATION,
+    RANGE,
+    VARY,
+    COUNT,
+    OTHER = COUNT
+};
+
+// Ordered, case-insensitive header container. Names and values live in one
+// owned byte buffer and fields refer to it by offset, so adding a header does
+// not allocate per field (the field table itself is inline up to
+// kInlineFields) and copies need no fix-up. The buffer comes from the given
+// memory resource (a connection's request arena, say); a copy-constructed
+// map uses the default resource, a moved-to one keeps the source's.
+class HeaderMap {
+public:
+    static constexpr size_t kInlineFields = 16;
+
+    struct Field {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    class const_iterator {
+    public:
+        const_iterator(const HeaderMap* map, size_t index) : map_(map), index_(index) {}
+
+        Field operator*() const { return map_->at(index_); }
+        const_iterator& operator++() { ++index_; return *this; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+
+    private:
+        const HeaderMap* map_;
+        size_t index_;
+    };
+
+    explicit HeaderMap(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Append a field; duplicates are kept in arrival order
+    void add(std::string_view name, std::string_view value);
+    // Replace every field with this name by a single one
+    void set(std::string_view name, std::string_view value);
+    bool remove(std::string_view name);
+    void clear(); // keeps the buffer for reuse
+
+    // Adopt a parsed request head: `head` is copied once and the parser's
+    // field spans are used as offsets into it
+    void assign(std::string_view head, const std::vector<RequestParser::HeaderField>& fields);
+
+    // First value for the name, or a null view when absent
+    std::string_view get(std::string_view name) const;
+    std::string_view get(HeaderId id) const;
+    bool contains(std::string_view name) const { return get(name).data() != nullptr; }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    Field at(size_t index) const;
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+
+    static HeaderId idOf(std::string_view name);
+
+private:
+    struct Entry {
+        uint32_t name_offset;
+        uint32_t name_length;
+        uint32_t value_offset;
+        uint32_t value_length;
+        HeaderId id;
+    };
+
+    std::pmr::string storage_;
+    Entry inline_[kInlineFields];
+    std::pmr::vector<Entry> overflow_;
+    size_t size_;
+    size_t garbage_; // bytes of storage_ no longer referenced
+    uint16_t first_[static_cast<size_t>(HeaderId::COUNT)]; // index + 1 of the first field, 0 if none
+
+    Entry& entry(size_t index) { return index < kInlineFields ? inline_[index] : overflow_[index - kInlineFields]; }
+    const Entry& entry(size_t index) const {
+        return index < kInlineFields ? inline_[index] : overflow_[index - kInlineFields];
+    }
+
+    void push(const Entry& entry);
+    bool aliasesStorage(std::string_view text) const;
+    size_t find(std::string_view name, HeaderId id) const;
+    void eraseAt(size_t index);
+    void rebuildIndex();
+    void compact();
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// HPACK header compression for HTTP/2 (RFC 7541)
+namespace hpack {
+
+// Default SETTINGS_HEADER_TABLE_SIZE
+constexpr size_t kDefaultTableSize = 4096;
+
+// The static table followed by the dynamic one, addressed by the 1-based
+// indices HPACK uses. Dynamic entries are evicted oldest first to keep the
+// table within its size (name + value + 32 bytes per entry).
+class HeaderTable {
+public:
+    static constexpr size_t kStaticEntries = 61;
+    static constexpr size_t kEntryOverhead = 32;
+
+    explicit HeaderTable(size_t max_size = kDefaultTableSize);
+
+    void setMaxSize(size_t max_size);
+    size_t getMaxSize() const { return max_size_; }
+    size_t getSize() const { return size_; }
+    size_t getDynamicCount() const { return entries_.size(); }
+
+    // Entries larger than the whole table empty it and are not stored
+    void insert(std::string_view name, std::string_view value);
+    bool lookup(size_t index, std::string_view& name, std::string_view& value) const;
+    // Index of an exact match, or 0; `name_index` gets the first entry with
+    // this name (0 if none)
+    size_t find(std::string_view name, std::string_view value, size_t& name_index) const;
+
+private:
+    struct Entry {
+        std::string name;
+        std::string value;
+    };
+
+    std::deque<Entry> entries_; // newest first
+    size_t size_;
+    size_t max_size_;
+
+    void evictTo(size_t limit);
+};
+
+// Decodes header blocks for one connection; the dynamic table carries over
+// from block to block, so every block must be decoded in arrival order.
+class Decoder {
+public:
+    // Return false to reject a field; decoding then fails
+    using FieldHandler = std::function<bool(std::string_view name, std::string_view value)>;
+
+    explicit Decoder(size_t max_table_size = kDefaultTableSize);
+
+    // Upper bound for table size updates the peer may send (our
+    // SETTINGS_HEADER_TABLE_SIZE)
+    void setMaxTableSize(size_t max_size) { max_table_size_ = max_size; }
+
+    // Decode one complete header block. False is a COMPRESSION_ERROR: the
+    // table is then out of step with the peer and the connection must end.
+    bool decode(const uint8_t* data, size_t length, const FieldHandler& on_field);
+
+    const HeaderTable& getTable() const { return table_; }
+
+private:
+    HeaderTable table_;
+    size_t max_table_size_;
+    std::string name_buffer_;
+    std::string value_buffer_;
+
+    bool readString(const uint8_t*& data, const uint8_t* end, std::string& out);
+};
+
+// Encodes header blocks for one connection. Fields are indexed when they
+// match a table entry and otherwise added to the dynamic table, except for
+// values that change with every response; strings are Huffman coded when
+// that is shorter.
+class Encoder {
+public:
+    explicit Encoder(size_t max_table_size = kDefaultTableSize);
+
+    // The peer's SETTINGS_HEADER_TABLE_SIZE; announced at the start of the
+    // next block
+    void setMaxTableSize(size_t max_size);
+
+    // `name` must already be lowercase
+    void encode(std::string_view name, std::string_view value, std::string& out);
+    // Call before the first field of every block
+    void beginBlock(std::string& out);
+
+    const HeaderTable& getTable() const { return table_; }
+
+private:
+    HeaderTable table_;
+    size_t pending_table_size_;
+    bool table_size_changed_;
+
+    static bool shouldIndex(std::string_view name);
+    static void writeString(std::string_view text, std::string& out);
+};
+
+// Primitive codings, exposed for tests
+void encodeInteger(uint64_t value, uint8_t prefix_bits, uint8_t flags, std::string& out);
+bool decodeInteger(const uint8_t*& data, const uint8_t* end, uint8_t prefix_bits, uint64_t& value);
+size_t huffmanEncodedLength(std::string_view text);
+void huffmanEncode(std::string_view text, std::string& out);
+bool huffmanDecode(const uint8_t* data, size_t length, std::string& out);
+
+} // namespace hpack
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "body_stream.h"
+#include "file_cache.h"
+#include "header_map.h"
+#include "hpack.h"
+#include "http_request.h"
+#include "http_response.h"
+
+// Server side of one HTTP/2 connection (RFC 9113) as a bytes-in, bytes-out
+// state machine: feed it what the socket delivered, hand it responses, and
+// write out whatever it produces. It does no I/O and no locking; the event
+// loop that owns the connection makes every call.
+class Http2Session {
+public:
+    static constexpr std::string_view kPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    static constexpr uint32_t kMaxConcurrentStreams = 100;
+    static constexpr uint32_t kStreamWindowSize = 1 << 20;      // granted to each request body
+    static constexpr uint32_t kConnectionWindowSize = 16 << 20; // shared by all of them
+    static constexpr uint32_t kMaxFrameSize = 16384;            // largest frame we accept
+    static constexpr size_t kMaxHeaderListSize = 64 * 1024;
+
+    enum class ErrorCode : uint32_t {
+        NO_ERROR = 0x0,
+        PROTOCOL_ERROR = 0x1,
+        INTERNAL_ERROR = 0x2,
+        FLOW_CONTROL_ERROR = 0x3,
+        STREAM_CLOSED = 0x5,
+        FRAME_SIZE_ERROR = 0x6,
+        REFUSED_STREAM = 0x7,
+        CANCEL = 0x8,
+        COMPRESSION_ERROR = 0x9,
+        ENHANCE_YOUR_CALM = 0xb
+    };
+
+    // A complete request arrived on `stream_id`; answer with submitResponse()
+    using RequestCallback = std::function<void(uint32_t stream_id, std::shared_ptr<HttpRequest> request)>;
+
+    Http2Session(size_t max_body_size, RequestCallback on_request);
+
+    ~Http2Session();
+
+    Http2Session(const Http2Session&) = delete;
+    Http2Session& operator=(const Http2Session&) = delete;
+
+    // Consume `input`, starting with the client preface; a trailing partial
+    // frame is left in it. False on a connection error: a GOAWAY is queued,
+    // and the caller should flush it and close.
+    bool receive(std::string& input);
+
+    // Queue the response for a stream; dropped if the client reset it. With
+    // `body`, DATA is taken from it as it is written and flow control allows,
+    // and END_STREAM follows once it ends.
+    void submitResponse(uint32_t stream_id, HttpResponse response, std::shared_ptr<BodyStream> body = nullptr);
+    // Producers still writing to any stream find out the session is gone
+    void abortBodyStreams();
+
+    // Append frames that are ready to `out`: control frames and headers
+    // first, then DATA round-robin across streams as flow control allows,
+    // stopping once roughly `limit` bytes have been added
+    void takeOutput(std::string& out, size_t limit);
+    bool hasOutput() const;
+
+    // Stop accepting streams; those already open still complete
+    void goAway(ErrorCode code = ErrorCode::NO_ERROR);
+    // Either side has sent GOAWAY and every stream has finished
+    bool isFinished() const { return (going_away_ || peer_going_away_) && streams_.empty(); }
+    bool hasOpenStreams() const { return !streams_.empty(); }
+    size_t getStreamCount() const { return streams_.size(); }
+
+private:
+    struct Stream {
+        // Request being received
+        HeaderMap headers;
+        std::string method;
+        std::string path;
+        std::string authority;
+        bool has_scheme = false;
+        bool malformed = false;
+        bool headers_too_large = false;
+        size_t header_list_size = 0;
+        std::string body;
+        bool remote_closed = false; // END_STREAM seen from the client
+        bool dispatched = false;
+        int64_t recv_window = kStreamWindowSize;
+        uint32_t recv_unacked = 0;
+
+        // Response being sent
+        bool responded = false;
+        bool head_only = false;
+        int64_t send_window = 0;
+        std::string response_body;
+        std::shared_ptr<const std::string> shared_body;
+        std::shared_ptr<const CachedFile> file_body;
+        size_t body_offset = 0;
+        size_t body_size = 0;
+        std::shared_ptr<BodyStream> body_stream; // refills response_body
+        bool body_stream_ended = false;
+    };
+
+    size_t max_body_size_;
+    RequestCallback on_request_;
+    hpack::Decoder decoder_;
+    hpack::Encoder encoder_;
+
+    std::map<uint32_t, Stream> streams_; // open or awaiting/sending a response
+    uint32_t last_stream_id_;            // highest client stream seen
+    uint32_t last_served_id_;            // round-robin position for DATA
+    bool preface_received_;
+    bool going_away_;
+    bool peer_going_away_;
+    uint64_t resets_received_;
+    uint64_t responses_completed_;
+
+    // Peer's settings and our send windows
+    uint32_t peer_max_frame_size_;
+    int64_t peer_initial_window_;
+    int64_t send_window_;
+    // Our receive window for the connection
+    int64_t recv_window_;
+    uint32_t recv_unacked_;
+
+    // An open HEADERS + CONTINUATION sequence
+    std::string header_block_;
+    uint32_t header_stream_id_;
+    uint8_t header_flags_;
+    bool in_header_block_;
+
+    std::string control_; // frames ready to go out ahead of DATA
+
+    bool processFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length);
+    bool onData(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length);
+    bool onHeaders(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length);
+    bool onContinuation(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length);
+    bool onHeaderBlock();
+    bool onRstStream(uint32_t stream_id, const uint8_t* payload, size_t length);
+    bool onSettings(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length);
+    bool onPing(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length);
+    bool onGoAway(uint32_t stream_id, size_t length);
+    bool onWindowUpdate(uint32_t stream_id, const uint8_t* payload, size_t length);
+
+    bool connectionError(ErrorCode code);
+    void resetStream(uint32_t stream_id, ErrorCode code);
+    void eraseStream(uint32_t stream_id);
+    void finishRequest(uint32_t stream_id, Stream& stream);
+    void respondWithStatus(uint32_t stream_id, HttpResponse::StatusCode status);
+    void creditReceived(uint32_t stream_id, Stream* stream, size_t length);
+    bool writeData(uint32_t stream_id, Stream& stream, std::string& out, size_t& budget);
+    static bool hasDataToSend(const Stream& stream);
+
+    void sendSettings();
+    void writeFrameHeader(std::string& out, size_t length, uint8_t type, uint8_t flags, uint32_t stream_id);
+    void writeWindowUpdate(uint32_t stream_id, uint32_t increment);
+};
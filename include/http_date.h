@@ -0,0 +1,16 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <string_view>
+
+// IMF-fixdate handling for Date, Last-Modified and If-Modified-Since
+// ("Sun, 06 Nov 1994 08:49:37 GMT", RFC 9110 section 5.6.7)
+namespace http_date {
+
+std::string format(time_t time);
+
+// Only the IMF-fixdate form is accepted; obsolete formats yield false
+bool parse(std::string_view text, time_t& time);
+
+} // namespace http_date
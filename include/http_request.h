@@ -1,8 +1,19 @@
 #pragma once
 
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <vector>
+
+#include "header_map.h"
+
+// Path capture filled in by the router: `name` refers to the route pattern,
+// the value is a range of the request path
+struct RouteParam {
+    std::string_view name;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
 
 class HttpRequest {
 public:
@@ -17,11 +28,26 @@ public:
         UNKNOWN
     };
 
+    static constexpr size_t kMaxRouteParams = 8;
+
+    using QueryParams = std::pmr::unordered_map<std::pmr::string, std::pmr::string>;
+
     HttpRequest();
-    explicit HttpRequest(const std::string& raw_request);
+    // Headers and query parameters are allocated from `resource`, which must
+    // outlive the request
+    explicit HttpRequest(std::pmr::memory_resource* resource);
+    explicit HttpRequest(std::string_view raw_request);
     
-    // Parse raw HTTP request
-    bool parse(const std::string& raw_request);
+    // Parse raw HTTP request; nothing refers back to `raw_request` afterwards
+    bool parse(std::string_view raw_request);
+    
+    // Take ownership of a message whose head `parser` has already parsed
+    bool load(std::string message, const RequestParser& parser);
+    
+    // Build from parts decoded elsewhere (HTTP/2 streams); `target` is the
+    // path with its query string
+    bool assign(std::string_view method, std::string_view target, std::string_view version, HeaderMap headers,
+                std::string body);
     
     // Getters
     Method getMethod() const { return method_; }
@@ -29,34 +55,49 @@ public:
     const std::string& getVersion() const { return version_; }
     const std::string& getBody() const { return body_; }
     
-    // Header operations
-    std::string getHeader(const std::string& name) const;
-    void setHeader(const std::string& name, const std::string& value);
-    const std::unordered_map<std::string, std::string>& getHeaders() const { return headers_; }
+    // Header operations (names are case-insensitive)
+    std::string getHeader(std::string_view name) const { return std::string(headers_.get(name)); }
+    void setHeader(std::string_view name, std::string_view value) { headers_.set(name, value); }
+    const HeaderMap& getHeaders() const { return headers_; }
+    
+    // Route parameters (`:name` and `*name` captures); views into the path,
+    // null when absent
+    std::string_view getParam(std::string_view name) const;
+    void setRouteParams(const RouteParam* params, size_t count);
     
     // Query parameters
     std::string getQueryParam(const std::string& name) const;
-    const std::unordered_map<std::string, std::string>& getQueryParams() const { return query_params_; }
+    const QueryParams& getQueryParams() const { return query_params_; }
     
     // Utility methods
     std::string methodToString() const;
-    static Method stringToMethod(const std::string& method_str);
+    static const char* methodName(Method method);
+    static Method stringToMethod(std::string_view method_str);
     bool isValid() const { return is_valid_; }
     
+    // Set when any part of the request arrived as TLS 1.3 early data, which
+    // an attacker can replay
+    void setEarlyData(bool early_data) { early_data_ = early_data; }
+    bool isEarlyData() const { return early_data_; }
+    
     // Content handling
     size_t getContentLength() const;
-    std::string getContentType() const;
+    std::string_view getContentType() const { return headers_.get(HeaderId::CONTENT_TYPE); }
 
 private:
     Method method_;
     std::string path_;
     std::string version_;
     std::string body_;
-    std::unordered_map<std::string, std::string> headers_;
-    std::unordered_map<std::string, std::string> query_params_;
+    HeaderMap headers_;
+    RouteParam route_params_[kMaxRouteParams];
+    size_t route_param_count_;
+    QueryParams query_params_;
     bool is_valid_;
+    bool early_data_;
     
-    void parseQueryParams(const std::string& query_string);
-    void parseHeaders(const std::vector<std::string>& header_lines);
-    std::string urlDecode(const std::string& encoded);
+    // Method, target and headers from a parsed head; the body is left to the caller
+    bool loadHead(std::string_view message, const RequestParser& parser);
+    void setTarget(std::string_view target);
+    void parseQueryParams(std::string_view query_string);
 };
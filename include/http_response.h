@@ -1,19 +1,32 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+
+#include "body_stream.h"
+#include "file_cache.h"
+#include "header_map.h"
 
 class HttpResponse {
 public:
+    using StreamProducer = std::function<void(const std::shared_ptr<BodyStream>& stream)>;
+
     enum class StatusCode {
         OK = 200,
         CREATED = 201,
         NO_CONTENT = 204,
+        NOT_MODIFIED = 304,
         BAD_REQUEST = 400,
         UNAUTHORIZED = 401,
         FORBIDDEN = 403,
         NOT_FOUND = 404,
         METHOD_NOT_ALLOWED = 405,
+        PAYLOAD_TOO_LARGE = 413,
+        TOO_EARLY = 425,
+        REQUEST_HEADER_FIELDS_TOO_LARGE = 431,
         INTERNAL_SERVER_ERROR = 500,
         NOT_IMPLEMENTED = 501,
         SERVICE_UNAVAILABLE = 503
@@ -21,27 +34,60 @@ public:
 
     HttpResponse();
     explicit HttpResponse(StatusCode status_code);
+    // Headers are allocated from `resource`, which must outlive the response
+    explicit HttpResponse(std::pmr::memory_resource* resource);
     
     // Status operations
     void setStatusCode(StatusCode code) { status_code_ = code; }
     StatusCode getStatusCode() const { return status_code_; }
     std::string getStatusText() const;
     
-    // Header operations
-    void setHeader(const std::string& name, const std::string& value);
-    std::string getHeader(const std::string& name) const;
-    const std::unordered_map<std::string, std::string>& getHeaders() const { return headers_; }
+    // Header operations (names are case-insensitive)
+    void setHeader(std::string_view name, std::string_view value) { headers_.set(name, value); }
+    // Another field of the name, for repeatable ones such as Link
+    void addHeader(std::string_view name, std::string_view value) { headers_.add(name, value); }
+    std::string getHeader(std::string_view name) const { return std::string(headers_.get(name)); }
+    const HeaderMap& getHeaders() const { return headers_; }
     
     // Body operations
     void setBody(const std::string& body);
+    void setBody(std::string&& body);
     void setBody(const char* body, size_t length);
-    const std::string& getBody() const { return body_; }
+    const std::string& getBody() const { return shared_body_ ? *shared_body_ : body_; } // empty when the body is a file
+    
+    // Immutable body shared with a cache: sent without being copied into
+    // the response
+    void setSharedBody(std::shared_ptr<const std::string> body);
+    const std::shared_ptr<const std::string>& getSharedBody() const { return shared_body_; }
+    
+    // File-backed body: sent straight from the descriptor (sendfile) rather
+    // than read into memory
+    void setFileBody(std::shared_ptr<const CachedFile> file);
+    const std::shared_ptr<const CachedFile>& getFileBody() const { return file_body_; }
+    size_t getBodySize() const { return file_body_ ? file_body_->getSize() : getBody().size(); }
+    
+    // Streamed body of unknown length: once the head is on its way,
+    // `producer` runs on a worker with the stream to write to. It may write
+    // everything and close the stream, or keep it and write later from any
+    // thread (a live feed); the response ends when the stream is closed or
+    // the producer drops its last reference to it.
+    // Sent chunked on HTTP/1.1, close-delimited on HTTP/1.0 and as DATA
+    // frames on HTTP/2. With compression enabled, a text-like stream is
+    // compressed as it goes, flushed at every batch the connection takes so
+    // each write still reaches the client without waiting for the next.
+    void setStreamingBody(StreamProducer producer);
+    // Server-sent events: text/event-stream, not cached, written with
+    // BodyStream::sendEvent()
+    void setEventStream(StreamProducer producer);
+    const StreamProducer& getStreamProducer() const { return stream_producer_; }
+    bool isStreaming() const { return static_cast<bool>(stream_producer_); }
     
     // Content type shortcuts
     void setJsonContent(const std::string& json);
     void setHtmlContent(const std::string& html);
     void setTextContent(const std::string& text);
     void setFileContent(const std::string& file_path);
+    void setFileContent(std::shared_ptr<const CachedFile> file);
     
     // CORS support
     void enableCors(const std::string& origin = "*");
@@ -49,16 +95,45 @@ public:
     // Generate HTTP response string
     std::string toString() const;
     
+    // Append the status line, headers and blank line to `buffer` in one pass;
+    // the body is left for the caller to send separately (scatter-gather)
+    void serializeHeadTo(std::string& buffer) const;
+    // Append the whole response to `buffer`; a file body is read in
+    void serializeTo(std::string& buffer) const;
+    // The same bytes written into caller memory of getSerializedSize() bytes
+    // (the WASM embedding's output buffer), with no intermediate string;
+    // false if a file body could not be read in full
+    size_t getSerializedSize() const;
+    bool serializeTo(char* buffer) const;
+    // Move the in-memory body out, e.g. to hand it to the connection without
+    // copying; a shared body stays put (see getSharedBody)
+    std::string takeBody() { return std::move(body_); }
+    // Drop the body (in memory, shared, file or streamed) but keep the
+    // headers, Content-Length included: a HEAD, 204 or 304 response
+    // describes a body it does not send
+    void clearBody();
+    
+    // Pre-rendered "HTTP/1.1 <code> <text>\r\n"; empty for unknown codes
+    static std::string_view statusLine(StatusCode code);
+    
+    // MIME type from the file extension; application/octet-stream if unknown
+    static std::string mimeTypeForPath(const std::string& file_path);
+    
     // Utility methods
     void setContentLength();
     bool isError() const;
 
 private:
     StatusCode status_code_;
-    std::unordered_map<std::string, std::string> headers_;
+    HeaderMap headers_;
     std::string body_;
+    std::shared_ptr<const std::string> shared_body_;
+    std::shared_ptr<const CachedFile> file_body_;
+    StreamProducer stream_producer_;
     std::string version_;
     
-    std::string statusCodeToString(StatusCode code) const;
-    std::string getMimeType(const std::string& file_extension) const;
+    void serialize(std::string& buffer, bool include_body) const;
+    // Status line, falling back to `storage` for codes without a pre-rendered one
+    std::string_view getStatusLine(std::string& storage) const;
+    static std::string getMimeType(const std::string& file_extension);
 };
@@ -4,15 +4,30 @@
 #include <memory>
 #include <unordered_map>
 #include <string>
+#include <thread>
 #include <vector>
+#include <array>
 #include <atomic>
+#include <chrono>
 
 #include "http_request.h"
+#include "access_log.h"
+#include "admission_control.h"
+#include "asset_cache.h"
+#include "file_cache.h"
 #include "http_response.h"
+#include "metrics.h"
+#include "request_framer.h"
+#include "response_cache.h"
+#include "response_completion.h"
+#include "router.h"
 
 #ifndef BUILD_WASM
+#include "connection.h"
+#include "event_loop.h"
 #include "socket_server.h"
 #include "thread_pool.h"
+#include "timer_wheel.h"
 #ifdef ENABLE_SSL
 #include "ssl_server.h"
 #endif
@@ -21,8 +36,24 @@
 class HttpServer {
 public:
     using RequestHandler = std::function<void(const HttpRequest&, HttpResponse&)>;
+    // May return before the response is ready: the worker is then free for
+    // other requests, and the response goes out once `done` is called (from
+    // any thread). `request` and `response` stay valid until then.
+    using AsyncRequestHandler = std::function<void(const HttpRequest&, HttpResponse&, ResponseCompletion done)>;
     using MiddlewareFunction = std::function<bool(const HttpRequest&, HttpResponse&)>;
 
+    // Requests allowed to wait for a worker before new ones are shed
+    static constexpr size_t kDefaultMaxQueuedRequests = 1024;
+    // Bodies smaller than this are not worth compressing
+    static constexpr size_t kDefaultCompressMinSize = 1024;
+    // Slow-client defaults (see setHeaderTimeoutSeconds()); the body rate
+    // is not limited unless set
+    static constexpr int kDefaultHeaderTimeoutSeconds = 10;
+    static constexpr int kDefaultWriteTimeoutSeconds = 30;
+    static constexpr int kBodyRateWindowSeconds = 5;
+    // Resolution of the connection timeouts
+    static constexpr int kTimeoutTickMs = 100;
+
     HttpServer();
     ~HttpServer();
 
@@ -30,11 +61,42 @@ public:
     bool start(int port, const std::string& host = "0.0.0.0");
     void stop();
     bool isRunning() const { return is_running_; }
+    // Graceful stop, safe from any thread: the listeners close (after taking
+    // whatever is already queued on them), idle keep-alive connections are
+    // closed, and requests in flight finish with `Connection: close` (a
+    // GOAWAY on HTTP/2). Once no connection is left, or `timeout_seconds`
+    // have passed and the rest are cut off, start() returns with every
+    // queued handler run. stop() still ends it at once.
+    void drain(int timeout_seconds);
+    bool isDraining() const { return draining_; }
+    
+#ifndef BUILD_WASM
+    // Hot restart: listening sockets handed over by the process being
+    // replaced (SocketServer::receiveSockets()) or by systemd. The next
+    // start() serves each on a shard of its own instead of binding; the
+    // server owns them from here on.
+    void setInheritedListeners(std::vector<int> sockets);
+    // The shards' listening sockets, to hand to a successor before drain();
+    // empty unless running
+    std::vector<int> getListenerSockets() const;
+#endif
 
 #ifdef ENABLE_SSL
-    // SSL/TLS support
+    // SSL/TLS support. OpenSSL writes to the socket with write(2) (and
+    // kTLS with sendfile), both of which raise SIGPIPE once a client has
+    // gone; a process serving TLS should ignore SIGPIPE, as main() does.
     bool startHttps(int port, const std::string& cert_file, const std::string& key_file, const std::string& host = "0.0.0.0");
     void setSslContext(const std::string& cert_file, const std::string& key_file);
+    
+#ifndef BUILD_WASM
+    // TLS session resumption and 0-RTT; configure before startHttps().
+    // Ticket keys rotate every `rotation_seconds` and are shared by all
+    // listener shards. Early data is off unless `max_early_data` > 0.
+    void setTlsSessionCache(size_t entries, int timeout_seconds);
+    void setTlsTicketKeyRotation(int rotation_seconds);
+    void setTlsEarlyData(uint32_t max_early_data);
+    SslServer::HandshakeStats getTlsHandshakeStats() const;
+#endif
 #endif
 
     // Route management
@@ -46,8 +108,36 @@ public:
     void options(const std::string& path, RequestHandler handler);
     void patch(const std::string& path, RequestHandler handler);
     
+    // Asynchronous handlers for the same routes
+    void get(const std::string& path, AsyncRequestHandler handler);
+    void post(const std::string& path, AsyncRequestHandler handler);
+    void put(const std::string& path, AsyncRequestHandler handler);
+    void del(const std::string& path, AsyncRequestHandler handler);
+    void head(const std::string& path, AsyncRequestHandler handler);
+    void options(const std::string& path, AsyncRequestHandler handler);
+    void patch(const std::string& path, AsyncRequestHandler handler);
+    
     // Generic route handler
     void route(HttpRequest::Method method, const std::string& path, RequestHandler handler);
+    void route(HttpRequest::Method method, const std::string& path, AsyncRequestHandler handler);
+    
+    // Whether a route may run for a request sent as TLS 1.3 early data.
+    // Routes for idempotent methods allow it by default and POST/PATCH
+    // routes refuse it; refused requests get 425 Too Early so the client
+    // retries after the handshake.
+    void setEarlyDataAllowed(HttpRequest::Method method, const std::string& path, bool allowed);
+    
+    // Response caching for a synchronous GET or HEAD route: what its handler answers is
+    // kept per path, the policy's query parameters and request headers (and
+    // the negotiated Content-Encoding when compression is on) and served
+    // again without running it until it expires. Misses on one key wait for
+    // a single handler run. Middlewares still run for every request; the
+    // handler starts from a blank response. See ResponseCache::fetch() for
+    // what is stored.
+    void cacheRoute(HttpRequest::Method method, const std::string& path, ResponseCache::Policy policy);
+    // Memory the responses cached for all routes may take
+    void setResponseCacheSize(size_t max_bytes);
+    const ResponseCache& getResponseCache() const { return response_cache_; }
     
     // Middleware
     void use(MiddlewareFunction middleware);
@@ -56,9 +146,71 @@ public:
     void serveStatic(const std::string& path, const std::string& directory);
     
     // Configuration
+    // Admission control: connections beyond these limits, and requests
+    // arriving while more than `max_queued` are waiting for a worker, get a
+    // prebuilt 503 with Retry-After and are closed. 0 disables a limit.
+    // Configure before start().
     void setMaxConnections(int max_connections);
+    void setMaxConnectionsPerClient(int max_per_client);
+    void setMaxQueuedRequests(size_t max_queued);
+    void setRetryAfterSeconds(int seconds);
     void setTimeoutSeconds(int timeout_seconds);
+    // Slow-client limits, enforced by each loop's timer wheel: a request head
+    // must arrive within `seconds` of its first byte (of the accept, for a
+    // connection's first request), a response write must make progress at
+    // least every `seconds`, and a body must keep up `bytes_per_second` on
+    // average, measured over windows of kBodyRateWindowSeconds. 0 disables
+    // each; the keep-alive timeout still bounds any silent connection.
+    void setHeaderTimeoutSeconds(int seconds);
+    void setWriteTimeoutSeconds(int seconds);
+    void setMinBodyRate(size_t bytes_per_second);
     void setThreadPoolSize(int size);
+    void setMaxBodySize(size_t max_body_size);
+    // Listener sharding: bind `shards` listeners with SO_REUSEPORT, each owned
+    // by its own event-loop thread, so the kernel spreads new connections
+    // across cores. 1 (the default) keeps a single listener on the thread
+    // that calls start(). Takes effect at the next start().
+    void setListenerShards(int shards);
+    // TCP_DEFER_ACCEPT timeout and TCP_FASTOPEN queue length (0 disables)
+    void setDeferAccept(int seconds);
+    void setTcpFastOpen(int queue_length);
+    // HTTP/2, negotiated through ALPN on TLS listeners and by prior knowledge
+    // (the client preface) on plaintext ones. On by default; configure
+    // before start().
+    void setHttp2Enabled(bool enabled);
+    // Access log: an entry per request once its response is built, with
+    // method, path, status, body bytes, latency, client address and TLS
+    // resumption, for about `sample_rate` of all requests. An empty file
+    // name sends the records to the log output.
+    void enableAccessLog(const std::string& filename, AccessLog::Format format = AccessLog::Format::JSON_LINES,
+                         double sample_rate = 1.0);
+    
+    // Metrics: requests by status class, latency histograms per route,
+    // connection, worker queue and TLS handshake figures, served in the
+    // Prometheus text format from GET `path`. Off until this is called
+    // (before start()); each update then costs a relaxed atomic add on a
+    // per-thread slot. Only the first call registers a route; later ones
+    // change nothing, whatever their `path`.
+    void enableMetrics(const std::string& path = "/metrics");
+    bool isMetricsEnabled() const { return metrics_enabled_; }
+    // Appends the exposition served at the metrics path
+    void renderMetrics(std::string& out) const;
+    
+    // Response compression: once handlers and middlewares are done, text-like
+    // bodies of at least `min_size` bytes are encoded with the best coding
+    // the client's Accept-Encoding allows (zstd, br or gzip, as built in).
+    // Bodies that already carry a Content-Encoding or come from the static
+    // asset cache are left alone. File bodies are compressed once per coding
+    // and kept in a bounded cache (see CompressedFileCache); one that does
+    // not fit is sent uncompressed from disk. Streamed bodies are compressed
+    // whatever their size, a flushed batch at a time (see
+    // HttpResponse::setStreamingBody()). Off by default.
+    void enableCompression(size_t min_size = kDefaultCompressMinSize);
+    
+    // Load statistics
+    size_t getActiveConnections() const { return admission_.getActiveConnections(); }
+    // Connections and requests refused with 503
+    uint64_t getRejectedCount() const { return admission_.getRejectedCount() + shed_requests_.load(); }
     
     // Error handlers
     void setNotFoundHandler(RequestHandler handler);
@@ -67,7 +219,12 @@ public:
 #ifdef BUILD_WASM
     // WebAssembly specific methods
     void handleRequest(const std::string& raw_request, std::string& response_output);
-    void processRequest(const HttpRequest& request, HttpResponse& response);
+    // Parses `raw_request` where it lies (the embedder's linear memory) and
+    // leaves the answer in `response` for the caller to serialize wherever
+    // it wants the bytes. Waits for an asynchronous handler to complete, so
+    // without pthreads one must complete before it returns.
+    void handleRequest(std::string_view raw_request, HttpResponse& response);
+    void processRequest(HttpRequest& request, HttpResponse& response);
 #endif
 
 private:
@@ -75,39 +232,165 @@ private:
         HttpRequest::Method method;
         std::string path;
         RequestHandler handler;
-        bool is_regex;
+        AsyncRequestHandler async_handler; // set instead of `handler` for asynchronous routes
+        bool allow_early_data;
+        std::unique_ptr<metrics::LatencyHistogram> latency; // while metrics are enabled
+        std::unique_ptr<ResponseCache::Policy> cache;        // null unless cacheRoute() was called
     };
 
     std::vector<Route> routes_;
+    Router router_; // values index routes_
     std::vector<MiddlewareFunction> middlewares_;
     std::unordered_map<std::string, std::string> static_paths_;
+    FileCache file_cache_;
+    AssetCache asset_cache_; // small files, in memory with compressed variants
+    CompressedFileCache compressed_files_; // larger files compressed on the fly
+    ResponseCache response_cache_;
     
     RequestHandler not_found_handler_;
     std::function<void(const std::exception&, const HttpRequest&, HttpResponse&)> error_handler_;
     
     std::atomic<bool> is_running_;
+    std::atomic<bool> draining_;
     int port_;
     std::string host_;
     
 #ifndef BUILD_WASM
-    std::unique_ptr<SocketServer> socket_server_;
-    std::unique_ptr<ThreadPool> thread_pool_;
+    // A listening socket with the event loop that owns it and the
+    // connections accepted from it; only that loop's thread touches them
+    struct ListenerShard {
+        SocketServer listener;
+        EventLoop loop;
+        TimerWheel timers{std::chrono::milliseconds(kTimeoutTickMs)}; // outlives the connections armed in it
+        std::vector<uint64_t> expired_timers;
+        std::unordered_map<int, std::shared_ptr<Connection>> connections;
+        std::thread thread; // not used by the shard run on start()'s caller
+        bool draining = false; // the listener is closed; the loop ends once connections are
+        std::chrono::steady_clock::time_point drain_deadline;
+        // Spare descriptor given up to accept (and refuse) a client when the
+        // process runs out of them; the timer tick retries if even that fails
+        int reserve_fd = -1;
+        bool accept_retry = false;
+        
+        ListenerShard();
+        ~ListenerShard();
+    };
+    
+    std::vector<std::unique_ptr<ListenerShard>> shards_;
+    std::vector<int> inherited_listeners_; // taken by the next start()
+    std::unique_ptr<ThreadPool> thread_pool_; // declared last: its tasks reference shards
 #ifdef ENABLE_SSL
     std::unique_ptr<SslServer> ssl_server_;
     bool use_ssl_;
 #endif
 #endif
 
-    int max_connections_;
+    AdmissionControl admission_;
+    size_t max_queued_requests_;
+    int retry_after_seconds_;
+    std::string overload_response_; // complete 503 response, built once
+    std::atomic<uint64_t> shed_requests_;
     int timeout_seconds_;
+    int header_timeout_seconds_;
+    int write_timeout_seconds_;
+    size_t min_body_rate_;
     int thread_pool_size_;
+    size_t max_body_size_;
+    int listener_shards_;
+    int defer_accept_seconds_;
+    int fast_open_queue_;
+    bool http2_enabled_;
+    AccessLog access_log_;
+    bool compression_enabled_;
+    size_t compress_min_size_;
+    
+    bool metrics_enabled_;
+    std::array<metrics::Counter, 5> responses_by_class_; // 1xx to 5xx
+    metrics::LatencyHistogram static_latency_;
+    metrics::LatencyHistogram unmatched_latency_;
+#ifndef BUILD_WASM
+    metrics::Counter connections_accepted_;
+#endif
+
+    Route makeRoute(HttpRequest::Method method, const std::string& path) const;
+    void addRoute(Route route);
 
     // Request processing
-    void handleConnection(int client_socket);
-    void processHttpRequest(const HttpRequest& request, HttpResponse& response);
+#ifndef BUILD_WASM
+    bool openShards(int port, const std::string& host);
+    void runShard(ListenerShard& shard);
+    // Runs on the shard's loop once drain() is called
+    void beginDrain(ListenerShard& shard, std::chrono::steady_clock::time_point deadline);
+    void acceptConnections(ListenerShard& shard);
+    // Out of descriptors: accept one client on the reserve and refuse it, so
+    // the backlog keeps moving. False if the reserve is gone too.
+    bool refuseWithReserve(ListenerShard& shard);
+    void onConnectionEvent(ListenerShard& shard, const std::shared_ptr<Connection>& connection, uint32_t events);
+    void dispatchRequest(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    void onResponseReady(ListenerShard& shard, const std::shared_ptr<Connection>& connection,
+                         HttpResponse& response, bool keep_alive);
+    void onWriteComplete(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    // Streamed bodies: the stream's notify posts onBodyStreamReady() to the
+    // owning loop, which sends whatever the producer has written so far
+    std::shared_ptr<BodyStream> makeBodyStream(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    void runStreamProducer(const HttpResponse::StreamProducer& producer, const std::shared_ptr<BodyStream>& stream);
+    void onBodyStreamReady(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    void pumpBodyStream(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    void rejectRequest(ListenerShard& shard, const std::shared_ptr<Connection>& connection,
+                       RequestFramer::Status status);
+    void closeConnection(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    // Timeouts: each connection's timer is armed for the deadline of the
+    // phase it is in. A timer firing rechecks, since activity since it was
+    // armed may have moved the deadline on; connections past it are closed
+    // together at the end of the tick.
+    void armTimeout(ListenerShard& shard, Connection& connection);
+    void expireConnections(ListenerShard& shard);
+    // False once `connection` is past its deadline; otherwise re-arms it
+    bool checkTimeout(ListenerShard& shard, Connection& connection, std::chrono::steady_clock::time_point now);
+    std::chrono::steady_clock::time_point timeoutDeadline(Connection& connection,
+                                                          std::chrono::steady_clock::time_point now) const;
+    void closeAllConnections(ListenerShard& shard);
+    bool isOverloaded() const;
+    void rejectAtAccept(int client_socket);
+    void shedRequest(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    // HTTP/2: every stream's request goes through processHttpRequest like an
+    // HTTP/1.1 one; the session multiplexes the responses
+    bool startHttp2(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    void serviceHttp2(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    void dispatchHttp2Request(ListenerShard& shard, const std::shared_ptr<Connection>& connection,
+                              uint32_t stream_id, std::shared_ptr<HttpRequest> request);
+    void flushHttp2(ListenerShard& shard, const std::shared_ptr<Connection>& connection);
+    // Access log entry for a request just taken off `connection`, made on
+    // the loop thread; logAccess() adds the response and writes it
+    AccessLog::Entry makeAccessEntry(const Connection& connection, const HttpRequest& request) const;
+    void logAccess(AccessLog::Entry& entry, const HttpResponse& response,
+                   std::chrono::steady_clock::time_point received) const;
+    // Adds the connection's framing headers to a processed response and
+    // serializes its head into `head`; the response still carries the body
+    // (in memory or file-backed)
+    void buildResponse(const HttpRequest& request, HttpResponse& response, bool& keep_alive, std::string& head);
+    // Runs on a worker once the connection's response is processed
+    void respondHttp1(ListenerShard& shard, const std::shared_ptr<Connection>& connection, bool logged,
+                      AccessLog::Entry& entry, std::chrono::steady_clock::time_point received);
+#endif
+    // Runs `then` once `response` is complete: before returning for
+    // synchronous handlers, on a worker once an asynchronous one is done
+    void processHttpRequest(HttpRequest& request, HttpResponse& response, Task then);
+    // `latency` is pointed at the histogram of whatever served the request.
+    // Returns the asynchronous route still to run, if the request got that far.
+    const Route* routeRequest(HttpRequest& request, HttpResponse& response, metrics::LatencyHistogram*& latency);
+    const Route* dispatchRoute(HttpRequest& request, HttpResponse& response, metrics::LatencyHistogram*& latency);
+    void runAsyncHandler(const Route& route, HttpRequest& request, HttpResponse& response,
+                         metrics::LatencyHistogram* latency, std::chrono::steady_clock::time_point started, Task then);
+    // Compression and metrics once the handler is done
+    void finishResponse(const HttpRequest& request, HttpResponse& response, metrics::LatencyHistogram* latency,
+                        std::chrono::steady_clock::time_point started);
+    void serveCached(const Route& route, const HttpRequest& request, HttpResponse& response);
     bool runMiddlewares(const HttpRequest& request, HttpResponse& response);
-    bool matchRoute(const std::string& pattern, const std::string& path) const;
-    void handleStaticFile(const std::string& file_path, HttpResponse& response);
+    void compressResponse(const HttpRequest& request, HttpResponse& response);
+    void handleStaticFile(const HttpRequest& request, const std::string& file_path, HttpResponse& response);
+    HttpResponse makeOverloadResponse() const;
+    void buildOverloadResponse();
     
     // Default handlers
     void defaultNotFoundHandler(const HttpRequest& request, HttpResponse& response);
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Bounded single-producer/single-consumer ring of variable-length records.
+// The producer reserves contiguous space, writes a record in place and
+// commits it; the consumer drains committed records in order. Each record
+// is a 4-byte length followed by its bytes, padded to 4; a record that
+// would straddle the end of the ring is placed at the start instead, behind
+// a skip marker. No locks, and no allocation after construction.
+class LogRing {
+public:
+    explicit LogRing(size_t capacity) {
+        size_t rounded = 4096;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        mask_ = rounded - 1;
+        data_.reset(new char[rounded]);
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        cached_tail_ = 0;
+        record_position_ = 0;
+    }
+
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+    // Largest record reserve() accepts; keeps a wrap from needing the
+    // whole ring
+    size_t maxRecordSize() const { return capacity() / 4; }
+
+    // Producer: room for a record of up to `size` bytes, or nullptr while
+    // the consumer has not freed enough. A successful reserve must be
+    // followed by commit() before the next one.
+    char* reserve(size_t size) {
+        if (size > maxRecordSize()) {
+            return nullptr;
+        }
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t needed = recordSize(size);
+        size_t to_end = capacity() - (head & mask_);
+        size_t total = needed > to_end ? to_end + needed : needed;
+
+        if (capacity() - (head - cached_tail_) < total) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (capacity() - (head - cached_tail_) < total) {
+                return nullptr;
+            }
+        }
+
+        if (needed > to_end) {
+            // Records are 4-aligned, so the marker always fits before the end
+            std::memcpy(&data_[head & mask_], &kSkipMarker, sizeof(kSkipMarker));
+            head += to_end;
+        }
+        record_position_ = head;
+        return &data_[(head & mask_) + kHeaderSize];
+    }
+
+    // Producer: publish the reserved record with its first `used` bytes
+    void commit(size_t used) {
+        uint32_t length = static_cast<uint32_t>(used);
+        std::memcpy(&data_[record_position_ & mask_], &length, sizeof(length));
+        head_.store(record_position_ + recordSize(used), std::memory_order_release);
+    }
+
+    // Consumer: hand every committed record to `sink(data, size)`, then
+    // release their space. Returns the number of records drained.
+    template <typename Sink>
+    size_t drain(Sink&& sink) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t records = 0;
+        while (tail != head) {
+            size_t offset = tail & mask_;
+            uint32_t length;
+            std::memcpy(&length, &data_[offset], sizeof(length));
+            if (length == kSkipMarker) {
+                tail += capacity() - offset;
+                continue;
+            }
+            sink(&data_[offset + kHeaderSize], static_cast<size_t>(length));
+            tail += recordSize(length);
+            ++records;
+        }
+        tail_.store(tail, std::memory_order_release);
+        return records;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t kHeaderSize = sizeof(uint32_t);
+    static constexpr uint32_t kSkipMarker = 0xffffffffu;
+
+    static size_t recordSize(size_t size) { return (kHeaderSize + size + 3) & ~static_cast<size_t>(3); }
+
+    std::unique_ptr<char[]> data_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_; // written by the producer
+    size_t cached_tail_;                   // producer's last look at tail_
+    size_t record_position_;               // producer: header of the reserved record
+    alignas(64) std::atomic<size_t> tail_; // written by the consumer
+};
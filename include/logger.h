@@ -1,10 +1,103 @@
 #pragma once
 
-#include <string>
-#include <fstream>
-#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "log_ring.h"
+
+// Lowest level compiled in: 0 DEBUG .. 4 FATAL, set by the LOG_MIN_LEVEL
+// CMake option. Macros below it expand to nothing that runs.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// The message being written into a thread's ring. Pieces are formatted in
+// place and cut off at the space reserved for the line.
+class LogLine {
+public:
+    LogLine() : out_(nullptr), used_(0), limit_(0) {}
+    LogLine(char* out, size_t used, size_t limit) : out_(out), used_(used), limit_(limit) {}
+
+    // Upper bound on the bytes put() writes for `value`
+    template <typename T>
+    static size_t sizeOf(const T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            return 5;
+        } else if constexpr (std::is_same_v<T, char>) {
+            return 1;
+        } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            return 20;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            return 32;
+        } else {
+            return text(value).size();
+        }
+    }
+
+    template <typename T>
+    void put(const T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            putText(value ? "true" : "false");
+        } else if constexpr (std::is_same_v<T, char>) {
+            if (used_ < limit_) {
+                out_[used_++] = value;
+            }
+        } else if constexpr (std::is_enum_v<T>) {
+            putInteger(static_cast<std::underlying_type_t<T>>(value));
+        } else if constexpr (std::is_integral_v<T>) {
+            putInteger(value);
+        } else if constexpr (std::is_floating_point_v<T>) {
+            putDouble(static_cast<double>(value));
+        } else {
+            putText(text(value));
+        }
+    }
 
+    char* data() const { return out_; }
+    size_t size() const { return used_; }
+
+private:
+    static std::string_view text(std::string_view value) { return value; }
+    static std::string_view text(const char* value) { return value ? std::string_view(value) : "(null)"; }
+
+    void putText(std::string_view value) {
+        size_t length = std::min(value.size(), limit_ - used_);
+        std::memcpy(out_ + used_, value.data(), length);
+        used_ += length;
+    }
+
+    template <typename Integer>
+    void putInteger(Integer value) {
+        auto result = std::to_chars(out_ + used_, out_ + limit_, value);
+        if (result.ec == std::errc()) {
+            used_ = static_cast<size_t>(result.ptr - out_);
+        }
+    }
+
+    void putDouble(double value);
+
+    char* out_;
+    size_t used_;
+    size_t limit_;
+};
+
+// Asynchronous logger. Each thread formats its lines into a ring of its own
+// (no locks on the logging path); a background thread drains all rings and
+// writes them out in batches with write(2). When a thread's ring is full
+// the line is dropped and counted, or, with OverflowPolicy::BLOCK, the
+// thread waits for the flusher. WebAssembly builds write synchronously.
 class Logger {
 public:
     enum class Level {
@@ -15,12 +108,54 @@ public:
         FATAL
     };
 
+    enum class OverflowPolicy {
+        DROP,
+        BLOCK
+    };
+
+    static constexpr size_t kDefaultThreadBufferSize = 256 * 1024;
+    static constexpr Level kCompiledMinLevel = static_cast<Level>(LOG_MIN_LEVEL);
+
     static Logger& getInstance();
-    
+
     void setLevel(Level level);
+    Level getLevel() const { return current_level_.load(std::memory_order_relaxed); }
+    bool isEnabled(Level level) const { return level >= kCompiledMinLevel && level >= getLevel(); }
     void setOutputFile(const std::string& filename);
     void enableConsoleOutput(bool enable);
-    
+    // Where access log records go; an empty name sends them back to the
+    // log output
+    void setAccessLogFile(const std::string& filename);
+    void setOverflowPolicy(OverflowPolicy policy);
+    // Ring size for threads that log for the first time after the call
+    void setThreadBufferSize(size_t bytes);
+
+    // Formats the pieces (strings, characters, numbers, bools) one after
+    // another straight into this thread's ring; nothing is built or
+    // allocated, and nothing is done at all below the enabled level
+    template <typename... Parts>
+    void write(Level level, const Parts&... parts) {
+        if (!isEnabled(level)) {
+            return;
+        }
+        LogLine line;
+        if (beginLine(level, (size_t(0) + ... + LogLine::sizeOf(parts)), line)) {
+            (line.put(parts), ...);
+            endLine(level, line);
+        }
+    }
+
+    // Access log records (see AccessLog): `format(out)` writes at most
+    // `max_size` bytes at `out` and returns how many it wrote. Records are
+    // written as they are, with no prefix or newline added, to the access
+    // log file or, when none is set, to the log output. Levels do not apply.
+    template <typename Formatter>
+    void writeAccessRecord(size_t max_size, Formatter&& format) {
+        if (char* out = reserveAccessRecord(max_size)) {
+            commitAccessRecord(out, format(out));
+        }
+    }
+
     void log(Level level, const std::string& message);
     void debug(const std::string& message);
     void info(const std::string& message);
@@ -28,26 +163,110 @@ public:
     void error(const std::string& message);
     void fatal(const std::string& message);
 
+    // Block until every line logged before the call has been written
+    void flush();
+    // Lines lost to full buffers since startup
+    uint64_t getDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
 private:
-    Logger() = default;
-    ~Logger() = default;
-    
+    // First byte of every ring record: which output it belongs to
+    enum class Channel : char {
+        LOG,
+        ACCESS
+    };
+
+    // One per logging thread; the flusher keeps it until it is drained
+    // after the thread has exited
+    struct ThreadBuffer {
+        explicit ThreadBuffer(size_t capacity) : ring(capacity), orphaned(false), second(-1) {}
+
+        LogRing ring;
+        std::atomic<bool> orphaned;
+        // "YYYY-MM-DD HH:MM:SS" for `second`, reformatted when it changes
+        time_t second;
+        char timestamp[20];
+    };
+
+    Logger();
+    ~Logger();
+
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
-    
-    Level current_level_ = Level::INFO;
-    std::unique_ptr<std::ofstream> file_stream_;
-    bool console_output_ = true;
-    std::mutex log_mutex_;
-    
-    std::string levelToString(Level level) const;
-    std::string getCurrentTimestamp() const;
-    void writeLog(const std::string& formatted_message);
+
+    std::atomic<Level> current_level_;
+    std::atomic<bool> console_output_;
+    std::atomic<OverflowPolicy> overflow_policy_;
+    std::atomic<size_t> thread_buffer_size_;
+    std::atomic<uint64_t> dropped_;
+    uint64_t reported_dropped_; // flusher only
+
+    std::mutex output_mutex_; // guards the descriptors and the writes themselves
+    int file_fd_;
+    int access_fd_;
+
+    std::mutex buffers_mutex_; // taken when a thread registers and by the flusher
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+
+    std::mutex flush_mutex_;
+    std::condition_variable flush_wake_;
+    std::condition_variable flush_done_;
+    uint64_t flush_requests_;
+    uint64_t flushes_completed_;
+    bool stopping_;
+    std::thread flusher_;
+    std::string batch_;        // flusher only
+    std::string access_batch_; // flusher only
+
+    static const char* levelToString(Level level);
+    ThreadBuffer& threadBuffer();
+    char* reserveLine(ThreadBuffer& buffer, size_t size);
+    size_t writePrefix(ThreadBuffer& buffer, Level level, char* out);
+    bool beginLine(Level level, size_t message_size, LogLine& line);
+    void endLine(Level level, LogLine& line);
+    char* reserveAccessRecord(size_t size);
+    void commitAccessRecord(char* out, size_t used);
+    void wakeFlusher();
+    void runFlusher();
+    void drainBuffers();
+    void writeOutput(const char* data, size_t size);
+    void writeAccess(const char* data, size_t size);
 };
 
-// Convenience macros
-#define LOG_DEBUG(msg) Logger::getInstance().debug(msg)
-#define LOG_INFO(msg) Logger::getInstance().info(msg)
-#define LOG_WARNING(msg) Logger::getInstance().warning(msg)
-#define LOG_ERROR(msg) Logger::getInstance().error(msg)
-#define LOG_FATAL(msg) Logger::getInstance().fatal(msg)
+// Convenience macros. Arguments are the pieces of the message, e.g.
+// LOG_INFO(method, " ", path), and are only evaluated when the level is
+// enabled. Levels below LOG_MIN_LEVEL still type-check but generate no code.
+#define LOG_AT(level, ...)                                    \
+    do {                                                      \
+        Logger& log_instance_ = Logger::getInstance();        \
+        if (log_instance_.isEnabled(level)) {                 \
+            log_instance_.write(level, __VA_ARGS__);          \
+        }                                                     \
+    } while (0)
+#define LOG_DISCARD(...)                                      \
+    do {                                                      \
+        if (false) {                                          \
+            Logger::getInstance().write(__VA_ARGS__);         \
+        }                                                     \
+    } while (0)
+
+#if LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(...) LOG_AT(Logger::Level::DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_DISCARD(Logger::Level::DEBUG, __VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL <= 1
+#define LOG_INFO(...) LOG_AT(Logger::Level::INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DISCARD(Logger::Level::INFO, __VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL <= 2
+#define LOG_WARNING(...) LOG_AT(Logger::Level::WARNING, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) LOG_DISCARD(Logger::Level::WARNING, __VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL <= 3
+#define LOG_ERROR(...) LOG_AT(Logger::Level::ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_DISCARD(Logger::Level::ERROR, __VA_ARGS__)
+#endif
+#define LOG_FATAL(...) LOG_AT(Logger::Level::FATAL, __VA_ARGS__)
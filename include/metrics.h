@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Lock-free metrics for the request path. Updates go to one of kShards
+// cache-line-sized slots picked per thread, so threads do not contend on a
+// line; readers sum the slots. An update is a single relaxed fetch_add.
+namespace metrics {
+
+constexpr size_t kShards = 8;
+
+// This thread's slot, assigned round-robin on first use
+inline size_t threadShard() {
+    static std::atomic<size_t> next_shard{0};
+    thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return shard;
+}
+
+class Counter {
+public:
+    void add(uint64_t amount = 1) {
+        shards_[threadShard()].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const {
+        uint64_t total = 0;
+        for (const auto& shard : shards_) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+
+    Shard shards_[kShards];
+};
+
+// HDR-style latency histogram over microseconds: exact below 8us, then 8
+// linear sub-buckets per power of two, so any recorded value is known to
+// within 12.5% up to 2^32us (about 71 minutes; longer ones land in the
+// last bucket).
+class LatencyHistogram {
+public:
+    static constexpr size_t kSubBuckets = 8;
+    static constexpr size_t kBucketCount = 30 * kSubBuckets;
+
+    struct Snapshot {
+        std::array<uint64_t, kBucketCount> counts{};
+        uint64_t count = 0;
+        uint64_t sum_us = 0;
+
+        // Recorded values at or below `bound_us`, counting whole buckets
+        // only (so at most one bucket's width below the true figure)
+        uint64_t countAtOrBelow(uint64_t bound_us) const;
+        // Upper bound of the bucket holding the `quantile` (0..1) value
+        uint64_t percentile(double quantile) const;
+    };
+
+    LatencyHistogram() : shards_(new Shard[kShards]()) {}
+
+    void record(uint64_t micros) {
+        Shard& shard = shards_[threadShard()];
+        shard.counts[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum_us.fetch_add(micros, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const;
+
+    static size_t bucketFor(uint64_t micros) {
+        if (micros < kSubBuckets) {
+            return static_cast<size_t>(micros);
+        }
+        if (micros > UINT32_MAX) {
+            return kBucketCount - 1;
+        }
+        // Position of the top bit, 3 or more here; the next three bits pick
+        // the sub-bucket
+        size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(micros));
+        size_t sub_bucket = static_cast<size_t>(micros >> (exponent - 3)) & (kSubBuckets - 1);
+        return (exponent - 2) * kSubBuckets + sub_bucket;
+    }
+
+    // Largest value that lands in bucket `index`
+    static uint64_t bucketUpperBound(size_t index) {
+        if (index < kSubBuckets) {
+            return index;
+        }
+        size_t exponent = index / kSubBuckets + 2;
+        uint64_t sub_bucket = index % kSubBuckets;
+        return ((kSubBuckets + sub_bucket + 1) << (exponent - 3)) - 1;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> counts[kBucketCount] = {};
+        std::atomic<uint64_t> sum_us{0};
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+};
+
+// Prometheus text exposition format (version 0.0.4)
+class PrometheusWriter {
+public:
+    static constexpr std::string_view kContentType = "text/plain; version=0.0.4; charset=utf-8";
+
+    explicit PrometheusWriter(std::string& out) : out_(out) {}
+
+    // "# HELP" and "# TYPE" lines; every family's samples follow its header
+    void family(std::string_view name, std::string_view type, std::string_view help);
+    // `labels` is preformatted, e.g. code="2xx", or empty
+    void sample(std::string_view name, std::string_view labels, uint64_t value);
+    void sample(std::string_view name, std::string_view labels, double value);
+    // Cumulative buckets at the usual latency bounds, with _sum and _count
+    // in seconds
+    void histogram(std::string_view name, std::string_view labels, const LatencyHistogram& histogram);
+
+    // `value` quoted and escaped for use as a label value
+    static void appendLabelValue(std::string& out, std::string_view value);
+
+private:
+    std::string& out_;
+
+    void appendName(std::string_view name, std::string_view suffix, std::string_view labels,
+                    std::string_view extra_label);
+};
+
+} // namespace metrics
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "request_parser.h"
+
+class HttpRequest;
+
+// Finds the boundaries of HTTP/1.x requests in a connection's receive buffer.
+// The buffer is examined incrementally: each call to frame() resumes where the
+// previous one stopped, so already-scanned bytes are never searched again.
+class RequestFramer {
+public:
+    enum class Status {
+        NEED_MORE,
+        COMPLETE,
+        BAD_REQUEST,
+        HEADERS_TOO_LARGE,
+        PAYLOAD_TOO_LARGE
+    };
+
+    static constexpr size_t kDefaultMaxHeaderSize = 64 * 1024;
+    static constexpr size_t kDefaultMaxBodySize = 8 * 1024 * 1024;
+
+    explicit RequestFramer(size_t max_body_size = kDefaultMaxBodySize,
+                           size_t max_header_size = kDefaultMaxHeaderSize);
+
+    // Examine newly appended bytes. The buffer must only grow between calls
+    // until takeMessage() consumes the framed request.
+    Status frame(const std::string& buffer);
+
+    // Remove the framed request from the buffer and return it with a
+    // de-chunked body. Resets the framer for the next pipelined request.
+    std::string takeMessage(std::string& buffer);
+
+    // Like takeMessage(), but hands the message to `request` together with the
+    // head already parsed while framing, so it is not scanned a second time
+    bool takeRequest(std::string& buffer, HttpRequest& request);
+
+    void reset();
+
+    // The head has been framed and the body is still arriving
+    bool isReadingBody() const {
+        return state_ != State::HEADERS && state_ != State::COMPLETE && state_ != State::ERROR;
+    }
+
+    void setMaxBodySize(size_t max_body_size) { max_body_size_ = max_body_size; }
+    size_t getMaxBodySize() const { return max_body_size_; }
+    void setMaxHeaderSize(size_t max_header_size) { max_header_size_ = max_header_size; }
+
+private:
+    enum class State {
+        HEADERS,
+        BODY,
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        TRAILERS,
+        COMPLETE,
+        ERROR
+    };
+
+    State state_;
+    Status error_;
+    size_t max_body_size_;
+    size_t max_header_size_;
+
+    size_t scan_offset_;     // next buffer offset to examine
+    size_t header_length_;   // request line + headers + blank line
+    size_t content_length_;
+    size_t chunk_remaining_;
+    size_t trailer_offset_;  // where the trailer section of a chunked body starts
+    size_t message_length_;  // bytes of the buffer occupied by the request
+    bool chunked_;
+    std::string decoded_body_;
+    RequestParser parser_;
+
+    Status fail(Status status);
+    std::string extractMessage(std::string& buffer);
+    Status parseHead(const std::string& buffer);
+    Status frameChunked(const std::string& buffer);
+};
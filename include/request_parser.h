@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Incremental, zero-copy parser for an HTTP/1.x request head (request line
+// and header fields). Fields are recorded as offsets into the caller's
+// buffer rather than views, so parsing resumes correctly after the buffer
+// grows and reallocates between reads. Each byte is scanned once.
+class RequestParser {
+public:
+    enum class Status {
+        NEED_MORE,
+        COMPLETE,
+        ERROR
+    };
+
+    struct Span {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+
+        std::string_view in(std::string_view buffer) const { return buffer.substr(offset, length); }
+    };
+
+    struct HeaderField {
+        Span name;
+        Span value;
+    };
+
+    static constexpr size_t kMaxHeaderCount = 128;
+
+    RequestParser();
+
+    // Parse bytes appended since the last call. With `at_eof` the end of the
+    // buffer also ends the head, for callers that already hold a whole message.
+    Status parse(std::string_view buffer, bool at_eof = false);
+    void reset();
+
+    Status getStatus() const;
+    size_t getHeadLength() const { return head_length_; }
+    size_t getScannedLength() const { return scan_pos_; }
+
+    Span getMethod() const { return method_; }
+    Span getTarget() const { return target_; }
+    Span getVersion() const { return version_; }
+    const std::vector<HeaderField>& getHeaders() const { return headers_; }
+
+    // Case-insensitive lookup of the first field with this name; returns a
+    // null view when absent
+    std::string_view findHeader(std::string_view buffer, std::string_view name) const;
+
+private:
+    enum class State {
+        REQUEST_LINE,
+        HEADER_LINE,
+        COMPLETE,
+        ERROR
+    };
+
+    State state_;
+    size_t line_start_;
+    size_t scan_pos_;
+    size_t head_length_;
+
+    Span method_;
+    Span target_;
+    Span version_;
+    std::vector<HeaderField> headers_;
+
+    bool parseLine(std::string_view buffer, size_t line_end);
+    bool parseRequestLine(std::string_view line, size_t offset);
+    bool parseHeaderLine(std::string_view line, size_t offset);
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "mpmc_queue.h"
+
+// Hands raw requests from the thread that submits them (the WASM
+// embedding's JS thread) to a fixed set of workers sharing one handler, and
+// their responses back, through lock-free rings. Submitting never blocks;
+// idle workers sleep until there is work. The number of requests in flight
+// is bounded by the capacity, so a response always has room in its ring.
+class RequestRing {
+public:
+    static constexpr size_t kDefaultCapacity = 1024;
+
+    // `request` views the submitter's bytes, which must stay put until the
+    // response has been polled
+    using Handler = std::function<void(std::string_view request, std::string& response)>;
+    // Runs on the worker after each response is queued
+    using Notify = std::function<void()>;
+
+    struct Response {
+        uint32_t tag = 0;
+        std::string data;
+    };
+
+    explicit RequestRing(Handler handler, size_t capacity = kDefaultCapacity, Notify notify = nullptr);
+    ~RequestRing();
+
+    RequestRing(const RequestRing&) = delete;
+    RequestRing& operator=(const RequestRing&) = delete;
+
+    void start(size_t workers);
+    // Queued requests are still answered before the workers exit
+    void stop();
+
+    // False when `capacity` requests are already in flight
+    bool submit(uint32_t tag, const char* data, size_t length);
+    // A finished response, in completion order
+    bool poll(Response& response);
+
+    // Bumped after every response, at a fixed address (wait on it with
+    // Atomics.wait from JS)
+    const std::atomic<int32_t>& getCompletionCount() const { return completions_; }
+    size_t getWorkerCount() const { return workers_.size(); }
+
+private:
+    struct Request {
+        uint32_t tag = 0;
+        const char* data = nullptr;
+        size_t length = 0;
+    };
+
+    Handler handler_;
+    Notify notify_;
+    size_t capacity_;
+    MpmcQueue<Request> requests_;
+    MpmcQueue<Response> responses_;
+    std::atomic<size_t> in_flight_; // submitted and not yet polled
+    std::atomic<size_t> queued_;    // submitted and not yet taken by a worker
+    std::atomic<int32_t> completions_;
+
+    // Sleeping workers only; the rings themselves take no lock
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::atomic<int> sleepers_;
+    bool stopping_;
+    std::vector<std::thread> workers_;
+
+    void runWorker();
+};
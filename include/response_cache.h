@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "header_map.h"
+#include "http_response.h"
+
+// Bounded-memory LRU of handler responses for routes that opt in (see
+// HttpServer::cacheRoute()), keyed by whatever the route's policy says the
+// response depends on. Concurrent misses on one key are coalesced: one
+// caller runs the handler while the others wait for its result, so a cold
+// key under load costs a single handler run. Bodies are shared with the
+// responses served from them rather than copied. Thread-safe.
+class ResponseCache {
+public:
+    static constexpr size_t kDefaultMaxBytes = 32 * 1024 * 1024;
+    static constexpr size_t kDefaultMaxEntrySize = 1024 * 1024;
+
+    // What a cached route's responses depend on besides method and path
+    struct Policy {
+        std::chrono::seconds ttl{60};
+        std::vector<std::string> query_params;
+        std::vector<std::string> headers; // request headers, e.g. Accept-Language
+    };
+
+    // Fills a blank response on a miss
+    using Loader = std::function<void(HttpResponse& response)>;
+
+    explicit ResponseCache(size_t max_bytes = kDefaultMaxBytes, size_t max_entry_size = kDefaultMaxEntrySize);
+
+    // Answer `response` from the entry for `key`, or from `load` when there
+    // is none (after waiting for a caller already loading the key). The
+    // loaded response is kept for `ttl`, or the s-maxage/max-age its
+    // Cache-Control gives, unless it is not storable: a status other than
+    // 200, 204 or 404, Cache-Control no-store/no-cache/private, Set-Cookie,
+    // a file or streamed body, or a body larger than the entry limit.
+    // Status, headers and body replace what `response` has, and headers it
+    // already carries (set by middlewares, say) stay unless the cached
+    // response has them too. Hits carry an Age header. Returns true if the
+    // handler did not run for this call.
+    bool fetch(const std::string& key, std::chrono::seconds ttl, const Loader& load, HttpResponse& response);
+
+    // Evicts down to the new limit
+    void setMaxBytes(size_t max_bytes);
+    void clear();
+    size_t size() const;
+    size_t getMemoryUsage() const;
+
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+    // Misses answered by another caller's load
+    uint64_t getCoalesced() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stored {
+        HttpResponse::StatusCode status;
+        HeaderMap headers;
+        std::shared_ptr<const std::string> body;
+        Clock::time_point stored_at;
+        Clock::time_point expires_at;
+        size_t memory_usage;
+    };
+
+    struct Entry {
+        std::shared_ptr<const Stored> stored;
+        std::list<std::string>::iterator lru_position;
+    };
+
+    // A load in progress; waiters sleep on `done`
+    struct Flight {
+        std::condition_variable done;
+        bool finished = false;
+        std::shared_ptr<const Stored> result; // null if the response was not storable
+    };
+
+    size_t max_bytes_;
+    size_t max_entry_size_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // most recently used first
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+    size_t memory_usage_;
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t coalesced_;
+
+    // Null if `response` must not be stored; otherwise its body is moved
+    // into the entry
+    std::shared_ptr<const Stored> store(const std::string& key, std::chrono::seconds ttl, HttpResponse& response);
+    void finishFlight(const std::string& key, const std::shared_ptr<Flight>& flight,
+                      std::shared_ptr<const Stored> result);
+    static void apply(const Stored& stored, HttpResponse& response, bool hit);
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+    void evictOverflow();
+};
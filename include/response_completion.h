@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "http_response.h"
+#include "task.h"
+
+// Handed to an asynchronous handler: calling it tells the server the
+// response is filled in, from whichever thread finished the work. Copies
+// share one completion and only the first call counts. If every copy is
+// dropped without a call, the request is answered with 500 instead of
+// hanging.
+class ResponseCompletion {
+public:
+    ResponseCompletion() = default;
+
+    void operator()() const;
+    bool isDone() const { return !state_ || state_->done.load(); }
+
+private:
+    friend class HttpServer;
+
+    struct State {
+        std::atomic<bool> done{false};
+        HttpResponse* response = nullptr;
+        Task finish;
+        ~State();
+    };
+
+    std::shared_ptr<State> state_;
+
+    // `finish` runs once, when the response is complete (or abandoned)
+    ResponseCompletion(HttpResponse& response, Task finish);
+    // Takes the completion over from the handler (it threw); false if the
+    // handler already completed it
+    bool claim() const { return state_ && !state_->done.exchange(true); }
+    void finish() const { state_->finish(); }
+};
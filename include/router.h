@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "http_request.h"
+
+// Route table compiled into one radix tree per method. Patterns are literal
+// paths with optional `:name` segments (one path segment) and a trailing `*`
+// or `*name` (the rest of the path, possibly empty). Lookup walks the path
+// once; literal edges win over parameters, which win over wildcards.
+class Router {
+public:
+    struct Match {
+        int32_t value = -1;
+        size_t param_count = 0;
+        RouteParam params[HttpRequest::kMaxRouteParams];
+    };
+
+    Router();
+    ~Router();
+
+    Router(const Router&) = delete;
+    Router& operator=(const Router&) = delete;
+
+    // Register `value` for the pattern; the first registration of a pattern
+    // wins. Fails on malformed patterns or conflicting parameter names.
+    bool add(HttpRequest::Method method, std::string_view pattern, int32_t value);
+
+    // Captured values are offsets into `path`; names point into the router
+    bool find(HttpRequest::Method method, std::string_view path, Match& match) const;
+
+    void clear();
+    bool empty() const { return route_count_ == 0; }
+
+private:
+    struct Node;
+
+    static constexpr size_t kMethodCount = static_cast<size_t>(HttpRequest::Method::UNKNOWN) + 1;
+
+    std::array<std::unique_ptr<Node>, kMethodCount> roots_;
+    size_t route_count_;
+
+    static bool match(const Node& node, std::string_view path, size_t pos, Match& match);
+};
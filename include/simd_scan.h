@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE4_2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// Byte scanning primitives for the request parser. The widest instruction set
+// enabled at compile time is used (AVX2, SSE4.2, SSE2 or WebAssembly SIMD);
+// builds without any of them fall back to a scalar loop.
+namespace simd {
+
+// Offset of the first byte equal to `a` or `b`, or `size` if there is none
+inline size_t findAny(const char* data, size_t size, char a, char b) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i match_a = _mm256_set1_epi8(a);
+    const __m256i match_b = _mm256_set1_epi8(b);
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, match_a), _mm256_cmpeq_epi8(chunk, match_b));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+#endif
+
+#if defined(__SSE4_2__)
+    const __m128i needles = _mm_setr_epi8(a, b, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int index = _mm_cmpestri(needles, 2, chunk, 16,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if (index < 16) {
+            return i + static_cast<size_t>(index);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i match_a = _mm_set1_epi8(a);
+    const __m128i match_b = _mm_set1_epi8(b);
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, match_a), _mm_cmpeq_epi8(chunk, match_b));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+#elif defined(__wasm_simd128__)
+    const v128_t match_a = wasm_i8x16_splat(a);
+    const v128_t match_b = wasm_i8x16_splat(b);
+    for (; i + 16 <= size; i += 16) {
+        v128_t chunk = wasm_v128_load(data + i);
+        v128_t hits = wasm_v128_or(wasm_i8x16_eq(chunk, match_a), wasm_i8x16_eq(chunk, match_b));
+        uint32_t mask = wasm_i8x16_bitmask(hits);
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+#endif
+
+    for (; i < size; ++i) {
+        if (data[i] == a || data[i] == b) {
+            return i;
+        }
+    }
+    return size;
+}
+
+// Offset of the first `c`, or `size` if there is none
+inline size_t findByte(const char* data, size_t size, char c) {
+    return findAny(data, size, c, c);
+}
+
+// Name of the instruction set selected at compile time (for diagnostics)
+inline const char* instructionSet() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE4_2__)
+    return "sse4.2";
+#elif defined(__SSE2__)
+    return "sse2";
+#elif defined(__wasm_simd128__)
+    return "wasm-simd128";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace simd
@@ -5,6 +5,7 @@
 #include <string>
 #include <atomic>
 #include <functional>
+#include <vector>
 
 class SocketServer {
 public:
@@ -15,9 +16,21 @@ public:
 
     bool bind(int port, const std::string& host = "0.0.0.0");
     bool listen(int backlog = 128);
+    // Take over a socket that is already bound and listening (inherited from
+    // the process this one replaces, or from systemd) instead of bind() and
+    // listen(); the port and host are read back from it. Fails, leaving the
+    // socket alone, if it is not a listening TCP socket.
+    bool adopt(int listener_socket);
     void accept(ConnectionHandler handler);
     void stop();
     
+    // Accept a single pending connection (accept4, close-on-exec). Returns -1
+    // when none is ready (errno EAGAIN) or the accept failed, with errno
+    // left as accept4 set it; intended for a non-blocking listener driven by
+    // an event loop. The client socket is non-blocking unless asked otherwise.
+    int acceptClient(std::string& remote_address, bool non_blocking = true);
+    int getSocket() const { return server_socket_; }
+    
     bool isRunning() const { return is_running_; }
     int getPort() const { return port_; }
     const std::string& getHost() const { return host_; }
@@ -26,12 +39,41 @@ public:
     void setReuseAddress(bool reuse);
     void setNonBlocking(bool non_blocking);
     void setTimeout(int seconds);
+    
+    // Listener options; they take effect at the next bind()/listen()
+    // SO_REUSEPORT: several sockets share the port and the kernel spreads
+    // incoming connections across them
+    void setReusePort(bool reuse_port) { reuse_port_ = reuse_port; }
+    // TCP_DEFER_ACCEPT: wake the acceptor only once the client has sent data
+    // (0 disables)
+    void setDeferAccept(int seconds) { defer_accept_seconds_ = seconds; }
+    // TCP_FASTOPEN: accept data in the SYN from clients holding a cookie;
+    // `queue_length` bounds pending fast-open requests (0 disables)
+    void setFastOpen(int queue_length) { fast_open_queue_ = queue_length; }
+
+    // Listener handoff between processes. The sockets travel as SCM_RIGHTS
+    // over a connected AF_UNIX `channel`; the receiver gets its own
+    // (close-on-exec) descriptors for the same sockets, so connections
+    // queued on them are not lost while one process hands over to the next.
+    static bool sendSockets(int channel, const std::vector<int>& sockets);
+    // Appends the received descriptors to `sockets`
+    static bool receiveSockets(int channel, std::vector<int>& sockets);
+    // Sockets passed by systemd socket activation (LISTEN_FDS, starting at
+    // descriptor 3), if LISTEN_PID names this process; empty otherwise. The
+    // variables are cleared so children do not take them for their own.
+    static std::vector<int> systemdSockets();
+    static constexpr int kSystemdFirstSocket = 3;
+    // At most this many sockets go in one handoff
+    static constexpr size_t kMaxHandoffSockets = 64;
 
 private:
     int server_socket_;
     int port_;
     std::string host_;
     std::atomic<bool> is_running_;
+    bool reuse_port_;
+    int defer_accept_seconds_;
+    int fast_open_queue_;
     
     bool createSocket();
     void closeSocket();
@@ -3,13 +3,42 @@
 #ifdef ENABLE_SSL
 #ifndef BUILD_WASM
 
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <sys/types.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
+#include "metrics.h"
+#include "tls_ticket_keys.h"
+
 class SslServer {
 public:
+    static constexpr size_t kDefaultSessionCacheSize = 20480;
+    static constexpr int kDefaultSessionTimeoutSeconds = 7200;
+
+    struct HandshakeStats {
+        uint64_t full = 0;
+        uint64_t resumed = 0;
+        uint64_t failed = 0;
+        uint64_t early_data_accepted = 0;
+        uint64_t early_data_rejected = 0;
+        uint64_t ktls_send = 0; // handshakes that left record encryption to the kernel
+    };
+
+    // Result of a non-blocking step on a socket watched by the event loop;
+    // WANT_* names the readiness to wait for before repeating the call
+    enum class IoResult {
+        DONE,
+        WANT_READ,
+        WANT_WRITE,
+        CLOSED,
+        FAILED
+    };
+
     SslServer();
     ~SslServer();
 
@@ -21,6 +50,18 @@ public:
     // SSL connection handling
     SSL* createSslConnection(int socket);
     bool performHandshake(SSL* ssl);
+    
+    // Non-blocking counterparts. acceptStep() advances the handshake and is
+    // repeated until DONE; while `early_data_open` is set it first collects
+    // 0-RTT data into `early_data` and clears the flag once the client has
+    // sent all of it. Writes made before then must pass `early` so they go
+    // out as 0.5-RTT data. Partial writes report progress in `written`.
+    IoResult acceptStep(SSL* ssl, bool& early_data_open, std::string& early_data);
+    IoResult readStep(SSL* ssl, char* buffer, size_t size, size_t& bytes_read);
+    IoResult writeStep(SSL* ssl, const char* data, size_t size, bool early, size_t& written);
+    // SSL_sendfile when kTLS carries the connection, else pread + SSL_write
+    IoResult sendFileStep(SSL* ssl, int fd, off_t offset, size_t size, size_t& written);
+    static bool isKernelTlsSend(SSL* ssl);
     void closeSslConnection(SSL* ssl);
     
     // SSL I/O operations
@@ -36,13 +77,62 @@ public:
     void setVerifyMode(int mode);
     void setCipherList(const std::string& ciphers);
     
+    // Session resumption; set before initialize(). The server-side cache
+    // serves session-ID resumption and stateful TLS 1.3 lookups; tickets
+    // are sealed with keys from the rotating ring. A cache size of 0
+    // disables the cache.
+    void setSessionCacheSize(size_t entries) { session_cache_size_ = entries; }
+    void setSessionTimeout(int seconds) { session_timeout_seconds_ = seconds; }
+    void setSessionTickets(bool enabled) { session_tickets_ = enabled; }
+    void setTicketKeyRotation(int seconds) { ticket_keys_.setRotationInterval(seconds); }
+    TicketKeyRing& getTicketKeys() { return ticket_keys_; }
+    // Largest 0-RTT payload accepted on resumed TLS 1.3 handshakes; 0 (the
+    // default) refuses early data
+    void setMaxEarlyData(uint32_t bytes) { max_early_data_ = bytes; }
+    uint32_t getMaxEarlyData() const { return max_early_data_; }
+    
+    HandshakeStats getHandshakeStats() const;
+    // Time from accept to a completed handshake, recorded by the connection
+    void recordHandshakeTime(uint64_t micros) { handshake_time_.record(micros); }
+    const metrics::LatencyHistogram& getHandshakeTimes() const { return handshake_time_; }
+    
+    // Offer "h2" ahead of "http/1.1" through ALPN (on by default); set
+    // before initialize()
+    void setHttp2(bool enabled) { http2_ = enabled; }
+    bool isHttp2Enabled() const { return http2_; }
+    // Protocol chosen by ALPN once the handshake is done; empty if none
+    static std::string_view negotiatedProtocol(SSL* ssl);
+    
     // Error handling
     std::string getLastError() const;
 
 private:
     SSL_CTX* ssl_context_;
     bool is_initialized_;
+    size_t session_cache_size_;
+    int session_timeout_seconds_;
+    bool session_tickets_;
+    uint32_t max_early_data_;
+    bool http2_;
+    TicketKeyRing ticket_keys_;
+    
+    std::atomic<uint64_t> full_handshakes_;
+    std::atomic<uint64_t> resumed_handshakes_;
+    std::atomic<uint64_t> failed_handshakes_;
+    std::atomic<uint64_t> early_data_accepted_;
+    std::atomic<uint64_t> early_data_rejected_;
+    std::atomic<uint64_t> ktls_send_;
+    metrics::LatencyHistogram handshake_time_;
     
+    void configureSessions();
+    void recordHandshake(SSL* ssl);
+    static IoResult ioResult(SSL* ssl, int result);
+    static int selectProtocol(SSL* ssl, const unsigned char** out, unsigned char* out_length,
+                              const unsigned char* in, unsigned int in_length, void* arg);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    static int ticketKeyCallback(SSL* ssl, unsigned char* key_name, unsigned char* iv,
+                                 EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt);
+#endif
     void initializeOpenSSL();
     void cleanupOpenSSL();
     std::string getSslError() const;
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Small allocation-free helpers shared by the HTTP parsing code
+namespace string_util {
+
+inline char toLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (toLower(a[i]) != toLower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Strip optional whitespace (SP / HTAB) from both ends
+inline std::string_view trim(std::string_view value) {
+    size_t begin = 0;
+    size_t end = value.size();
+    while (begin < end && (value[begin] == ' ' || value[begin] == '\t')) {
+        ++begin;
+    }
+    while (end > begin && (value[end - 1] == ' ' || value[end - 1] == '\t')) {
+        --end;
+    }
+    return value.substr(begin, end - begin);
+}
+
+// True if a comma-separated list (e.g. a Connection header) contains `token`
+inline bool hasToken(std::string_view list, std::string_view token) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = trim(list.substr(0, comma));
+        if (equalsIgnoreCase(item, token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// Parse a non-empty run of decimal digits; false on any other character or overflow
+inline bool parseDecimal(std::string_view digits, size_t& value) {
+    if (digits.empty()) {
+        return false;
+    }
+    size_t result = 0;
+    for (char c : digits) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        size_t digit = static_cast<size_t>(c - '0');
+        if (result > (SIZE_MAX - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    value = result;
+    return true;
+}
+
+} // namespace string_util
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only `void()` callable. Callables up to kInlineSize bytes (a handler
+// lambda capturing `this` and a couple of shared_ptrs) are stored inside the
+// object, so submitting one allocates nothing; larger ones go to the heap.
+class Task {
+public:
+    static constexpr size_t kInlineSize = 48;
+
+    Task() noexcept : ops_(nullptr) {}
+
+    template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Task>::value>>
+    Task(F&& function) : ops_(nullptr) {
+        using Callable = std::decay_t<F>;
+        if constexpr (fitsInline<Callable>()) {
+            new (storage_) Callable(std::forward<F>(function));
+            ops_ = &inlineOps<Callable>;
+        } else {
+            *reinterpret_cast<Callable**>(storage_) = new Callable(std::forward<F>(function));
+            ops_ = &heapOps<Callable>;
+        }
+    }
+
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops_) {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+    void operator()() { ops_->invoke(storage_); }
+
+    // True if the callable lives inside the Task (no heap allocation)
+    bool isInline() const { return ops_ && ops_->is_inline; }
+
+    void reset() {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* destination, void* source); // leaves source destroyed
+        void (*destroy)(void* storage);
+        bool is_inline;
+    };
+
+    template <typename Callable>
+    static constexpr bool fitsInline() {
+        // Moves must not throw: Task's own move is noexcept
+        return sizeof(Callable) <= kInlineSize && alignof(Callable) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Callable>::value;
+    }
+
+    template <typename Callable>
+    static constexpr Ops inlineOps = {
+        [](void* storage) { (*static_cast<Callable*>(storage))(); },
+        [](void* destination, void* source) {
+            Callable* callable = static_cast<Callable*>(source);
+            new (destination) Callable(std::move(*callable));
+            callable->~Callable();
+        },
+        [](void* storage) { static_cast<Callable*>(storage)->~Callable(); },
+        true
+    };
+
+    template <typename Callable>
+    static constexpr Ops heapOps = {
+        [](void* storage) { (**static_cast<Callable**>(storage))(); },
+        [](void* destination, void* source) {
+            *static_cast<Callable**>(destination) = *static_cast<Callable**>(source);
+        },
+        [](void* storage) { delete *static_cast<Callable**>(storage); },
+        false
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops* ops_;
+};
@@ -3,42 +3,85 @@
 #ifndef BUILD_WASM
 
 #include <vector>
-#include <queue>
+#include <deque>
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <functional>
 #include <atomic>
 
+#include "mpmc_queue.h"
+#include "task.h"
+#include "work_stealing_deque.h"
+
+// Work-stealing pool. Each worker owns a Chase-Lev deque: tasks a worker
+// submits go on its own deque and are popped LIFO while still cache-warm.
+// Tasks from other threads (the event loop) go through a lock-free MPMC
+// injection queue. An idle worker drains its deque, then the injection
+// queue, then steals the oldest task from a random peer, and only sleeps
+// after a short spin finds nothing.
 class ThreadPool {
 public:
-    using Task = std::function<void()>;
+    using Task = ::Task;
+
+    // Bounded part of the injection queue; a mutex-guarded overflow list
+    // absorbs bursts beyond it so enqueue never fails
+    static constexpr size_t kInjectionCapacity = 4096;
 
     explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency());
     ~ThreadPool();
 
     // Add task to the pool
     void enqueue(Task task);
-    
+
     // Pool management
     void start();
+    // Workers finish the task in hand and exit; queued tasks are kept for
+    // the next start()
     void stop();
+    // Like stop(), but workers first run every queued task, including those
+    // the tasks themselves submit along the way
+    void drain();
     void resize(size_t new_size);
-    
+    // Pin worker i to CPU i (modulo the CPU count); applies from the next start()
+    void setCpuPinning(bool enabled) { pin_threads_ = enabled; }
+
     // Status
     bool isRunning() const { return is_running_; }
-    size_t getThreadCount() const { return threads_.size(); }
-    size_t getQueueSize() const;
+    size_t getThreadCount() const { return workers_.size(); }
+    size_t getQueueSize() const { return pending_.load(); }
+    // Tasks a worker took from a peer's deque
+    uint64_t getStealCount() const { return steals_.load(std::memory_order_relaxed); }
 
 private:
-    std::vector<std::thread> threads_;
-    std::queue<Task> tasks_;
-    
-    mutable std::mutex queue_mutex_;
-    std::condition_variable condition_;
+    struct Worker {
+        std::thread thread;
+        WorkStealingDeque<Task*> deque;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    MpmcQueue<Task> injection_;
+    std::mutex overflow_mutex_;
+    std::deque<Task> overflow_;
+    std::atomic<size_t> overflow_size_;
+
+    // Queued tasks not yet taken by a worker; sleeping workers wait on it
+    std::atomic<size_t> pending_;
+    std::mutex idle_mutex_;
+    std::condition_variable idle_condition_;
+    std::atomic<size_t> sleeping_;
+
     std::atomic<bool> is_running_;
-    
-    void workerLoop();
+    std::atomic<bool> draining_; // workers keep going until nothing is queued
+    bool pin_threads_;
+    std::atomic<uint64_t> steals_;
+
+    void shutdown(bool drain);
+    void workerLoop(size_t index);
+    bool takeTask(size_t index, Task& task);
+    bool takeInjected(Task& task);
+    bool stealTask(size_t index, Task& task);
+    void wakeOne();
 };
 
 #endif // BUILD_WASM
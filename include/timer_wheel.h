@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timing wheel: four levels of 64 slots, where a slot of each
+// level spans one turn of the level below. Arming and cancelling a timer is
+// a list splice whatever its delay, and a tick only visits the slot falling
+// due; a timer far out waits in a coarse slot and drops a level each time the
+// wheel below it completes a turn. Expiry is rounded up to the next tick, and
+// delays beyond the wheel's span (64^4 ticks) are clamped to it. Not
+// thread-safe: each event loop owns its own wheel.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t kLevels = 4;
+    static constexpr size_t kSlotBits = 6;
+    static constexpr size_t kSlots = size_t(1) << kSlotBits;
+
+    // Intrusive node, embedded in whatever it times; the tag tells advance()'s
+    // caller which one expired. A timer must not outlive its wheel while armed.
+    class Timer {
+    public:
+        explicit Timer(uint64_t tag = 0) : tag_(tag), expiry_(0), prev_(nullptr), next_(nullptr) {}
+        ~Timer() { unlink(); }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        uint64_t getTag() const { return tag_; }
+        bool isArmed() const { return next_ != nullptr; }
+
+    private:
+        friend class TimerWheel;
+
+        uint64_t tag_;
+        uint64_t expiry_; // in ticks since the wheel's start
+        Timer* prev_;
+        Timer* next_;
+
+        void unlink();
+    };
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100),
+                        Clock::time_point start = Clock::now());
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Expire `timer` at the first tick at or after `deadline`, moving it if it
+    // is already armed; a deadline already passed expires at the next tick
+    void arm(Timer& timer, Clock::time_point deadline);
+    void cancel(Timer& timer) { timer.unlink(); }
+
+    // Turn the wheel up to `now`, disarming every timer that falls due and
+    // appending its tag to `expired`
+    void advance(Clock::time_point now, std::vector<uint64_t>& expired);
+
+    std::chrono::milliseconds getTick() const { return tick_; }
+
+private:
+    std::chrono::milliseconds tick_;
+    Clock::time_point start_;
+    uint64_t current_; // ticks processed so far
+    // Each slot is the sentinel of a circular list of its timers
+    std::array<std::array<Timer, kSlots>, kLevels> slots_;
+
+    void insert(Timer& timer);
+    void cascade(size_t level, size_t index);
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#ifdef ENABLE_SSL
+#ifndef BUILD_WASM
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+
+// Keys protecting RFC 5077 session tickets. New tickets are always sealed
+// with the newest key; a few retired keys are kept so tickets issued before
+// a rotation still resume (and are then reissued under the current key).
+// Rotation happens lazily on use once the current key is older than the
+// interval. One ring serves every listener shard. Thread-safe.
+class TicketKeyRing {
+public:
+    static constexpr size_t kNameSize = 16;
+    static constexpr size_t kSecretSize = 32;
+    static constexpr int kDefaultRotationSeconds = 3600;
+    static constexpr size_t kDefaultRetainedKeys = 2;
+
+    struct Key {
+        unsigned char name[kNameSize];
+        unsigned char aes_key[kSecretSize];  // AES-256-CBC
+        unsigned char hmac_key[kSecretSize]; // HMAC-SHA256
+        time_t created;
+    };
+
+    explicit TicketKeyRing(int rotation_seconds = kDefaultRotationSeconds,
+                           size_t retained_keys = kDefaultRetainedKeys);
+
+    void setRotationInterval(int seconds);
+    int getRotationInterval() const;
+
+    // Key for sealing a new ticket, rotating first when the current one is due
+    bool current(time_t now, Key& key);
+    // Key named by a presented ticket. `renew` is set when it has been
+    // rotated out, so the client should get a fresh ticket.
+    bool find(const unsigned char* name, time_t now, Key& key, bool& renew);
+
+    // Force a new current key
+    bool rotate(time_t now);
+
+    size_t size() const;
+    uint64_t getRotationCount() const;
+
+private:
+    bool rotateLocked(time_t now);
+    void rotateIfDueLocked(time_t now);
+
+    mutable std::mutex mutex_;
+    std::deque<Key> keys_; // newest first
+    int rotation_seconds_;
+    size_t retained_keys_;
+    uint64_t rotations_;
+};
+
+#endif // BUILD_WASM
+#endif // ENABLE_SSL
@@ -0,0 +1,182 @@
+#include "access_log.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Longest client address and protocol version written out
+constexpr size_t kMaxAddressSize = 46;
+constexpr size_t kMaxVersionSize = 16;
+// Everything in a JSON line but the client, path and version strings
+constexpr size_t kJsonFixedSize = 192;
+
+void putJsonString(LogLine& line, std::string_view text) {
+    static const char kHex[] = "0123456789abcdef";
+    line.put('"');
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            line.put('\\');
+            line.put(c);
+        } else if (byte < 0x20 || byte == 0x7f) {
+            line.put("\\u00");
+            line.put(kHex[byte >> 4]);
+            line.put(kHex[byte & 0xf]);
+        } else {
+            line.put(c);
+        }
+    }
+    line.put('"');
+}
+
+template <typename Integer>
+void storeLittleEndian(char* out, Integer value) {
+    for (size_t i = 0; i < sizeof(Integer); ++i) {
+        out[i] = static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff);
+    }
+}
+
+// Dotted-quad IPv4 into `out` (network order); false for anything else
+bool parseIpv4(std::string_view text, char* out) {
+    unsigned value = 0;
+    size_t octet = 0;
+    size_t digits = 0;
+    for (char c : text) {
+        if (c >= '0' && c <= '9' && digits < 3) {
+            value = value * 10 + static_cast<unsigned>(c - '0');
+            ++digits;
+        } else if (c == '.' && digits > 0 && octet < 3 && value <= 255) {
+            out[octet++] = static_cast<char>(value);
+            value = 0;
+            digits = 0;
+        } else {
+            return false;
+        }
+    }
+    if (octet != 3 || digits == 0 || value > 255) {
+        return false;
+    }
+    out[3] = static_cast<char>(value);
+    return true;
+}
+
+uint64_t nextRandom() {
+    // xorshift64*, one generator per thread, seeded from its address
+    thread_local uint64_t state = 0;
+    if (state == 0) {
+        state = reinterpret_cast<uintptr_t>(&state) ^
+                static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+                0x9e3779b97f4a7c15ull;
+        state = state ? state : 1;
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+} // namespace
+
+AccessLog::AccessLog() : enabled_(false), format_(Format::JSON_LINES), sample_threshold_(0) {
+}
+
+void AccessLog::enable(Format format, double sample_rate) {
+    // Converting 2^64 or more to uint64_t is undefined, so the cast only
+    // sees products below it; anything at the top samples everything
+    uint64_t threshold = 0;
+    double scaled = sample_rate * 0x1p64;
+    if (sample_rate >= 1.0 || scaled >= 0x1p64) {
+        threshold = std::numeric_limits<uint64_t>::max();
+    } else if (sample_rate > 0.0) {
+        threshold = static_cast<uint64_t>(scaled);
+    }
+    format_.store(format, std::memory_order_relaxed);
+    sample_threshold_.store(threshold, std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void AccessLog::disable() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+bool AccessLog::sample() const {
+    if (!isEnabled()) {
+        return false;
+    }
+    uint64_t threshold = sample_threshold_.load(std::memory_order_relaxed);
+    return threshold == std::numeric_limits<uint64_t>::max() || nextRandom() < threshold;
+}
+
+void AccessLog::write(const Entry& entry) const {
+    Format format = getFormat();
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    uint64_t timestamp_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+
+    Logger::getInstance().writeAccessRecord(maxRecordSize(entry, format), [&](char* out) {
+        return format == Format::BINARY ? formatBinary(entry, timestamp_us, out)
+                                        : formatJson(entry, timestamp_us / 1000, out);
+    });
+}
+
+size_t AccessLog::maxRecordSize(const Entry& entry, Format format) {
+    size_t path = std::min(entry.path.size(), kMaxPathSize);
+    if (format == Format::BINARY) {
+        return kBinaryHeaderSize + path;
+    }
+    // Any byte escapes to at most six
+    return kJsonFixedSize + 6 * (std::min(entry.client_address.size(), kMaxAddressSize) +
+                                 std::min(entry.version.size(), kMaxVersionSize) + path);
+}
+
+size_t AccessLog::formatJson(const Entry& entry, uint64_t timestamp_ms, char* out) {
+    LogLine line(out, 0, maxRecordSize(entry, Format::JSON_LINES));
+    line.put("{\"ts\":");
+    line.put(timestamp_ms);
+    line.put(",\"client\":");
+    putJsonString(line, entry.client_address.substr(0, kMaxAddressSize));
+    line.put(",\"method\":\"");
+    line.put(HttpRequest::methodName(entry.method));
+    line.put("\",\"path\":");
+    putJsonString(line, entry.path.substr(0, kMaxPathSize));
+    line.put(",\"version\":");
+    putJsonString(line, entry.version.substr(0, kMaxVersionSize));
+    line.put(",\"status\":");
+    line.put(entry.status);
+    line.put(",\"bytes\":");
+    line.put(entry.bytes);
+    line.put(",\"latency_us\":");
+    line.put(entry.latency_us);
+    line.put(",\"tls\":");
+    line.put(entry.tls);
+    line.put(",\"resumed\":");
+    line.put(entry.tls_resumed);
+    line.put("}\n");
+    return line.size();
+}
+
+size_t AccessLog::formatBinary(const Entry& entry, uint64_t timestamp_us, char* out) {
+    std::string_view path = entry.path.substr(0, kMaxPathSize);
+    size_t size = kBinaryHeaderSize + path.size();
+    uint8_t flags = (entry.tls ? kFlagTls : 0) | (entry.tls_resumed ? kFlagTlsResumed : 0);
+    uint64_t latency = std::min<uint64_t>(entry.latency_us, std::numeric_limits<uint32_t>::max());
+
+    std::memset(out, 0, kBinaryHeaderSize);
+    storeLittleEndian(out, static_cast<uint16_t>(size));
+    out[2] = static_cast<char>(kBinaryVersion);
+    out[3] = static_cast<char>(entry.method);
+    storeLittleEndian(out + 4, static_cast<uint16_t>(entry.status));
+    out[6] = static_cast<char>(flags);
+    storeLittleEndian(out + 8, timestamp_us);
+    storeLittleEndian(out + 16, entry.bytes);
+    storeLittleEndian(out + 24, static_cast<uint32_t>(latency));
+    if (!parseIpv4(entry.client_address, out + 28)) {
+        std::memset(out + 28, 0, 4);
+    }
+    storeLittleEndian(out + 32, static_cast<uint16_t>(path.size()));
+    std::memcpy(out + kBinaryHeaderSize, path.data(), path.size());
+    return size;
+}
@@ -0,0 +1,46 @@
+#include "admission_control.h"
+
+AdmissionControl::AdmissionControl()
+    : max_connections_(0), max_per_client_(0), active_(0), rejected_(0) {
+}
+
+bool AdmissionControl::tryAdmit(const std::string& client) {
+    size_t limit = max_connections_.load(std::memory_order_relaxed);
+    size_t active = active_.fetch_add(1, std::memory_order_relaxed);
+    if (limit > 0 && active >= limit) {
+        active_.fetch_sub(1, std::memory_order_relaxed);
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    size_t per_client = max_per_client_.load(std::memory_order_relaxed);
+    if (per_client > 0) {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        size_t& count = clients_[client];
+        if (count >= per_client) {
+            active_.fetch_sub(1, std::memory_order_relaxed);
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        ++count;
+    }
+    return true;
+}
+
+void AdmissionControl::release(const std::string& client) {
+    active_.fetch_sub(1, std::memory_order_relaxed);
+
+    if (max_per_client_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        auto it = clients_.find(client);
+        if (it != clients_.end() && --it->second == 0) {
+            clients_.erase(it); // keep the map as small as the set of live clients
+        }
+    }
+}
+
+size_t AdmissionControl::getActiveConnections(const std::string& client) const {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = clients_.find(client);
+    return it != clients_.end() ? it->second : 0;
+}
@@ -0,0 +1,96 @@
+#include "arena.h"
+
+#include <cstdint>
+#include <new>
+
+namespace {
+
+char* alignUp(char* pointer, size_t alignment) {
+    uintptr_t value = reinterpret_cast<uintptr_t>(pointer);
+    return reinterpret_cast<char*>((value + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1));
+}
+
+} // namespace
+
+Arena::Arena(size_t block_size)
+    : block_size_(block_size), first_(nullptr), current_(nullptr), cursor_(nullptr), end_(nullptr), used_(0),
+      capacity_(0) {
+}
+
+Arena::~Arena() {
+    Block* block = first_;
+    while (block) {
+        Block* next = block->next;
+        ::operator delete(block);
+        block = next;
+    }
+}
+
+void Arena::reset() {
+    if (!first_) {
+        return;
+    }
+
+    // Usually nothing to trim; only a run of oversized requests leaves a
+    // long chain behind
+    Block* kept = first_;
+    for (size_t i = 0; i < kMaxRetainedBlocks && kept->next; ++i) {
+        kept = kept->next;
+    }
+    Block* extra = kept->next;
+    kept->next = nullptr;
+    while (extra) {
+        Block* next = extra->next;
+        capacity_ -= extra->size;
+        ::operator delete(extra);
+        extra = next;
+    }
+
+    current_ = first_;
+    cursor_ = dataOf(first_);
+    end_ = cursor_ + first_->size;
+    used_ = 0;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    char* start = alignUp(cursor_, alignment);
+    if (cursor_ && start + bytes <= end_) {
+        cursor_ = start + bytes;
+        used_ += bytes;
+        return start;
+    }
+    return allocateFromNextBlock(bytes, alignment);
+}
+
+void* Arena::allocateFromNextBlock(size_t bytes, size_t alignment) {
+    size_t needed = bytes + alignment;
+
+    // Blocks kept from earlier requests come first
+    Block* next = current_ ? current_->next : first_;
+    while (next && next->size < needed) {
+        next = next->next;
+    }
+
+    if (!next) {
+        size_t size = needed > block_size_ ? needed : block_size_;
+        next = static_cast<Block*>(::operator new(sizeof(Block) + size));
+        next->size = size;
+        capacity_ += size;
+        if (!first_) {
+            next->next = nullptr;
+            first_ = next;
+        } else {
+            // Linked in after the current block, so the chain still runs
+            // through every block not yet used since the reset
+            next->next = current_->next;
+            current_->next = next;
+        }
+    }
+
+    current_ = next;
+    char* start = alignUp(dataOf(next), alignment);
+    cursor_ = start + bytes;
+    end_ = dataOf(next) + next->size;
+    used_ += bytes;
+    return start;
+}
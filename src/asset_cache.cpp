@@ -0,0 +1,320 @@
+#include "asset_cache.h"
+#include "http_date.h"
+#include "http_response.h"
+#include "string_util.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+uint64_t fnv1a(std::string_view data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string_view opaqueTag(std::string_view etag) {
+    etag = string_util::trim(etag);
+    if (etag.size() >= 2 && etag[0] == 'W' && etag[1] == '/') {
+        etag.remove_prefix(2);
+    }
+    return etag;
+}
+
+} // namespace
+
+bool etagMatches(std::string_view if_none_match, std::string_view etag) {
+    std::string_view wanted = opaqueTag(etag);
+    while (!if_none_match.empty()) {
+        size_t comma = if_none_match.find(',');
+        std::string_view candidate = string_util::trim(if_none_match.substr(0, comma));
+        if (candidate == "*" || (!candidate.empty() && opaqueTag(candidate) == wanted)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        if_none_match.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+compression::Encoding Asset::selectEncoding(std::string_view accept_encoding) const {
+    using compression::Encoding;
+    // br compresses text noticeably better than gzip; prefer it on ties
+    Encoding best = Encoding::IDENTITY;
+    double best_weight = 0.0;
+    for (Encoding encoding : {Encoding::BROTLI, Encoding::GZIP}) {
+        if (!variant(encoding).body) {
+            continue;
+        }
+        double weight = compression::acceptWeight(accept_encoding, encoding);
+        if (weight > best_weight) {
+            best = encoding;
+            best_weight = weight;
+        }
+    }
+    return best;
+}
+
+bool Asset::matchesEtag(std::string_view if_none_match) const {
+    for (const Variant& entry : variants) {
+        if (entry.body && etagMatches(if_none_match, entry.etag)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t Asset::memoryUsage() const {
+    size_t total = path.size() + content_type.size() + last_modified.size();
+    for (const Variant& entry : variants) {
+        total += entry.etag.size() + (entry.body ? entry.body->size() : 0);
+    }
+    return total;
+}
+
+AssetCache::AssetCache(size_t max_bytes, size_t max_asset_size)
+    : max_bytes_(max_bytes), max_asset_size_(max_asset_size), memory_usage_(0), hits_(0), misses_(0) {
+}
+
+std::shared_ptr<const Asset> AssetCache::get(const std::shared_ptr<const CachedFile>& file) {
+    if (!file || file->getSize() > max_asset_size_) {
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(file->getPath());
+        if (it != entries_.end()) {
+            const Entry& entry = it->second;
+            if (entry.device == file->getDevice() && entry.inode == file->getInode() &&
+                entry.size == file->getSize() && entry.mtime_ns == file->getModifiedTimeNs()) {
+                lru_.splice(lru_.begin(), lru_, entry.lru_position);
+                ++hits_;
+                return entry.asset;
+            }
+            erase(it); // stale: the file changed since the asset was built
+        }
+        ++misses_;
+    }
+
+    // Reading and compressing happen outside the lock; two workers missing
+    // on the same file at once both build it and the later one wins
+    std::shared_ptr<const Asset> asset = build(*file);
+    if (!asset) {
+        return nullptr;
+    }
+
+    size_t usage = asset->memoryUsage();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (usage > max_bytes_) {
+        return asset; // served once, never cached
+    }
+
+    auto it = entries_.find(file->getPath());
+    if (it != entries_.end()) {
+        erase(it);
+    }
+
+    lru_.push_front(file->getPath());
+    entries_[file->getPath()] = Entry{asset, file->getDevice(), file->getInode(), file->getSize(),
+                                      file->getModifiedTimeNs(), lru_.begin()};
+    memory_usage_ += usage;
+    evictOverflow();
+    return asset;
+}
+
+void AssetCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    memory_usage_ = 0;
+}
+
+size_t AssetCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t AssetCache::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memory_usage_;
+}
+
+uint64_t AssetCache::getHits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint64_t AssetCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+std::shared_ptr<const Asset> AssetCache::build(const CachedFile& file) {
+    using compression::Encoding;
+
+    auto content = std::make_shared<std::string>();
+    if (!file.readInto(*content, 0, file.getSize())) {
+        return nullptr;
+    }
+
+    auto asset = std::make_shared<Asset>();
+    asset->path = file.getPath();
+    asset->content_type = HttpResponse::mimeTypeForPath(file.getPath());
+    asset->modified_time = static_cast<time_t>(file.getModifiedTimeNs() / 1000000000);
+    asset->last_modified = http_date::format(asset->modified_time);
+
+    // Strong validator: content hash plus length
+    char tag[48];
+    std::snprintf(tag, sizeof(tag), "%016llx-%zx", static_cast<unsigned long long>(fnv1a(*content)),
+                  content->size());
+    std::string base_tag = tag;
+    asset->variants[static_cast<size_t>(Encoding::IDENTITY)] = {content, "\"" + base_tag + "\""};
+
+    if (content->size() >= kMinCompressSize && compression::isCompressibleType(asset->content_type)) {
+        const std::pair<Encoding, const char*> codings[] = {{Encoding::GZIP, "-gz"}, {Encoding::BROTLI, "-br"}};
+        for (const auto& coding : codings) {
+            auto compressed = std::make_shared<std::string>();
+            // Keep a variant only if it actually saves bytes
+            if (compression::compress(coding.first, *content, *compressed) && compressed->size() < content->size()) {
+                asset->variants[static_cast<size_t>(coding.first)] = {std::move(compressed),
+                                                                      "\"" + base_tag + coding.second + "\""};
+            }
+        }
+    }
+    return asset;
+}
+
+void AssetCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+    memory_usage_ -= it->second.asset->memoryUsage();
+    lru_.erase(it->second.lru_position);
+    entries_.erase(it);
+}
+
+void AssetCache::evictOverflow() {
+    // Responses still holding an evicted asset's bodies keep them alive
+    while (memory_usage_ > max_bytes_ && !lru_.empty()) {
+        erase(entries_.find(lru_.back()));
+    }
+}
+
+CompressedFileCache::CompressedFileCache(size_t max_bytes, size_t max_entry_size)
+    : max_bytes_(max_bytes), max_entry_size_(max_entry_size), memory_usage_(0), hits_(0), misses_(0) {
+}
+
+std::shared_ptr<const std::string> CompressedFileCache::get(const std::shared_ptr<const CachedFile>& file,
+                                                            compression::Encoding encoding) {
+    if (!file || !compression::Compressor::forThread(encoding)) {
+        return nullptr;
+    }
+    std::string key = std::string(compression::name(encoding)) + ":" + file->getPath();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            const Entry& entry = it->second;
+            if (entry.device == file->getDevice() && entry.inode == file->getInode() &&
+                entry.size == file->getSize() && entry.mtime_ns == file->getModifiedTimeNs()) {
+                lru_.splice(lru_.begin(), lru_, entry.lru_position);
+                ++hits_;
+                return entry.body;
+            }
+            erase(it); // stale: the file changed since it was compressed
+        }
+        ++misses_;
+    }
+
+    // As with assets, concurrent misses each compress and the later one wins
+    std::shared_ptr<const std::string> body = build(*file, encoding);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        erase(it);
+    }
+
+    lru_.push_front(key);
+    Entry entry{body, file->getDevice(), file->getInode(), file->getSize(), file->getModifiedTimeNs(), lru_.begin()};
+    memory_usage_ += memoryUsage(key, entry);
+    entries_[key] = std::move(entry);
+    evictOverflow();
+    return body;
+}
+
+void CompressedFileCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    memory_usage_ = 0;
+}
+
+size_t CompressedFileCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t CompressedFileCache::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memory_usage_;
+}
+
+uint64_t CompressedFileCache::getHits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint64_t CompressedFileCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+std::shared_ptr<const std::string> CompressedFileCache::build(const CachedFile& file,
+                                                              compression::Encoding encoding) const {
+    compression::Compressor* compressor = compression::Compressor::forThread(encoding);
+    if (!compressor || !compressor->begin()) {
+        return nullptr;
+    }
+
+    // Read a chunk at a time and give up as soon as the output stops paying
+    // for itself, so a miss never holds more than the entry limit
+    size_t size = file.getSize();
+    size_t limit = std::min(size, std::min(max_entry_size_, max_bytes_));
+    auto compressed = std::make_shared<std::string>();
+    std::string chunk;
+    for (size_t offset = 0; offset < size; offset += chunk.size()) {
+        chunk.clear();
+        if (!file.readInto(chunk, offset, std::min(kReadChunkSize, size - offset)) || chunk.empty() ||
+            !compressor->update(chunk, *compressed) || compressed->size() >= limit) {
+            return nullptr;
+        }
+    }
+    if (!compressor->finish(*compressed) || compressed->size() >= limit) {
+        return nullptr;
+    }
+    compressed->shrink_to_fit();
+    return compressed;
+}
+
+size_t CompressedFileCache::memoryUsage(const std::string& key, const Entry& entry) {
+    return key.size() + (entry.body ? entry.body->size() : 0);
+}
+
+void CompressedFileCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+    memory_usage_ -= memoryUsage(it->first, it->second);
+    lru_.erase(it->second.lru_position);
+    entries_.erase(it);
+}
+
+void CompressedFileCache::evictOverflow() {
+    // Responses still sending an evicted body keep it alive
+    while (memory_usage_ > max_bytes_ && !lru_.empty()) {
+        erase(entries_.find(lru_.back()));
+    }
+}
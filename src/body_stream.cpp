@@ -0,0 +1,143 @@
+#include "body_stream.h"
+
+BodyStream::BodyStream(Notify notify)
+    : notify_(std::move(notify)), notified_(false), closed_(false), failed_(false), aborted_(false),
+      encoder_finished_(false) {
+}
+
+bool BodyStream::write(std::string_view data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this]() { return pending_.size() < kHighWaterMark || aborted_; });
+    if (closed_ || aborted_) {
+        return false;
+    }
+    if (data.empty()) {
+        return true;
+    }
+    pending_.append(data);
+    notifyLocked();
+    return true;
+}
+
+bool BodyStream::sendEvent(std::string_view data, std::string_view event, std::string_view id) {
+    std::string formatted;
+    appendEvent(formatted, data, event, id);
+    return write(formatted);
+}
+
+void BodyStream::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || aborted_) {
+        return;
+    }
+    closed_ = true;
+    notifyLocked();
+}
+
+void BodyStream::fail() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || aborted_) {
+        return;
+    }
+    closed_ = true;
+    failed_ = true;
+    pending_.clear();
+    notifyLocked();
+}
+
+bool BodyStream::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !closed_ && !aborted_;
+}
+
+bool BodyStream::encode(compression::Encoding encoding) {
+    auto encoder = std::make_unique<compression::Compressor>(encoding);
+    if (!encoder->begin()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    encoder_ = std::move(encoder);
+    return true;
+}
+
+BodyStream::State BodyStream::take(std::string& out) {
+    compression::Compressor* encoder = nullptr;
+    std::string taken;
+    State state;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_) {
+            return State::FAILED;
+        }
+        encoder = encoder_.get();
+        std::string& target = encoder ? taken : out;
+        if (target.empty()) {
+            target.swap(pending_);
+        } else {
+            target.append(pending_);
+            pending_.clear();
+        }
+        notified_ = false;
+        drained_.notify_all();
+        state = closed_ ? State::ENDED : State::OPEN;
+    }
+    if (!encoder || encoder_finished_) {
+        return state;
+    }
+
+    // Compressed outside the lock, so writers are not held up by it
+    bool ended = state == State::ENDED;
+    bool ok = taken.empty() || (encoder->update(taken, out) && (ended || encoder->flush(out)));
+    if (ok && ended) {
+        ok = encoder->finish(out);
+        encoder_finished_ = true;
+    }
+    if (!ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        failed_ = true;
+        aborted_ = true;
+        pending_.clear();
+        drained_.notify_all();
+        return State::FAILED;
+    }
+    return state;
+}
+
+bool BodyStream::isReady() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !pending_.empty() || closed_;
+}
+
+void BodyStream::abort() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aborted_ = true;
+    pending_.clear();
+    drained_.notify_all();
+}
+
+void BodyStream::appendEvent(std::string& out, std::string_view data, std::string_view event, std::string_view id) {
+    if (!event.empty()) {
+        out.append("event: ").append(event).append("\n");
+    }
+    if (!id.empty()) {
+        out.append("id: ").append(id).append("\n");
+    }
+    // A line break inside the data would end the field; each line gets its own
+    while (true) {
+        size_t newline = data.find('\n');
+        out.append("data: ").append(data.substr(0, newline)).append("\n");
+        if (newline == std::string_view::npos) {
+            break;
+        }
+        data.remove_prefix(newline + 1);
+    }
+    out.append("\n");
+}
+
+void BodyStream::notifyLocked() {
+    if (!notified_ && !aborted_ && notify_) {
+        notified_ = true;
+        notify_();
+    }
+}
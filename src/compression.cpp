@@ -0,0 +1,405 @@
+#include "compression.h"
+#include "string_util.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace compression {
+
+namespace {
+
+// Output grows by this much whenever a streaming call runs out of room
+constexpr size_t kOutputChunk = 16 * 1024;
+
+constexpr int kGzipStreamLevel = 6;
+constexpr int kBrotliStreamQuality = 5;
+constexpr int kZstdStreamLevel = 3;
+constexpr int kZstdBestLevel = 19;
+
+#if defined(HAVE_ZLIB) || defined(HAVE_BROTLI) || defined(HAVE_ZSTD)
+// Grow `output` by a chunk and return where the new room starts
+char* growOutput(std::string& output, size_t& room) {
+    size_t used = output.size();
+    output.resize(used + kOutputChunk);
+    room = kOutputChunk;
+    return &output[used];
+}
+#endif
+
+#ifdef HAVE_ZLIB
+bool gzipCompress(std::string_view input, std::string& output) {
+    z_stream stream{};
+    // windowBits 15 + 16 selects the gzip wrapper instead of zlib's
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    output.resize(deflateBound(&stream, static_cast<uLong>(input.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+
+    int result = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+#endif
+
+#ifdef HAVE_BROTLI
+bool brotliCompress(std::string_view input, std::string& output) {
+    size_t encoded_size = BrotliEncoderMaxCompressedSize(input.size());
+    if (encoded_size == 0) {
+        return false;
+    }
+
+    output.resize(encoded_size);
+    if (!BrotliEncoderCompress(BROTLI_DEFAULT_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+                               input.size(), reinterpret_cast<const uint8_t*>(input.data()),
+                               &encoded_size, reinterpret_cast<uint8_t*>(&output[0]))) {
+        output.clear();
+        return false;
+    }
+    output.resize(encoded_size);
+    return true;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+bool zstdCompress(std::string_view input, std::string& output) {
+    output.resize(ZSTD_compressBound(input.size()));
+    size_t encoded_size = ZSTD_compress(&output[0], output.size(), input.data(), input.size(), kZstdBestLevel);
+    if (ZSTD_isError(encoded_size)) {
+        output.clear();
+        return false;
+    }
+    output.resize(encoded_size);
+    return true;
+}
+#endif
+
+} // namespace
+
+bool isAvailable(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::IDENTITY:
+            return true;
+        case Encoding::GZIP:
+#ifdef HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case Encoding::BROTLI:
+#ifdef HAVE_BROTLI
+            return true;
+#else
+            return false;
+#endif
+        case Encoding::ZSTD:
+#ifdef HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+std::string_view name(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::GZIP:   return "gzip";
+        case Encoding::BROTLI: return "br";
+        case Encoding::ZSTD:   return "zstd";
+        default:               return "identity";
+    }
+}
+
+bool compress(Encoding encoding, std::string_view input, std::string& output) {
+    switch (encoding) {
+#ifdef HAVE_ZLIB
+        case Encoding::GZIP:
+            return gzipCompress(input, output);
+#endif
+#ifdef HAVE_BROTLI
+        case Encoding::BROTLI:
+            return brotliCompress(input, output);
+#endif
+#ifdef HAVE_ZSTD
+        case Encoding::ZSTD:
+            return zstdCompress(input, output);
+#endif
+        default:
+            (void)input;
+            (void)output;
+            return false;
+    }
+}
+
+bool isCompressibleType(std::string_view content_type) {
+    std::string_view type = string_util::trim(content_type.substr(0, content_type.find(';')));
+    if (type.substr(0, 5) == "text/") {
+        return true;
+    }
+    return type == "application/javascript" || type == "application/json" || type == "application/xml" ||
+           type == "application/wasm" || type == "image/svg+xml";
+}
+
+double acceptWeight(std::string_view accept_encoding, Encoding encoding) {
+    std::string_view wanted = name(encoding);
+    double wildcard = -1.0;
+
+    while (!accept_encoding.empty()) {
+        size_t comma = accept_encoding.find(',');
+        std::string_view item = string_util::trim(accept_encoding.substr(0, comma));
+        accept_encoding = comma == std::string_view::npos ? std::string_view() : accept_encoding.substr(comma + 1);
+
+        // coding [; q=weight]
+        size_t semicolon = item.find(';');
+        std::string_view coding = string_util::trim(item.substr(0, semicolon));
+        double weight = 1.0;
+        if (semicolon != std::string_view::npos) {
+            std::string_view parameter = string_util::trim(item.substr(semicolon + 1));
+            if (parameter.size() > 2 && string_util::toLower(parameter[0]) == 'q' && parameter[1] == '=') {
+                std::string value(parameter.substr(2));
+                weight = std::strtod(value.c_str(), nullptr);
+            }
+        }
+
+        if (string_util::equalsIgnoreCase(coding, wanted)) {
+            return weight;
+        }
+        if (coding == "*") {
+            wildcard = weight;
+        }
+    }
+
+    if (wildcard >= 0.0) {
+        return wildcard;
+    }
+    // identity is acceptable unless explicitly refused
+    return encoding == Encoding::IDENTITY ? 1.0 : 0.0;
+}
+
+Encoding negotiate(std::string_view accept_encoding) {
+    // zstd at its default level costs the least CPU per byte saved, and br
+    // beats gzip on text; earlier codings win ties
+    Encoding best = Encoding::IDENTITY;
+    double best_weight = 0.0;
+    for (Encoding encoding : {Encoding::ZSTD, Encoding::BROTLI, Encoding::GZIP}) {
+        if (!isAvailable(encoding)) {
+            continue;
+        }
+        double weight = acceptWeight(accept_encoding, encoding);
+        if (weight > best_weight) {
+            best = encoding;
+            best_weight = weight;
+        }
+    }
+    return best;
+}
+
+Compressor::Compressor(Encoding encoding) : encoding_(encoding), state_(nullptr) {
+}
+
+Compressor::~Compressor() {
+    release();
+}
+
+void Compressor::release() {
+    if (!state_) {
+        return;
+    }
+    switch (encoding_) {
+#ifdef HAVE_ZLIB
+        case Encoding::GZIP:
+            deflateEnd(static_cast<z_stream*>(state_));
+            delete static_cast<z_stream*>(state_);
+            break;
+#endif
+#ifdef HAVE_BROTLI
+        case Encoding::BROTLI:
+            BrotliEncoderDestroyInstance(static_cast<BrotliEncoderState*>(state_));
+            break;
+#endif
+#ifdef HAVE_ZSTD
+        case Encoding::ZSTD:
+            ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(state_));
+            break;
+#endif
+        default:
+            break;
+    }
+    state_ = nullptr;
+}
+
+bool Compressor::begin() {
+    switch (encoding_) {
+#ifdef HAVE_ZLIB
+        case Encoding::GZIP: {
+            if (state_) {
+                return deflateReset(static_cast<z_stream*>(state_)) == Z_OK;
+            }
+            auto stream = std::make_unique<z_stream>();
+            // windowBits 15 + 16 selects the gzip wrapper instead of zlib's
+            if (deflateInit2(stream.get(), kGzipStreamLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                return false;
+            }
+            state_ = stream.release();
+            return true;
+        }
+#endif
+#ifdef HAVE_BROTLI
+        case Encoding::BROTLI: {
+            // The encoder has no reset; a fresh instance is still far
+            // cheaper than zlib's setup
+            release();
+            BrotliEncoderState* encoder = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+            if (!encoder) {
+                return false;
+            }
+            BrotliEncoderSetParameter(encoder, BROTLI_PARAM_QUALITY, kBrotliStreamQuality);
+            state_ = encoder;
+            return true;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case Encoding::ZSTD: {
+            if (state_) {
+                return !ZSTD_isError(ZSTD_CCtx_reset(static_cast<ZSTD_CCtx*>(state_), ZSTD_reset_session_only));
+            }
+            ZSTD_CCtx* context = ZSTD_createCCtx();
+            if (!context) {
+                return false;
+            }
+            ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, kZstdStreamLevel);
+            state_ = context;
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+bool Compressor::update(std::string_view input, std::string& output) {
+    return run(input, output, Mode::PROCESS);
+}
+
+bool Compressor::flush(std::string& output) {
+    return run(std::string_view(), output, Mode::FLUSH);
+}
+
+bool Compressor::finish(std::string& output) {
+    return run(std::string_view(), output, Mode::FINISH);
+}
+
+bool Compressor::run(std::string_view input, std::string& output, Mode mode) {
+    if (!state_) {
+        return false;
+    }
+
+    size_t room = 0;
+    switch (encoding_) {
+#ifdef HAVE_ZLIB
+        case Encoding::GZIP: {
+            z_stream* stream = static_cast<z_stream*>(state_);
+            stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+            stream->avail_in = static_cast<uInt>(input.size());
+            for (;;) {
+                char* out = growOutput(output, room);
+                stream->next_out = reinterpret_cast<Bytef*>(out);
+                stream->avail_out = static_cast<uInt>(room);
+                int flush = mode == Mode::FINISH ? Z_FINISH : mode == Mode::FLUSH ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+                int result = deflate(stream, flush);
+                output.resize(output.size() - stream->avail_out);
+                if (result == Z_STREAM_ERROR) {
+                    return false;
+                }
+                // Short of the end, a partly filled output means zlib has
+                // consumed the input (and, flushing, emitted all of it)
+                if (mode == Mode::FINISH ? result == Z_STREAM_END : stream->avail_in == 0 && stream->avail_out != 0) {
+                    return true;
+                }
+            }
+        }
+#endif
+#ifdef HAVE_BROTLI
+        case Encoding::BROTLI: {
+            BrotliEncoderState* encoder = static_cast<BrotliEncoderState*>(state_);
+            const uint8_t* next_in = reinterpret_cast<const uint8_t*>(input.data());
+            size_t avail_in = input.size();
+            for (;;) {
+                uint8_t* next_out = reinterpret_cast<uint8_t*>(growOutput(output, room));
+                BrotliEncoderOperation operation = mode == Mode::FINISH ? BROTLI_OPERATION_FINISH
+                                                   : mode == Mode::FLUSH ? BROTLI_OPERATION_FLUSH
+                                                                         : BROTLI_OPERATION_PROCESS;
+                if (!BrotliEncoderCompressStream(encoder, operation, &avail_in, &next_in, &room, &next_out, nullptr)) {
+                    output.resize(output.size() - room);
+                    return false;
+                }
+                output.resize(output.size() - room);
+                bool done = mode == Mode::FINISH ? BrotliEncoderIsFinished(encoder) : avail_in == 0;
+                if (done && !BrotliEncoderHasMoreOutput(encoder)) {
+                    return true;
+                }
+            }
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case Encoding::ZSTD: {
+            ZSTD_CCtx* context = static_cast<ZSTD_CCtx*>(state_);
+            ZSTD_inBuffer in{input.data(), input.size(), 0};
+            for (;;) {
+                char* out = growOutput(output, room);
+                ZSTD_outBuffer buffer{out, room, 0};
+                ZSTD_EndDirective directive = mode == Mode::FINISH ? ZSTD_e_end
+                                              : mode == Mode::FLUSH ? ZSTD_e_flush
+                                                                    : ZSTD_e_continue;
+                size_t remaining = ZSTD_compressStream2(context, &buffer, &in, directive);
+                output.resize(output.size() - room + buffer.pos);
+                if (ZSTD_isError(remaining)) {
+                    return false;
+                }
+                if (mode == Mode::PROCESS ? in.pos == in.size : remaining == 0) {
+                    return true;
+                }
+            }
+        }
+#endif
+        default:
+            (void)input;
+            (void)output;
+            (void)mode;
+            (void)room;
+            return false;
+    }
+}
+
+Compressor* Compressor::forThread(Encoding encoding) {
+    if (encoding == Encoding::IDENTITY || !isAvailable(encoding)) {
+        return nullptr;
+    }
+    thread_local std::unique_ptr<Compressor> compressors[kEncodingCount];
+    std::unique_ptr<Compressor>& compressor = compressors[static_cast<size_t>(encoding)];
+    if (!compressor) {
+        compressor = std::make_unique<Compressor>(encoding);
+    }
+    return compressor.get();
+}
+
+} // namespace compression
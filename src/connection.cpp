@@ -0,0 +1,384 @@
+#include "connection.h"
+
+#ifndef BUILD_WASM
+
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+
+namespace {
+constexpr size_t kReadChunkSize = 16384;
+}
+
+Connection::Connection(int socket, const std::string& remote_address, size_t max_body_size)
+    : socket_(socket), remote_address_(remote_address), state_(State::READING),
+      peer_closed_(false), keep_alive_(false), request_count_(0),
+      last_activity_(std::chrono::steady_clock::now()), timer_(static_cast<uint64_t>(socket)), bytes_received_(0),
+      request_start_(last_activity_), rate_mark_(last_activity_), rate_mark_bytes_(0), framer_(max_body_size),
+      head_offset_(0), body_offset_(0), file_offset_(0), body_stream_chunked_(false), handshaking_(false), early_data_open_(false),
+      read_wants_write_(false), write_wants_read_(false), early_bytes_(0)
+#ifdef ENABLE_SSL
+      , tls_(nullptr), ssl_(nullptr)
+#endif
+{
+}
+
+Connection::~Connection() {
+    close();
+}
+
+HttpRequest& Connection::nextRequest() {
+    // Destroyed before the rewind: their destructors still walk arena memory
+    request_.reset();
+    response_.reset();
+    arena_.reset();
+    request_.emplace(&arena_);
+    response_.emplace(&arena_);
+    return *request_;
+}
+
+void Connection::startRequestClock() {
+    request_start_ = std::chrono::steady_clock::now();
+    markRate(request_start_);
+}
+
+void Connection::receive(const char* data, size_t length) {
+    // The first request's clock runs from the accept
+    if (input_buffer_.empty() && request_count_ > 0) {
+        startRequestClock();
+    }
+    input_buffer_.append(data, length);
+    bytes_received_ += length;
+    touch();
+}
+
+#ifdef ENABLE_SSL
+void Connection::enableTls(SslServer& tls, SSL* ssl) {
+    tls_ = &tls;
+    ssl_ = ssl;
+    handshaking_ = true;
+    early_data_open_ = tls.getMaxEarlyData() > 0;
+    handshake_started_ = std::chrono::steady_clock::now();
+}
+#endif
+
+bool Connection::takeEarlyData(size_t length) {
+    if (early_bytes_ == 0) {
+        return false;
+    }
+    early_bytes_ -= std::min(early_bytes_, length);
+    return true;
+}
+
+std::string_view Connection::getAlpnProtocol() const {
+#ifdef ENABLE_SSL
+    if (ssl_) {
+        return SslServer::negotiatedProtocol(ssl_);
+    }
+#endif
+    return std::string_view();
+}
+
+bool Connection::isTls() const {
+#ifdef ENABLE_SSL
+    return ssl_ != nullptr;
+#else
+    return false;
+#endif
+}
+
+bool Connection::isTlsResumed() const {
+#ifdef ENABLE_SSL
+    return ssl_ && !handshaking_ && SSL_session_reused(ssl_);
+#else
+    return false;
+#endif
+}
+
+bool Connection::readAvailable() {
+#ifdef ENABLE_SSL
+    if (ssl_) {
+        return readTls();
+    }
+#endif
+    char buffer[kReadChunkSize];
+
+    while (true) {
+        ssize_t bytes_read = recv(socket_, buffer, sizeof(buffer), 0);
+        if (bytes_read > 0) {
+            receive(buffer, static_cast<size_t>(bytes_read));
+            continue;
+        }
+
+        if (bytes_read == 0) {
+            peer_closed_ = true;
+            return true;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+void Connection::queueBody(std::string body) {
+    body_buffer_ = std::move(body);
+    shared_body_.reset();
+    body_ = body_buffer_;
+    head_offset_ = 0;
+    body_offset_ = 0;
+}
+
+void Connection::queueBody(std::shared_ptr<const std::string> body) {
+    std::string().swap(body_buffer_);
+    shared_body_ = std::move(body);
+    body_ = shared_body_ ? std::string_view(*shared_body_) : std::string_view();
+    head_offset_ = 0;
+    body_offset_ = 0;
+}
+
+void Connection::queueFile(std::shared_ptr<const CachedFile> file) {
+    file_body_ = std::move(file);
+    file_offset_ = 0;
+}
+
+bool Connection::flushOutput() {
+    if (!flushBuffers() || !flushFile()) {
+        return false;
+    }
+
+    if (hasPendingOutput()) {
+        return true; // socket is full; resume on the next EPOLLOUT
+    }
+
+    // Keep the head buffer's capacity for the next response; drop the body
+    head_buffer_.clear();
+    head_offset_ = 0;
+    std::string().swap(body_buffer_);
+    shared_body_.reset();
+    body_ = std::string_view();
+    body_offset_ = 0;
+    file_body_.reset();
+    file_offset_ = 0;
+    return true;
+}
+
+bool Connection::flushBuffers() {
+#ifdef ENABLE_SSL
+    if (ssl_) {
+        return flushBuffersTls();
+    }
+#endif
+    while (head_offset_ < head_buffer_.size() || body_offset_ < body_.size()) {
+        struct iovec chunks[2];
+        int count = 0;
+        if (head_offset_ < head_buffer_.size()) {
+            chunks[count].iov_base = &head_buffer_[head_offset_];
+            chunks[count].iov_len = head_buffer_.size() - head_offset_;
+            ++count;
+        }
+        if (body_offset_ < body_.size()) {
+            chunks[count].iov_base = const_cast<char*>(body_.data() + body_offset_);
+            chunks[count].iov_len = body_.size() - body_offset_;
+            ++count;
+        }
+
+        // sendmsg rather than writev so a closed peer yields EPIPE, not
+        // SIGPIPE; MSG_MORE lets the head share a segment with the file
+        struct msghdr message = {};
+        message.msg_iov = chunks;
+        message.msg_iovlen = static_cast<size_t>(count);
+        int flags = MSG_NOSIGNAL | (file_body_ ? MSG_MORE : 0);
+
+        ssize_t bytes_sent = sendmsg(socket_, &message, flags);
+        if (bytes_sent > 0) {
+            size_t sent = static_cast<size_t>(bytes_sent);
+            size_t from_head = std::min(sent, head_buffer_.size() - head_offset_);
+            head_offset_ += from_head;
+            body_offset_ += sent - from_head;
+            touch();
+            continue;
+        }
+
+        if (bytes_sent < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (bytes_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool Connection::flushFile() {
+    if (!file_body_ || head_offset_ < head_buffer_.size() || body_offset_ < body_.size()) {
+        return true;
+    }
+#ifdef ENABLE_SSL
+    if (ssl_) {
+        return flushFileTls();
+    }
+#endif
+
+    while (file_offset_ < file_body_->getSize()) {
+        off_t offset = static_cast<off_t>(file_offset_);
+        ssize_t bytes_sent = sendfile(socket_, file_body_->getFd(), &offset, file_body_->getSize() - file_offset_);
+        if (bytes_sent > 0) {
+            file_offset_ += static_cast<size_t>(bytes_sent);
+            touch();
+            continue;
+        }
+
+        if (bytes_sent < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (bytes_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        return false; // error, or the file shrank underneath us
+    }
+    return true;
+}
+
+#ifdef ENABLE_SSL
+bool Connection::readTls() {
+    read_wants_write_ = false;
+
+    if (handshaking_) {
+        size_t buffered = input_buffer_.size();
+        SslServer::IoResult result = tls_->acceptStep(ssl_, early_data_open_, input_buffer_);
+        if (input_buffer_.size() > buffered) {
+            early_bytes_ += input_buffer_.size() - buffered;
+            touch();
+        }
+        switch (result) {
+            case SslServer::IoResult::DONE: {
+                handshaking_ = false;
+                auto elapsed = std::chrono::steady_clock::now() - handshake_started_;
+                tls_->recordHandshakeTime(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+                break;
+            }
+            case SslServer::IoResult::WANT_READ:
+                return true;
+            case SslServer::IoResult::WANT_WRITE:
+                read_wants_write_ = true;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    char buffer[kReadChunkSize];
+    while (true) {
+        size_t bytes_read = 0;
+        switch (tls_->readStep(ssl_, buffer, sizeof(buffer), bytes_read)) {
+            case SslServer::IoResult::DONE:
+                receive(buffer, bytes_read);
+                break;
+            case SslServer::IoResult::WANT_READ:
+                return true;
+            case SslServer::IoResult::WANT_WRITE:
+                read_wants_write_ = true;
+                return true;
+            case SslServer::IoResult::CLOSED:
+                peer_closed_ = true;
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+bool Connection::flushBuffersTls() {
+    write_wants_read_ = false;
+
+    // A small body rides in the head's record instead of one of its own
+    if (head_offset_ == 0 && body_offset_ < body_.size() && head_buffer_.size() + body_.size() <= kReadChunkSize) {
+        head_buffer_.append(body_.data() + body_offset_, body_.size() - body_offset_);
+        body_offset_ = body_.size();
+    }
+
+    while (head_offset_ < head_buffer_.size() || body_offset_ < body_.size()) {
+        bool from_head = head_offset_ < head_buffer_.size();
+        const char* data = from_head ? head_buffer_.data() + head_offset_ : body_.data() + body_offset_;
+        size_t size = from_head ? head_buffer_.size() - head_offset_ : body_.size() - body_offset_;
+
+        size_t written = 0;
+        switch (tls_->writeStep(ssl_, data, size, early_data_open_, written)) {
+            case SslServer::IoResult::DONE:
+                if (from_head) {
+                    head_offset_ += written;
+                } else {
+                    body_offset_ += written;
+                }
+                touch();
+                break;
+            case SslServer::IoResult::WANT_WRITE:
+                return true;
+            case SslServer::IoResult::WANT_READ:
+                write_wants_read_ = true;
+                return true;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool Connection::flushFileTls() {
+    write_wants_read_ = false;
+
+    while (file_offset_ < file_body_->getSize()) {
+        size_t written = 0;
+        switch (tls_->sendFileStep(ssl_, file_body_->getFd(), static_cast<off_t>(file_offset_),
+                                   file_body_->getSize() - file_offset_, written)) {
+            case SslServer::IoResult::DONE:
+                file_offset_ += written;
+                touch();
+                break;
+            case SslServer::IoResult::WANT_WRITE:
+                return true;
+            case SslServer::IoResult::WANT_READ:
+                write_wants_read_ = true;
+                return true;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+#endif
+
+void Connection::close() {
+#ifdef ENABLE_SSL
+    if (ssl_) {
+        // Best-effort close_notify; a completed handshake's session stays resumable
+        tls_->closeSslConnection(ssl_);
+        ssl_ = nullptr;
+    }
+#endif
+    if (socket_ >= 0) {
+        ::close(socket_);
+        socket_ = -1;
+    }
+    // Producers still writing find out the client is gone
+    if (body_stream_) {
+        body_stream_->abort();
+        body_stream_.reset();
+    }
+    if (http2_) {
+        http2_->abortBodyStreams();
+    }
+    state_ = State::CLOSED;
+}
+
+#endif // BUILD_WASM
@@ -0,0 +1,198 @@
+#include "event_loop.h"
+
+#ifndef BUILD_WASM
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+constexpr int kMaxEventsPerWait = 256;
+}
+
+EventLoop::EventLoop()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wakeup_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      is_running_(false), quit_(false) {
+    if (epoll_fd_ >= 0 && wakeup_fd_ >= 0) {
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr; // nullptr marks the wakeup descriptor
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event);
+    }
+}
+
+EventLoop::~EventLoop() {
+    for (int timer_fd : timer_fds_) {
+        close(timer_fd);
+    }
+    if (wakeup_fd_ >= 0) {
+        close(wakeup_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+bool EventLoop::add(int fd, uint32_t events, EventCallback callback) {
+    if (epoll_fd_ < 0 || fd < 0 || handlers_.count(fd) != 0) {
+        return false;
+    }
+
+    auto handler = std::make_unique<Handler>();
+    handler->fd = fd;
+    handler->callback = std::move(callback);
+    handler->active = true;
+
+    struct epoll_event event{};
+    event.events = events;
+    event.data.ptr = handler.get();
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+        return false;
+    }
+
+    handlers_[fd] = std::move(handler);
+    return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events) {
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end()) {
+        return false;
+    }
+
+    struct epoll_event event{};
+    event.events = events;
+    event.data.ptr = it->second.get();
+
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void EventLoop::remove(int fd) {
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end()) {
+        return;
+    }
+
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+
+    // The handler may be the one currently executing, and later events in the
+    // same batch may still reference it, so it is only freed after the batch.
+    it->second->active = false;
+    retired_handlers_.push_back(std::move(it->second));
+    handlers_.erase(it);
+}
+
+void EventLoop::run() {
+    if (epoll_fd_ < 0 || wakeup_fd_ < 0) {
+        return;
+    }
+
+    loop_thread_ = std::this_thread::get_id();
+    is_running_ = true;
+
+    struct epoll_event events[kMaxEventsPerWait];
+
+    while (!quit_) {
+        int count = epoll_wait(epoll_fd_, events, kMaxEventsPerWait, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            auto* handler = static_cast<Handler*>(events[i].data.ptr);
+            if (!handler) {
+                uint64_t value;
+                while (read(wakeup_fd_, &value, sizeof(value)) > 0) {
+                }
+                continue;
+            }
+
+            if (handler->active) {
+                handler->callback(events[i].events);
+            }
+        }
+
+        retired_handlers_.clear();
+        runPendingFunctors();
+    }
+
+    runPendingFunctors();
+    retired_handlers_.clear();
+    is_running_ = false;
+}
+
+void EventLoop::stop() {
+    quit_ = true;
+    wakeup();
+}
+
+void EventLoop::post(Functor functor) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_functors_.push_back(std::move(functor));
+    }
+    wakeup();
+}
+
+bool EventLoop::runEvery(int interval_ms, Functor functor) {
+    if (interval_ms <= 0) {
+        return false;
+    }
+
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        return false;
+    }
+
+    struct itimerspec spec{};
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = static_cast<long>(interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+
+    bool added = timerfd_settime(timer_fd, 0, &spec, nullptr) == 0 &&
+        add(timer_fd, EPOLLIN, [timer_fd, functor = std::move(functor)](uint32_t) {
+            uint64_t expirations;
+            while (read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+            }
+            functor();
+        });
+
+    if (!added) {
+        close(timer_fd);
+        return false;
+    }
+
+    timer_fds_.push_back(timer_fd);
+    return true;
+}
+
+void EventLoop::wakeup() {
+    if (wakeup_fd_ < 0) {
+        return;
+    }
+
+    uint64_t value = 1;
+    ssize_t result = write(wakeup_fd_, &value, sizeof(value));
+    (void)result;
+}
+
+void EventLoop::runPendingFunctors() {
+    std::vector<Functor> functors;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        functors.swap(pending_functors_);
+    }
+
+    for (auto& functor : functors) {
+        functor();
+    }
+}
+
+#endif // BUILD_WASM
@@ -0,0 +1,170 @@
+#include "file_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+
+int64_t modifiedTimeNs(const struct stat& info) {
+#if defined(__APPLE__)
+    return static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+}
+
+} // namespace
+
+CachedFile::CachedFile(int fd, const std::string& path)
+    : fd_(fd), path_(path), size_(0), mtime_ns_(0), device_(0), inode_(0) {
+}
+
+CachedFile::~CachedFile() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+std::shared_ptr<const CachedFile> CachedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    std::shared_ptr<CachedFile> file(new CachedFile(fd, path));
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        return nullptr; // directories and devices are never served
+    }
+
+    file->size_ = static_cast<size_t>(info.st_size);
+    file->mtime_ns_ = modifiedTimeNs(info);
+    file->device_ = static_cast<uint64_t>(info.st_dev);
+    file->inode_ = static_cast<uint64_t>(info.st_ino);
+    return file;
+}
+
+bool CachedFile::readInto(std::string& out, size_t offset, size_t length) const {
+    size_t start = out.size();
+    out.resize(start + length);
+    if (!readInto(&out[start], offset, length)) {
+        out.resize(start);
+        return false;
+    }
+    return true;
+}
+
+bool CachedFile::readInto(char* out, size_t offset, size_t length) const {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t bytes_read = pread(fd_, out + done, length - done, static_cast<off_t>(offset + done));
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(bytes_read);
+    }
+    return true;
+}
+
+bool CachedFile::matchesDisk() const {
+    struct stat info;
+    if (stat(path_.c_str(), &info) != 0) {
+        return false;
+    }
+    return static_cast<uint64_t>(info.st_dev) == device_ && static_cast<uint64_t>(info.st_ino) == inode_ &&
+           static_cast<size_t>(info.st_size) == size_ && modifiedTimeNs(info) == mtime_ns_;
+}
+
+FileCache::FileCache(size_t capacity, std::chrono::milliseconds revalidate_after)
+    : capacity_(capacity), revalidate_after_(revalidate_after), hits_(0), misses_(0) {
+}
+
+std::shared_ptr<const CachedFile> FileCache::open(const std::string& path) {
+    auto now = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(path);
+        if (it != entries_.end()) {
+            Entry& entry = it->second;
+            bool fresh = now - entry.checked_at < revalidate_after_;
+            if (fresh || entry.file->matchesDisk()) {
+                entry.checked_at = now;
+                lru_.splice(lru_.begin(), lru_, entry.lru_position);
+                ++hits_;
+                return entry.file;
+            }
+
+            // Replaced or modified on disk: forget it and reopen below
+            lru_.erase(entry.lru_position);
+            entries_.erase(it);
+        }
+        ++misses_;
+    }
+
+    // Open outside the lock so a slow disk does not serialize all workers
+    std::shared_ptr<const CachedFile> file = CachedFile::open(path);
+    if (!file) {
+        return file;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0) {
+        return file;
+    }
+
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+        // Another worker cached it meanwhile
+        it->second.file = file;
+        it->second.checked_at = now;
+        lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+        return file;
+    }
+
+    lru_.push_front(path);
+    entries_[path] = Entry{file, now, lru_.begin()};
+    evictOverflow();
+    return file;
+}
+
+void FileCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+}
+
+void FileCache::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    evictOverflow();
+}
+
+size_t FileCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+uint64_t FileCache::getHits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint64_t FileCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+void FileCache::evictOverflow() {
+    // Evicted files stay open until responses still sending them finish
+    while (entries_.size() > capacity_ && !lru_.empty()) {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+    }
+}
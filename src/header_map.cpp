@@ -0,0 +1,263 @@
+#include "header_map.h"
+#include "string_util.h"
+#include <cstring>
+#include <functional>
+
+namespace {
+
+struct KnownHeader {
+    std::string_view name;
+    HeaderId id;
+};
+
+// Lower-case names; candidates are filtered by length before comparing
+const KnownHeader kKnownHeaders[] = {
+    {"host", HeaderId::HOST},
+    {"connection", HeaderId::CONNECTION},
+    {"content-length", HeaderId::CONTENT_LENGTH},
+    {"content-type", HeaderId::CONTENT_TYPE},
+    {"transfer-encoding", HeaderId::TRANSFER_ENCODING},
+    {"keep-alive", HeaderId::KEEP_ALIVE},
+    {"accept", HeaderId::ACCEPT},
+    {"accept-encoding", HeaderId::ACCEPT_ENCODING},
+    {"content-encoding", HeaderId::CONTENT_ENCODING},
+    {"user-agent", HeaderId::USER_AGENT},
+    {"date", HeaderId::DATE},
+    {"server", HeaderId::SERVER},
+    {"cache-control", HeaderId::CACHE_CONTROL},
+    {"etag", HeaderId::ETAG},
+    {"if-none-match", HeaderId::IF_NONE_MATCH},
+    {"if-modified-since", HeaderId::IF_MODIFIED_SINCE},
+    {"last-modified", HeaderId::LAST_MODIFIED},
+    {"expect", HeaderId::EXPECT},
+    {"upgrade", HeaderId::UPGRADE},
+    {"cookie", HeaderId::COOKIE},
+    {"authorization", HeaderId::AUTHORIZATION},
+    {"origin", HeaderId::ORIGIN},
+    {"location", HeaderId::LOCATION},
+    {"range", HeaderId::RANGE},
+    {"vary", HeaderId::VARY},
+};
+
+constexpr size_t kKnownCount = static_cast<size_t>(HeaderId::COUNT);
+static_assert(sizeof(kKnownHeaders) / sizeof(kKnownHeaders[0]) == kKnownCount,
+              "every HeaderId needs a name");
+
+} // namespace
+
+HeaderId HeaderMap::idOf(std::string_view name) {
+    // Well-known names are all 4..17 bytes long
+    if (name.size() < 4 || name.size() > 17) {
+        return HeaderId::OTHER;
+    }
+
+    for (const auto& known : kKnownHeaders) {
+        if (known.name.size() == name.size() && string_util::equalsIgnoreCase(name, known.name)) {
+            return known.id;
+        }
+    }
+    return HeaderId::OTHER;
+}
+
+HeaderMap::HeaderMap(std::pmr::memory_resource* resource)
+    : storage_(resource), overflow_(resource), size_(0), garbage_(0) {
+    std::memset(first_, 0, sizeof(first_));
+}
+
+void HeaderMap::push(const Entry& field) {
+    if (size_ < kInlineFields) {
+        inline_[size_] = field;
+    } else {
+        overflow_.push_back(field);
+    }
+    ++size_;
+
+    if (field.id != HeaderId::OTHER && first_[static_cast<size_t>(field.id)] == 0 && size_ <= UINT16_MAX) {
+        first_[static_cast<size_t>(field.id)] = static_cast<uint16_t>(size_);
+    }
+}
+
+void HeaderMap::add(std::string_view name, std::string_view value) {
+    if (aliasesStorage(name) || aliasesStorage(value)) {
+        // Appending may reallocate the buffer the arguments point into
+        std::string name_copy(name);
+        std::string value_copy(value);
+        add(name_copy, value_copy);
+        return;
+    }
+
+    Entry field;
+    field.name_offset = static_cast<uint32_t>(storage_.size());
+    field.name_length = static_cast<uint32_t>(name.size());
+    storage_.append(name);
+    field.value_offset = static_cast<uint32_t>(storage_.size());
+    field.value_length = static_cast<uint32_t>(value.size());
+    storage_.append(value);
+    field.id = idOf(name);
+    push(field);
+}
+
+void HeaderMap::set(std::string_view name, std::string_view value) {
+    if (aliasesStorage(name) || aliasesStorage(value)) {
+        std::string name_copy(name);
+        std::string value_copy(value);
+        set(name_copy, value_copy);
+        return;
+    }
+
+    HeaderId id = idOf(name);
+    size_t index = find(name, id);
+    if (index == size_) {
+        add(name, value);
+        return;
+    }
+
+    // Drop later duplicates so exactly one field remains
+    for (size_t i = size_; i-- > index + 1;) {
+        const Entry& later = entry(i);
+        if (later.id == id &&
+            string_util::equalsIgnoreCase(std::string_view(storage_).substr(later.name_offset, later.name_length), name)) {
+            eraseAt(i);
+        }
+    }
+
+    Entry& field = entry(index);
+    if (value.size() <= field.value_length) {
+        // Overwrite in place; the tail of the old value becomes garbage
+        storage_.replace(field.value_offset, value.size(), value);
+        garbage_ += field.value_length - value.size();
+    } else {
+        garbage_ += field.value_length;
+        field.value_offset = static_cast<uint32_t>(storage_.size());
+        storage_.append(value);
+    }
+    field.value_length = static_cast<uint32_t>(value.size());
+
+    if (garbage_ > 256 && garbage_ > storage_.size() / 2) {
+        compact();
+    }
+}
+
+bool HeaderMap::remove(std::string_view name) {
+    HeaderId id = idOf(name);
+    bool removed = false;
+    for (size_t index = find(name, id); index < size_; index = find(name, id)) {
+        eraseAt(index);
+        removed = true;
+    }
+    return removed;
+}
+
+void HeaderMap::clear() {
+    storage_.clear();
+    overflow_.clear();
+    size_ = 0;
+    garbage_ = 0;
+    std::memset(first_, 0, sizeof(first_));
+}
+
+void HeaderMap::assign(std::string_view head, const std::vector<RequestParser::HeaderField>& fields) {
+    clear();
+    storage_.assign(head);
+
+    for (const auto& parsed : fields) {
+        Entry field;
+        field.name_offset = parsed.name.offset;
+        field.name_length = parsed.name.length;
+        field.value_offset = parsed.value.offset;
+        field.value_length = parsed.value.length;
+        field.id = idOf(parsed.name.in(storage_));
+        push(field);
+    }
+
+    // Request line and line breaks are never referenced
+    garbage_ = 0;
+}
+
+std::string_view HeaderMap::get(std::string_view name) const {
+    size_t index = find(name, idOf(name));
+    return index < size_ ? at(index).value : std::string_view();
+}
+
+std::string_view HeaderMap::get(HeaderId id) const {
+    if (id == HeaderId::OTHER) {
+        return std::string_view();
+    }
+    uint16_t position = first_[static_cast<size_t>(id)];
+    return position != 0 ? at(position - 1u).value : std::string_view();
+}
+
+HeaderMap::Field HeaderMap::at(size_t index) const {
+    const Entry& field = entry(index);
+    std::string_view storage(storage_);
+    return Field{storage.substr(field.name_offset, field.name_length),
+                 storage.substr(field.value_offset, field.value_length)};
+}
+
+size_t HeaderMap::find(std::string_view name, HeaderId id) const {
+    if (id != HeaderId::OTHER) {
+        uint16_t position = first_[static_cast<size_t>(id)];
+        if (position != 0 || size_ <= UINT16_MAX) {
+            return position != 0 ? position - 1u : size_;
+        }
+    }
+
+    std::string_view storage(storage_);
+    for (size_t i = 0; i < size_; ++i) {
+        const Entry& field = entry(i);
+        if (field.id == id && field.name_length == name.size() &&
+            string_util::equalsIgnoreCase(storage.substr(field.name_offset, field.name_length), name)) {
+            return i;
+        }
+    }
+    return size_;
+}
+
+bool HeaderMap::aliasesStorage(std::string_view text) const {
+    std::less<const char*> before;
+    const char* begin = storage_.data();
+    const char* end = begin + storage_.capacity();
+    return !text.empty() && !before(text.data(), begin) && before(text.data(), end);
+}
+
+void HeaderMap::eraseAt(size_t index) {
+    const Entry& removed = entry(index);
+    garbage_ += removed.name_length + removed.value_length;
+
+    for (size_t i = index + 1; i < size_; ++i) {
+        entry(i - 1) = entry(i);
+    }
+    if (size_ > kInlineFields) {
+        overflow_.pop_back();
+    }
+    --size_;
+    rebuildIndex();
+}
+
+void HeaderMap::rebuildIndex() {
+    std::memset(first_, 0, sizeof(first_));
+    for (size_t i = 0; i < size_ && i < UINT16_MAX; ++i) {
+        HeaderId id = entry(i).id;
+        if (id != HeaderId::OTHER && first_[static_cast<size_t>(id)] == 0) {
+            first_[static_cast<size_t>(id)] = static_cast<uint16_t>(i + 1);
+        }
+    }
+}
+
+void HeaderMap::compact() {
+    std::pmr::string packed(storage_.get_allocator());
+    packed.reserve(storage_.size() - garbage_);
+
+    for (size_t i = 0; i < size_; ++i) {
+        Entry& field = entry(i);
+        uint32_t name_offset = static_cast<uint32_t>(packed.size());
+        packed.append(storage_, field.name_offset, field.name_length);
+        uint32_t value_offset = static_cast<uint32_t>(packed.size());
+        packed.append(storage_, field.value_offset, field.value_length);
+        field.name_offset = name_offset;
+        field.value_offset = value_offset;
+    }
+
+    storage_ = std::move(packed);
+    garbage_ = 0;
+}
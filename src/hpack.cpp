@@ -0,0 +1,477 @@
+#include "hpack.h"
+
+#include <array>
+#include <vector>
+
+namespace hpack {
+
+namespace {
+
+struct StaticEntry {
+    const char* name;
+    const char* value;
+};
+
+// RFC 7541 appendix A
+const StaticEntry kStaticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+// RFC 7541 appendix B: code and bit length of each byte value. EOS
+// (0x3fffffff, 30 bits) only ever appears as padding.
+const uint32_t kHuffmanCodes[256] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+    0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+    0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+    0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+    0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+    0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+    0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+    0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+    0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+    0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+    0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+    0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+    0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+    0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+    0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+    0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+    0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+    0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+    0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+    0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+};
+
+const uint8_t kHuffmanLengths[256] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+
+constexpr uint16_t kEndOfString = 256;
+
+// Binary decoding tree for the canonical Huffman code. Children >= 0 are
+// node indices; negative ones are leaves holding ~symbol.
+class HuffmanTree {
+public:
+    HuffmanTree() {
+        nodes_.push_back({0, 0});
+        for (uint16_t symbol = 0; symbol < 256; ++symbol) {
+            add(kHuffmanCodes[symbol], kHuffmanLengths[symbol], symbol);
+        }
+        add(0x3fffffff, 30, kEndOfString);
+    }
+
+    int32_t child(int32_t node, unsigned bit) const { return nodes_[static_cast<size_t>(node)][bit]; }
+
+private:
+    std::vector<std::array<int32_t, 2>> nodes_;
+
+    void add(uint32_t code, uint8_t length, uint16_t symbol) {
+        int32_t node = 0;
+        for (int shift = length - 1; shift > 0; --shift) {
+            unsigned bit = (code >> shift) & 1;
+            if (nodes_[static_cast<size_t>(node)][bit] == 0) {
+                nodes_[static_cast<size_t>(node)][bit] = static_cast<int32_t>(nodes_.size());
+                nodes_.push_back({0, 0});
+            }
+            node = nodes_[static_cast<size_t>(node)][bit];
+        }
+        nodes_[static_cast<size_t>(node)][code & 1] = ~static_cast<int32_t>(symbol);
+    }
+};
+
+const HuffmanTree& huffmanTree() {
+    static const HuffmanTree tree;
+    return tree;
+}
+
+} // namespace
+
+void encodeInteger(uint64_t value, uint8_t prefix_bits, uint8_t flags, std::string& out) {
+    uint64_t limit = (1u << prefix_bits) - 1;
+    if (value < limit) {
+        out.push_back(static_cast<char>(flags | value));
+        return;
+    }
+    out.push_back(static_cast<char>(flags | limit));
+    value -= limit;
+    while (value >= 128) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool decodeInteger(const uint8_t*& data, const uint8_t* end, uint8_t prefix_bits, uint64_t& value) {
+    if (data >= end) {
+        return false;
+    }
+    uint64_t limit = (1u << prefix_bits) - 1;
+    value = *data++ & limit;
+    if (value < limit) {
+        return true;
+    }
+    // Continuation bytes; more than 62 bits of value is an attack, not a header
+    for (unsigned shift = 0; shift <= 56; shift += 7) {
+        if (data >= end) {
+            return false;
+        }
+        uint8_t byte = *data++;
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t huffmanEncodedLength(std::string_view text) {
+    size_t bits = 0;
+    for (unsigned char c : text) {
+        bits += kHuffmanLengths[c];
+    }
+    return (bits + 7) / 8;
+}
+
+void huffmanEncode(std::string_view text, std::string& out) {
+    uint64_t pending = 0;
+    unsigned pending_bits = 0;
+    for (unsigned char c : text) {
+        pending = (pending << kHuffmanLengths[c]) | kHuffmanCodes[c];
+        pending_bits += kHuffmanLengths[c];
+        while (pending_bits >= 8) {
+            pending_bits -= 8;
+            out.push_back(static_cast<char>(pending >> pending_bits));
+        }
+    }
+    if (pending_bits > 0) {
+        // Pad with the most significant bits of EOS, all ones
+        out.push_back(static_cast<char>((pending << (8 - pending_bits)) | (0xff >> pending_bits)));
+    }
+}
+
+bool huffmanDecode(const uint8_t* data, size_t length, std::string& out) {
+    const HuffmanTree& tree = huffmanTree();
+    int32_t node = 0;
+    unsigned trailing_bits = 0; // bits read since the last complete symbol
+    bool trailing_ones = true;
+
+    for (size_t i = 0; i < length; ++i) {
+        for (int shift = 7; shift >= 0; --shift) {
+            unsigned bit = (data[i] >> shift) & 1;
+            int32_t next = tree.child(node, bit);
+            if (next < 0) {
+                uint16_t symbol = static_cast<uint16_t>(~next);
+                if (symbol == kEndOfString) {
+                    return false;
+                }
+                out.push_back(static_cast<char>(symbol));
+                node = 0;
+                trailing_bits = 0;
+                trailing_ones = true;
+                continue;
+            }
+            if (next == 0) {
+                return false;
+            }
+            node = next;
+            ++trailing_bits;
+            trailing_ones = trailing_ones && bit == 1;
+        }
+    }
+    // Padding must be a strict prefix of EOS shorter than a byte
+    return trailing_bits < 8 && trailing_ones;
+}
+
+HeaderTable::HeaderTable(size_t max_size) : size_(0), max_size_(max_size) {
+}
+
+void HeaderTable::setMaxSize(size_t max_size) {
+    max_size_ = max_size;
+    evictTo(max_size_);
+}
+
+void HeaderTable::insert(std::string_view name, std::string_view value) {
+    size_t entry_size = name.size() + value.size() + kEntryOverhead;
+    if (entry_size > max_size_) {
+        evictTo(0);
+        return;
+    }
+    evictTo(max_size_ - entry_size);
+    entries_.push_front(Entry{std::string(name), std::string(value)});
+    size_ += entry_size;
+}
+
+bool HeaderTable::lookup(size_t index, std::string_view& name, std::string_view& value) const {
+    if (index == 0) {
+        return false;
+    }
+    if (index <= kStaticEntries) {
+        name = kStaticTable[index - 1].name;
+        value = kStaticTable[index - 1].value;
+        return true;
+    }
+    size_t dynamic = index - kStaticEntries - 1;
+    if (dynamic >= entries_.size()) {
+        return false;
+    }
+    name = entries_[dynamic].name;
+    value = entries_[dynamic].value;
+    return true;
+}
+
+size_t HeaderTable::find(std::string_view name, std::string_view value, size_t& name_index) const {
+    name_index = 0;
+    for (size_t i = 0; i < kStaticEntries; ++i) {
+        if (name == kStaticTable[i].name) {
+            if (value == kStaticTable[i].value) {
+                return i + 1;
+            }
+            if (name_index == 0) {
+                name_index = i + 1;
+            }
+        }
+    }
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].name == name) {
+            if (entries_[i].value == value) {
+                return kStaticEntries + 1 + i;
+            }
+            if (name_index == 0) {
+                name_index = kStaticEntries + 1 + i;
+            }
+        }
+    }
+    return 0;
+}
+
+void HeaderTable::evictTo(size_t limit) {
+    while (size_ > limit && !entries_.empty()) {
+        size_ -= entries_.back().name.size() + entries_.back().value.size() + kEntryOverhead;
+        entries_.pop_back();
+    }
+}
+
+Decoder::Decoder(size_t max_table_size) : table_(max_table_size), max_table_size_(max_table_size) {
+}
+
+bool Decoder::decode(const uint8_t* data, size_t length, const FieldHandler& on_field) {
+    const uint8_t* end = data + length;
+    bool fields_seen = false;
+
+    while (data < end) {
+        uint8_t first = *data;
+        uint64_t index = 0;
+
+        if (first & 0x80) {
+            // Indexed field
+            std::string_view name;
+            std::string_view value;
+            if (!decodeInteger(data, end, 7, index) || !table_.lookup(index, name, value) ||
+                !on_field(name, value)) {
+                return false;
+            }
+            fields_seen = true;
+            continue;
+        }
+
+        if ((first & 0xe0) == 0x20) {
+            // Table size update; only allowed before the first field
+            if (fields_seen || !decodeInteger(data, end, 5, index) || index > max_table_size_) {
+                return false;
+            }
+            table_.setMaxSize(index);
+            continue;
+        }
+
+        // Literal: with incremental indexing (01), without (0000) or never indexed (0001)
+        bool indexed = (first & 0xc0) == 0x40;
+        if (!decodeInteger(data, end, indexed ? 6 : 4, index)) {
+            return false;
+        }
+        if (index > 0) {
+            std::string_view name;
+            std::string_view ignored;
+            if (!table_.lookup(index, name, ignored)) {
+                return false;
+            }
+            name_buffer_.assign(name);
+        } else if (!readString(data, end, name_buffer_)) {
+            return false;
+        }
+        if (!readString(data, end, value_buffer_) || !on_field(name_buffer_, value_buffer_)) {
+            return false;
+        }
+        if (indexed) {
+            table_.insert(name_buffer_, value_buffer_);
+        }
+        fields_seen = true;
+    }
+    return true;
+}
+
+bool Decoder::readString(const uint8_t*& data, const uint8_t* end, std::string& out) {
+    if (data >= end) {
+        return false;
+    }
+    bool huffman = (*data & 0x80) != 0;
+    uint64_t length = 0;
+    if (!decodeInteger(data, end, 7, length) || length > static_cast<uint64_t>(end - data)) {
+        return false;
+    }
+    out.clear();
+    if (huffman) {
+        if (!huffmanDecode(data, static_cast<size_t>(length), out)) {
+            return false;
+        }
+    } else {
+        out.assign(reinterpret_cast<const char*>(data), static_cast<size_t>(length));
+    }
+    data += length;
+    return true;
+}
+
+Encoder::Encoder(size_t max_table_size)
+    : table_(max_table_size), pending_table_size_(max_table_size), table_size_changed_(false) {
+}
+
+void Encoder::setMaxTableSize(size_t max_size) {
+    // Our own table never needs to be larger than the default
+    pending_table_size_ = max_size < kDefaultTableSize ? max_size : kDefaultTableSize;
+    table_size_changed_ = pending_table_size_ != table_.getMaxSize();
+}
+
+void Encoder::beginBlock(std::string& out) {
+    if (table_size_changed_) {
+        table_.setMaxSize(pending_table_size_);
+        encodeInteger(pending_table_size_, 5, 0x20, out);
+        table_size_changed_ = false;
+    }
+}
+
+void Encoder::encode(std::string_view name, std::string_view value, std::string& out) {
+    size_t name_index = 0;
+    size_t index = table_.find(name, value, name_index);
+    if (index > 0) {
+        encodeInteger(index, 7, 0x80, out);
+        return;
+    }
+
+    bool indexed = shouldIndex(name);
+    if (name_index > 0) {
+        encodeInteger(name_index, indexed ? 6 : 4, indexed ? 0x40 : 0x00, out);
+    } else {
+        out.push_back(indexed ? 0x40 : 0x00);
+        writeString(name, out);
+    }
+    writeString(value, out);
+
+    if (indexed) {
+        table_.insert(name, value);
+    }
+}
+
+bool Encoder::shouldIndex(std::string_view name) {
+    // Values that differ per response would only churn the table
+    return name != "content-length" && name != "date" && name != "etag" && name != "last-modified" &&
+           name != "set-cookie" && name != "location" && name != ":path";
+}
+
+void Encoder::writeString(std::string_view text, std::string& out) {
+    size_t huffman_length = huffmanEncodedLength(text);
+    if (huffman_length < text.size()) {
+        encodeInteger(huffman_length, 7, 0x80, out);
+        huffmanEncode(text, out);
+    } else {
+        encodeInteger(text.size(), 7, 0x00, out);
+        out.append(text);
+    }
+}
+
+} // namespace hpack
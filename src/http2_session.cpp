@@ -0,0 +1,773 @@
+#include "http2_session.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+enum FrameType : uint8_t {
+    DATA = 0x0,
+    HEADERS = 0x1,
+    PRIORITY = 0x2,
+    RST_STREAM = 0x3,
+    SETTINGS = 0x4,
+    PUSH_PROMISE = 0x5,
+    PING = 0x6,
+    GOAWAY = 0x7,
+    WINDOW_UPDATE = 0x8,
+    CONTINUATION = 0x9
+};
+
+enum FrameFlag : uint8_t {
+    END_STREAM = 0x1,
+    ACK = 0x1,
+    END_HEADERS = 0x4,
+    PADDED = 0x8,
+    PRIORITY_FLAG = 0x20
+};
+
+enum Setting : uint16_t {
+    HEADER_TABLE_SIZE = 0x1,
+    ENABLE_PUSH = 0x2,
+    MAX_CONCURRENT_STREAMS = 0x3,
+    INITIAL_WINDOW_SIZE = 0x4,
+    MAX_FRAME_SIZE = 0x5,
+    MAX_HEADER_LIST_SIZE = 0x6
+};
+
+constexpr size_t kFrameHeaderSize = 9;
+constexpr uint32_t kDefaultWindowSize = 65535;
+constexpr int64_t kMaxWindowSize = 0x7fffffff;
+
+uint32_t readUint32(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+           (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+void appendUint32(std::string& out, uint32_t value) {
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+// RFC 9113 section 8.2.2: meaningless in HTTP/2 and must not be forwarded
+bool isConnectionSpecific(std::string_view name) {
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+           name == "transfer-encoding" || name == "upgrade";
+}
+
+// Strip padding from a PADDED frame; false if the padding overruns it
+bool removePadding(uint8_t flags, const uint8_t*& payload, size_t& length) {
+    if (!(flags & PADDED)) {
+        return true;
+    }
+    if (length < 1 || payload[0] >= length) {
+        return false;
+    }
+    size_t padding = payload[0];
+    payload += 1;
+    length -= 1 + padding;
+    return true;
+}
+
+} // namespace
+
+Http2Session::Http2Session(size_t max_body_size, RequestCallback on_request)
+    : max_body_size_(max_body_size), on_request_(std::move(on_request)), last_stream_id_(0),
+      last_served_id_(0), preface_received_(false), going_away_(false), peer_going_away_(false),
+      resets_received_(0), responses_completed_(0), peer_max_frame_size_(kMaxFrameSize),
+      peer_initial_window_(kDefaultWindowSize), send_window_(kDefaultWindowSize),
+      recv_window_(kDefaultWindowSize), recv_unacked_(0), header_stream_id_(0), header_flags_(0),
+      in_header_block_(false) {
+    sendSettings();
+}
+
+Http2Session::~Http2Session() {
+    abortBodyStreams();
+}
+
+bool Http2Session::receive(std::string& input) {
+    size_t offset = 0;
+
+    if (!preface_received_) {
+        if (input.size() < kPreface.size()) {
+            return kPreface.compare(0, input.size(), input) == 0 || connectionError(ErrorCode::PROTOCOL_ERROR);
+        }
+        if (input.compare(0, kPreface.size(), kPreface) != 0) {
+            return connectionError(ErrorCode::PROTOCOL_ERROR);
+        }
+        preface_received_ = true;
+        offset = kPreface.size();
+    }
+
+    bool ok = true;
+    while (ok && input.size() - offset >= kFrameHeaderSize) {
+        const uint8_t* header = reinterpret_cast<const uint8_t*>(input.data() + offset);
+        size_t length = (static_cast<size_t>(header[0]) << 16) | (static_cast<size_t>(header[1]) << 8) | header[2];
+        if (length > kMaxFrameSize) {
+            ok = connectionError(ErrorCode::FRAME_SIZE_ERROR);
+            break;
+        }
+        if (input.size() - offset < kFrameHeaderSize + length) {
+            break;
+        }
+
+        uint32_t stream_id = readUint32(header + 5) & 0x7fffffff;
+        ok = processFrame(header[3], header[4], stream_id, header + kFrameHeaderSize, length);
+        offset += kFrameHeaderSize + length;
+    }
+
+    input.erase(0, ok ? offset : input.size());
+    return ok;
+}
+
+bool Http2Session::processFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t* payload,
+                                size_t length) {
+    // A header block must be continued before anything else on the connection
+    if (in_header_block_ && type != CONTINUATION) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+
+    switch (type) {
+        case DATA:
+            return onData(flags, stream_id, payload, length);
+        case HEADERS:
+            return onHeaders(flags, stream_id, payload, length);
+        case PRIORITY:
+            // Advisory only; we schedule round-robin
+            return stream_id != 0 && length == 5 ? true : connectionError(ErrorCode::PROTOCOL_ERROR);
+        case RST_STREAM:
+            return onRstStream(stream_id, payload, length);
+        case SETTINGS:
+            return onSettings(flags, stream_id, payload, length);
+        case PUSH_PROMISE:
+            return connectionError(ErrorCode::PROTOCOL_ERROR); // clients never push
+        case PING:
+            return onPing(flags, stream_id, payload, length);
+        case GOAWAY:
+            return onGoAway(stream_id, length);
+        case WINDOW_UPDATE:
+            return onWindowUpdate(stream_id, payload, length);
+        case CONTINUATION:
+            return onContinuation(flags, stream_id, payload, length);
+        default:
+            return true; // unknown frame types are ignored
+    }
+}
+
+bool Http2Session::onData(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length) {
+    if (stream_id == 0) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+
+    // Flow control counts the whole frame, padding included
+    recv_window_ -= static_cast<int64_t>(length);
+    if (recv_window_ < 0) {
+        return connectionError(ErrorCode::FLOW_CONTROL_ERROR);
+    }
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end() || it->second.remote_closed) {
+        if (stream_id > last_stream_id_) {
+            return connectionError(ErrorCode::PROTOCOL_ERROR); // idle stream
+        }
+        creditReceived(0, nullptr, length);
+        if (it != streams_.end()) {
+            resetStream(stream_id, ErrorCode::STREAM_CLOSED);
+        }
+        return true;
+    }
+
+    Stream& stream = it->second;
+    stream.recv_window -= static_cast<int64_t>(length);
+    if (stream.recv_window < 0) {
+        creditReceived(0, nullptr, length);
+        resetStream(stream_id, ErrorCode::FLOW_CONTROL_ERROR);
+        return true;
+    }
+
+    size_t frame_length = length;
+    if (!removePadding(flags, payload, length)) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+
+    creditReceived(stream_id, &stream, frame_length);
+    if (stream.responded) {
+        // Answered early (431); drain without buffering
+    } else if (stream.body.size() + length > max_body_size_) {
+        respondWithStatus(stream_id, HttpResponse::StatusCode::PAYLOAD_TOO_LARGE);
+        return true; // the rest of the upload is drained unread
+    } else {
+        stream.body.append(reinterpret_cast<const char*>(payload), length);
+    }
+
+    if (flags & END_STREAM) {
+        stream.remote_closed = true;
+        finishRequest(stream_id, stream);
+    }
+    return true;
+}
+
+bool Http2Session::onHeaders(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length) {
+    if (stream_id == 0 || (stream_id & 1) == 0) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+    if (!removePadding(flags, payload, length)) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+    if (flags & PRIORITY_FLAG) {
+        if (length < 5) {
+            return connectionError(ErrorCode::FRAME_SIZE_ERROR);
+        }
+        payload += 5;
+        length -= 5;
+    }
+
+    header_block_.assign(reinterpret_cast<const char*>(payload), length);
+    header_stream_id_ = stream_id;
+    header_flags_ = flags;
+    if (flags & END_HEADERS) {
+        return onHeaderBlock();
+    }
+    in_header_block_ = true;
+    return true;
+}
+
+bool Http2Session::onContinuation(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length) {
+    if (!in_header_block_ || stream_id != header_stream_id_) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+    if (header_block_.size() + length > kMaxHeaderListSize * 2) {
+        return connectionError(ErrorCode::ENHANCE_YOUR_CALM); // endless CONTINUATION
+    }
+    header_block_.append(reinterpret_cast<const char*>(payload), length);
+    if (flags & END_HEADERS) {
+        in_header_block_ = false;
+        return onHeaderBlock();
+    }
+    return true;
+}
+
+bool Http2Session::onHeaderBlock() {
+    uint32_t stream_id = header_stream_id_;
+    bool end_stream = header_flags_ & END_STREAM;
+    const uint8_t* block = reinterpret_cast<const uint8_t*>(header_block_.data());
+
+    auto it = streams_.find(stream_id);
+    if (it != streams_.end()) {
+        // Trailers: decoded to keep the table in step, then dropped
+        bool decoded = decoder_.decode(block, header_block_.size(),
+                                       [](std::string_view, std::string_view) { return true; });
+        if (!decoded) {
+            return connectionError(ErrorCode::COMPRESSION_ERROR);
+        }
+        if (it->second.remote_closed || !end_stream) {
+            resetStream(stream_id, ErrorCode::PROTOCOL_ERROR);
+            return true;
+        }
+        it->second.remote_closed = true;
+        finishRequest(stream_id, it->second);
+        return true;
+    }
+
+    if (stream_id <= last_stream_id_) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR); // reused or closed stream
+    }
+    last_stream_id_ = stream_id;
+
+    Stream stream;
+    bool regular_seen = false;
+    bool decoded = decoder_.decode(block, header_block_.size(), [&](std::string_view name, std::string_view value) {
+        stream.header_list_size += name.size() + value.size() + hpack::HeaderTable::kEntryOverhead;
+        if (stream.header_list_size > kMaxHeaderListSize) {
+            stream.headers_too_large = true;
+            return true;
+        }
+        if (std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; })) {
+            stream.malformed = true;
+            return true;
+        }
+
+        if (!name.empty() && name[0] == ':') {
+            if (regular_seen) {
+                stream.malformed = true;
+            } else if (name == ":method") {
+                stream.method.assign(value);
+            } else if (name == ":path") {
+                stream.path.assign(value);
+            } else if (name == ":authority") {
+                stream.authority.assign(value);
+            } else if (name == ":scheme") {
+                stream.has_scheme = true;
+            } else {
+                stream.malformed = true;
+            }
+            return true;
+        }
+
+        regular_seen = true;
+        if (isConnectionSpecific(name) || (name == "te" && value != "trailers")) {
+            stream.malformed = true;
+            return true;
+        }
+        stream.headers.add(name, value);
+        return true;
+    });
+    if (!decoded) {
+        return connectionError(ErrorCode::COMPRESSION_ERROR);
+    }
+
+    if (going_away_) {
+        return true; // beyond our GOAWAY's last stream; ignored
+    }
+    if (streams_.size() >= kMaxConcurrentStreams) {
+        resetStream(stream_id, ErrorCode::REFUSED_STREAM);
+        return true;
+    }
+    if (stream.malformed || stream.method.empty() || stream.path.empty() || !stream.has_scheme) {
+        resetStream(stream_id, ErrorCode::PROTOCOL_ERROR);
+        return true;
+    }
+
+    stream.send_window = peer_initial_window_;
+    stream.remote_closed = end_stream;
+    Stream& stored = streams_.emplace(stream_id, std::move(stream)).first->second;
+    if (stored.headers_too_large) {
+        respondWithStatus(stream_id, HttpResponse::StatusCode::REQUEST_HEADER_FIELDS_TOO_LARGE);
+    } else if (end_stream) {
+        finishRequest(stream_id, stored);
+    }
+    return true;
+}
+
+bool Http2Session::onRstStream(uint32_t stream_id, const uint8_t*, size_t length) {
+    if (stream_id == 0) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+    if (length != 4) {
+        return connectionError(ErrorCode::FRAME_SIZE_ERROR);
+    }
+    if (stream_id > last_stream_id_) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR); // idle stream
+    }
+
+    eraseStream(stream_id);
+
+    // Opening and immediately cancelling streams costs us the handler while
+    // costing the client nothing ("rapid reset"); cut off clients that
+    // cancel more streams than they let finish
+    if (++resets_received_ > 2 * kMaxConcurrentStreams && resets_received_ > responses_completed_) {
+        return connectionError(ErrorCode::ENHANCE_YOUR_CALM);
+    }
+    return true;
+}
+
+bool Http2Session::onSettings(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length) {
+    if (stream_id != 0) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+    if (flags & ACK) {
+        return length == 0 ? true : connectionError(ErrorCode::FRAME_SIZE_ERROR);
+    }
+    if (length % 6 != 0) {
+        return connectionError(ErrorCode::FRAME_SIZE_ERROR);
+    }
+
+    for (size_t i = 0; i < length; i += 6) {
+        uint16_t id = static_cast<uint16_t>((payload[i] << 8) | payload[i + 1]);
+        uint32_t value = readUint32(payload + i + 2);
+        switch (id) {
+            case HEADER_TABLE_SIZE:
+                encoder_.setMaxTableSize(value);
+                break;
+            case ENABLE_PUSH:
+                if (value > 1) {
+                    return connectionError(ErrorCode::PROTOCOL_ERROR);
+                }
+                break;
+            case INITIAL_WINDOW_SIZE: {
+                if (value > kMaxWindowSize) {
+                    return connectionError(ErrorCode::FLOW_CONTROL_ERROR);
+                }
+                // Applies retroactively to every open stream's send window
+                int64_t delta = static_cast<int64_t>(value) - peer_initial_window_;
+                peer_initial_window_ = value;
+                for (auto& entry : streams_) {
+                    entry.second.send_window += delta;
+                    if (entry.second.send_window > kMaxWindowSize) {
+                        return connectionError(ErrorCode::FLOW_CONTROL_ERROR);
+                    }
+                }
+                break;
+            }
+            case MAX_FRAME_SIZE:
+                if (value < 16384 || value > 0xffffff) {
+                    return connectionError(ErrorCode::PROTOCOL_ERROR);
+                }
+                peer_max_frame_size_ = value;
+                break;
+            default:
+                break; // MAX_CONCURRENT_STREAMS and MAX_HEADER_LIST_SIZE bound pushes and requests we never send
+        }
+    }
+
+    writeFrameHeader(control_, 0, SETTINGS, ACK, 0);
+    return true;
+}
+
+bool Http2Session::onPing(uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length) {
+    if (stream_id != 0) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+    if (length != 8) {
+        return connectionError(ErrorCode::FRAME_SIZE_ERROR);
+    }
+    if (!(flags & ACK)) {
+        writeFrameHeader(control_, 8, PING, ACK, 0);
+        control_.append(reinterpret_cast<const char*>(payload), 8);
+    }
+    return true;
+}
+
+bool Http2Session::onGoAway(uint32_t stream_id, size_t length) {
+    if (stream_id != 0) {
+        return connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+    if (length < 8) {
+        return connectionError(ErrorCode::FRAME_SIZE_ERROR);
+    }
+    peer_going_away_ = true;
+    return true;
+}
+
+bool Http2Session::onWindowUpdate(uint32_t stream_id, const uint8_t* payload, size_t length) {
+    if (length != 4) {
+        return connectionError(ErrorCode::FRAME_SIZE_ERROR);
+    }
+    uint32_t increment = readUint32(payload) & 0x7fffffff;
+
+    if (stream_id == 0) {
+        if (increment == 0) {
+            return connectionError(ErrorCode::PROTOCOL_ERROR);
+        }
+        send_window_ += increment;
+        return send_window_ <= kMaxWindowSize ? true : connectionError(ErrorCode::FLOW_CONTROL_ERROR);
+    }
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) {
+        return stream_id <= last_stream_id_ ? true : connectionError(ErrorCode::PROTOCOL_ERROR);
+    }
+    if (increment == 0) {
+        resetStream(stream_id, ErrorCode::PROTOCOL_ERROR);
+        return true;
+    }
+    it->second.send_window += increment;
+    if (it->second.send_window > kMaxWindowSize) {
+        resetStream(stream_id, ErrorCode::FLOW_CONTROL_ERROR);
+    }
+    return true;
+}
+
+bool Http2Session::connectionError(ErrorCode code) {
+    goAway(code);
+    abortBodyStreams();
+    streams_.clear();
+    return false;
+}
+
+void Http2Session::goAway(ErrorCode code) {
+    if (going_away_) {
+        return;
+    }
+    going_away_ = true;
+    writeFrameHeader(control_, 8, GOAWAY, 0, 0);
+    appendUint32(control_, last_stream_id_);
+    appendUint32(control_, static_cast<uint32_t>(code));
+}
+
+void Http2Session::resetStream(uint32_t stream_id, ErrorCode code) {
+    writeFrameHeader(control_, 4, RST_STREAM, 0, stream_id);
+    appendUint32(control_, static_cast<uint32_t>(code));
+    eraseStream(stream_id);
+}
+
+void Http2Session::eraseStream(uint32_t stream_id) {
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) {
+        return;
+    }
+    if (it->second.body_stream) {
+        it->second.body_stream->abort();
+    }
+    streams_.erase(it);
+}
+
+void Http2Session::abortBodyStreams() {
+    for (auto& entry : streams_) {
+        if (entry.second.body_stream) {
+            entry.second.body_stream->abort();
+            entry.second.body_stream.reset();
+        }
+    }
+}
+
+void Http2Session::finishRequest(uint32_t stream_id, Stream& stream) {
+    if (stream.dispatched || stream.responded) {
+        return;
+    }
+    stream.dispatched = true;
+
+    HeaderMap headers = std::move(stream.headers);
+    if (!stream.authority.empty() && !headers.contains("host")) {
+        headers.add("host", stream.authority);
+    }
+
+    auto request = std::make_shared<HttpRequest>();
+    if (!request->assign(stream.method, stream.path, "HTTP/2", std::move(headers), std::move(stream.body))) {
+        resetStream(stream_id, ErrorCode::PROTOCOL_ERROR);
+        return;
+    }
+    stream.head_only = request->getMethod() == HttpRequest::Method::HEAD;
+    on_request_(stream_id, std::move(request));
+}
+
+void Http2Session::respondWithStatus(uint32_t stream_id, HttpResponse::StatusCode status) {
+    HttpResponse response(status);
+    response.setTextContent(response.getStatusText());
+    submitResponse(stream_id, std::move(response));
+}
+
+void Http2Session::creditReceived(uint32_t stream_id, Stream* stream, size_t length) {
+    // Window updates are batched: one per half window consumed
+    recv_unacked_ += static_cast<uint32_t>(length);
+    if (recv_unacked_ >= kConnectionWindowSize / 2 || recv_window_ < kDefaultWindowSize) {
+        writeWindowUpdate(0, recv_unacked_);
+        recv_window_ += recv_unacked_;
+        recv_unacked_ = 0;
+    }
+
+    if (stream && !stream->remote_closed) {
+        stream->recv_unacked += static_cast<uint32_t>(length);
+        if (stream->recv_unacked >= kStreamWindowSize / 2) {
+            writeWindowUpdate(stream_id, stream->recv_unacked);
+            stream->recv_window += stream->recv_unacked;
+            stream->recv_unacked = 0;
+        }
+    }
+}
+
+void Http2Session::submitResponse(uint32_t stream_id, HttpResponse response, std::shared_ptr<BodyStream> body) {
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end() || it->second.responded) {
+        if (body) {
+            body->abort();
+        }
+        return;
+    }
+    Stream& stream = it->second;
+    stream.responded = true;
+
+    // Header block: :status, then the response's fields lowercased
+    std::string block;
+    encoder_.beginBlock(block);
+    encoder_.encode(":status", std::to_string(static_cast<int>(response.getStatusCode())), block);
+    std::string name;
+    for (const HeaderMap::Field field : response.getHeaders()) {
+        name.assign(field.name);
+        std::transform(name.begin(), name.end(), name.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (!isConnectionSpecific(name)) {
+            encoder_.encode(name, field.value, block);
+        }
+    }
+
+    if (body && stream.head_only) {
+        body->abort();
+    } else if (body) {
+        stream.body_stream = std::move(body);
+    } else if (!stream.head_only) {
+        if (response.getFileBody()) {
+            stream.file_body = response.getFileBody();
+            stream.body_size = stream.file_body->getSize();
+        } else if (response.getSharedBody()) {
+            stream.shared_body = response.getSharedBody();
+            stream.body_size = stream.shared_body->size();
+        } else {
+            stream.response_body = response.takeBody();
+            stream.body_size = stream.response_body.size();
+        }
+    }
+    bool end_stream = stream.body_size == 0 && !stream.body_stream;
+
+    // Split across CONTINUATION frames if the block outgrows a frame
+    size_t offset = 0;
+    do {
+        size_t chunk = std::min<size_t>(block.size() - offset, peer_max_frame_size_);
+        bool last = offset + chunk == block.size();
+        uint8_t type = offset == 0 ? HEADERS : CONTINUATION;
+        uint8_t flags = (last ? END_HEADERS : 0) | (offset == 0 && end_stream ? END_STREAM : 0);
+        writeFrameHeader(control_, chunk, type, flags, stream_id);
+        control_.append(block, offset, chunk);
+        offset += chunk;
+    } while (offset < block.size());
+
+    if (end_stream) {
+        if (!stream.remote_closed) {
+            // Answered before the request finished (413, 431): stop the upload
+            writeFrameHeader(control_, 4, RST_STREAM, 0, stream_id);
+            appendUint32(control_, static_cast<uint32_t>(ErrorCode::NO_ERROR));
+        }
+        streams_.erase(it);
+        ++responses_completed_;
+    }
+}
+
+void Http2Session::takeOutput(std::string& out, size_t limit) {
+    size_t start = out.size();
+    out.append(control_);
+    control_.clear();
+
+    // Round-robin from the stream after the last one served
+    size_t budget = limit > out.size() - start ? limit - (out.size() - start) : 0;
+    bool progress = true;
+    while (budget > 0 && send_window_ > 0 && progress) {
+        progress = false;
+        auto it = streams_.upper_bound(last_served_id_);
+        for (size_t visited = 0; visited < streams_.size() && budget > 0 && send_window_ > 0; ++visited) {
+            if (it == streams_.end()) {
+                it = streams_.begin();
+            }
+            uint32_t stream_id = it->first;
+            Stream& stream = it->second;
+            auto next = std::next(it);
+            if (hasDataToSend(stream)) {
+                bool finished = writeData(stream_id, stream, out, budget);
+                responses_completed_ += finished ? 1 : 0;
+                last_served_id_ = stream_id;
+                progress = true;
+                if (finished) {
+                    if (!stream.remote_closed) {
+                        writeFrameHeader(out, 4, RST_STREAM, 0, stream_id);
+                        appendUint32(out, static_cast<uint32_t>(ErrorCode::NO_ERROR));
+                    }
+                    streams_.erase(it);
+                    if (streams_.empty()) {
+                        break;
+                    }
+                }
+            }
+            it = next;
+        }
+    }
+}
+
+bool Http2Session::writeData(uint32_t stream_id, Stream& stream, std::string& out, size_t& budget) {
+    if (stream.body_stream && stream.body_offset == stream.body_size) {
+        // Everything taken so far has been sent; collect what was written since
+        stream.response_body.clear();
+        BodyStream::State state = stream.body_stream->take(stream.response_body);
+        if (state == BodyStream::State::FAILED) {
+            writeFrameHeader(out, 4, RST_STREAM, 0, stream_id);
+            appendUint32(out, static_cast<uint32_t>(ErrorCode::INTERNAL_ERROR));
+            stream.remote_closed = true;
+            return true;
+        }
+        stream.body_offset = 0;
+        stream.body_size = stream.response_body.size();
+        stream.body_stream_ended = state == BodyStream::State::ENDED;
+    }
+
+    size_t chunk = stream.body_size - stream.body_offset;
+    chunk = std::min<size_t>(chunk, peer_max_frame_size_);
+    chunk = std::min<size_t>(chunk, static_cast<size_t>(std::min(stream.send_window, send_window_)));
+
+    // A streamed body ends with the producer, possibly in an empty frame
+    bool last = stream.body_offset + chunk == stream.body_size && (!stream.body_stream || stream.body_stream_ended);
+    if (chunk == 0 && !last) {
+        return false;
+    }
+    writeFrameHeader(out, chunk, DATA, last ? END_STREAM : 0, stream_id);
+    if (stream.file_body) {
+        if (!stream.file_body->readInto(out, stream.body_offset, chunk)) {
+            // The file shrank under us; the length promised cannot be kept
+            out.resize(out.size() - kFrameHeaderSize);
+            writeFrameHeader(out, 4, RST_STREAM, 0, stream_id);
+            appendUint32(out, static_cast<uint32_t>(ErrorCode::INTERNAL_ERROR));
+            stream.remote_closed = true;
+            return true;
+        }
+    } else {
+        const std::string& body = stream.shared_body ? *stream.shared_body : stream.response_body;
+        out.append(body, stream.body_offset, chunk);
+    }
+
+    stream.body_offset += chunk;
+    stream.send_window -= static_cast<int64_t>(chunk);
+    send_window_ -= static_cast<int64_t>(chunk);
+    budget -= std::min(budget, chunk + kFrameHeaderSize);
+    return last;
+}
+
+bool Http2Session::hasOutput() const {
+    if (!control_.empty()) {
+        return true;
+    }
+    if (send_window_ <= 0) {
+        return false;
+    }
+    for (const auto& entry : streams_) {
+        if (hasDataToSend(entry.second)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Http2Session::hasDataToSend(const Stream& stream) {
+    if (!stream.responded || stream.send_window <= 0) {
+        return false;
+    }
+    if (stream.body_offset < stream.body_size) {
+        return true;
+    }
+    return stream.body_stream && !stream.body_stream_ended && stream.body_stream->isReady();
+}
+
+void Http2Session::sendSettings() {
+    struct {
+        uint16_t id;
+        uint32_t value;
+    } const settings[] = {
+        {MAX_CONCURRENT_STREAMS, kMaxConcurrentStreams},
+        {INITIAL_WINDOW_SIZE, kStreamWindowSize},
+        {MAX_HEADER_LIST_SIZE, static_cast<uint32_t>(kMaxHeaderListSize)},
+        {ENABLE_PUSH, 0},
+    };
+
+    writeFrameHeader(control_, sizeof(settings) / sizeof(settings[0]) * 6, SETTINGS, 0, 0);
+    for (const auto& setting : settings) {
+        control_.push_back(static_cast<char>(setting.id >> 8));
+        control_.push_back(static_cast<char>(setting.id));
+        appendUint32(control_, setting.value);
+    }
+
+    // The connection window can only be raised with WINDOW_UPDATE
+    writeWindowUpdate(0, kConnectionWindowSize - kDefaultWindowSize);
+    recv_window_ = kConnectionWindowSize;
+}
+
+void Http2Session::writeFrameHeader(std::string& out, size_t length, uint8_t type, uint8_t flags, uint32_t stream_id) {
+    out.push_back(static_cast<char>(length >> 16));
+    out.push_back(static_cast<char>(length >> 8));
+    out.push_back(static_cast<char>(length));
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(flags));
+    appendUint32(out, stream_id & 0x7fffffff);
+}
+
+void Http2Session::writeWindowUpdate(uint32_t stream_id, uint32_t increment) {
+    writeFrameHeader(control_, 4, WINDOW_UPDATE, 0, stream_id);
+    appendUint32(control_, increment);
+}
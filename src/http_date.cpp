@@ -0,0 +1,71 @@
+#include "http_date.h"
+#include "string_util.h"
+
+#include <cstdio>
+
+namespace http_date {
+
+namespace {
+
+const char* const kDays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char* const kMonths[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                               "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+bool parseDigits(std::string_view text, size_t offset, size_t count, int& value) {
+    value = 0;
+    for (size_t i = offset; i < offset + count; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+} // namespace
+
+std::string format(time_t time) {
+    struct tm parts;
+    gmtime_r(&time, &parts);
+
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+                               kDays[parts.tm_wday], parts.tm_mday, kMonths[parts.tm_mon],
+                               parts.tm_year + 1900, parts.tm_hour, parts.tm_min, parts.tm_sec);
+    return std::string(buffer, length > 0 ? static_cast<size_t>(length) : 0);
+}
+
+bool parse(std::string_view text, time_t& time) {
+    text = string_util::trim(text);
+    // "Sun, 06 Nov 1994 08:49:37 GMT"
+    if (text.size() != 29 || text[3] != ',' || text[4] != ' ' || text[7] != ' ' || text[11] != ' ' ||
+        text[16] != ' ' || text[19] != ':' || text[22] != ':' || text.substr(25) != " GMT") {
+        return false;
+    }
+
+    struct tm parts = {};
+    int month = -1;
+    for (int i = 0; i < 12; ++i) {
+        if (text.substr(8, 3) == kMonths[i]) {
+            month = i;
+            break;
+        }
+    }
+    if (month < 0) {
+        return false;
+    }
+    parts.tm_mon = month;
+
+    int year = 0;
+    if (!parseDigits(text, 5, 2, parts.tm_mday) || !parseDigits(text, 12, 4, year) ||
+        !parseDigits(text, 17, 2, parts.tm_hour) || !parseDigits(text, 20, 2, parts.tm_min) ||
+        !parseDigits(text, 23, 2, parts.tm_sec)) {
+        return false;
+    }
+    parts.tm_year = year - 1900;
+
+    time = timegm(&parts);
+    return time != static_cast<time_t>(-1);
+}
+
+} // namespace http_date
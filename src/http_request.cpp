@@ -1,121 +1,146 @@
 #include "http_request.h"
-#include <sstream>
-#include <algorithm>
-#include <cctype>
+#include "request_parser.h"
+#include "string_util.h"
+
+namespace {
+
+// Percent- and plus-decode `encoded` onto the end of `decoded`, which may be
+// a string from any allocator
+template <typename String>
+void appendUrlDecoded(std::string_view encoded, String& decoded) {
+    auto hex_value = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    
+    decoded.reserve(decoded.size() + encoded.length());
+    
+    for (size_t i = 0; i < encoded.length(); ++i) {
+        if (encoded[i] == '%' && i + 2 < encoded.length() && hex_value(encoded[i + 1]) >= 0 &&
+            hex_value(encoded[i + 2]) >= 0) {
+            decoded += static_cast<char>(hex_value(encoded[i + 1]) * 16 + hex_value(encoded[i + 2]));
+            i += 2;
+        } else if (encoded[i] == '+') {
+            decoded += ' ';
+        } else {
+            decoded += encoded[i];
+        }
+    }
+}
+
+} // namespace
 
 HttpRequest::HttpRequest() 
-    : method_(Method::UNKNOWN), version_("HTTP/1.1"), is_valid_(false) {
+    : method_(Method::UNKNOWN), version_("HTTP/1.1"), route_param_count_(0), is_valid_(false), early_data_(false) {
+}
+
+HttpRequest::HttpRequest(std::pmr::memory_resource* resource)
+    : method_(Method::UNKNOWN), version_("HTTP/1.1"), headers_(resource), route_param_count_(0),
+      query_params_(resource), is_valid_(false), early_data_(false) {
 }
 
-HttpRequest::HttpRequest(const std::string& raw_request) 
-    : method_(Method::UNKNOWN), version_("HTTP/1.1"), is_valid_(false) {
+HttpRequest::HttpRequest(std::string_view raw_request) 
+    : method_(Method::UNKNOWN), version_("HTTP/1.1"), route_param_count_(0), is_valid_(false), early_data_(false) {
     parse(raw_request);
 }
 
-bool HttpRequest::parse(const std::string& raw_request) {
-    if (raw_request.empty()) {
+bool HttpRequest::parse(std::string_view raw_request) {
+    // The caller holds the whole message, so the end of input also ends the head
+    RequestParser parser;
+    if (parser.parse(raw_request, true) != RequestParser::Status::COMPLETE || !loadHead(raw_request, parser)) {
         is_valid_ = false;
         return false;
     }
-
-    std::istringstream stream(raw_request);
-    std::string line;
     
-    // Parse request line
-    if (!std::getline(stream, line)) {
+    // Only the body is copied out of the caller's buffer
+    body_.assign(raw_request.substr(parser.getHeadLength()));
+    is_valid_ = true;
+    return true;
+}
+
+bool HttpRequest::load(std::string message, const RequestParser& parser) {
+    if (!loadHead(message, parser)) {
         is_valid_ = false;
         return false;
     }
     
-    // Remove carriage return if present
-    if (!line.empty() && line.back() == '\r') {
-        line.pop_back();
-    }
-    
-    std::istringstream request_line(line);
-    std::string method_str, path_with_query, version;
+    // Everything after the head is the body, taken byte for byte; the message
+    // buffer is reused for it rather than copied
+    body_ = std::move(message);
+    body_.erase(0, parser.getHeadLength());
     
-    if (!(request_line >> method_str >> path_with_query >> version)) {
-        is_valid_ = false;
-        return false;
-    }
-    
-    // Basic validation
-    if (method_str.empty() || path_with_query.empty() || version.empty()) {
-        is_valid_ = false;
+    is_valid_ = true;
+    return true;
+}
+
+bool HttpRequest::loadHead(std::string_view message, const RequestParser& parser) {
+    if (parser.getStatus() != RequestParser::Status::COMPLETE || parser.getHeadLength() > message.size()) {
         return false;
     }
     
-    // Validate HTTP version format
-    if (version.find("HTTP/") != 0) {
-        is_valid_ = false;
-        return false;
-    }
+    method_ = stringToMethod(parser.getMethod().in(message));
+    version_.assign(parser.getVersion().in(message));
     
-    method_ = stringToMethod(method_str);
-    version_ = version;
+    setTarget(parser.getTarget().in(message));
     
-    // Parse path and query parameters
-    size_t query_pos = path_with_query.find('?');
-    if (query_pos != std::string::npos) {
-        path_ = path_with_query.substr(0, query_pos);
-        std::string query_string = path_with_query.substr(query_pos + 1);
-        parseQueryParams(query_string);
-    } else {
-        path_ = path_with_query;
+    // One copy of the head backs every header field
+    headers_.assign(message.substr(0, parser.getHeadLength()), parser.getHeaders());
+    return true;
+}
+
+bool HttpRequest::assign(std::string_view method, std::string_view target, std::string_view version,
+                         HeaderMap headers, std::string body) {
+    method_ = stringToMethod(method);
+    version_.assign(version);
+    setTarget(target);
+    headers_ = std::move(headers);
+    body_ = std::move(body);
+    is_valid_ = !path_.empty();
+    return is_valid_;
+}
+
+void HttpRequest::setTarget(std::string_view target) {
+    // Split path and query parameters
+    size_t query_pos = target.find('?');
+    if (query_pos != std::string_view::npos) {
+        parseQueryParams(target.substr(query_pos + 1));
+        target = target.substr(0, query_pos);
     }
     
     // URL decode the path
-    path_ = urlDecode(path_);
-    
-    // Parse headers
-    std::vector<std::string> header_lines;
-    while (std::getline(stream, line)) {
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-        
-        if (line.empty()) {
-            break; // End of headers
-        }
-        
-        header_lines.push_back(line);
-    }
-    
-    parseHeaders(header_lines);
-    
-    // Parse body
-    std::ostringstream body_stream;
-    while (std::getline(stream, line)) {
-        body_stream << line << "\n";
-    }
-    body_ = body_stream.str();
-    
-    // Remove trailing newline if present
-    if (!body_.empty() && body_.back() == '\n') {
-        body_.pop_back();
-    }
-    
-    is_valid_ = true;
-    return true;
+    path_.clear();
+    appendUrlDecoded(target, path_);
 }
 
-std::string HttpRequest::getHeader(const std::string& name) const {
-    auto it = headers_.find(name);
-    return (it != headers_.end()) ? it->second : "";
+std::string_view HttpRequest::getParam(std::string_view name) const {
+    for (size_t i = 0; i < route_param_count_; ++i) {
+        if (route_params_[i].name == name) {
+            return std::string_view(path_).substr(route_params_[i].offset, route_params_[i].length);
+        }
+    }
+    return std::string_view();
 }
 
-void HttpRequest::setHeader(const std::string& name, const std::string& value) {
-    headers_[name] = value;
+void HttpRequest::setRouteParams(const RouteParam* params, size_t count) {
+    route_param_count_ = count < kMaxRouteParams ? count : kMaxRouteParams;
+    for (size_t i = 0; i < route_param_count_; ++i) {
+        route_params_[i] = params[i];
+    }
 }
 
 std::string HttpRequest::getQueryParam(const std::string& name) const {
-    auto it = query_params_.find(name);
-    return (it != query_params_.end()) ? it->second : "";
+    auto it = query_params_.find(std::pmr::string(name, query_params_.get_allocator().resource()));
+    return (it != query_params_.end()) ? std::string(it->second) : "";
 }
 
 std::string HttpRequest::methodToString() const {
-    switch (method_) {
+    return methodName(method_);
+}
+
+const char* HttpRequest::methodName(Method method) {
+    switch (method) {
         case Method::GET:     return "GET";
         case Method::POST:    return "POST";
         case Method::PUT:     return "PUT";
@@ -127,92 +152,49 @@ std::string HttpRequest::methodToString() const {
     }
 }
 
-HttpRequest::Method HttpRequest::stringToMethod(const std::string& method_str) {
-    std::string upper_method = method_str;
-    std::transform(upper_method.begin(), upper_method.end(), upper_method.begin(), ::toupper);
+HttpRequest::Method HttpRequest::stringToMethod(std::string_view method_str) {
+    using string_util::equalsIgnoreCase;
     
-    if (upper_method == "GET")         return Method::GET;
-    if (upper_method == "POST")        return Method::POST;
-    if (upper_method == "PUT")         return Method::PUT;
-    if (upper_method == "DELETE")      return Method::DELETE;
-    if (upper_method == "HEAD")        return Method::HEAD;
-    if (upper_method == "OPTIONS")     return Method::OPTIONS;
-    if (upper_method == "PATCH")       return Method::PATCH;
+    if (equalsIgnoreCase(method_str, "GET"))     return Method::GET;
+    if (equalsIgnoreCase(method_str, "POST"))    return Method::POST;
+    if (equalsIgnoreCase(method_str, "PUT"))     return Method::PUT;
+    if (equalsIgnoreCase(method_str, "DELETE"))  return Method::DELETE;
+    if (equalsIgnoreCase(method_str, "HEAD"))    return Method::HEAD;
+    if (equalsIgnoreCase(method_str, "OPTIONS")) return Method::OPTIONS;
+    if (equalsIgnoreCase(method_str, "PATCH"))   return Method::PATCH;
     
     return Method::UNKNOWN;
 }
 
 size_t HttpRequest::getContentLength() const {
-    std::string length_str = getHeader("Content-Length");
-    if (length_str.empty()) {
+    size_t length = 0;
+    if (!string_util::parseDecimal(headers_.get(HeaderId::CONTENT_LENGTH), length)) {
         return 0;
     }
-    
-    try {
-        return std::stoull(length_str);
-    } catch (const std::exception&) {
-        return 0;
-    }
-}
-
-std::string HttpRequest::getContentType() const {
-    return getHeader("Content-Type");
+    return length;
 }
 
-void HttpRequest::parseQueryParams(const std::string& query_string) {
-    std::istringstream stream(query_string);
-    std::string pair;
-    
-    while (std::getline(stream, pair, '&')) {
-        size_t eq_pos = pair.find('=');
-        if (eq_pos != std::string::npos) {
-            std::string key = urlDecode(pair.substr(0, eq_pos));
-            std::string value = urlDecode(pair.substr(eq_pos + 1));
-            query_params_[key] = value;
-        } else {
-            query_params_[urlDecode(pair)] = "";
-        }
-    }
-}
-
-void HttpRequest::parseHeaders(const std::vector<std::string>& header_lines) {
-    for (const auto& line : header_lines) {
-        size_t colon_pos = line.find(':');
-        if (colon_pos != std::string::npos) {
-            std::string name = line.substr(0, colon_pos);
-            std::string value = line.substr(colon_pos + 1);
-            
-            // Trim whitespace
-            name.erase(0, name.find_first_not_of(" \t"));
-            name.erase(name.find_last_not_of(" \t") + 1);
-            value.erase(0, value.find_first_not_of(" \t"));
-            value.erase(value.find_last_not_of(" \t") + 1);
-            
-            headers_[name] = value;
-        }
-    }
-}
-
-std::string HttpRequest::urlDecode(const std::string& encoded) {
-    std::string decoded;
-    decoded.reserve(encoded.length());
-    
-    for (size_t i = 0; i < encoded.length(); ++i) {
-        if (encoded[i] == '%' && i + 2 < encoded.length()) {
-            std::string hex = encoded.substr(i + 1, 2);
-            try {
-                char ch = static_cast<char>(std::stoi(hex, nullptr, 16));
-                decoded += ch;
-                i += 2;
-            } catch (const std::exception&) {
-                decoded += encoded[i];
+void HttpRequest::parseQueryParams(std::string_view query_string) {
+    // Decoded straight into strings from the map's own resource
+    std::pmr::memory_resource* resource = query_params_.get_allocator().resource();
+    while (!query_string.empty()) {
+        size_t amp_pos = query_string.find('&');
+        std::string_view pair = query_string.substr(0, amp_pos);
+        
+        if (!pair.empty()) {
+            size_t eq_pos = pair.find('=');
+            std::pmr::string name(resource);
+            std::pmr::string value(resource);
+            appendUrlDecoded(pair.substr(0, eq_pos), name);
+            if (eq_pos != std::string_view::npos) {
+                appendUrlDecoded(pair.substr(eq_pos + 1), value);
             }
-        } else if (encoded[i] == '+') {
-            decoded += ' ';
-        } else {
-            decoded += encoded[i];
+            query_params_.insert_or_assign(std::move(name), std::move(value));
         }
+        
+        if (amp_pos == std::string_view::npos) {
+            break;
+        }
+        query_string.remove_prefix(amp_pos + 1);
     }
-    
-    return decoded;
 }
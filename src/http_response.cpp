@@ -1,6 +1,5 @@
 #include "http_response.h"
-#include <sstream>
-#include <fstream>
+#include <cstring>
 #include <unordered_map>
 
 HttpResponse::HttpResponse() 
@@ -11,29 +10,72 @@ HttpResponse::HttpResponse(StatusCode status_code)
     : status_code_(status_code), version_("HTTP/1.1") {
 }
 
-std::string HttpResponse::getStatusText() const {
-    return statusCodeToString(status_code_);
+HttpResponse::HttpResponse(std::pmr::memory_resource* resource)
+    : status_code_(StatusCode::OK), headers_(resource), version_("HTTP/1.1") {
 }
 
-void HttpResponse::setHeader(const std::string& name, const std::string& value) {
-    headers_[name] = value;
+std::string HttpResponse::getStatusText() const {
+    std::string_view line = statusLine(status_code_);
+    if (line.empty()) {
+        return "Unknown";
+    }
+    // Between "HTTP/1.1 NNN " and the trailing CRLF
+    return std::string(line.substr(13, line.size() - 15));
 }
 
-std::string HttpResponse::getHeader(const std::string& name) const {
-    auto it = headers_.find(name);
-    return (it != headers_.end()) ? it->second : "";
+std::string_view HttpResponse::statusLine(StatusCode code) {
+    switch (code) {
+        case StatusCode::OK:                              return "HTTP/1.1 200 OK\r\n";
+        case StatusCode::CREATED:                         return "HTTP/1.1 201 Created\r\n";
+        case StatusCode::NO_CONTENT:                      return "HTTP/1.1 204 No Content\r\n";
+        case StatusCode::NOT_MODIFIED:                    return "HTTP/1.1 304 Not Modified\r\n";
+        case StatusCode::BAD_REQUEST:                     return "HTTP/1.1 400 Bad Request\r\n";
+        case StatusCode::UNAUTHORIZED:                    return "HTTP/1.1 401 Unauthorized\r\n";
+        case StatusCode::FORBIDDEN:                       return "HTTP/1.1 403 Forbidden\r\n";
+        case StatusCode::NOT_FOUND:                       return "HTTP/1.1 404 Not Found\r\n";
+        case StatusCode::METHOD_NOT_ALLOWED:              return "HTTP/1.1 405 Method Not Allowed\r\n";
+        case StatusCode::PAYLOAD_TOO_LARGE:               return "HTTP/1.1 413 Payload Too Large\r\n";
+        case StatusCode::TOO_EARLY:                       return "HTTP/1.1 425 Too Early\r\n";
+        case StatusCode::REQUEST_HEADER_FIELDS_TOO_LARGE: return "HTTP/1.1 431 Request Header Fields Too Large\r\n";
+        case StatusCode::INTERNAL_SERVER_ERROR:           return "HTTP/1.1 500 Internal Server Error\r\n";
+        case StatusCode::NOT_IMPLEMENTED:                 return "HTTP/1.1 501 Not Implemented\r\n";
+        case StatusCode::SERVICE_UNAVAILABLE:             return "HTTP/1.1 503 Service Unavailable\r\n";
+    }
+    return std::string_view();
 }
 
 void HttpResponse::setBody(const std::string& body) {
+    shared_body_.reset();
+    file_body_.reset();
+    stream_producer_ = nullptr;
     body_ = body;
     setContentLength();
 }
 
+void HttpResponse::setBody(std::string&& body) {
+    shared_body_.reset();
+    file_body_.reset();
+    stream_producer_ = nullptr;
+    body_ = std::move(body);
+    setContentLength();
+}
+
 void HttpResponse::setBody(const char* body, size_t length) {
+    shared_body_.reset();
+    file_body_.reset();
+    stream_producer_ = nullptr;
     body_.assign(body, length);
     setContentLength();
 }
 
+void HttpResponse::setSharedBody(std::shared_ptr<const std::string> body) {
+    body_.clear();
+    file_body_.reset();
+    stream_producer_ = nullptr;
+    shared_body_ = std::move(body);
+    setContentLength();
+}
+
 void HttpResponse::setJsonContent(const std::string& json) {
     setHeader("Content-Type", "application/json; charset=utf-8");
     setBody(json);
@@ -50,27 +92,42 @@ void HttpResponse::setTextContent(const std::string& text) {
 }
 
 void HttpResponse::setFileContent(const std::string& file_path) {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file.is_open()) {
+    std::shared_ptr<const CachedFile> file = CachedFile::open(file_path);
+    if (!file) {
         status_code_ = StatusCode::NOT_FOUND;
         setTextContent("File not found");
         return;
     }
     
-    // Get file extension for MIME type
-    size_t dot_pos = file_path.find_last_of('.');
-    std::string extension;
-    if (dot_pos != std::string::npos) {
-        extension = file_path.substr(dot_pos + 1);
-    }
-    
-    std::string mime_type = getMimeType(extension);
-    setHeader("Content-Type", mime_type);
-    
-    // Read file content
-    std::ostringstream content;
-    content << file.rdbuf();
-    setBody(content.str());
+    setFileContent(std::move(file));
+}
+
+void HttpResponse::setFileContent(std::shared_ptr<const CachedFile> file) {
+    setHeader("Content-Type", mimeTypeForPath(file->getPath()));
+    setFileBody(std::move(file));
+}
+
+void HttpResponse::setFileBody(std::shared_ptr<const CachedFile> file) {
+    body_.clear();
+    shared_body_.reset();
+    stream_producer_ = nullptr;
+    file_body_ = std::move(file);
+    setContentLength();
+}
+
+void HttpResponse::setStreamingBody(StreamProducer producer) {
+    body_.clear();
+    shared_body_.reset();
+    file_body_.reset();
+    stream_producer_ = std::move(producer);
+    // The length is not known up front; the transport frames the body
+    headers_.remove("Content-Length");
+}
+
+void HttpResponse::setEventStream(StreamProducer producer) {
+    setHeader("Content-Type", "text/event-stream");
+    setHeader("Cache-Control", "no-cache");
+    setStreamingBody(std::move(producer));
 }
 
 void HttpResponse::enableCors(const std::string& origin) {
@@ -80,27 +137,99 @@ void HttpResponse::enableCors(const std::string& origin) {
 }
 
 std::string HttpResponse::toString() const {
-    std::ostringstream response;
-    
-    // Status line
-    response << version_ << " " << static_cast<int>(status_code_) << " " << getStatusText() << "\r\n";
+    std::string response;
+    serializeTo(response);
+    return response;
+}
+
+void HttpResponse::serializeHeadTo(std::string& buffer) const {
+    serialize(buffer, false);
+}
+
+void HttpResponse::serializeTo(std::string& buffer) const {
+    serialize(buffer, true);
+}
+
+size_t HttpResponse::getSerializedSize() const {
+    std::string fallback_line;
+    size_t size = getStatusLine(fallback_line).size() + 2 + getBodySize();
+    for (const auto& header : headers_) {
+        size += header.name.size() + header.value.size() + 4;
+    }
+    return size;
+}
+
+bool HttpResponse::serializeTo(char* buffer) const {
+    std::string fallback_line;
+    std::string_view status_line = getStatusLine(fallback_line);
+    auto append = [&buffer](std::string_view piece) {
+        std::memcpy(buffer, piece.data(), piece.size());
+        buffer += piece.size();
+    };
     
-    // Headers
+    append(status_line);
     for (const auto& header : headers_) {
-        response << header.first << ": " << header.second << "\r\n";
+        append(header.name);
+        append(": ");
+        append(header.value);
+        append("\r\n");
+    }
+    append("\r\n");
+    
+    if (file_body_) {
+        return file_body_->readInto(buffer, 0, file_body_->getSize());
+    }
+    append(getBody());
+    return true;
+}
+
+std::string_view HttpResponse::getStatusLine(std::string& storage) const {
+    std::string_view status_line = statusLine(status_code_);
+    if (status_line.empty()) {
+        storage = version_ + " " + std::to_string(static_cast<int>(status_code_)) + " Unknown\r\n";
+        status_line = storage;
     }
+    return status_line;
+}
+
+void HttpResponse::serialize(std::string& buffer, bool include_body) const {
+    std::string fallback_line;
+    std::string_view status_line = getStatusLine(fallback_line);
     
-    // Empty line to separate headers from body
-    response << "\r\n";
+    // Size the buffer once so appending never reallocates
+    size_t total_size = status_line.size() + 2 + (include_body ? getBodySize() : 0);
+    for (const auto& header : headers_) {
+        total_size += header.name.size() + header.value.size() + 4;
+    }
+    buffer.reserve(buffer.size() + total_size);
     
-    // Body
-    response << body_;
+    buffer.append(status_line);
+    for (const auto& header : headers_) {
+        buffer.append(header.name);
+        buffer.append(": ", 2);
+        buffer.append(header.value);
+        buffer.append("\r\n", 2);
+    }
+    buffer.append("\r\n", 2);
     
-    return response.str();
+    if (include_body) {
+        if (file_body_) {
+            file_body_->readInto(buffer, 0, file_body_->getSize());
+        } else {
+            buffer.append(getBody());
+        }
+    }
+}
+
+void HttpResponse::clearBody() {
+    body_.clear();
+    shared_body_.reset();
+    file_body_.reset();
+    stream_producer_ = nullptr;
 }
 
 void HttpResponse::setContentLength() {
-    setHeader("Content-Length", std::to_string(body_.length()));
+    setHeader("Content-Length", std::to_string(getBodySize()));
 }
 
 bool HttpResponse::isError() const {
@@ -108,26 +237,15 @@ bool HttpResponse::isError() const {
     return code >= 400;
 }
 
-std::string HttpResponse::statusCodeToString(StatusCode code) const {
-    static const std::unordered_map<StatusCode, std::string> status_texts = {
-        {StatusCode::OK, "OK"},
-        {StatusCode::CREATED, "Created"},
-        {StatusCode::NO_CONTENT, "No Content"},
-        {StatusCode::BAD_REQUEST, "Bad Request"},
-        {StatusCode::UNAUTHORIZED, "Unauthorized"},
-        {StatusCode::FORBIDDEN, "Forbidden"},
-        {StatusCode::NOT_FOUND, "Not Found"},
-        {StatusCode::METHOD_NOT_ALLOWED, "Method Not Allowed"},
-        {StatusCode::INTERNAL_SERVER_ERROR, "Internal Server Error"},
-        {StatusCode::NOT_IMPLEMENTED, "Not Implemented"},
-        {StatusCode::SERVICE_UNAVAILABLE, "Service Unavailable"}
-    };
-    
-    auto it = status_texts.find(code);
-    return (it != status_texts.end()) ? it->second : "Unknown";
+std::string HttpResponse::mimeTypeForPath(const std::string& file_path) {
+    size_t dot_pos = file_path.find_last_of('.');
+    if (dot_pos == std::string::npos) {
+        return getMimeType(std::string());
+    }
+    return getMimeType(file_path.substr(dot_pos + 1));
 }
 
-std::string HttpResponse::getMimeType(const std::string& file_extension) const {
+std::string HttpResponse::getMimeType(const std::string& file_extension) {
     static const std::unordered_map<std::string, std::string> mime_types = {
         {"html", "text/html"},
         {"htm", "text/html"},
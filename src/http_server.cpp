@@ -1,23 +1,125 @@
 #include "http_server.h"
+#include "http_date.h"
 #include "logger.h"
+#include "string_util.h"
+#include <cstdio>
 #include <sstream>
-#include <fstream>
 #include <algorithm>
-#include <regex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 #ifndef BUILD_WASM
+#include <cerrno>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #endif
 
+#ifndef BUILD_WASM
+namespace {
+
+// HTTP/1.1 connections persist unless the client opts out; HTTP/1.0 ones
+// only persist when the client asks for it.
+bool wantsKeepAlive(const HttpRequest& request) {
+    std::string_view connection = request.getHeaders().get(HeaderId::CONNECTION);
+    if (request.getVersion() == "HTTP/1.0") {
+        return string_util::hasToken(connection, "keep-alive");
+    }
+    return !string_util::hasToken(connection, "close");
+}
+
+// Error response for a request the framer refused; the connection is closed after it
+HttpResponse framingErrorResponse(RequestFramer::Status status) {
+    HttpResponse response;
+    switch (status) {
+        case RequestFramer::Status::PAYLOAD_TOO_LARGE:
+            response.setStatusCode(HttpResponse::StatusCode::PAYLOAD_TOO_LARGE);
+            break;
+        case RequestFramer::Status::HEADERS_TOO_LARGE:
+            response.setStatusCode(HttpResponse::StatusCode::REQUEST_HEADER_FIELDS_TOO_LARGE);
+            break;
+        default:
+            response.setStatusCode(HttpResponse::StatusCode::BAD_REQUEST);
+            break;
+    }
+    response.setTextContent(response.getStatusText());
+    response.setHeader("Connection", "close");
+    return response;
+}
+
+// HEAD responses, and 1xx, 204 and 304 ones, end with the head (RFC 9112
+// section 6.3); a body sent anyway would be read as the next response
+bool sendsBody(const HttpRequest& request, const HttpResponse& response) {
+    int status = static_cast<int>(response.getStatusCode());
+    return request.getMethod() != HttpRequest::Method::HEAD && status >= 200 && status != 204 && status != 304;
+}
+
+// Most a single flush may take from an HTTP/2 session before the socket
+// gets it, so one busy stream cannot balloon the head buffer
+constexpr size_t kHttp2WriteChunk = 64 * 1024;
+
+// The client preface, or as much of it as has arrived so far
+bool startsWithPreface(std::string_view input, bool& complete) {
+    std::string_view preface = Http2Session::kPreface;
+    size_t compared = std::min(input.size(), preface.size());
+    complete = compared == preface.size();
+    return input.compare(0, compared, preface.substr(0, compared)) == 0;
+}
+
+} // namespace
+#endif
+
+namespace {
+
+// Runs `step`; an exception escaping it (the error handler's own, say)
+// leaves a bare 500 rather than a request that is never answered
+template <typename Step>
+void runGuarded(HttpResponse& response, Step&& step) {
+#if defined(__cpp_exceptions)
+    try {
+        step();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error handling connection: ", e.what());
+        response = HttpResponse(HttpResponse::StatusCode::INTERNAL_SERVER_ERROR);
+    }
+#else
+    step();
+#endif
+}
+
+// RFC 9110 section 13.2.2: If-None-Match takes precedence, and
+// If-Modified-Since is only consulted when it is absent
+template <typename EtagMatcher>
+bool isNotModified(std::string_view if_none_match, std::string_view if_modified_since, time_t modified_time,
+                   EtagMatcher etag_matches) {
+    if (!if_none_match.empty()) {
+        return etag_matches(if_none_match);
+    }
+    time_t since;
+    return !if_modified_since.empty() && http_date::parse(if_modified_since, since) && modified_time <= since;
+}
+
+} // namespace
+
 HttpServer::HttpServer() 
-    : is_running_(false), port_(0), host_("0.0.0.0"),
-      max_connections_(100), timeout_seconds_(30), thread_pool_size_(std::thread::hardware_concurrency()) {
+    : is_running_(false), draining_(false), port_(0), host_("0.0.0.0"),
+      max_queued_requests_(kDefaultMaxQueuedRequests), retry_after_seconds_(1), shed_requests_(0),
+      timeout_seconds_(30), header_timeout_seconds_(kDefaultHeaderTimeoutSeconds),
+      write_timeout_seconds_(kDefaultWriteTimeoutSeconds), min_body_rate_(0), thread_pool_size_(std::thread::hardware_concurrency()),
+      max_body_size_(RequestFramer::kDefaultMaxBodySize), listener_shards_(1),
+      defer_accept_seconds_(0), fast_open_queue_(0), http2_enabled_(true), compression_enabled_(false),
+      compress_min_size_(kDefaultCompressMinSize), metrics_enabled_(false) {
+    
+    admission_.setMaxConnections(100);
+    buildOverloadResponse();
     
 #ifndef BUILD_WASM
-    socket_server_ = std::make_unique<SocketServer>();
     thread_pool_ = std::make_unique<ThreadPool>(thread_pool_size_);
 #ifdef ENABLE_SSL
+    ssl_server_ = std::make_unique<SslServer>();
     use_ssl_ = false;
 #endif
 #endif
@@ -34,6 +136,15 @@ HttpServer::HttpServer()
 
 HttpServer::~HttpServer() {
     stop();
+    
+#ifndef BUILD_WASM
+    // Shard threads exit once their loops see the stop
+    for (auto& shard : shards_) {
+        if (shard->thread.joinable() && shard->thread.get_id() != std::this_thread::get_id()) {
+            shard->thread.join();
+        }
+    }
+#endif
 }
 
 bool HttpServer::start(int port, const std::string& host) {
@@ -43,37 +154,51 @@ bool HttpServer::start(int port, const std::string& host) {
     
     port_ = port;
     host_ = host;
+    draining_ = false;
 
 #ifndef BUILD_WASM
-    if (!socket_server_->bind(port, host)) {
-        LOG_ERROR("Failed to bind to " + host + ":" + std::to_string(port));
-        return false;
-    }
-    
-    if (!socket_server_->listen()) {
-        LOG_ERROR("Failed to listen on socket");
+    if (!openShards(port, host)) {
         return false;
     }
     
+    port_ = shards_.front()->listener.getPort();
+    host_ = shards_.front()->listener.getHost();
     thread_pool_->start();
     is_running_ = true;
     
 #ifdef ENABLE_SSL
     if (use_ssl_) {
-        LOG_INFO("HTTPS server started on " + host + ":" + std::to_string(port));
+        LOG_INFO("HTTPS server started on ", host_, ":", port_);
     } else {
-        LOG_INFO("HTTP server started on " + host + ":" + std::to_string(port));
+        LOG_INFO("HTTP server started on ", host_, ":", port_);
     }
 #else
-    LOG_INFO("HTTP server started on " + host + ":" + std::to_string(port));
+    LOG_INFO("HTTP server started on ", host_, ":", port_);
 #endif
     
-    // Accept connections
-    socket_server_->accept([this](int client_socket) {
-        thread_pool_->enqueue([this, client_socket]() {
-            handleConnection(client_socket);
+    // Extra shards get their own reactor threads; the first one runs on the
+    // calling thread until stop()
+    for (size_t i = 1; i < shards_.size(); ++i) {
+        ListenerShard* shard = shards_[i].get();
+        shard->thread = std::thread([this, shard]() {
+            runShard(*shard);
         });
-    });
+    }
+    runShard(*shards_.front());
+    
+    for (auto& shard : shards_) {
+        if (shard->thread.joinable()) {
+            shard->thread.join();
+        }
+    }
+    
+    // The loops ended on their own, so a drain finished: handlers still
+    // queued (for connections cut off at the deadline) run before returning.
+    // Otherwise stop() got here first and leaves the pool to itself.
+    if (is_running_.exchange(false)) {
+        thread_pool_->drain();
+        LOG_INFO("HTTP server drained");
+    }
 #else
     is_running_ = true;
     LOG_INFO("WebAssembly HTTP server initialized");
@@ -89,7 +214,6 @@ bool HttpServer::startHttps(int port, const std::string& cert_file, const std::s
         return false;
     }
     
-    ssl_server_ = std::make_unique<SslServer>();
     if (!ssl_server_->initialize(cert_file, key_file)) {
         LOG_ERROR("Failed to initialize SSL server");
         return false;
@@ -105,24 +229,39 @@ bool HttpServer::startHttps(int port, const std::string& cert_file, const std::s
 
 void HttpServer::setSslContext(const std::string& cert_file, const std::string& key_file) {
 #ifndef BUILD_WASM
-    if (!ssl_server_) {
-        ssl_server_ = std::make_unique<SslServer>();
-    }
     ssl_server_->initialize(cert_file, key_file);
 #endif
 }
+
+#ifndef BUILD_WASM
+void HttpServer::setTlsSessionCache(size_t entries, int timeout_seconds) {
+    ssl_server_->setSessionCacheSize(entries);
+    ssl_server_->setSessionTimeout(timeout_seconds);
+}
+
+void HttpServer::setTlsTicketKeyRotation(int rotation_seconds) {
+    ssl_server_->setTicketKeyRotation(rotation_seconds);
+}
+
+void HttpServer::setTlsEarlyData(uint32_t max_early_data) {
+    ssl_server_->setMaxEarlyData(max_early_data);
+}
+
+SslServer::HandshakeStats HttpServer::getTlsHandshakeStats() const {
+    return ssl_server_->getHandshakeStats();
+}
+#endif
 #endif
 
 void HttpServer::stop() {
-    if (!is_running_) {
+    if (!is_running_.exchange(false)) {
         return;
     }
     
-    is_running_ = false;
-    
 #ifndef BUILD_WASM
-    if (socket_server_) {
-        socket_server_->stop();
+    // Each loop thread closes its listener and connections on exit
+    for (auto& shard : shards_) {
+        shard->loop.stop();
     }
     
     if (thread_pool_) {
@@ -133,6 +272,45 @@ void HttpServer::stop() {
     LOG_INFO("HTTP server stopped");
 }
 
+void HttpServer::drain(int timeout_seconds) {
+    if (!is_running_ || draining_.exchange(true)) {
+        return;
+    }
+    
+#ifndef BUILD_WASM
+    LOG_INFO("Draining connections for up to ", timeout_seconds, "s");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(std::max(timeout_seconds, 0));
+    for (auto& shard : shards_) {
+        ListenerShard* raw_shard = shard.get();
+        raw_shard->loop.post([this, raw_shard, deadline]() {
+            beginDrain(*raw_shard, deadline);
+        });
+    }
+#else
+    // Requests are answered synchronously: nothing is ever in flight
+    stop();
+#endif
+}
+
+#ifndef BUILD_WASM
+void HttpServer::setInheritedListeners(std::vector<int> sockets) {
+    for (int socket : inherited_listeners_) {
+        close(socket);
+    }
+    inherited_listeners_ = std::move(sockets);
+}
+
+std::vector<int> HttpServer::getListenerSockets() const {
+    std::vector<int> sockets;
+    if (is_running_) {
+        for (const auto& shard : shards_) {
+            sockets.push_back(shard->listener.getSocket());
+        }
+    }
+    return sockets;
+}
+#endif
+
 void HttpServer::get(const std::string& path, RequestHandler handler) {
     route(HttpRequest::Method::GET, path, handler);
 }
@@ -161,14 +339,95 @@ void HttpServer::patch(const std::string& path, RequestHandler handler) {
     route(HttpRequest::Method::PATCH, path, handler);
 }
 
+void HttpServer::get(const std::string& path, AsyncRequestHandler handler) {
+    route(HttpRequest::Method::GET, path, handler);
+}
+
+void HttpServer::post(const std::string& path, AsyncRequestHandler handler) {
+    route(HttpRequest::Method::POST, path, handler);
+}
+
+void HttpServer::put(const std::string& path, AsyncRequestHandler handler) {
+    route(HttpRequest::Method::PUT, path, handler);
+}
+
+void HttpServer::del(const std::string& path, AsyncRequestHandler handler) {
+    route(HttpRequest::Method::DELETE, path, handler);
+}
+
+void HttpServer::head(const std::string& path, AsyncRequestHandler handler) {
+    route(HttpRequest::Method::HEAD, path, handler);
+}
+
+void HttpServer::options(const std::string& path, AsyncRequestHandler handler) {
+    route(HttpRequest::Method::OPTIONS, path, handler);
+}
+
+void HttpServer::patch(const std::string& path, AsyncRequestHandler handler) {
+    route(HttpRequest::Method::PATCH, path, handler);
+}
+
 void HttpServer::route(HttpRequest::Method method, const std::string& path, RequestHandler handler) {
+    Route route = makeRoute(method, path);
+    route.handler = handler;
+    addRoute(std::move(route));
+}
+
+void HttpServer::route(HttpRequest::Method method, const std::string& path, AsyncRequestHandler handler) {
+    Route route = makeRoute(method, path);
+    route.async_handler = handler;
+    addRoute(std::move(route));
+}
+
+HttpServer::Route HttpServer::makeRoute(HttpRequest::Method method, const std::string& path) const {
     Route route;
     route.method = method;
     route.path = path;
-    route.handler = handler;
-    route.is_regex = path.find('*') != std::string::npos || path.find('(') != std::string::npos;
-    
-    routes_.push_back(route);
+    route.allow_early_data = method != HttpRequest::Method::POST && method != HttpRequest::Method::PATCH;
+    if (metrics_enabled_) {
+        route.latency = std::make_unique<metrics::LatencyHistogram>();
+    }
+    return route;
+}
+
+void HttpServer::addRoute(Route route) {
+    if (!router_.add(route.method, route.path, static_cast<int32_t>(routes_.size()))) {
+        LOG_ERROR("Invalid route pattern: ", route.path);
+        return;
+    }
+    routes_.push_back(std::move(route));
+}
+
+void HttpServer::setEarlyDataAllowed(HttpRequest::Method method, const std::string& path, bool allowed) {
+    for (auto& route : routes_) {
+        if (route.method == method && route.path == path) {
+            route.allow_early_data = allowed;
+            return;
+        }
+    }
+    LOG_ERROR("No route for early data setting: ", path);
+}
+
+void HttpServer::cacheRoute(HttpRequest::Method method, const std::string& path, ResponseCache::Policy policy) {
+    if (method != HttpRequest::Method::GET && method != HttpRequest::Method::HEAD) {
+        LOG_ERROR("Only GET and HEAD routes can be cached: ", path);
+        return;
+    }
+    for (auto& route : routes_) {
+        if (route.method == method && route.path == path) {
+            if (route.async_handler) {
+                LOG_ERROR("Asynchronous routes cannot be cached: ", path);
+                return;
+            }
+            route.cache = std::make_unique<ResponseCache::Policy>(std::move(policy));
+            return;
+        }
+    }
+    LOG_ERROR("No route to cache: ", path);
+}
+
+void HttpServer::setResponseCacheSize(size_t max_bytes) {
+    response_cache_.setMaxBytes(max_bytes);
 }
 
 void HttpServer::use(MiddlewareFunction middleware) {
@@ -180,13 +439,146 @@ void HttpServer::serveStatic(const std::string& path, const std::string& directo
 }
 
 void HttpServer::setMaxConnections(int max_connections) {
-    max_connections_ = max_connections;
+    admission_.setMaxConnections(max_connections > 0 ? static_cast<size_t>(max_connections) : 0);
+}
+
+void HttpServer::setMaxConnectionsPerClient(int max_per_client) {
+    admission_.setMaxConnectionsPerClient(max_per_client > 0 ? static_cast<size_t>(max_per_client) : 0);
+}
+
+void HttpServer::setMaxQueuedRequests(size_t max_queued) {
+    max_queued_requests_ = max_queued;
+}
+
+void HttpServer::setRetryAfterSeconds(int seconds) {
+    retry_after_seconds_ = seconds;
+    buildOverloadResponse();
 }
 
 void HttpServer::setTimeoutSeconds(int timeout_seconds) {
     timeout_seconds_ = timeout_seconds;
 }
 
+void HttpServer::setHeaderTimeoutSeconds(int seconds) {
+    header_timeout_seconds_ = seconds;
+}
+
+void HttpServer::setWriteTimeoutSeconds(int seconds) {
+    write_timeout_seconds_ = seconds;
+}
+
+void HttpServer::setMinBodyRate(size_t bytes_per_second) {
+    min_body_rate_ = bytes_per_second;
+}
+
+void HttpServer::setMaxBodySize(size_t max_body_size) {
+    max_body_size_ = max_body_size;
+}
+
+void HttpServer::setListenerShards(int shards) {
+    listener_shards_ = shards < 1 ? 1 : shards;
+}
+
+void HttpServer::setDeferAccept(int seconds) {
+    defer_accept_seconds_ = seconds;
+}
+
+void HttpServer::setTcpFastOpen(int queue_length) {
+    fast_open_queue_ = queue_length;
+}
+
+void HttpServer::setHttp2Enabled(bool enabled) {
+    http2_enabled_ = enabled;
+#if defined(ENABLE_SSL) && !defined(BUILD_WASM)
+    ssl_server_->setHttp2(enabled);
+#endif
+}
+
+void HttpServer::enableAccessLog(const std::string& filename, AccessLog::Format format, double sample_rate) {
+    Logger::getInstance().setAccessLogFile(filename);
+    access_log_.enable(format, sample_rate);
+}
+
+void HttpServer::enableCompression(size_t min_size) {
+    compression_enabled_ = true;
+    compress_min_size_ = min_size;
+}
+
+void HttpServer::enableMetrics(const std::string& path) {
+    if (metrics_enabled_) {
+        return;
+    }
+    metrics_enabled_ = true;
+    for (auto& route : routes_) {
+        route.latency = std::make_unique<metrics::LatencyHistogram>();
+    }
+    get(path, [this](const HttpRequest&, HttpResponse& res) {
+        std::string body;
+        renderMetrics(body);
+        res.setTextContent(body);
+        res.setHeader("Content-Type", metrics::PrometheusWriter::kContentType);
+    });
+}
+
+void HttpServer::renderMetrics(std::string& out) const {
+    metrics::PrometheusWriter writer(out);
+    
+    static const char* const kStatusClasses[] = {"code=\"1xx\"", "code=\"2xx\"", "code=\"3xx\"", "code=\"4xx\"",
+                                                 "code=\"5xx\""};
+    writer.family("http_requests_total", "counter", "Requests answered by a route, static file or fallback handler.");
+    for (size_t i = 0; i < responses_by_class_.size(); ++i) {
+        writer.sample("http_requests_total", kStatusClasses[i], responses_by_class_[i].value());
+    }
+    writer.family("http_requests_rejected_total", "counter", "Connections and requests refused with 503.");
+    writer.sample("http_requests_rejected_total", "", getRejectedCount());
+    
+    writer.family("http_request_duration_seconds", "histogram", "Time to produce a response, by route.");
+    std::string labels;
+    for (const auto& route : routes_) {
+        if (route.latency) {
+            labels.assign("method=\"").append(HttpRequest::methodName(route.method)).append("\",route=");
+            metrics::PrometheusWriter::appendLabelValue(labels, route.path);
+            writer.histogram("http_request_duration_seconds", labels, *route.latency);
+        }
+    }
+    writer.histogram("http_request_duration_seconds", "method=\"\",route=\"(static)\"", static_latency_);
+    writer.histogram("http_request_duration_seconds", "method=\"\",route=\"(unmatched)\"", unmatched_latency_);
+    
+    writer.family("http_response_cache_requests_total", "counter", "Requests to cached routes, by how they were answered.");
+    writer.sample("http_response_cache_requests_total", "result=\"hit\"", response_cache_.getHits());
+    writer.sample("http_response_cache_requests_total", "result=\"coalesced\"", response_cache_.getCoalesced());
+    writer.sample("http_response_cache_requests_total", "result=\"miss\"", response_cache_.getMisses());
+    
+    writer.family("http_connections_active", "gauge", "Open client connections.");
+    writer.sample("http_connections_active", "", static_cast<uint64_t>(getActiveConnections()));
+#ifndef BUILD_WASM
+    writer.family("http_connections_accepted_total", "counter", "Client connections admitted.");
+    writer.sample("http_connections_accepted_total", "", connections_accepted_.value());
+    
+    writer.family("thread_pool_queued_tasks", "gauge", "Tasks waiting for a worker.");
+    writer.sample("thread_pool_queued_tasks", "", static_cast<uint64_t>(thread_pool_->getQueueSize()));
+    writer.family("thread_pool_threads", "gauge", "Worker threads.");
+    writer.sample("thread_pool_threads", "", static_cast<uint64_t>(thread_pool_->getThreadCount()));
+    writer.family("thread_pool_steals_total", "counter", "Tasks a worker took from a peer's deque.");
+    writer.sample("thread_pool_steals_total", "", thread_pool_->getStealCount());
+    
+#ifdef ENABLE_SSL
+    if (use_ssl_) {
+        SslServer::HandshakeStats stats = ssl_server_->getHandshakeStats();
+        writer.family("tls_handshakes_total", "counter", "TLS handshakes by outcome.");
+        writer.sample("tls_handshakes_total", "result=\"full\"", stats.full);
+        writer.sample("tls_handshakes_total", "result=\"resumed\"", stats.resumed);
+        writer.sample("tls_handshakes_total", "result=\"failed\"", stats.failed);
+        writer.family("tls_handshake_duration_seconds", "histogram", "Time from accept to a completed TLS handshake.");
+        writer.histogram("tls_handshake_duration_seconds", "", ssl_server_->getHandshakeTimes());
+    }
+#endif
+#endif
+    
+    writer.family("log_lines_dropped_total", "counter", "Log lines lost to full logger buffers.");
+    writer.sample("log_lines_dropped_total", "", Logger::getInstance().getDroppedCount());
+}
+
 void HttpServer::setThreadPoolSize(int size) {
     thread_pool_size_ = size;
 #ifndef BUILD_WASM
@@ -206,147 +598,1012 @@ void HttpServer::setErrorHandler(std::function<void(const std::exception&, const
 
 #ifdef BUILD_WASM
 void HttpServer::handleRequest(const std::string& raw_request, std::string& response_output) {
-    HttpRequest request(raw_request);
     HttpResponse response;
-    
+    handleRequest(std::string_view(raw_request), response);
+    response_output.clear();
+    response.serializeTo(response_output);
+}
+
+void HttpServer::handleRequest(std::string_view raw_request, HttpResponse& response) {
+    HttpRequest request(raw_request);
     processRequest(request, response);
-    response_output = response.toString();
 }
 
-void HttpServer::processRequest(const HttpRequest& request, HttpResponse& response) {
-    processHttpRequest(request, response);
+void HttpServer::processRequest(HttpRequest& request, HttpResponse& response) {
+    // The embedding answers synchronously, so an asynchronous handler's
+    // completion is waited for
+    std::mutex mutex;
+    std::condition_variable completed;
+    bool finished = false;
+    processHttpRequest(request, response, [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        completed.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    completed.wait(lock, [&finished]() { return finished; });
 }
 #endif
 
 #ifndef BUILD_WASM
-void HttpServer::handleConnection(int client_socket) {
-    try {
-        // Set socket timeout
-        struct timeval timeout;
-        timeout.tv_sec = timeout_seconds_;
-        timeout.tv_usec = 0;
-        setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+HttpServer::ListenerShard::ListenerShard() : reserve_fd(open("/dev/null", O_RDONLY | O_CLOEXEC)) {
+}
+
+HttpServer::ListenerShard::~ListenerShard() {
+    if (reserve_fd >= 0) {
+        close(reserve_fd);
+    }
+}
+
+bool HttpServer::openShards(int port, const std::string& host) {
+    shards_.clear();
+    
+    // Inherited sockets are already bound with their options, so `port`,
+    // `host` and the listener settings are left to whoever made them
+    std::vector<int> inherited = std::move(inherited_listeners_);
+    inherited_listeners_.clear();
+    int shard_count = inherited.empty() ? listener_shards_ : static_cast<int>(inherited.size());
+    
+    for (int i = 0; i < shard_count; ++i) {
+        auto shard = std::make_unique<ListenerShard>();
+        SocketServer& listener = shard->listener;
         
-#ifdef ENABLE_SSL
-        SSL* ssl_connection = nullptr;
-        if (use_ssl_ && ssl_server_) {
-            ssl_connection = ssl_server_->createSslConnection(client_socket);
-            if (!ssl_connection || !ssl_server_->performHandshake(ssl_connection)) {
-                LOG_ERROR("SSL handshake failed");
-                if (ssl_connection) {
-                    ssl_server_->closeSslConnection(ssl_connection);
+        if (!inherited.empty()) {
+            if (!listener.adopt(inherited[i])) {
+                LOG_ERROR("Inherited socket ", inherited[i], " is not a TCP listener");
+                for (size_t j = i; j < inherited.size(); ++j) {
+                    close(inherited[j]);
                 }
-                close(client_socket);
-                return;
-            }
-        }
-#endif
-        
-        // Read request
-        char buffer[8192];
-        std::string raw_request;
-        
-        ssize_t bytes_read;
-        while (true) {
-#ifdef ENABLE_SSL
-            if (use_ssl_ && ssl_connection) {
-                bytes_read = ssl_server_->sslRead(ssl_connection, buffer, sizeof(buffer) - 1);
-            } else {
-                bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
+                shards_.clear();
+                return false;
             }
-#else
-            bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-#endif
+        } else {
+            listener.setReusePort(listener_shards_ > 1);
+            listener.setDeferAccept(defer_accept_seconds_);
+            listener.setFastOpen(fast_open_queue_);
             
-            if (bytes_read <= 0) {
-                break;
+            // Later shards join whatever port the first one bound (port 0 included)
+            int shard_port = shards_.empty() ? port : shards_.front()->listener.getPort();
+            if (!listener.bind(shard_port, host)) {
+                LOG_ERROR("Failed to bind to ", host, ":", shard_port);
+                shards_.clear();
+                return false;
             }
             
-            buffer[bytes_read] = '\0';
-            raw_request += buffer;
-            
-            // Check if we have a complete HTTP request
-            if (raw_request.find("\r\n\r\n") != std::string::npos) {
-                break;
-            }
-        }
-        
-        if (raw_request.empty()) {
-#ifdef ENABLE_SSL
-            if (ssl_connection) {
-                ssl_server_->closeSslConnection(ssl_connection);
+            if (!listener.listen()) {
+                LOG_ERROR("Failed to listen on socket");
+                shards_.clear();
+                return false;
             }
-#endif
-            close(client_socket);
-            return;
         }
         
-        // Parse and process request
-        HttpRequest request(raw_request);
-        HttpResponse response;
-        
-        processHttpRequest(request, response);
+        listener.setNonBlocking(true);
         
-        // Send response
-        std::string response_str = response.toString();
-        
-#ifdef ENABLE_SSL
-        if (use_ssl_ && ssl_connection) {
-            ssl_server_->sslWrite(ssl_connection, response_str.c_str(), response_str.length());
-            ssl_server_->closeSslConnection(ssl_connection);
-        } else {
-            send(client_socket, response_str.c_str(), response_str.length(), 0);
+        ListenerShard* raw_shard = shard.get();
+        shard->loop.add(listener.getSocket(), EPOLLIN | EPOLLET, [this, raw_shard](uint32_t) {
+            acceptConnections(*raw_shard);
+        });
+        shard->loop.runEvery(kTimeoutTickMs, [this, raw_shard]() {
+            expireConnections(*raw_shard);
+        });
+        shards_.push_back(std::move(shard));
+    }
+    return true;
+}
+
+void HttpServer::runShard(ListenerShard& shard) {
+    shard.loop.run();
+    
+    closeAllConnections(shard);
+    shard.listener.stop();
+}
+
+void HttpServer::beginDrain(ListenerShard& shard, std::chrono::steady_clock::time_point deadline) {
+    shard.draining = true;
+    shard.drain_deadline = deadline;
+    
+    // Connections already queued are still served; the kernel's listening
+    // socket lives on in a successor holding it, which takes the new ones
+    acceptConnections(shard);
+    shard.loop.remove(shard.listener.getSocket());
+    shard.listener.stop();
+    
+    // Keep-alive connections between requests go now; a client may close an
+    // idle connection at any time anyway. A connection that has not sent its
+    // first request yet gets the chance to, answered with `Connection: close`.
+    std::vector<std::shared_ptr<Connection>> idle;
+    std::vector<std::shared_ptr<Connection>> sessions;
+    for (const auto& entry : shard.connections) {
+        Connection& connection = *entry.second;
+        if (connection.getHttp2()) {
+            sessions.push_back(entry.second);
+        } else if (connection.getState() == Connection::State::READING && connection.getRequestCount() > 0 &&
+                   connection.getInputBuffer().empty()) {
+            idle.push_back(entry.second);
+        }
+    }
+    for (const auto& connection : idle) {
+        closeConnection(shard, connection);
+    }
+    for (const auto& connection : sessions) {
+        if (!connection->isClosed()) {
+            connection->getHttp2()->goAway();
+            flushHttp2(shard, connection); // closes the session once its streams are done
         }
-#else
-        send(client_socket, response_str.c_str(), response_str.length(), 0);
-#endif
-        
-    } catch (const std::exception& e) {
-        LOG_ERROR("Error handling connection: " + std::string(e.what()));
     }
     
-    close(client_socket);
+    if (shard.connections.empty()) {
+        shard.loop.stop();
+    }
 }
-#endif
 
-void HttpServer::processHttpRequest(const HttpRequest& request, HttpResponse& response) {
-    try {
-        // Run middlewares
-        if (!runMiddlewares(request, response)) {
-            return;
+void HttpServer::acceptConnections(ListenerShard& shard) {
+    // Edge-triggered listener: drain the whole accept backlog. Stopping
+    // short of EAGAIN would leave queued clients with no event to wake us.
+    while (true) {
+        std::string remote_address;
+        int client_socket = shard.listener.acceptClient(remote_address);
+        if (client_socket < 0) {
+            int error = errno;
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                break;
+            }
+            if (error == ECONNABORTED || error == EPROTO || error == EPERM) {
+                continue; // that client is gone (or refused by a firewall); the next may be fine
+            }
+            if ((error == EMFILE || error == ENFILE) && refuseWithReserve(shard)) {
+                continue;
+            }
+            // Out of memory or descriptors with no reserve left: the timer
+            // tick takes the backlog up again
+            shard.accept_retry = true;
+            break;
         }
         
-        // Check static files first
-        for (const auto& static_path : static_paths_) {
-            if (request.getPath().find(static_path.first) == 0) {
-                std::string file_path = static_path.second + request.getPath().substr(static_path.first.length());
-                handleStaticFile(file_path, response);
-                return;
-            }
+        if (!admission_.tryAdmit(remote_address)) {
+            rejectAtAccept(client_socket);
+            continue;
         }
         
-        // Find matching route
-        bool route_found = false;
-        for (const auto& route : routes_) {
-            if (route.method == request.getMethod() || route.method == HttpRequest::Method::OPTIONS) {
-                if (matchRoute(route.path, request.getPath())) {
-                    route.handler(request, response);
-                    route_found = true;
-                    break;
-                }
+        if (metrics_enabled_) {
+            connections_accepted_.add();
+        }
+        
+        auto connection = std::make_shared<Connection>(client_socket, remote_address, max_body_size_);
+#ifdef ENABLE_SSL
+        if (use_ssl_) {
+            // The handshake runs on this loop like any other read
+            SSL* ssl = ssl_server_->createSslConnection(client_socket);
+            if (!ssl) {
+                admission_.release(remote_address);
+                continue;
             }
+            connection->enableTls(*ssl_server_, ssl);
         }
+#endif
+        
+        ListenerShard* owner = &shard;
+        bool added = shard.loop.add(client_socket, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+                                    [this, owner, connection](uint32_t events) {
+            onConnectionEvent(*owner, connection, events);
+        });
         
-        if (!route_found) {
-            not_found_handler_(request, response);
+        if (!added) {
+            admission_.release(remote_address);
+            continue; // Connection destructor closes the socket
         }
         
-    } catch (const std::exception& e) {
-        error_handler_(e, request, response);
+        shard.connections[client_socket] = connection;
+        armTimeout(shard, *connection);
     }
 }
 
-bool HttpServer::runMiddlewares(const HttpRequest& request, HttpResponse& response) {
+bool HttpServer::refuseWithReserve(ListenerShard& shard) {
+    if (shard.reserve_fd < 0) {
+        return false;
+    }
+    close(shard.reserve_fd);
+    std::string remote_address;
+    int client_socket = shard.listener.acceptClient(remote_address, false);
+    if (client_socket >= 0) {
+        rejectAtAccept(client_socket);
+    }
+    shard.reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return client_socket >= 0;
+}
+
+void HttpServer::onConnectionEvent(ListenerShard& shard, const std::shared_ptr<Connection>& connection,
+                                   uint32_t events) {
+    if (events & EPOLLERR) {
+        closeConnection(shard, connection);
+        return;
+    }
+    
+    // Always drain the socket: with edge triggering a skipped read while a
+    // request is being processed would lose the readiness notification.
+    // A TLS read can also be waiting for the socket to become writable.
+    bool readable = events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP);
+    if (readable || ((events & EPOLLOUT) && connection->readWantsWrite())) {
+        if (!connection->readAvailable()) {
+            closeConnection(shard, connection);
+            return;
+        }
+        
+        if (connection->getState() == Connection::State::CLOSING) {
+            if (!connection->isHandshaking() || connection->isPeerClosed()) {
+                closeConnection(shard, connection);
+            }
+            return;
+        }
+        
+        if (connection->getState() == Connection::State::READING) {
+            dispatchRequest(shard, connection);
+            if (connection->isClosed()) {
+                return;
+            }
+        } else if (connection->getInputBuffer().size() > max_body_size_ + RequestFramer::kDefaultMaxHeaderSize) {
+            // Client keeps pipelining while we are busy; refuse to buffer without bound
+            closeConnection(shard, connection);
+            return;
+        }
+    }
+    
+    bool writable = (events & EPOLLOUT) || (readable && connection->writeWantsRead());
+    if (writable && connection->getHttp2()) {
+        flushHttp2(shard, connection);
+    } else if (writable && connection->getState() == Connection::State::WRITING) {
+        if (!connection->flushOutput()) {
+            closeConnection(shard, connection);
+            return;
+        }
+        
+        if (!connection->hasPendingOutput()) {
+            onWriteComplete(shard, connection);
+        }
+    }
+    
+    if (!connection->isClosed()) {
+        armTimeout(shard, *connection);
+    }
+}
+
+void HttpServer::dispatchRequest(ListenerShard& shard, const std::shared_ptr<Connection>& connection) {
+    std::string& input = connection->getInputBuffer();
+    RequestFramer& framer = connection->getFramer();
+    
+    if (connection->getHttp2()) {
+        serviceHttp2(shard, connection);
+        return;
+    }
+    if (http2_enabled_ && connection->getRequestCount() == 0 && startHttp2(shard, connection)) {
+        return;
+    }
+    
+    RequestFramer::Status status = framer.frame(input);
+    if (status == RequestFramer::Status::NEED_MORE) {
+        if (connection->isPeerClosed()) {
+            closeConnection(shard, connection);
+        }
+        return;
+    }
+    
+    if (status != RequestFramer::Status::COMPLETE) {
+        rejectRequest(shard, connection, status);
+        return;
+    }
+    
+    if (isOverloaded()) {
+        shedRequest(shard, connection);
+        return;
+    }
+    
+    connection->setState(Connection::State::PROCESSING);
+    
+    // Pipelined requests behind this one stay in the connection buffer; the
+    // head parsed while framing is reused rather than scanned again
+    HttpRequest& request = connection->nextRequest();
+    size_t buffered = input.size();
+    framer.takeRequest(input, request);
+    connection->countRequest();
+    request.setEarlyData(connection->takeEarlyData(buffered - input.size()));
+    
+    // Sampled up front, so unsampled requests skip the clock reads too
+    bool logged = access_log_.sample();
+    AccessLog::Entry entry;
+    std::chrono::steady_clock::time_point received;
+    if (logged) {
+        entry = makeAccessEntry(*connection, request);
+        received = std::chrono::steady_clock::now();
+    }
+    
+    // Handlers run on the pool; the reactor thread never blocks on them.
+    // The response goes back to the loop that owns the connection.
+    ListenerShard* owner = &shard;
+    thread_pool_->enqueue([this, owner, connection, logged, entry, received]() mutable {
+        // The connection is PROCESSING, so its request, response and head
+        // buffer are ours to use until the response is handed to the loop
+        processHttpRequest(connection->getRequest(), connection->getResponse(),
+                           [this, owner, connection, logged, entry, received]() mutable {
+            respondHttp1(*owner, connection, logged, entry, received);
+        });
+    });
+}
+
+void HttpServer::respondHttp1(ListenerShard& shard, const std::shared_ptr<Connection>& connection, bool logged,
+                              AccessLog::Entry& entry, std::chrono::steady_clock::time_point received) {
+    bool keep_alive = false;
+    HttpResponse& response = connection->getResponse();
+    buildResponse(connection->getRequest(), response, keep_alive, connection->getHeadBuffer());
+    if (logged) {
+        logAccess(entry, response, received);
+    }
+    if (!sendsBody(connection->getRequest(), response)) {
+        response.clearBody();
+    }
+    
+    // A streamed body's producer starts once the head is on its way; the
+    // loop owns the response from here, so keep a copy of it
+    HttpResponse::StreamProducer producer;
+    std::shared_ptr<BodyStream> stream;
+    if (response.isStreaming()) {
+        producer = response.getStreamProducer();
+        stream = makeBodyStream(shard, connection);
+    }
+    bool chunked = response.getHeaders().contains("Transfer-Encoding");
+    
+    ListenerShard* owner = &shard;
+    owner->loop.post([this, owner, connection, keep_alive, stream, chunked]() {
+        if (stream) {
+            connection->setBodyStream(stream, chunked);
+        }
+        onResponseReady(*owner, connection, connection->getResponse(), keep_alive);
+    });
+    if (producer) {
+        runStreamProducer(producer, stream);
+    }
+}
+
+void HttpServer::onResponseReady(ListenerShard& shard, const std::shared_ptr<Connection>& connection,
+                                 HttpResponse& response, bool keep_alive) {
+    if (connection->isClosed()) {
+        return;
+    }
+    
+    connection->setKeepAlive(keep_alive);
+    connection->setState(Connection::State::WRITING);
+    if (response.getSharedBody()) {
+        connection->queueBody(response.getSharedBody());
+    } else {
+        connection->queueBody(response.takeBody());
+    }
+    if (response.getFileBody()) {
+        connection->queueFile(response.getFileBody());
+    }
+    
+    if (!connection->flushOutput()) {
+        closeConnection(shard, connection);
+        return;
+    }
+    
+    if (!connection->hasPendingOutput()) {
+        onWriteComplete(shard, connection);
+    }
+    // Otherwise the next EPOLLOUT edge resumes the write
+    
+    if (!connection->isClosed()) {
+        armTimeout(shard, *connection);
+    }
+}
+
+void HttpServer::rejectRequest(ListenerShard& shard, const std::shared_ptr<Connection>& connection,
+                               RequestFramer::Status status) {
+    connection->getInputBuffer().clear();
+    
+    HttpResponse response = framingErrorResponse(status);
+    response.serializeHeadTo(connection->getHeadBuffer());
+    onResponseReady(shard, connection, response, false);
+}
+
+void HttpServer::onWriteComplete(ListenerShard& shard, const std::shared_ptr<Connection>& connection) {
+    if (connection->getBodyStream()) {
+        pumpBodyStream(shard, connection);
+        return;
+    }
+    
+    if (!connection->isKeepAlive() || !is_running_ || draining_) {
+        if (connection->isHandshaking() && is_running_) {
+            // A 0.5-RTT response went out before the client's Finished;
+            // closing now would reset the connection under it
+            connection->setState(Connection::State::CLOSING);
+            return;
+        }
+        closeConnection(shard, connection);
+        return;
+    }
+    
+    // Serve the next pipelined request, if one is already buffered; its
+    // head is timed from now, not from when it arrived behind this one
+    connection->setState(Connection::State::READING);
+    if (!connection->getInputBuffer().empty()) {
+        connection->startRequestClock();
+    }
+    dispatchRequest(shard, connection);
+}
+
+std::shared_ptr<BodyStream> HttpServer::makeBodyStream(ListenerShard& shard,
+                                                       const std::shared_ptr<Connection>& connection) {
+    // Weak: the connection holds the stream, which holds this
+    ListenerShard* owner = &shard;
+    std::weak_ptr<Connection> weak = connection;
+    return std::make_shared<BodyStream>([this, owner, weak]() {
+        owner->loop.post([this, owner, weak]() {
+            std::shared_ptr<Connection> connection = weak.lock();
+            if (connection && !connection->isClosed()) {
+                onBodyStreamReady(*owner, connection);
+            }
+        });
+    });
+}
+
+void HttpServer::runStreamProducer(const HttpResponse::StreamProducer& producer,
+                                   const std::shared_ptr<BodyStream>& stream) {
+    // The producer's handle closes the stream once its last copy is gone, so
+    // one that returns without closing (or drops a stored copy) cannot leave
+    // the response open forever
+    std::shared_ptr<BodyStream> handle(stream.get(), [stream](BodyStream* body) { body->close(); });
+    try {
+        producer(handle);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error streaming response body: ", e.what());
+        stream->fail();
+    }
+}
+
+void HttpServer::onBodyStreamReady(ListenerShard& shard, const std::shared_ptr<Connection>& connection) {
+    if (connection->getHttp2()) {
+        flushHttp2(shard, connection);
+    } else if (connection->getBodyStream() && connection->getState() == Connection::State::WRITING &&
+               !connection->hasPendingOutput()) {
+        pumpBodyStream(shard, connection);
+    }
+    // Otherwise the write in flight picks the data up when it completes
+}
+
+void HttpServer::pumpBodyStream(ListenerShard& shard, const std::shared_ptr<Connection>& connection) {
+    BodyStream* stream = connection->getBodyStream();
+    std::string data;
+    BodyStream::State state = stream->take(data);
+    if (state == BodyStream::State::FAILED) {
+        // No terminating chunk: the client must see the body as cut off
+        closeConnection(shard, connection);
+        return;
+    }
+    
+    // Each batch is one chunk; its size line rides in the (drained) head buffer
+    bool ended = state == BodyStream::State::ENDED;
+    if (connection->isBodyStreamChunked()) {
+        if (!data.empty()) {
+            char size_line[24];
+            int length = std::snprintf(size_line, sizeof(size_line), "%zx\r\n", data.size());
+            connection->getHeadBuffer().append(size_line, static_cast<size_t>(length));
+            data.append("\r\n");
+        }
+        if (ended) {
+            data.append("0\r\n\r\n");
+        }
+    }
+    if (ended) {
+        connection->setBodyStream(nullptr, false);
+    }
+    if (data.empty() && connection->getHeadBuffer().empty()) {
+        if (ended) {
+            onWriteComplete(shard, connection);
+        }
+        return; // nothing written yet; the next notify brings us back
+    }
+    
+    connection->queueBody(std::move(data));
+    if (!connection->flushOutput()) {
+        closeConnection(shard, connection);
+        return;
+    }
+    if (!connection->hasPendingOutput()) {
+        onWriteComplete(shard, connection);
+    }
+}
+
+void HttpServer::armTimeout(ListenerShard& shard, Connection& connection) {
+    shard.timers.arm(connection.getTimer(), timeoutDeadline(connection, std::chrono::steady_clock::now()));
+}
+
+void HttpServer::expireConnections(ListenerShard& shard) {
+    auto now = std::chrono::steady_clock::now();
+    shard.expired_timers.clear();
+    shard.timers.advance(now, shard.expired_timers);
+    
+    std::vector<std::shared_ptr<Connection>> expired;
+    for (uint64_t socket : shard.expired_timers) {
+        auto it = shard.connections.find(static_cast<int>(socket));
+        if (it != shard.connections.end() && !checkTimeout(shard, *it->second, now)) {
+            expired.push_back(it->second);
+        }
+    }
+    
+    for (const auto& connection : expired) {
+        closeConnection(shard, connection);
+    }
+    
+    if (shard.accept_retry && !shard.draining) {
+        shard.accept_retry = false;
+        if (shard.reserve_fd < 0) {
+            shard.reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        }
+        acceptConnections(shard);
+    }
+    
+    // Whatever outlasts a drain is cut off when the loop ends
+    if (shard.draining && (shard.connections.empty() || now >= shard.drain_deadline)) {
+        shard.loop.stop();
+    }
+}
+
+bool HttpServer::checkTimeout(ListenerShard& shard, Connection& connection,
+                              std::chrono::steady_clock::time_point now) {
+    // A body still arriving must have kept up the minimum rate since the
+    // last check; the window then starts over
+    if (min_body_rate_ > 0 && connection.getState() == Connection::State::READING && !connection.getHttp2() &&
+        connection.getFramer().isReadingBody() &&
+        now - connection.getRateMark() >= std::chrono::seconds(kBodyRateWindowSeconds)) {
+        double elapsed = std::chrono::duration<double>(now - connection.getRateMark()).count();
+        if (static_cast<double>(connection.getBytesReceived() - connection.getRateMarkBytes()) <
+            static_cast<double>(min_body_rate_) * elapsed) {
+            return false;
+        }
+        connection.markRate(now);
+    }
+    
+    auto deadline = timeoutDeadline(connection, now);
+    if (deadline <= now) {
+        return false;
+    }
+    shard.timers.arm(connection.getTimer(), deadline);
+    return true;
+}
+
+std::chrono::steady_clock::time_point HttpServer::timeoutDeadline(Connection& connection,
+                                                                  std::chrono::steady_clock::time_point now) const {
+    // Phases without a limit of their own are looked at again after the
+    // keep-alive timeout, in case a change of phase went unnoticed
+    auto idle = connection.getLastActivity() + std::chrono::seconds(timeout_seconds_);
+    auto recheck = now + std::chrono::seconds(std::max(timeout_seconds_, 1));
+    auto write_stall = write_timeout_seconds_ > 0
+                           ? connection.getLastActivity() + std::chrono::seconds(write_timeout_seconds_)
+                           : recheck;
+    
+    switch (connection.getState()) {
+        case Connection::State::PROCESSING:
+            return recheck; // handlers take as long as they take
+        case Connection::State::WRITING:
+            // A streamed body waiting on its producer is not stalled
+            return connection.hasPendingOutput() ? write_stall : recheck;
+        case Connection::State::CLOSING:
+            return connection.hasPendingOutput() ? write_stall : idle;
+        case Connection::State::CLOSED:
+            return now;
+        case Connection::State::READING:
+            break;
+    }
+    
+    if (Http2Session* session = connection.getHttp2()) {
+        if (connection.hasPendingOutput()) {
+            return write_stall;
+        }
+        return session->hasOpenStreams() ? recheck : idle;
+    }
+    
+    if (connection.getFramer().isReadingBody()) {
+        if (min_body_rate_ > 0) {
+            return std::min(idle, connection.getRateMark() + std::chrono::seconds(kBodyRateWindowSeconds));
+        }
+        return idle;
+    }
+    
+    // Between requests the keep-alive timeout applies; a head in progress
+    // (or the first one, from the accept) also has its own deadline
+    if ((connection.getInputBuffer().empty() && connection.getRequestCount() > 0) || header_timeout_seconds_ <= 0) {
+        return idle;
+    }
+    return std::min(idle, connection.getRequestStart() + std::chrono::seconds(header_timeout_seconds_));
+}
+
+void HttpServer::closeConnection(ListenerShard& shard, const std::shared_ptr<Connection>& connection) {
+    if (connection->isClosed()) {
+        return;
+    }
+    
+    int client_socket = connection->getSocket();
+    shard.timers.cancel(connection->getTimer());
+    shard.loop.remove(client_socket);
+    shard.connections.erase(client_socket);
+    connection->close();
+    admission_.release(connection->getRemoteAddress());
+}
+
+void HttpServer::closeAllConnections(ListenerShard& shard) {
+    auto connections = std::move(shard.connections);
+    shard.connections.clear();
+    
+    for (auto& entry : connections) {
+        shard.timers.cancel(entry.second->getTimer());
+        shard.loop.remove(entry.first);
+        entry.second->close();
+        admission_.release(entry.second->getRemoteAddress());
+    }
+}
+
+bool HttpServer::isOverloaded() const {
+    return max_queued_requests_ > 0 && thread_pool_->getQueueSize() >= max_queued_requests_;
+}
+
+void HttpServer::rejectAtAccept(int client_socket) {
+#ifdef ENABLE_SSL
+    // A TLS client cannot read a plaintext answer; just hang up
+    if (!use_ssl_) {
+        send(client_socket, overload_response_.data(), overload_response_.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+#else
+    send(client_socket, overload_response_.data(), overload_response_.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
+    close(client_socket);
+}
+
+void HttpServer::shedRequest(ListenerShard& shard, const std::shared_ptr<Connection>& connection) {
+    // Answered on the loop thread without touching the saturated pool
+    shed_requests_.fetch_add(1);
+    connection->getInputBuffer().clear();
+    connection->getHeadBuffer().assign(overload_response_);
+    HttpResponse response;
+    onResponseReady(shard, connection, response, false);
+}
+
+bool HttpServer::startHttp2(ListenerShard& shard, const std::shared_ptr<Connection>& connection) {
+    // Nothing is written before the client has spoken: until then a TLS
+    // handshake may still be in flight
+    const std::string& input = connection->getInputBuffer();
+    if (input.empty()) {
+        return false;
+    }
+    
+    // ALPN settles it on TLS; otherwise the client preface does
+    bool complete = false;
+    bool preface = startsWithPreface(input, complete);
+    if (connection->getAlpnProtocol() != "h2") {
+        if (!preface) {
+            return false;
+        }
+        if (!complete) {
+            // Could still be the preface; wait for the rest
+            if (connection->isPeerClosed()) {
+                closeConnection(shard, connection);
+            }
+            return true;
+        }
+    }
+    
+    // The session invokes this from within receive(), on the loop thread;
+    // it holds the connection weakly since the connection owns the session
+    std::weak_ptr<Connection> weak_connection = connection;
+    ListenerShard* owner = &shard;
+    connection->enableHttp2(std::make_unique<Http2Session>(
+        max_body_size_, [this, owner, weak_connection](uint32_t stream_id, std::shared_ptr<HttpRequest> request) {
+            if (auto connection = weak_connection.lock()) {
+                dispatchHttp2Request(*owner, connection, stream_id, std::move(request));
+            }
+        }));
+    serviceHttp2(shard, connection);
+    return true;
+}
+
+void HttpServer::serviceHttp2(ListenerShard& shard, const std::shared_ptr<Connection>& connection) {
+    Http2Session* session = connection->getHttp2();
+    bool ok = session->receive(connection->getInputBuffer());
+    if (!is_running_ || draining_) {
+        session->goAway();
+    }
+    
+    flushHttp2(shard, connection);
+    if (!ok) {
+        // The GOAWAY went out with the flush, as far as the socket took it
+        closeConnection(shard, connection);
+    }
+}
+
+void HttpServer::dispatchHttp2Request(ListenerShard& shard, const std::shared_ptr<Connection>& connection,
+                                      uint32_t stream_id, std::shared_ptr<HttpRequest> request) {
+    request->setEarlyData(connection->isHandshaking());
+    
+    bool logged = access_log_.sample();
+    AccessLog::Entry entry;
+    std::chrono::steady_clock::time_point received;
+    if (logged) {
+        entry = makeAccessEntry(*connection, *request);
+        received = std::chrono::steady_clock::now();
+    }
+    
+    // Responses are always handed back through the loop, never submitted
+    // from inside the session's receive()
+    ListenerShard* owner = &shard;
+    auto respond = [this, owner, connection, stream_id](HttpResponse response, std::shared_ptr<BodyStream> stream) {
+        owner->loop.post([this, owner, connection, stream_id, response = std::move(response), stream]() mutable {
+            if (connection->isClosed()) {
+                if (stream) {
+                    stream->abort();
+                }
+                return;
+            }
+            connection->getHttp2()->submitResponse(stream_id, std::move(response), std::move(stream));
+            flushHttp2(*owner, connection);
+        });
+    };
+    
+    if (isOverloaded()) {
+        // A stream is refused, not the connection: the others carry on
+        shed_requests_.fetch_add(1);
+        HttpResponse response = makeOverloadResponse();
+        if (logged) {
+            logAccess(entry, response, received);
+        }
+        respond(std::move(response), nullptr);
+        return;
+    }
+    
+    thread_pool_->enqueue([this, owner, connection, request, respond, logged, entry, received]() mutable {
+        // Outlives this task if the handler is asynchronous
+        auto response = std::make_shared<HttpResponse>();
+        processHttpRequest(*request, *response, [this, owner, connection, request, response, respond, logged, entry,
+                                                 received]() mutable {
+            if (logged) {
+                logAccess(entry, *response, received);
+            }
+            
+            HttpResponse::StreamProducer producer;
+            std::shared_ptr<BodyStream> stream;
+            if (response->isStreaming() && request->getMethod() != HttpRequest::Method::HEAD) {
+                producer = response->getStreamProducer();
+                stream = makeBodyStream(*owner, connection);
+            }
+            respond(std::move(*response), stream);
+            if (producer) {
+                runStreamProducer(producer, stream);
+            }
+        });
+    });
+}
+
+void HttpServer::flushHttp2(ListenerShard& shard, const std::shared_ptr<Connection>& connection) {
+    Http2Session* session = connection->getHttp2();
+    
+    // Finish the batch the socket last refused, then refill the head buffer
+    // only once the socket has taken it
+    if (connection->hasPendingOutput() && !connection->flushOutput()) {
+        closeConnection(shard, connection);
+        return;
+    }
+    while (!connection->hasPendingOutput() && session->hasOutput()) {
+        session->takeOutput(connection->getHeadBuffer(), kHttp2WriteChunk);
+        if (!connection->flushOutput()) {
+            closeConnection(shard, connection);
+            return;
+        }
+    }
+    
+    if (!connection->hasPendingOutput() &&
+        (session->isFinished() || (connection->isPeerClosed() && !session->hasOpenStreams()))) {
+        closeConnection(shard, connection);
+        return;
+    }
+    armTimeout(shard, *connection);
+}
+
+AccessLog::Entry HttpServer::makeAccessEntry(const Connection& connection, const HttpRequest& request) const {
+    // Views into the request and the connection, both kept alive by the
+    // task that serves the request
+    AccessLog::Entry entry;
+    entry.method = request.getMethod();
+    entry.path = request.getPath();
+    entry.version = request.getVersion();
+    entry.client_address = connection.getRemoteAddress();
+    entry.tls = connection.isTls();
+    entry.tls_resumed = connection.isTlsResumed();
+    return entry;
+}
+
+void HttpServer::logAccess(AccessLog::Entry& entry, const HttpResponse& response,
+                           std::chrono::steady_clock::time_point received) const {
+    auto latency = std::chrono::steady_clock::now() - received;
+    entry.status = static_cast<int>(response.getStatusCode());
+    entry.bytes = response.getBodySize();
+    entry.latency_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    access_log_.write(entry);
+}
+
+void HttpServer::buildResponse(const HttpRequest& request, HttpResponse& response, bool& keep_alive,
+                               std::string& head) {
+    keep_alive = request.isValid() && wantsKeepAlive(request) && is_running_ && !draining_;
+    
+    // A streamed body's length is unknown up front: chunked on HTTP/1.1, and
+    // an HTTP/1.0 client reads until the connection closes
+    if (response.isStreaming()) {
+        if (request.getVersion() == "HTTP/1.1") {
+            response.setHeader("Transfer-Encoding", "chunked");
+        } else {
+            keep_alive = false;
+        }
+    }
+    
+    if (keep_alive) {
+        response.setHeader("Connection", "keep-alive");
+        response.setHeader("Keep-Alive", "timeout=" + std::to_string(timeout_seconds_));
+    } else {
+        response.setHeader("Connection", "close");
+    }
+    
+    response.serializeHeadTo(head);
+}
+#endif
+
+void HttpServer::processHttpRequest(HttpRequest& request, HttpResponse& response, Task then) {
+    // Requests no route or static path took (a middleware answered, or
+    // nothing matched) count as unmatched
+    metrics::LatencyHistogram* latency = &unmatched_latency_;
+    // Timed around the whole stage: middlewares, error handler, an
+    // asynchronous handler's wait and compression included
+    std::chrono::steady_clock::time_point started;
+    if (metrics_enabled_) {
+        started = std::chrono::steady_clock::now();
+    }
+    
+    const Route* async_route = nullptr;
+    runGuarded(response, [&]() { async_route = routeRequest(request, response, latency); });
+    if (async_route) {
+        runAsyncHandler(*async_route, request, response, latency, started, std::move(then));
+        return;
+    }
+    finishResponse(request, response, latency, started);
+    then();
+}
+
+void HttpServer::runAsyncHandler(const Route& route, HttpRequest& request, HttpResponse& response,
+                                 metrics::LatencyHistogram* latency, std::chrono::steady_clock::time_point started,
+                                 Task then) {
+    ResponseCompletion done(response, [this, &request, &response, latency, started, then = std::move(then)]() mutable {
+        Task rest = [this, &request, &response, latency, started, then = std::move(then)]() mutable {
+            finishResponse(request, response, latency, started);
+            then();
+        };
+#ifndef BUILD_WASM
+        // Back on a worker: compression and the hand-off to the loop stay off
+        // whichever thread completed the handler
+        thread_pool_->enqueue(std::move(rest));
+#else
+        rest();
+#endif
+    });
+    
+#if defined(__cpp_exceptions)
+    try {
+        route.async_handler(request, response, done);
+    } catch (const std::exception& e) {
+        // Answered by the error handler unless the handler completed first
+        if (done.claim()) {
+            runGuarded(response, [&]() { error_handler_(e, request, response); });
+            done.finish();
+        }
+    }
+#else
+    route.async_handler(request, response, done);
+#endif
+}
+
+void HttpServer::finishResponse(const HttpRequest& request, HttpResponse& response,
+                                metrics::LatencyHistogram* latency, std::chrono::steady_clock::time_point started) {
+    runGuarded(response, [&]() { compressResponse(request, response); });
+    if (!metrics_enabled_) {
+        return;
+    }
+    
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    if (latency) {
+        latency->record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+    }
+    size_t status_class = static_cast<size_t>(response.getStatusCode()) / 100;
+    if (status_class >= 1 && status_class <= responses_by_class_.size()) {
+        responses_by_class_[status_class - 1].add();
+    }
+}
+
+const HttpServer::Route* HttpServer::routeRequest(HttpRequest& request, HttpResponse& response,
+                                                  metrics::LatencyHistogram*& latency) {
+#if defined(__cpp_exceptions)
+    try {
+        return dispatchRoute(request, response, latency);
+    } catch (const std::exception& e) {
+        error_handler_(e, request, response);
+    }
+    return nullptr;
+#else
+    // Built with -fno-exceptions (the exception-free WASM profile): a throw
+    // aborts, so there is nothing for the error handler to catch
+    return dispatchRoute(request, response, latency);
+#endif
+}
+
+const HttpServer::Route* HttpServer::dispatchRoute(HttpRequest& request, HttpResponse& response,
+                                                   metrics::LatencyHistogram*& latency) {
+    // Run middlewares
+    if (!runMiddlewares(request, response)) {
+        return nullptr;
+    }
+    
+    // Check static files first
+    for (const auto& static_path : static_paths_) {
+        if (request.getPath().find(static_path.first) == 0) {
+            std::string file_path = static_path.second + request.getPath().substr(static_path.first.length());
+            latency = &static_latency_;
+            handleStaticFile(request, file_path, response);
+            return nullptr;
+        }
+    }
+    
+    // Find matching route; captures are views into the request path
+    Router::Match match;
+    if (router_.find(request.getMethod(), request.getPath(), match)) {
+        const Route& route = routes_[static_cast<size_t>(match.value)];
+        latency = route.latency.get();
+        if (request.isEarlyData() && !route.allow_early_data) {
+            // RFC 8470: the client resends once the handshake is done
+            response.setStatusCode(HttpResponse::StatusCode::TOO_EARLY);
+            response.setTextContent(response.getStatusText());
+            return nullptr;
+        }
+        request.setRouteParams(match.params, match.param_count);
+        if (route.async_handler) {
+            return &route;
+        }
+        if (route.cache) {
+            serveCached(route, request, response);
+        } else {
+            route.handler(request, response);
+        }
+    } else {
+        not_found_handler_(request, response);
+    }
+    return nullptr;
+}
+
+void HttpServer::serveCached(const Route& route, const HttpRequest& request, HttpResponse& response) {
+    // Everything the response may vary with; fields are NUL-separated
+    std::string key(HttpRequest::methodName(route.method));
+    key.append(1, ' ').append(request.getPath());
+    for (const auto& name : route.cache->query_params) {
+        key.append(1, '\0').append(name).append(1, '=').append(request.getQueryParam(name));
+    }
+    for (const auto& name : route.cache->headers) {
+        key.append(1, '\0').append(name).append(1, ':').append(request.getHeaders().get(name));
+    }
+    if (compression_enabled_) {
+        // Stored compressed, so one entry per coding
+        compression::Encoding encoding = compression::negotiate(request.getHeaders().get(HeaderId::ACCEPT_ENCODING));
+        key.append(1, '\0').append(compression::name(encoding));
+    }
+    
+    response_cache_.fetch(key, route.cache->ttl, [&](HttpResponse& fresh) {
+        route.handler(request, fresh);
+        compressResponse(request, fresh);
+    }, response);
+}
+
+bool HttpServer::runMiddlewares(const HttpRequest& request, HttpResponse& response) {
     for (const auto& middleware : middlewares_) {
         if (!middleware(request, response)) {
             return false;
@@ -355,37 +1612,138 @@ bool HttpServer::runMiddlewares(const HttpRequest& request, HttpResponse& respon
     return true;
 }
 
-bool HttpServer::matchRoute(const std::string& pattern, const std::string& path) const {
-    if (pattern == path) {
-        return true;
+void HttpServer::compressResponse(const HttpRequest& request, HttpResponse& response) {
+    if (!compression_enabled_ || response.getSharedBody()) {
+        return;
     }
     
-    // Simple wildcard matching
-    if (pattern.find('*') != std::string::npos) {
-        std::string regex_pattern = pattern;
-        std::replace(regex_pattern.begin(), regex_pattern.end(), '*', '.');
-        regex_pattern += "*";
-        
-        try {
-            std::regex regex(regex_pattern);
-            return std::regex_match(path, regex);
-        } catch (const std::exception&) {
-            return false;
+    // A streamed body's size is unknown, so the minimum does not apply
+    const HeaderMap& headers = response.getHeaders();
+    int status = static_cast<int>(response.getStatusCode());
+    size_t size = response.getBodySize();
+    bool streaming = response.isStreaming();
+    if (status < 200 || status == 204 || status == 304 || (!streaming && size < compress_min_size_) ||
+        headers.contains("Content-Encoding") || !compression::isCompressibleType(headers.get(HeaderId::CONTENT_TYPE))) {
+        return;
+    }
+    
+    // From here on the body sent depends on Accept-Encoding
+    std::string_view vary = headers.get(HeaderId::VARY);
+    if (vary.empty()) {
+        response.setHeader("Vary", "Accept-Encoding");
+    } else if (!string_util::hasToken(vary, "Accept-Encoding")) {
+        response.setHeader("Vary", std::string(vary) + ", Accept-Encoding");
+    }
+    
+    compression::Encoding encoding = compression::negotiate(request.getHeaders().get(HeaderId::ACCEPT_ENCODING));
+    std::shared_ptr<const std::string> shared;
+    std::string compressed;
+    if (streaming) {
+        if (encoding == compression::Encoding::IDENTITY) {
+            return;
+        }
+        // The stream compresses what the connection takes, one flushed
+        // batch at a time; set up before the producer writes anything
+        response.setStreamingBody(
+            [producer = response.getStreamProducer(), encoding](const std::shared_ptr<BodyStream>& stream) {
+                if (!stream->encode(encoding)) {
+                    stream->fail();
+                    return;
+                }
+                producer(stream);
+            });
+    } else if (const std::shared_ptr<const CachedFile>& file = response.getFileBody()) {
+        // Compressed once per file and coding, then shared like an asset
+        shared = compressed_files_.get(file, encoding);
+        if (!shared) {
+            return;
+        }
+    } else {
+        compression::Compressor* compressor = compression::Compressor::forThread(encoding);
+        if (!compressor || !compressor->begin() || !compressor->update(response.getBody(), compressed) ||
+            !compressor->finish(compressed) || compressed.size() >= size) {
+            return;
         }
     }
     
-    return false;
+    response.setHeader("Content-Encoding", compression::name(encoding));
+    // The encoded bytes differ, so a strong validator no longer holds
+    std::string_view etag = headers.get(HeaderId::ETAG);
+    if (!etag.empty() && etag.substr(0, 2) != "W/") {
+        response.setHeader("ETag", "W/" + std::string(etag));
+    }
+    if (shared) {
+        response.setSharedBody(std::move(shared));
+    } else if (!streaming) {
+        response.setBody(std::move(compressed));
+    }
 }
 
-void HttpServer::handleStaticFile(const std::string& file_path, HttpResponse& response) {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file.is_open()) {
+void HttpServer::handleStaticFile(const HttpRequest& request, const std::string& file_path, HttpResponse& response) {
+    // One cached open+stat serves both the existence check and the body
+    std::shared_ptr<const CachedFile> file = file_cache_.open(file_path);
+    if (!file) {
         response.setStatusCode(HttpResponse::StatusCode::NOT_FOUND);
         response.setTextContent("File not found");
         return;
     }
     
-    response.setFileContent(file_path);
+    const HeaderMap& headers = request.getHeaders();
+    std::string_view if_none_match = headers.get(HeaderId::IF_NONE_MATCH);
+    std::string_view if_modified_since = headers.get(HeaderId::IF_MODIFIED_SINCE);
+    
+    std::shared_ptr<const Asset> asset = asset_cache_.get(file);
+    if (!asset) {
+        // Too large to keep in memory: validators come from the file's
+        // metadata and the body is sent from disk
+        time_t modified_time = static_cast<time_t>(file->getModifiedTimeNs() / 1000000000);
+        char tag[48];
+        std::snprintf(tag, sizeof(tag), "\"%zx-%llx\"", file->getSize(),
+                      static_cast<unsigned long long>(file->getModifiedTimeNs()));
+        response.setHeader("ETag", tag);
+        response.setHeader("Last-Modified", http_date::format(modified_time));
+        if (isNotModified(if_none_match, if_modified_since, modified_time,
+                          [&](std::string_view header) { return etagMatches(header, tag); })) {
+            response.setStatusCode(HttpResponse::StatusCode::NOT_MODIFIED);
+            return;
+        }
+        response.setFileContent(std::move(file));
+        return;
+    }
+    
+    compression::Encoding encoding = asset->selectEncoding(headers.get(HeaderId::ACCEPT_ENCODING));
+    const Asset::Variant& variant = asset->variant(encoding);
+    
+    response.setHeader("ETag", variant.etag);
+    response.setHeader("Last-Modified", asset->last_modified);
+    if (asset->hasCompressedVariants()) {
+        response.setHeader("Vary", "Accept-Encoding");
+    }
+    
+    if (isNotModified(if_none_match, if_modified_since, asset->modified_time,
+                      [&](std::string_view header) { return asset->matchesEtag(header); })) {
+        response.setStatusCode(HttpResponse::StatusCode::NOT_MODIFIED);
+        return;
+    }
+    
+    response.setHeader("Content-Type", asset->content_type);
+    if (encoding != compression::Encoding::IDENTITY) {
+        response.setHeader("Content-Encoding", compression::name(encoding));
+    }
+    response.setSharedBody(variant.body);
+}
+
+HttpResponse HttpServer::makeOverloadResponse() const {
+    HttpResponse response(HttpResponse::StatusCode::SERVICE_UNAVAILABLE);
+    response.setHeader("Retry-After", std::to_string(retry_after_seconds_));
+    response.setTextContent(response.getStatusText());
+    return response;
+}
+
+void HttpServer::buildOverloadResponse() {
+    HttpResponse response = makeOverloadResponse();
+    response.setHeader("Connection", "close");
+    overload_response_ = response.toString();
 }
 
 void HttpServer::defaultNotFoundHandler(const HttpRequest& request, HttpResponse& response) {
@@ -394,7 +1752,7 @@ void HttpServer::defaultNotFoundHandler(const HttpRequest& request, HttpResponse
 }
 
 void HttpServer::defaultErrorHandler(const std::exception& e, const HttpRequest& request, HttpResponse& response) {
-    LOG_ERROR("Error processing request " + request.getPath() + ": " + e.what());
+    LOG_ERROR("Error processing request ", request.getPath(), ": ", e.what());
     response.setStatusCode(HttpResponse::StatusCode::INTERNAL_SERVER_ERROR);
     response.setTextContent("Internal Server Error");
 }
@@ -1,41 +1,139 @@
 #include "logger.h"
-#include <iostream>
-#include <iomanip>
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
-#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// "[YYYY-MM-DD HH:MM:SS.mmm] [WARNING] " at its longest
+constexpr size_t kMaxPrefixSize = 40;
+// How long written lines may sit in the rings before the flusher runs
+constexpr auto kFlushInterval = std::chrono::milliseconds(20);
+// Batches are written out once they reach this size
+constexpr size_t kBatchSize = 64 * 1024;
+
+// Keeps the calling thread's buffer registered; marks it for collection
+// when the thread exits
+struct ThreadBufferHandle {
+    std::shared_ptr<void> buffer;
+    std::atomic<bool>* orphaned = nullptr;
+
+    ~ThreadBufferHandle() {
+        if (orphaned) {
+            orphaned->store(true, std::memory_order_release);
+        }
+    }
+};
+
+void writeAll(int fd, const char* data, size_t size) {
+    size_t written = 0;
+    while (fd >= 0 && written < size) {
+        ssize_t result = ::write(fd, data + written, size - written);
+        if (result > 0) {
+            written += static_cast<size_t>(result);
+        } else if (result < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break; // the output is gone; nothing better to do with the data
+        }
+    }
+}
+
+} // namespace
+
+void LogLine::putDouble(double value) {
+    char digits[32];
+    int length = std::snprintf(digits, sizeof(digits), "%g", value);
+    if (length > 0) {
+        putText(std::string_view(digits, std::min(static_cast<size_t>(length), sizeof(digits) - 1)));
+    }
+}
 
 Logger& Logger::getInstance() {
     static Logger instance;
     return instance;
 }
 
+Logger::Logger()
+    : current_level_(Level::INFO), console_output_(true), overflow_policy_(OverflowPolicy::DROP),
+      thread_buffer_size_(kDefaultThreadBufferSize), dropped_(0), reported_dropped_(0), file_fd_(-1), access_fd_(-1),
+      flush_requests_(0), flushes_completed_(0), stopping_(false) {
+#ifndef BUILD_WASM
+    flusher_ = std::thread([this]() { runFlusher(); });
+#endif
+}
+
+Logger::~Logger() {
+#ifndef BUILD_WASM
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        stopping_ = true;
+    }
+    flush_wake_.notify_one();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+#endif
+    if (file_fd_ >= 0) {
+        ::close(file_fd_);
+    }
+    if (access_fd_ >= 0) {
+        ::close(access_fd_);
+    }
+}
+
 void Logger::setLevel(Level level) {
-    std::lock_guard<std::mutex> lock(log_mutex_);
-    current_level_ = level;
+    current_level_.store(level, std::memory_order_relaxed);
 }
 
 void Logger::setOutputFile(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(log_mutex_);
-    file_stream_ = std::make_unique<std::ofstream>(filename, std::ios::app);
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+
+    // Lines already buffered go to the new file
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if (file_fd_ >= 0) {
+        ::close(file_fd_);
+    }
+    file_fd_ = fd;
+}
+
+void Logger::setAccessLogFile(const std::string& filename) {
+    int fd = -1;
+    if (!filename.empty()) {
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if (access_fd_ >= 0) {
+        ::close(access_fd_);
+    }
+    access_fd_ = fd;
 }
 
 void Logger::enableConsoleOutput(bool enable) {
-    std::lock_guard<std::mutex> lock(log_mutex_);
-    console_output_ = enable;
+    console_output_.store(enable, std::memory_order_relaxed);
+}
+
+void Logger::setOverflowPolicy(OverflowPolicy policy) {
+    overflow_policy_.store(policy, std::memory_order_relaxed);
+}
+
+void Logger::setThreadBufferSize(size_t bytes) {
+    thread_buffer_size_.store(bytes, std::memory_order_relaxed);
 }
 
 void Logger::log(Level level, const std::string& message) {
-    if (level < current_level_) {
-        return;
-    }
-    
-    std::string timestamp = getCurrentTimestamp();
-    std::string level_str = levelToString(level);
-    
-    std::ostringstream formatted;
-    formatted << "[" << timestamp << "] [" << level_str << "] " << message;
-    
-    writeLog(formatted.str());
+    write(level, std::string_view(message));
 }
 
 void Logger::debug(const std::string& message) {
@@ -58,7 +156,19 @@ void Logger::fatal(const std::string& message) {
     log(Level::FATAL, message);
 }
 
-std::string Logger::levelToString(Level level) const {
+void Logger::flush() {
+#ifndef BUILD_WASM
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    if (stopping_) {
+        return;
+    }
+    uint64_t ticket = ++flush_requests_;
+    flush_wake_.notify_one();
+    flush_done_.wait(lock, [&]() { return flushes_completed_ >= ticket || stopping_; });
+#endif
+}
+
+const char* Logger::levelToString(Level level) {
     switch (level) {
         case Level::DEBUG:   return "DEBUG";
         case Level::INFO:    return "INFO";
@@ -69,28 +179,224 @@ std::string Logger::levelToString(Level level) const {
     }
 }
 
-std::string Logger::getCurrentTimestamp() const {
+Logger::ThreadBuffer& Logger::threadBuffer() {
+    thread_local ThreadBufferHandle handle;
+    if (!handle.buffer) {
+        auto buffer = std::make_shared<ThreadBuffer>(thread_buffer_size_.load(std::memory_order_relaxed));
+        {
+            std::lock_guard<std::mutex> lock(buffers_mutex_);
+            buffers_.push_back(buffer);
+        }
+        handle.orphaned = &buffer->orphaned;
+        handle.buffer = std::move(buffer);
+    }
+    return *static_cast<ThreadBuffer*>(handle.buffer.get());
+}
+
+char* Logger::reserveLine(ThreadBuffer& buffer, size_t size) {
+    char* out = buffer.ring.reserve(size);
+#ifndef BUILD_WASM
+    if (!out && overflow_policy_.load(std::memory_order_relaxed) == OverflowPolicy::BLOCK) {
+        // Backpressure: hold this thread until the flusher frees room
+        while (!out && flusher_.joinable()) {
+            wakeFlusher();
+            std::this_thread::yield();
+            out = buffer.ring.reserve(size);
+        }
+    }
+#endif
+    if (!out) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return out;
+}
+
+size_t Logger::writePrefix(ThreadBuffer& buffer, Level level, char* out) {
     auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()) % 1000;
-    
-    std::ostringstream oss;
-    oss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    oss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-    
-    return oss.str();
-}
-
-void Logger::writeLog(const std::string& formatted_message) {
-    std::lock_guard<std::mutex> lock(log_mutex_);
-    
-    if (console_output_) {
-        std::cout << formatted_message << std::endl;
-    }
-    
-    if (file_stream_ && file_stream_->is_open()) {
-        *file_stream_ << formatted_message << std::endl;
-        file_stream_->flush();
+    auto since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
+    time_t second = static_cast<time_t>(since_epoch.count() / 1000);
+    int millisecond = static_cast<int>(since_epoch.count() % 1000);
+
+    // Calendar conversion once per second per thread; localtime_r is the
+    // thread-safe form
+    if (second != buffer.second) {
+        struct tm local;
+        localtime_r(&second, &local);
+        std::strftime(buffer.timestamp, sizeof(buffer.timestamp), "%Y-%m-%d %H:%M:%S", &local);
+        buffer.second = second;
+    }
+
+    size_t used = 0;
+    out[used++] = '[';
+    std::memcpy(out + used, buffer.timestamp, 19);
+    used += 19;
+    out[used++] = '.';
+    out[used++] = static_cast<char>('0' + millisecond / 100);
+    out[used++] = static_cast<char>('0' + millisecond / 10 % 10);
+    out[used++] = static_cast<char>('0' + millisecond % 10);
+    std::memcpy(out + used, "] [", 3);
+    used += 3;
+    const char* name = levelToString(level);
+    size_t name_length = std::strlen(name);
+    std::memcpy(out + used, name, name_length);
+    used += name_length;
+    std::memcpy(out + used, "] ", 2);
+    return used + 2;
+}
+
+bool Logger::beginLine(Level level, size_t message_size, LogLine& line) {
+    ThreadBuffer& buffer = threadBuffer();
+    size_t limit = std::min(message_size, buffer.ring.maxRecordSize() - kMaxPrefixSize - 2);
+    char* out = reserveLine(buffer, kMaxPrefixSize + limit + 2);
+    if (!out) {
+        return false;
+    }
+
+    out[0] = static_cast<char>(Channel::LOG);
+    size_t used = 1 + writePrefix(buffer, level, out + 1);
+    line = LogLine(out, used, used + limit);
+    return true;
+}
+
+void Logger::endLine(Level level, LogLine& line) {
+    // beginLine kept a byte past the limit for the newline
+    char* out = line.data();
+    size_t used = line.size();
+    out[used++] = '\n';
+
+#ifdef BUILD_WASM
+    // No flusher thread: the reserved space is only scratch for the line
+    (void)level;
+    writeOutput(out + 1, used - 1);
+#else
+    threadBuffer().ring.commit(used);
+    if (level == Level::FATAL) {
+        flush();
+    }
+#endif
+}
+
+char* Logger::reserveAccessRecord(size_t size) {
+    char* out = reserveLine(threadBuffer(), size + 1);
+    if (!out) {
+        return nullptr;
+    }
+    out[0] = static_cast<char>(Channel::ACCESS);
+    return out + 1;
+}
+
+void Logger::commitAccessRecord(char* out, size_t used) {
+#ifdef BUILD_WASM
+    writeAccess(out, used);
+#else
+    (void)out;
+    threadBuffer().ring.commit(used + 1);
+#endif
+}
+
+void Logger::wakeFlusher() {
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        ++flush_requests_;
+    }
+    flush_wake_.notify_one();
+}
+
+void Logger::runFlusher() {
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    while (true) {
+        flush_wake_.wait_for(lock, kFlushInterval,
+                             [this]() { return stopping_ || flush_requests_ > flushes_completed_; });
+        uint64_t target = flush_requests_;
+        bool stopping = stopping_;
+
+        lock.unlock();
+        drainBuffers();
+        lock.lock();
+
+        flushes_completed_ = target;
+        flush_done_.notify_all();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void Logger::drainBuffers() {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers = buffers_;
+    }
+
+    auto append = [this](const char* data, size_t size) {
+        batch_.append(data, size);
+        if (batch_.size() >= kBatchSize) {
+            writeOutput(batch_.data(), batch_.size());
+            batch_.clear();
+        }
+    };
+    auto route = [&](const char* data, size_t size) {
+        if (static_cast<Channel>(data[0]) == Channel::LOG) {
+            append(data + 1, size - 1);
+            return;
+        }
+        access_batch_.append(data + 1, size - 1);
+        if (access_batch_.size() >= kBatchSize) {
+            writeAccess(access_batch_.data(), access_batch_.size());
+            access_batch_.clear();
+        }
+    };
+
+    bool collected = false;
+    for (const auto& buffer : buffers) {
+        // Read the flag first: a thread that has exited has no more lines
+        bool orphaned = buffer->orphaned.load(std::memory_order_acquire);
+        buffer->ring.drain(route);
+        collected = collected || orphaned;
+    }
+
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped > reported_dropped_) {
+        std::string notice = "[logger] [WARNING] " + std::to_string(dropped - reported_dropped_) +
+                             " log lines dropped: buffers full\n";
+        append(notice.data(), notice.size());
+        reported_dropped_ = dropped;
+    }
+
+    if (!batch_.empty()) {
+        writeOutput(batch_.data(), batch_.size());
+        batch_.clear();
+    }
+    if (!access_batch_.empty()) {
+        writeAccess(access_batch_.data(), access_batch_.size());
+        access_batch_.clear();
+    }
+
+    if (collected) {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(),
+                                      [](const std::shared_ptr<ThreadBuffer>& buffer) {
+                                          return buffer->orphaned.load(std::memory_order_acquire) &&
+                                                 buffer->ring.empty();
+                                      }),
+                       buffers_.end());
+    }
+}
+
+void Logger::writeOutput(const char* data, size_t size) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    writeAll(console_output_.load(std::memory_order_relaxed) ? STDOUT_FILENO : -1, data, size);
+    writeAll(file_fd_, data, size);
+}
+
+void Logger::writeAccess(const char* data, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(output_mutex_);
+        if (access_fd_ >= 0) {
+            writeAll(access_fd_, data, size);
+            return;
+        }
     }
+    writeOutput(data, size);
 }
@@ -4,12 +4,71 @@
 #include <csignal>
 #include <memory>
 
+#ifndef BUILD_WASM
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
 #ifdef BUILD_WASM
 #include <emscripten.h>
+#include <cstdint>
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <emscripten/threading.h>
+#include <climits>
+#include <vector>
+#include "request_ring.h"
+#endif
 
 // Global server instance for WebAssembly
 std::unique_ptr<HttpServer> g_server;
 
+namespace {
+// A response that did not fit the caller's buffer, held for take_response();
+// per thread, so concurrent callers on different workers never share it
+thread_local std::string t_held_response;
+
+// Answer one request into `out`; the size needed is returned either way
+uint32_t answerInto(const char* request, uint32_t request_length, char* out, uint32_t out_capacity) {
+    HttpResponse response;
+    if (g_server) {
+        g_server->handleRequest(std::string_view(request, request_length), response);
+    } else {
+        response.setStatusCode(HttpResponse::StatusCode::SERVICE_UNAVAILABLE);
+        response.setTextContent("Server not initialized");
+    }
+    
+    size_t size = response.getSerializedSize();
+    if (size <= out_capacity && response.serializeTo(out)) {
+        return static_cast<uint32_t>(size);
+    }
+    t_held_response.clear();
+    response.serializeTo(t_held_response);
+    return static_cast<uint32_t>(t_held_response.size());
+}
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+// Worker mode: pthreads sharing g_server's routes, fed by submit_request()
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "completion_counter() is read as an Int32Array slot");
+std::unique_ptr<RequestRing> g_ring;
+// What the last poll_responses() handed out, kept alive until the next
+std::vector<RequestRing::Response> g_polled;
+#endif
+}
+
 extern "C" {
     EMSCRIPTEN_KEEPALIVE
     void start_server() {
@@ -36,16 +95,135 @@ extern "C" {
         }
     }
     
+    // NUL-terminated in and out; the result is valid until this thread's
+    // next call. Kept for existing embedders, handle_request_into() avoids
+    // the string round trips.
     EMSCRIPTEN_KEEPALIVE
     const char* handle_request(const char* raw_request) {
         if (!g_server) {
             return "Server not initialized";
         }
         
-        static std::string response_buffer;
+        thread_local std::string response_buffer;
         g_server->handleRequest(std::string(raw_request), response_buffer);
         return response_buffer.c_str();
     }
+    
+    // Caller-owned buffers in linear memory: the request is parsed where it
+    // lies and the response serialized straight into `out`. Returns the
+    // response's size; when that exceeds `out_capacity` nothing is written
+    // and the response is held for take_response().
+    EMSCRIPTEN_KEEPALIVE
+    uint32_t handle_request_into(const char* request, uint32_t request_length, char* out, uint32_t out_capacity) {
+        t_held_response.clear();
+        return answerInto(request, request_length, out, out_capacity);
+    }
+    
+    // Copy out the held response; returns its size, and keeps holding it if
+    // `out_capacity` is still too small
+    EMSCRIPTEN_KEEPALIVE
+    uint32_t take_response(char* out, uint32_t out_capacity) {
+        uint32_t size = static_cast<uint32_t>(t_held_response.size());
+        if (size <= out_capacity) {
+            t_held_response.copy(out, size);
+            std::string().swap(t_held_response);
+        }
+        return size;
+    }
+    
+    // `count` requests per call, to pay for one JS->WASM transition instead
+    // of one each. Requests lie back to back in `requests`, their sizes in
+    // `request_lengths`; responses are packed into `out` the same way, their
+    // sizes in `response_lengths`. Returns how many responses were written.
+    // If that is short of `count`, response_lengths[result] is the size of
+    // the one that did not fit: it is held for take_response(), and the
+    // caller resumes with the request after it.
+    EMSCRIPTEN_KEEPALIVE
+    uint32_t handle_request_batch(const char* requests, const uint32_t* request_lengths, uint32_t count, char* out,
+                                  uint32_t out_capacity, uint32_t* response_lengths) {
+        t_held_response.clear();
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t size = answerInto(requests, request_lengths[i], out + used, out_capacity - used);
+            response_lengths[i] = size;
+            if (!t_held_response.empty()) {
+                return i;
+            }
+            requests += request_lengths[i];
+            used += size;
+        }
+        return count;
+    }
+    
+#ifdef __EMSCRIPTEN_PTHREADS__
+    // Start `count` workers answering submitted requests in parallel; routes
+    // must all be registered first. Returns the number running.
+    EMSCRIPTEN_KEEPALIVE
+    uint32_t start_workers(uint32_t count) {
+        if (!g_server) {
+            return 0;
+        }
+        if (!g_ring) {
+            g_ring = std::make_unique<RequestRing>(
+                [](std::string_view request, std::string& out) {
+                    HttpResponse response;
+                    g_server->handleRequest(request, response);
+                    response.serializeTo(out);
+                },
+                RequestRing::kDefaultCapacity,
+                []() {
+                    // Wakes a JS thread in Atomics.wait/waitAsync on completion_counter()
+                    emscripten_futex_wake(const_cast<std::atomic<int32_t>*>(&g_ring->getCompletionCount()), INT_MAX);
+                });
+        }
+        g_ring->start(count);
+        return static_cast<uint32_t>(g_ring->getWorkerCount());
+    }
+    
+    // Queued requests are answered before this returns
+    EMSCRIPTEN_KEEPALIVE
+    void stop_workers() {
+        if (g_ring) {
+            g_ring->stop();
+        }
+    }
+    
+    // Hand a request to the workers without waiting for it. Its bytes are
+    // parsed where they lie, so they must stay put until its response has
+    // been polled. Returns 0 when the ring is full (or no workers were
+    // started): poll, then submit again.
+    EMSCRIPTEN_KEEPALIVE
+    int submit_request(const char* request, uint32_t request_length, uint32_t tag) {
+        return g_ring && g_ring->getWorkerCount() > 0 && g_ring->submit(tag, request, request_length) ? 1 : 0;
+    }
+    
+    // Up to `max` finished responses as (tag, pointer, size) triples in
+    // `records`; returns how many. The bytes stay valid until the next call.
+    EMSCRIPTEN_KEEPALIVE
+    uint32_t poll_responses(uint32_t* records, uint32_t max) {
+        g_polled.clear();
+        RequestRing::Response response;
+        while (g_ring && g_polled.size() < max && g_ring->poll(response)) {
+            g_polled.push_back(std::move(response));
+        }
+        for (size_t i = 0; i < g_polled.size(); ++i) {
+            records[i * 3] = g_polled[i].tag;
+            records[i * 3 + 1] = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(g_polled[i].data.data()));
+            records[i * 3 + 2] = static_cast<uint32_t>(g_polled[i].data.size());
+        }
+        return static_cast<uint32_t>(g_polled.size());
+    }
+    
+    // Address of a 32-bit counter bumped after every response, to wait on
+    // with Atomics.wait/waitAsync instead of polling
+    EMSCRIPTEN_KEEPALIVE
+    const int32_t* completion_counter() {
+        if (!g_ring) {
+            return nullptr;
+        }
+        return reinterpret_cast<const int32_t*>(&g_ring->getCompletionCount());
+    }
+#endif
 }
 
 int main() {
@@ -58,20 +236,149 @@ int main() {
 // Global server instance for signal handling
 std::unique_ptr<HttpServer> g_server;
 
-void signalHandler(int signal) {
-    if (signal == SIGINT || signal == SIGTERM) {
-        std::cout << "\nShutting down server..." << std::endl;
-        if (g_server) {
-            g_server->stop();
+namespace {
+
+// Set in a successor's environment: its end of the channel the listening
+// sockets arrive on, and the acknowledgement goes back over
+constexpr const char* kHandoffVariable = "HTTPSERVER_HANDOFF_FD";
+// How long a successor gets to take the listeners over
+constexpr int kHandoffTimeoutMs = 30000;
+
+char** g_argv = nullptr;
+int g_drain_seconds = 30;
+std::atomic<bool> g_exiting(false);
+
+// Hot restart: start whatever binary is now at argv[0] with the same
+// arguments, hand it the listening sockets and drain once it confirms it
+// has them. The kernel keeps queueing connections on the sockets
+// throughout, so none are refused. If the successor fails, this process
+// keeps serving.
+void hotRestart() {
+    std::vector<int> listeners = g_server->getListenerSockets();
+    if (listeners.empty() || g_server->isDraining()) {
+        return;
+    }
+    
+    // Only the successor's end survives the exec
+    int channel[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, channel) < 0) {
+        LOG_ERROR("Hot restart: socketpair failed: ", std::strerror(errno));
+        return;
+    }
+    fcntl(channel[0], F_SETFD, FD_CLOEXEC);
+    
+    std::string prefix = std::string(kHandoffVariable) + "=";
+    std::vector<std::string> variables;
+    for (char** variable = environ; *variable; ++variable) {
+        if (std::strncmp(*variable, prefix.c_str(), prefix.size()) != 0) {
+            variables.emplace_back(*variable);
         }
-        exit(0);
     }
+    variables.push_back(prefix + std::to_string(channel[1]));
+    std::vector<char*> envp;
+    for (auto& variable : variables) {
+        envp.push_back(&variable[0]);
+    }
+    envp.push_back(nullptr);
+    
+    // It starts with no signals blocked, whatever it then does with them
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t unblocked;
+    sigemptyset(&unblocked);
+    posix_spawnattr_setsigmask(&attributes, &unblocked);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK);
+    
+    pid_t successor;
+    int spawned = posix_spawnp(&successor, g_argv[0], nullptr, &attributes, g_argv, envp.data());
+    posix_spawnattr_destroy(&attributes);
+    close(channel[1]);
+    if (spawned != 0) {
+        LOG_ERROR("Hot restart: cannot start ", g_argv[0], ": ", std::strerror(spawned));
+        close(channel[0]);
+        return;
+    }
+    
+    // The successor writes a byte once it is about to serve the sockets
+    bool taken_over = SocketServer::sendSockets(channel[0], listeners);
+    if (taken_over) {
+        struct pollfd ready = {channel[0], POLLIN, 0};
+        char byte;
+        taken_over = poll(&ready, 1, kHandoffTimeoutMs) == 1 && read(channel[0], &byte, 1) == 1;
+    }
+    close(channel[0]);
+    
+    if (!taken_over) {
+        LOG_ERROR("Hot restart: process ", successor, " did not take over; still serving");
+        kill(successor, SIGTERM);
+        return;
+    }
+    LOG_INFO("Hot restart: listeners handed to process ", successor);
+    g_server->drain(g_drain_seconds);
 }
 
+// Signals are blocked everywhere and taken here synchronously, so handling
+// one may log, spawn and call into the server like any other code.
+// SIGINT/SIGTERM drain (a second one stops at once), SIGHUP/SIGUSR2 hot
+// restart, SIGCHLD reaps a successor that gave up.
+void handleSignals(sigset_t signals) {
+    while (true) {
+        int signal = 0;
+        if (sigwait(&signals, &signal) != 0) {
+            continue;
+        }
+        if (g_exiting) {
+            return;
+        }
+        
+        switch (signal) {
+            case SIGCHLD:
+                while (waitpid(-1, nullptr, WNOHANG) > 0) {
+                }
+                break;
+            case SIGHUP:
+            case SIGUSR2:
+                hotRestart();
+                break;
+            default:
+                if (g_server->isDraining()) {
+                    g_server->stop();
+                } else {
+                    std::cout << "\nShutting down server..." << std::endl;
+                    g_server->drain(g_drain_seconds);
+                }
+                break;
+        }
+    }
+}
+
+// Ends the signal thread once main() is done with the server
+struct SignalThread {
+    std::thread thread;
+    ~SignalThread() {
+        g_exiting = true;
+        pthread_kill(thread.native_handle(), SIGTERM);
+        thread.join();
+    }
+};
+
+} // namespace
+
 int main(int argc, char* argv[]) {
-    // Set up signal handling
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    // Blocked before any thread starts, so every thread inherits the mask
+    // and the signals reach handleSignals() only
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    // TLS writes (write(2) in OpenSSL's socket BIO, sendfile under kTLS)
+    // cannot pass MSG_NOSIGNAL; a client gone away must mean EPIPE, not exit
+    signal(SIGPIPE, SIG_IGN);
+    g_argv = argv;
     
     // Configure logger
     Logger::getInstance().setLevel(Logger::Level::INFO);
@@ -91,12 +398,6 @@ int main(int argc, char* argv[]) {
         return true;
     });
     
-    // Add logging middleware
-    g_server->use([](const HttpRequest& req, HttpResponse& res) -> bool {
-        LOG_INFO(req.methodToString() + " " + req.getPath());
-        return true;
-    });
-    
     // Define routes
     g_server->get("/", [](const HttpRequest& req, HttpResponse& res) {
         res.setHtmlContent(R"(
@@ -168,6 +469,9 @@ int main(int argc, char* argv[]) {
     bool use_https = false;
     std::string cert_file = "./certs/server.crt";
     std::string key_file = "./certs/server.key";
+    std::string access_log_file;
+    AccessLog::Format access_log_format = AccessLog::Format::JSON_LINES;
+    double access_log_sample = 1.0;
     
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -182,6 +486,27 @@ int main(int argc, char* argv[]) {
             cert_file = argv[++i];
         } else if (arg == "--key" && i + 1 < argc) {
             key_file = argv[++i];
+        } else if (arg == "--shards" && i + 1 < argc) {
+            g_server->setListenerShards(std::stoi(argv[++i]));
+        } else if (arg == "--no-http2") {
+            g_server->setHttp2Enabled(false);
+        } else if (arg == "--metrics") {
+            g_server->enableMetrics("/metrics");
+        } else if (arg == "--compress") {
+            g_server->enableCompression();
+        } else if (arg == "--access-log" && i + 1 < argc) {
+            access_log_file = argv[++i];
+        } else if (arg == "--access-log-format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            access_log_format = format == "binary" ? AccessLog::Format::BINARY : AccessLog::Format::JSON_LINES;
+        } else if (arg == "--access-log-sample" && i + 1 < argc) {
+            access_log_sample = std::stod(argv[++i]);
+        } else if (arg == "--drain-timeout" && i + 1 < argc) {
+            g_drain_seconds = std::stoi(argv[++i]);
+#ifdef ENABLE_SSL
+        } else if (arg == "--early-data" && i + 1 < argc) {
+            g_server->setTlsEarlyData(static_cast<uint32_t>(std::stoul(argv[++i])));
+#endif
         } else if (arg == "--help") {
             std::cout << "Usage: " << argv[0] << " [options]\n";
             std::cout << "Options:\n";
@@ -190,21 +515,63 @@ int main(int argc, char* argv[]) {
             std::cout << "  --https          Enable HTTPS mode with SSL/TLS\n";
             std::cout << "  --cert <file>    SSL certificate file (default: ./certs/server.crt)\n";
             std::cout << "  --key <file>     SSL private key file (default: ./certs/server.key)\n";
+            std::cout << "  --shards <n>     SO_REUSEPORT listeners, one event loop each (default: 1)\n";
+            std::cout << "  --early-data <n> Accept up to n bytes of TLS 1.3 0-RTT data (default: 0, off)\n";
+            std::cout << "  --no-http2       Serve HTTP/1.1 only (no ALPN h2, no h2c prior knowledge)\n";
+            std::cout << "  --metrics        Serve Prometheus metrics at /metrics\n";
+            std::cout << "  --compress       Compress text responses the client accepts (zstd, br, gzip)\n";
+            std::cout << "  --access-log <file>         Access log file (default: the console)\n";
+            std::cout << "  --access-log-format <fmt>   json or binary (default: json)\n";
+            std::cout << "  --access-log-sample <rate>  Fraction of requests logged, e.g. 0.01 (default: 1)\n";
+            std::cout << "  --drain-timeout <s>         Time connections get to finish on shutdown (default: 30)\n";
             std::cout << "  --help           Show this help message\n";
             std::cout << "\nExamples:\n";
             std::cout << "  " << argv[0] << "                    # Start HTTP server on port 8080\n";
             std::cout << "  " << argv[0] << " --https             # Start HTTPS server on port 8443\n";
             std::cout << "  " << argv[0] << " --https --port 443  # Start HTTPS server on port 443\n";
+            std::cout << "\nSignals:\n";
+            std::cout << "  SIGTERM, SIGINT  Stop accepting, finish requests in flight, exit (twice: exit now)\n";
+            std::cout << "  SIGHUP, SIGUSR2  Hot restart: start a new process on the same sockets, then drain\n";
             return 0;
         }
     }
     
+    g_server->enableAccessLog(access_log_file, access_log_format, access_log_sample);
+    
+    // Listening sockets from systemd socket activation, or from the process
+    // this one replaces; either way nothing is bound here
+    std::vector<int> inherited = SocketServer::systemdSockets();
+    int handoff_channel = -1;
+    if (const char* handoff = std::getenv(kHandoffVariable)) {
+        handoff_channel = std::atoi(handoff);
+        unsetenv(kHandoffVariable);
+        fcntl(handoff_channel, F_SETFD, FD_CLOEXEC);
+        if (!SocketServer::receiveSockets(handoff_channel, inherited)) {
+            LOG_ERROR("No listening sockets received from the previous process");
+            return 1;
+        }
+    }
+    if (!inherited.empty()) {
+        LOG_INFO("Serving ", inherited.size(), " inherited listening socket(s)");
+        g_server->setInheritedListeners(inherited);
+    }
+    if (handoff_channel >= 0) {
+        // The previous process drains from here on
+        char byte = 1;
+        if (write(handoff_channel, &byte, 1) != 1) {
+            LOG_ERROR("Could not acknowledge the handoff");
+        }
+        close(handoff_channel);
+    }
+    
+    SignalThread signal_thread{std::thread(handleSignals, signals)};
+    
     // Start server
     if (use_https) {
 #ifdef ENABLE_SSL
-        LOG_INFO("Starting HTTPS server on " + host + ":" + std::to_string(port));
-        LOG_INFO("Certificate: " + cert_file);
-        LOG_INFO("Private key: " + key_file);
+        LOG_INFO("Starting HTTPS server on ", host, ":", port);
+        LOG_INFO("Certificate: ", cert_file);
+        LOG_INFO("Private key: ", key_file);
         
         if (!g_server->startHttps(port, cert_file, key_file, host)) {
             LOG_ERROR("Failed to start HTTPS server");
@@ -212,14 +579,14 @@ int main(int argc, char* argv[]) {
         }
         
         LOG_INFO("🔒 HTTPS server started successfully!");
-        LOG_INFO("🌐 Visit: https://" + (host == "0.0.0.0" ? "localhost" : host) + ":" + std::to_string(port));
+        LOG_INFO("🌐 Visit: https://", (host == "0.0.0.0" ? "localhost" : host), ":", port);
         LOG_INFO("⚠️  Browser will show security warning for self-signed certificate");
 #else
         LOG_ERROR("SSL support not compiled in. Rebuild with ENABLE_SSL=ON");
         return 1;
 #endif
     } else {
-        LOG_INFO("Starting HTTP server on " + host + ":" + std::to_string(port));
+        LOG_INFO("Starting HTTP server on ", host, ":", port);
         
         if (!g_server->start(port, host)) {
             LOG_ERROR("Failed to start HTTP server");
@@ -227,7 +594,7 @@ int main(int argc, char* argv[]) {
         }
         
         LOG_INFO("🌐 HTTP server started successfully!");
-        LOG_INFO("🌐 Visit: http://" + (host == "0.0.0.0" ? "localhost" : host) + ":" + std::to_string(port));
+        LOG_INFO("🌐 Visit: http://", (host == "0.0.0.0" ? "localhost" : host), ":", port);
     }
     
     return 0;
@@ -0,0 +1,132 @@
+#include "metrics.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace metrics {
+
+namespace {
+
+// Histogram bounds exported to Prometheus, in microseconds, with their
+// "le" label values
+struct ExportedBound {
+    uint64_t micros;
+    const char* label;
+};
+
+constexpr ExportedBound kExportedBounds[] = {
+    {100, "0.0001"},   {250, "0.00025"},   {500, "0.0005"},   {1000, "0.001"},
+    {2500, "0.0025"},  {5000, "0.005"},    {10000, "0.01"},   {25000, "0.025"},
+    {50000, "0.05"},   {100000, "0.1"},    {250000, "0.25"},  {500000, "0.5"},
+    {1000000, "1"},    {2500000, "2.5"},   {5000000, "5"},    {10000000, "10"},
+};
+
+} // namespace
+
+uint64_t LatencyHistogram::Snapshot::countAtOrBelow(uint64_t bound_us) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount && bucketUpperBound(i) <= bound_us; ++i) {
+        total += counts[i];
+    }
+    return total;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(count)));
+    rank = rank == 0 ? 1 : rank;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return bucketUpperBound(i);
+        }
+    }
+    return bucketUpperBound(kBucketCount - 1);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    // Not atomic across buckets: a scrape racing with updates may see a
+    // record in the count but not yet in the sum, which Prometheus tolerates
+    Snapshot snapshot;
+    for (size_t shard = 0; shard < kShards; ++shard) {
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            snapshot.counts[i] += shards_[shard].counts[i].load(std::memory_order_relaxed);
+        }
+        snapshot.sum_us += shards_[shard].sum_us.load(std::memory_order_relaxed);
+    }
+    for (uint64_t bucket : snapshot.counts) {
+        snapshot.count += bucket;
+    }
+    return snapshot;
+}
+
+void PrometheusWriter::family(std::string_view name, std::string_view type, std::string_view help) {
+    out_.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out_.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void PrometheusWriter::sample(std::string_view name, std::string_view labels, uint64_t value) {
+    appendName(name, "", labels, "");
+    out_.append(" ").append(std::to_string(value)).append("\n");
+}
+
+void PrometheusWriter::sample(std::string_view name, std::string_view labels, double value) {
+    char number[32];
+    int length = std::snprintf(number, sizeof(number), "%.6f", value);
+    appendName(name, "", labels, "");
+    out_.append(" ").append(number, static_cast<size_t>(length > 0 ? length : 0)).append("\n");
+}
+
+void PrometheusWriter::histogram(std::string_view name, std::string_view labels,
+                                 const LatencyHistogram& histogram) {
+    LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+    std::string le;
+    for (const ExportedBound& bound : kExportedBounds) {
+        le.assign("le=\"").append(bound.label).append("\"");
+        appendName(name, "_bucket", labels, le);
+        out_.append(" ").append(std::to_string(snapshot.countAtOrBelow(bound.micros))).append("\n");
+    }
+    appendName(name, "_bucket", labels, "le=\"+Inf\"");
+    out_.append(" ").append(std::to_string(snapshot.count)).append("\n");
+
+    char number[32];
+    int length = std::snprintf(number, sizeof(number), "%.6f", static_cast<double>(snapshot.sum_us) / 1e6);
+    appendName(name, "_sum", labels, "");
+    out_.append(" ").append(number, static_cast<size_t>(length > 0 ? length : 0)).append("\n");
+    appendName(name, "_count", labels, "");
+    out_.append(" ").append(std::to_string(snapshot.count)).append("\n");
+}
+
+void PrometheusWriter::appendLabelValue(std::string& out, std::string_view value) {
+    out.push_back('"');
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\n') {
+            out.append("\\n");
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+void PrometheusWriter::appendName(std::string_view name, std::string_view suffix, std::string_view labels,
+                                  std::string_view extra_label) {
+    out_.append(name).append(suffix);
+    if (labels.empty() && extra_label.empty()) {
+        return;
+    }
+    out_.push_back('{');
+    out_.append(labels);
+    if (!labels.empty() && !extra_label.empty()) {
+        out_.push_back(',');
+    }
+    out_.append(extra_label).push_back('}');
+}
+
+} // namespace metrics
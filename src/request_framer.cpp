@@ -0,0 +1,315 @@
+#include "request_framer.h"
+#include "http_request.h"
+#include "string_util.h"
+#include <algorithm>
+
+namespace {
+constexpr size_t kMaxChunkLineLength = 1024;
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Calls `element` with each trimmed, non-empty element of a comma-separated
+// field value, stopping early when it returns false
+template <typename Element>
+bool forEachElement(std::string_view list, Element element) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = string_util::trim(list.substr(0, comma));
+        if (!item.empty() && !element(item)) {
+            return false;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return true;
+}
+}
+
+RequestFramer::RequestFramer(size_t max_body_size, size_t max_header_size)
+    : max_body_size_(max_body_size), max_header_size_(max_header_size) {
+    reset();
+}
+
+void RequestFramer::reset() {
+    state_ = State::HEADERS;
+    error_ = Status::BAD_REQUEST;
+    scan_offset_ = 0;
+    header_length_ = 0;
+    content_length_ = 0;
+    chunk_remaining_ = 0;
+    trailer_offset_ = 0;
+    message_length_ = 0;
+    chunked_ = false;
+    decoded_body_.clear();
+    parser_.reset();
+}
+
+RequestFramer::Status RequestFramer::frame(const std::string& buffer) {
+    if (state_ == State::COMPLETE) {
+        return Status::COMPLETE;
+    }
+    if (state_ == State::ERROR) {
+        return error_;
+    }
+
+    if (state_ == State::HEADERS) {
+        // The parser resumes at the first unscanned byte of the buffer
+        RequestParser::Status head = parser_.parse(buffer);
+        if (head == RequestParser::Status::ERROR) {
+            return fail(Status::BAD_REQUEST);
+        }
+        if (head == RequestParser::Status::NEED_MORE) {
+            scan_offset_ = buffer.size();
+            return buffer.size() > max_header_size_ ? fail(Status::HEADERS_TOO_LARGE) : Status::NEED_MORE;
+        }
+
+        header_length_ = parser_.getHeadLength();
+        if (header_length_ > max_header_size_) {
+            return fail(Status::HEADERS_TOO_LARGE);
+        }
+
+        Status status = parseHead(buffer);
+        if (status != Status::NEED_MORE) {
+            return status;
+        }
+    }
+
+    if (state_ == State::BODY) {
+        if (buffer.size() - header_length_ < content_length_) {
+            return Status::NEED_MORE;
+        }
+        message_length_ = header_length_ + content_length_;
+        state_ = State::COMPLETE;
+        return Status::COMPLETE;
+    }
+
+    return frameChunked(buffer);
+}
+
+std::string RequestFramer::takeMessage(std::string& buffer) {
+    if (state_ != State::COMPLETE) {
+        return std::string();
+    }
+
+    std::string message = extractMessage(buffer);
+    reset();
+    return message;
+}
+
+bool RequestFramer::takeRequest(std::string& buffer, HttpRequest& request) {
+    if (state_ != State::COMPLETE) {
+        return false;
+    }
+
+    // The head occupies the same offsets in the extracted message, so the
+    // fields the parser recorded while framing are still valid for it
+    bool valid = request.load(extractMessage(buffer), parser_);
+    reset();
+    return valid;
+}
+
+std::string RequestFramer::extractMessage(std::string& buffer) {
+    std::string message;
+    if (chunked_) {
+        message.reserve(header_length_ + decoded_body_.size());
+        message.append(buffer, 0, header_length_);
+        message.append(decoded_body_);
+        buffer.erase(0, message_length_);
+    } else if (message_length_ == buffer.size()) {
+        // Common case: no pipelined bytes behind the request, so hand the
+        // whole buffer over instead of copying it
+        message = std::move(buffer);
+        buffer.clear();
+    } else {
+        message.assign(buffer, 0, message_length_);
+        buffer.erase(0, message_length_);
+    }
+    return message;
+}
+
+RequestFramer::Status RequestFramer::fail(Status status) {
+    state_ = State::ERROR;
+    error_ = status;
+    return status;
+}
+
+RequestFramer::Status RequestFramer::parseHead(const std::string& buffer) {
+    // Every field counts, not just the first of each name: a proxy that
+    // frames by a different one than we do would otherwise let a request
+    // hide inside another's body (request smuggling)
+    bool has_transfer_encoding = false;
+    bool has_content_length = false;
+    bool chunked_last = false;
+    size_t chunked_count = 0;
+    size_t length = 0;
+    for (const auto& field : parser_.getHeaders()) {
+        std::string_view name = field.name.in(buffer);
+        std::string_view value = field.value.in(buffer);
+
+        if (string_util::equalsIgnoreCase(name, "Transfer-Encoding")) {
+            // Several fields make one list of codings, applied in order
+            has_transfer_encoding = true;
+            forEachElement(value, [&](std::string_view coding) {
+                chunked_last = string_util::equalsIgnoreCase(coding, "chunked");
+                chunked_count += chunked_last ? 1 : 0;
+                return true;
+            });
+        } else if (string_util::equalsIgnoreCase(name, "Content-Length")) {
+            // Repeats (as fields or a list) are only allowed to agree
+            bool empty = true;
+            bool valid = forEachElement(value, [&](std::string_view digits) {
+                size_t parsed = 0;
+                if (!string_util::parseDecimal(digits, parsed) || (has_content_length && parsed != length)) {
+                    return false;
+                }
+                length = parsed;
+                has_content_length = true;
+                empty = false;
+                return true;
+            });
+            if (!valid || empty) {
+                return fail(Status::BAD_REQUEST);
+            }
+        }
+    }
+
+    if (has_transfer_encoding) {
+        // chunked must be the final coding, applied once; a request carrying
+        // both framing headers is rejected rather than guessed at
+        if (!chunked_last || chunked_count != 1 || has_content_length) {
+            return fail(Status::BAD_REQUEST);
+        }
+
+        chunked_ = true;
+        state_ = State::CHUNK_SIZE;
+    } else {
+        content_length_ = length;
+        if (content_length_ > max_body_size_) {
+            return fail(Status::PAYLOAD_TOO_LARGE);
+        }
+        state_ = State::BODY;
+    }
+
+    scan_offset_ = header_length_;
+    return Status::NEED_MORE;
+}
+
+RequestFramer::Status RequestFramer::frameChunked(const std::string& buffer) {
+    size_t pos = scan_offset_;
+
+    while (true) {
+        // Size lines, extensions and trailers count against the request too:
+        // tiny chunks with long extensions must not grow the buffer forever
+        if (pos - header_length_ > max_body_size_ + max_header_size_) {
+            return fail(Status::PAYLOAD_TOO_LARGE);
+        }
+
+        switch (state_) {
+            case State::CHUNK_SIZE: {
+                size_t line_end = buffer.find("\r\n", pos);
+                if (line_end == std::string::npos) {
+                    scan_offset_ = pos;
+                    return buffer.size() - pos > kMaxChunkLineLength ? fail(Status::BAD_REQUEST) : Status::NEED_MORE;
+                }
+
+                // chunk-size [; extensions] CRLF
+                size_t chunk_size = 0;
+                size_t digits = 0;
+                for (size_t i = pos; i < line_end; ++i, ++digits) {
+                    int value = hexValue(buffer[i]);
+                    if (value < 0) {
+                        break;
+                    }
+                    if (chunk_size > (max_body_size_ >> 4)) {
+                        return fail(Status::PAYLOAD_TOO_LARGE);
+                    }
+                    chunk_size = (chunk_size << 4) | static_cast<size_t>(value);
+                }
+
+                // Only extensions may follow the size ("5;name=value"), so
+                // "5x" or "5 6" is not read as 5 by us and as something else
+                // by a peer
+                size_t rest = pos + digits;
+                while (rest < line_end && (buffer[rest] == ' ' || buffer[rest] == '\t')) {
+                    ++rest;
+                }
+                if (digits == 0 || (rest < line_end && buffer[rest] != ';') || (rest == line_end && rest != pos + digits)) {
+                    return fail(Status::BAD_REQUEST);
+                }
+
+                pos = line_end + 2;
+                if (chunk_size == 0) {
+                    trailer_offset_ = pos;
+                    state_ = State::TRAILERS;
+                } else {
+                    if (decoded_body_.size() + chunk_size > max_body_size_) {
+                        return fail(Status::PAYLOAD_TOO_LARGE);
+                    }
+                    chunk_remaining_ = chunk_size;
+                    state_ = State::CHUNK_DATA;
+                }
+                break;
+            }
+
+            case State::CHUNK_DATA: {
+                size_t available = std::min(chunk_remaining_, buffer.size() - pos);
+                decoded_body_.append(buffer, pos, available);
+                pos += available;
+                chunk_remaining_ -= available;
+
+                if (chunk_remaining_ > 0) {
+                    scan_offset_ = pos;
+                    return Status::NEED_MORE;
+                }
+                state_ = State::CHUNK_DATA_END;
+                break;
+            }
+
+            case State::CHUNK_DATA_END: {
+                if (buffer.size() - pos < 2) {
+                    scan_offset_ = pos;
+                    return Status::NEED_MORE;
+                }
+                if (buffer[pos] != '\r' || buffer[pos + 1] != '\n') {
+                    return fail(Status::BAD_REQUEST);
+                }
+                pos += 2;
+                state_ = State::CHUNK_SIZE;
+                break;
+            }
+
+            case State::TRAILERS: {
+                // The whole trailer section is held to the header limit
+                size_t line_end = buffer.find("\r\n", pos);
+                size_t section_end = line_end == std::string::npos ? buffer.size() : line_end + 2;
+                if (section_end - trailer_offset_ > max_header_size_) {
+                    return fail(Status::HEADERS_TOO_LARGE);
+                }
+                if (line_end == std::string::npos) {
+                    scan_offset_ = pos;
+                    return Status::NEED_MORE;
+                }
+
+                // Trailer fields are skipped; an empty line ends the message
+                bool empty_line = line_end == pos;
+                pos = line_end + 2;
+                if (empty_line) {
+                    message_length_ = pos;
+                    state_ = State::COMPLETE;
+                    return Status::COMPLETE;
+                }
+                break;
+            }
+
+            default:
+                return fail(Status::BAD_REQUEST);
+        }
+    }
+}
@@ -0,0 +1,203 @@
+#include "request_parser.h"
+#include "simd_scan.h"
+#include "string_util.h"
+
+namespace {
+
+RequestParser::Span makeSpan(size_t offset, size_t length) {
+    RequestParser::Span span;
+    span.offset = static_cast<uint32_t>(offset);
+    span.length = static_cast<uint32_t>(length);
+    return span;
+}
+
+bool isTokenChar(char c) {
+    // RFC 7230 tchar
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+        return true;
+    }
+    switch (c) {
+        case '!': case '#': case '$': case '%': case '&': case '\'': case '*':
+        case '+': case '-': case '.': case '^': case '_': case '`': case '|': case '~':
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+RequestParser::RequestParser() {
+    headers_.reserve(32);
+    reset();
+}
+
+void RequestParser::reset() {
+    state_ = State::REQUEST_LINE;
+    line_start_ = 0;
+    scan_pos_ = 0;
+    head_length_ = 0;
+    method_ = Span();
+    target_ = Span();
+    version_ = Span();
+    headers_.clear(); // keeps capacity for the next request on the connection
+}
+
+RequestParser::Status RequestParser::getStatus() const {
+    switch (state_) {
+        case State::COMPLETE: return Status::COMPLETE;
+        case State::ERROR:    return Status::ERROR;
+        default:              return Status::NEED_MORE;
+    }
+}
+
+RequestParser::Status RequestParser::parse(std::string_view buffer, bool at_eof) {
+    if (buffer.size() > UINT32_MAX) {
+        state_ = State::ERROR;
+    }
+
+    while (state_ == State::REQUEST_LINE || state_ == State::HEADER_LINE) {
+        size_t remaining = buffer.size() - scan_pos_;
+        size_t line_end = scan_pos_ + simd::findByte(buffer.data() + scan_pos_, remaining, '\n');
+
+        if (line_end == buffer.size()) {
+            scan_pos_ = buffer.size();
+            if (!at_eof) {
+                return Status::NEED_MORE;
+            }
+
+            // Caller holds the whole message: an unterminated final line still
+            // counts, and running out of input ends the head
+            if (line_start_ < buffer.size() && !parseLine(buffer, buffer.size())) {
+                state_ = State::ERROR;
+                break;
+            }
+            if (state_ == State::REQUEST_LINE) {
+                state_ = State::ERROR;
+                break;
+            }
+            head_length_ = buffer.size();
+            state_ = State::COMPLETE;
+            break;
+        }
+
+        scan_pos_ = line_end + 1;
+        if (!parseLine(buffer, line_end)) {
+            state_ = State::ERROR;
+        }
+    }
+
+    return getStatus();
+}
+
+bool RequestParser::parseLine(std::string_view buffer, size_t line_end) {
+    size_t start = line_start_;
+    size_t end = line_end;
+    if (end > start && buffer[end - 1] == '\r') {
+        --end;
+    }
+    line_start_ = line_end + 1;
+
+    std::string_view line = buffer.substr(start, end - start);
+
+    if (state_ == State::REQUEST_LINE) {
+        // Tolerate empty lines before the request line (RFC 7230 3.5)
+        if (line.empty()) {
+            return true;
+        }
+        if (!parseRequestLine(line, start)) {
+            return false;
+        }
+        state_ = State::HEADER_LINE;
+        return true;
+    }
+
+    if (line.empty()) {
+        head_length_ = line_start_ < buffer.size() ? line_start_ : buffer.size();
+        state_ = State::COMPLETE;
+        return true;
+    }
+
+    return parseHeaderLine(line, start);
+}
+
+bool RequestParser::parseRequestLine(std::string_view line, size_t offset) {
+    // method SP request-target SP HTTP-version
+    size_t first_space = simd::findByte(line.data(), line.size(), ' ');
+    if (first_space == 0 || first_space == line.size()) {
+        return false;
+    }
+
+    size_t target_start = first_space + 1;
+    while (target_start < line.size() && line[target_start] == ' ') {
+        ++target_start;
+    }
+
+    size_t second_space = target_start + simd::findByte(line.data() + target_start, line.size() - target_start, ' ');
+    if (second_space == target_start || second_space == line.size()) {
+        return false;
+    }
+
+    size_t version_start = second_space + 1;
+    while (version_start < line.size() && line[version_start] == ' ') {
+        ++version_start;
+    }
+
+    std::string_view version = string_util::trim(line.substr(version_start));
+    // HTTP/<digit>.<digit>
+    if (version.size() != 8 || version.substr(0, 5) != "HTTP/" ||
+        version[5] < '0' || version[5] > '9' || version[6] != '.' || version[7] < '0' || version[7] > '9') {
+        return false;
+    }
+
+    for (size_t i = 0; i < first_space; ++i) {
+        if (!isTokenChar(line[i])) {
+            return false;
+        }
+    }
+
+    method_ = makeSpan(offset, first_space);
+    target_ = makeSpan(offset + target_start, second_space - target_start);
+    version_ = makeSpan(offset + static_cast<size_t>(version.data() - line.data()), version.size());
+    return true;
+}
+
+bool RequestParser::parseHeaderLine(std::string_view line, size_t offset) {
+    // Obsolete line folding is refused rather than unfolded (RFC 7230 3.2.4)
+    if (line[0] == ' ' || line[0] == '\t') {
+        return false;
+    }
+
+    size_t colon = simd::findByte(line.data(), line.size(), ':');
+    if (colon == line.size() || colon == 0) {
+        return false;
+    }
+
+    std::string_view name = line.substr(0, colon);
+    for (char c : name) {
+        if (!isTokenChar(c)) {
+            return false; // includes whitespace before the colon
+        }
+    }
+
+    if (headers_.size() >= kMaxHeaderCount) {
+        return false;
+    }
+
+    std::string_view value = string_util::trim(line.substr(colon + 1));
+
+    HeaderField field;
+    field.name = makeSpan(offset, colon);
+    field.value = makeSpan(offset + static_cast<size_t>(value.data() - line.data()), value.size());
+    headers_.push_back(field);
+    return true;
+}
+
+std::string_view RequestParser::findHeader(std::string_view buffer, std::string_view name) const {
+    for (const auto& field : headers_) {
+        if (string_util::equalsIgnoreCase(field.name.in(buffer), name)) {
+            return field.value.in(buffer);
+        }
+    }
+    return std::string_view();
+}
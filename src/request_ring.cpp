@@ -0,0 +1,85 @@
+#include "request_ring.h"
+
+RequestRing::RequestRing(Handler handler, size_t capacity, Notify notify)
+    : handler_(std::move(handler)), notify_(std::move(notify)), capacity_(capacity), requests_(capacity),
+      responses_(capacity), in_flight_(0), queued_(0), completions_(0), sleepers_(0), stopping_(false) {
+}
+
+RequestRing::~RequestRing() {
+    stop();
+}
+
+void RequestRing::start(size_t workers) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+    }
+    while (workers_.size() < workers) {
+        workers_.emplace_back(&RequestRing::runWorker, this);
+    }
+}
+
+void RequestRing::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+bool RequestRing::submit(uint32_t tag, const char* data, size_t length) {
+    if (in_flight_.fetch_add(1) >= capacity_) {
+        in_flight_.fetch_sub(1);
+        return false;
+    }
+    // Counted before it is pushed, so a worker popping it at once cannot
+    // take the count below zero. A worker that saw nothing queued
+    // registered as a sleeper first, so either it sees this request or we
+    // see it and wake it
+    queued_.fetch_add(1);
+    Request request{tag, data, length};
+    requests_.tryPush(std::move(request)); // cannot fail: in-flight requests are bounded
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_one();
+    }
+    return true;
+}
+
+bool RequestRing::poll(Response& response) {
+    if (!responses_.tryPop(response)) {
+        return false;
+    }
+    in_flight_.fetch_sub(1);
+    return true;
+}
+
+void RequestRing::runWorker() {
+    Request request;
+    while (true) {
+        if (requests_.tryPop(request)) {
+            queued_.fetch_sub(1);
+            Response response;
+            response.tag = request.tag;
+            handler_(std::string_view(request.data, request.length), response.data);
+            responses_.tryPush(std::move(response));
+            completions_.fetch_add(1, std::memory_order_release);
+            if (notify_) {
+                notify_();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        wake_.wait(lock, [this]() { return stopping_ || queued_.load() > 0; });
+        sleepers_.fetch_sub(1);
+        if (stopping_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,235 @@
+#include "response_cache.h"
+#include "string_util.h"
+
+#include <algorithm>
+
+namespace {
+
+// Value of a `name=seconds` directive in a Cache-Control list
+bool directiveSeconds(std::string_view cache_control, std::string_view name, size_t& seconds) {
+    while (!cache_control.empty()) {
+        size_t comma = cache_control.find(',');
+        std::string_view item = string_util::trim(cache_control.substr(0, comma));
+        size_t equals = item.find('=');
+        if (equals != std::string_view::npos && string_util::equalsIgnoreCase(item.substr(0, equals), name)) {
+            return string_util::parseDecimal(item.substr(equals + 1), seconds);
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        cache_control.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+bool isStorableStatus(HttpResponse::StatusCode status) {
+    return status == HttpResponse::StatusCode::OK || status == HttpResponse::StatusCode::NO_CONTENT ||
+           status == HttpResponse::StatusCode::NOT_FOUND;
+}
+
+} // namespace
+
+ResponseCache::ResponseCache(size_t max_bytes, size_t max_entry_size)
+    : max_bytes_(max_bytes), max_entry_size_(max_entry_size), memory_usage_(0), hits_(0), misses_(0),
+      coalesced_(0) {
+}
+
+bool ResponseCache::fetch(const std::string& key, std::chrono::seconds ttl, const Loader& load,
+                          HttpResponse& response) {
+    std::shared_ptr<const Stored> stored;
+    std::shared_ptr<Flight> flight;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            if (it->second.stored->expires_at > Clock::now()) {
+                lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+                ++hits_;
+                stored = it->second.stored;
+            } else {
+                erase(it);
+            }
+        }
+
+        if (!stored) {
+            auto loading = flights_.find(key);
+            if (loading == flights_.end()) {
+                flight = std::make_shared<Flight>();
+                flights_.emplace(key, flight);
+                ++misses_;
+            } else {
+                // Someone is already running the handler for this key
+                std::shared_ptr<Flight> other = loading->second;
+                other->done.wait(lock, [&other]() { return other->finished; });
+                if (other->result) {
+                    ++coalesced_;
+                    stored = other->result;
+                } else {
+                    ++misses_; // not storable: the handler runs again for us
+                }
+            }
+        }
+    }
+
+    if (stored) {
+        apply(*stored, response, true);
+        return true;
+    }
+
+    HttpResponse loaded;
+    if (!flight) {
+        load(loaded);
+    } else {
+        // Waiters are released even if the handler throws
+        struct Release {
+            ResponseCache* cache;
+            const std::string& key;
+            const std::shared_ptr<Flight>& flight;
+            std::shared_ptr<const Stored> result;
+            ~Release() { cache->finishFlight(key, flight, std::move(result)); }
+        } release{this, key, flight, nullptr};
+
+        load(loaded);
+        release.result = store(key, ttl, loaded);
+        if (release.result) {
+            apply(*release.result, response, false);
+            return false;
+        }
+    }
+
+    // Not stored: hand over the loaded response as it is, keeping the
+    // headers the caller had that it does not set
+    for (const HeaderMap::Field field : response.getHeaders()) {
+        if (!loaded.getHeaders().contains(field.name)) {
+            loaded.addHeader(field.name, field.value);
+        }
+    }
+    response = std::move(loaded);
+    return false;
+}
+
+std::shared_ptr<const ResponseCache::Stored> ResponseCache::store(const std::string& key, std::chrono::seconds ttl,
+                                                                  HttpResponse& response) {
+    const HeaderMap& headers = response.getHeaders();
+    std::string_view cache_control = headers.get(HeaderId::CACHE_CONTROL);
+    if (!isStorableStatus(response.getStatusCode()) || response.getFileBody() || response.isStreaming() ||
+        response.getBodySize() > max_entry_size_ || headers.contains("Set-Cookie") ||
+        string_util::hasToken(cache_control, "no-store") || string_util::hasToken(cache_control, "no-cache") ||
+        string_util::hasToken(cache_control, "private")) {
+        return nullptr;
+    }
+
+    // The response's own lifetime wins, s-maxage being meant for shared caches
+    size_t seconds = 0;
+    if (directiveSeconds(cache_control, "s-maxage", seconds) || directiveSeconds(cache_control, "max-age", seconds)) {
+        ttl = std::chrono::seconds(static_cast<long long>(std::min<size_t>(seconds, INT32_MAX)));
+    }
+    if (ttl.count() <= 0) {
+        return nullptr;
+    }
+
+    auto stored = std::make_shared<Stored>();
+    stored->status = response.getStatusCode();
+    stored->headers = headers;
+    stored->body = response.getSharedBody() ? response.getSharedBody()
+                                            : std::make_shared<const std::string>(response.takeBody());
+    stored->stored_at = Clock::now();
+    stored->expires_at = stored->stored_at + ttl;
+    stored->memory_usage = sizeof(Stored) + key.size() + stored->body->size();
+    for (const HeaderMap::Field field : stored->headers) {
+        stored->memory_usage += field.name.size() + field.value.size();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stored->memory_usage > max_bytes_) {
+        return stored; // shared with this flight's waiters, never cached
+    }
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        erase(it);
+    }
+    lru_.push_front(key);
+    entries_[key] = Entry{stored, lru_.begin()};
+    memory_usage_ += stored->memory_usage;
+    evictOverflow();
+    return stored;
+}
+
+void ResponseCache::finishFlight(const std::string& key, const std::shared_ptr<Flight>& flight,
+                                 std::shared_ptr<const Stored> result) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flights_.erase(key);
+        flight->finished = true;
+        flight->result = std::move(result);
+    }
+    flight->done.notify_all();
+}
+
+void ResponseCache::apply(const Stored& stored, HttpResponse& response, bool hit) {
+    response.setStatusCode(stored.status);
+    for (const HeaderMap::Field field : stored.headers) {
+        // The first field of a name replaces the caller's; repeats are added
+        if (stored.headers.get(field.name).data() == field.value.data()) {
+            response.setHeader(field.name, field.value);
+        } else {
+            response.addHeader(field.name, field.value);
+        }
+    }
+    response.setSharedBody(stored.body);
+    if (hit) {
+        auto age = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - stored.stored_at);
+        response.setHeader("Age", std::to_string(age.count()));
+    }
+}
+
+void ResponseCache::setMaxBytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    evictOverflow();
+}
+
+void ResponseCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    memory_usage_ = 0;
+}
+
+size_t ResponseCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t ResponseCache::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memory_usage_;
+}
+
+uint64_t ResponseCache::getHits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint64_t ResponseCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+uint64_t ResponseCache::getCoalesced() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return coalesced_;
+}
+
+void ResponseCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+    memory_usage_ -= it->second.stored->memory_usage;
+    lru_.erase(it->second.lru_position);
+    entries_.erase(it);
+}
+
+void ResponseCache::evictOverflow() {
+    // Responses still holding an evicted entry's body keep it alive
+    while (memory_usage_ > max_bytes_ && !lru_.empty()) {
+        erase(entries_.find(lru_.back()));
+    }
+}
@@ -0,0 +1,21 @@
+#include "response_completion.h"
+
+ResponseCompletion::ResponseCompletion(HttpResponse& response, Task finish) : state_(std::make_shared<State>()) {
+    state_->response = &response;
+    state_->finish = std::move(finish);
+}
+
+void ResponseCompletion::operator()() const {
+    if (claim()) {
+        finish();
+    }
+}
+
+ResponseCompletion::State::~State() {
+    if (!done.exchange(true)) {
+        // Every copy was dropped without a call: answer rather than hang
+        *response = HttpResponse(HttpResponse::StatusCode::INTERNAL_SERVER_ERROR);
+        response->setTextContent(response->getStatusText());
+        finish();
+    }
+}
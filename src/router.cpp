@@ -0,0 +1,194 @@
+#include "router.h"
+
+struct Router::Node {
+    std::string prefix; // literal label consumed on entry to the node
+    std::vector<std::unique_ptr<Node>> children; // literal children, distinct first bytes
+    std::unique_ptr<Node> param;                  // `:name` child
+    std::string param_name;
+    std::unique_ptr<Node> wildcard;               // `*name` child, always a leaf
+    std::string wildcard_name;
+    int32_t value = -1;
+};
+
+namespace {
+
+size_t commonPrefix(std::string_view a, std::string_view b) {
+    size_t length = 0;
+    while (length < a.size() && length < b.size() && a[length] == b[length]) {
+        ++length;
+    }
+    return length;
+}
+
+} // namespace
+
+Router::Router() : route_count_(0) {
+}
+
+Router::~Router() = default;
+
+void Router::clear() {
+    for (auto& root : roots_) {
+        root.reset();
+    }
+    route_count_ = 0;
+}
+
+bool Router::add(HttpRequest::Method method, std::string_view pattern, int32_t value) {
+    if (value < 0 || pattern.empty()) {
+        return false;
+    }
+
+    auto& root = roots_[static_cast<size_t>(method)];
+    if (!root) {
+        root = std::make_unique<Node>();
+    }
+
+    Node* node = root.get();
+    size_t pos = 0;
+    size_t param_count = 0;
+
+    while (pos < pattern.size()) {
+        char c = pattern[pos];
+
+        if (c == ':') {
+            size_t end = pattern.find('/', pos);
+            if (end == std::string_view::npos) {
+                end = pattern.size();
+            }
+            std::string_view name = pattern.substr(pos + 1, end - pos - 1);
+            if (name.empty() || ++param_count > HttpRequest::kMaxRouteParams) {
+                return false;
+            }
+
+            if (!node->param) {
+                node->param = std::make_unique<Node>();
+                node->param_name.assign(name);
+            } else if (node->param_name != name) {
+                return false; // `/users/:id` and `/users/:name` cannot share a tree
+            }
+            node = node->param.get();
+            pos = end;
+            continue;
+        }
+
+        if (c == '*') {
+            std::string_view name = pattern.substr(pos + 1);
+            if (name.find('/') != std::string_view::npos || ++param_count > HttpRequest::kMaxRouteParams) {
+                return false;
+            }
+
+            if (!node->wildcard) {
+                node->wildcard = std::make_unique<Node>();
+                node->wildcard_name.assign(name);
+            } else if (node->wildcard_name != name) {
+                return false;
+            }
+            node = node->wildcard.get();
+            break;
+        }
+
+        // Literal run up to the next capture
+        size_t end = pattern.find_first_of(":*", pos);
+        if (end == std::string_view::npos) {
+            end = pattern.size();
+        }
+        std::string_view label = pattern.substr(pos, end - pos);
+        pos = end;
+
+        while (!label.empty()) {
+            auto it = node->children.begin();
+            while (it != node->children.end() && (*it)->prefix[0] != label[0]) {
+                ++it;
+            }
+
+            if (it == node->children.end()) {
+                auto child = std::make_unique<Node>();
+                child->prefix.assign(label);
+                node->children.push_back(std::move(child));
+                node = node->children.back().get();
+                break;
+            }
+
+            Node* child = it->get();
+            size_t shared = commonPrefix(child->prefix, label);
+            if (shared < child->prefix.size()) {
+                // Split the edge: the shared part becomes a new parent
+                auto parent = std::make_unique<Node>();
+                parent->prefix = child->prefix.substr(0, shared);
+                child->prefix.erase(0, shared);
+                parent->children.push_back(std::move(*it));
+                *it = std::move(parent);
+                child = it->get();
+            }
+
+            node = child;
+            label.remove_prefix(shared);
+        }
+    }
+
+    if (node->value < 0) {
+        node->value = value;
+        ++route_count_;
+    }
+    return true;
+}
+
+bool Router::find(HttpRequest::Method method, std::string_view path, Match& match) const {
+    match.value = -1;
+    match.param_count = 0;
+
+    const auto& root = roots_[static_cast<size_t>(method)];
+    return root && Router::match(*root, path, 0, match);
+}
+
+bool Router::match(const Node& node, std::string_view path, size_t pos, Match& match) {
+    if (pos == path.size() && node.value >= 0) {
+        match.value = node.value;
+        return true;
+    }
+
+    // Literal edges first; at most one child can start with the next byte
+    if (pos < path.size()) {
+        for (const auto& child : node.children) {
+            if (child->prefix[0] != path[pos]) {
+                continue;
+            }
+            if (path.compare(pos, child->prefix.size(), child->prefix) == 0 &&
+                Router::match(*child, path, pos + child->prefix.size(), match)) {
+                return true;
+            }
+            break;
+        }
+    }
+
+    // A parameter captures one non-empty segment
+    if (node.param && pos < path.size() && path[pos] != '/') {
+        size_t end = path.find('/', pos);
+        if (end == std::string_view::npos) {
+            end = path.size();
+        }
+
+        size_t saved_count = match.param_count;
+        RouteParam& param = match.params[match.param_count++];
+        param.name = node.param_name;
+        param.offset = static_cast<uint32_t>(pos);
+        param.length = static_cast<uint32_t>(end - pos);
+
+        if (Router::match(*node.param, path, end, match)) {
+            return true;
+        }
+        match.param_count = saved_count;
+    }
+
+    if (node.wildcard && node.wildcard->value >= 0) {
+        RouteParam& param = match.params[match.param_count++];
+        param.name = node.wildcard_name;
+        param.offset = static_cast<uint32_t>(pos);
+        param.length = static_cast<uint32_t>(path.size() - pos);
+        match.value = node.wildcard->value;
+        return true;
+    }
+
+    return false;
+}
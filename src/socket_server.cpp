@@ -4,14 +4,18 @@
 
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <cstring>
+#include <cerrno>
+#include <cstdlib>
 #include <stdexcept>
 
 SocketServer::SocketServer() 
-    : server_socket_(-1), port_(0), is_running_(false) {
+    : server_socket_(-1), port_(0), is_running_(false), reuse_port_(false),
+      defer_accept_seconds_(0), fast_open_queue_(0) {
 }
 
 SocketServer::~SocketServer() {
@@ -19,7 +23,9 @@ SocketServer::~SocketServer() {
 }
 
 bool SocketServer::createSocket() {
-    server_socket_ = socket(AF_INET, SOCK_STREAM, 0);
+    // Close-on-exec: a listener only reaches another process when handed
+    // over on purpose (sendSockets())
+    server_socket_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (server_socket_ < 0) {
         return false;
     }
@@ -27,10 +33,22 @@ bool SocketServer::createSocket() {
     // Set socket to reuse address
     setReuseAddress(true);
     
+    if (reuse_port_) {
+        int option = 1;
+        if (setsockopt(server_socket_, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)) < 0) {
+            closeSocket();
+            return false;
+        }
+    }
+    
     return true;
 }
 
 bool SocketServer::bind(int port, const std::string& host) {
+    if (port < 0 || port > 65535) {
+        return false;
+    }
+    
     if (!createSocket()) {
         return false;
     }
@@ -58,6 +76,15 @@ bool SocketServer::bind(int port, const std::string& host) {
         return false;
     }
     
+    if (port == 0) {
+        // Ephemeral port: report the one the kernel picked so further
+        // SO_REUSEPORT listeners can join it
+        socklen_t length = sizeof(server_addr);
+        if (getsockname(server_socket_, (struct sockaddr*)&server_addr, &length) == 0) {
+            port_ = ntohs(server_addr.sin_port);
+        }
+    }
+    
     return true;
 }
 
@@ -66,6 +93,15 @@ bool SocketServer::listen(int backlog) {
         return false;
     }
     
+    // Both options are best effort: kernels without them still serve
+    if (fast_open_queue_ > 0) {
+        setsockopt(server_socket_, IPPROTO_TCP, TCP_FASTOPEN, &fast_open_queue_, sizeof(fast_open_queue_));
+    }
+    if (defer_accept_seconds_ > 0) {
+        setsockopt(server_socket_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_accept_seconds_,
+                   sizeof(defer_accept_seconds_));
+    }
+    
     if (::listen(server_socket_, backlog) < 0) {
         return false;
     }
@@ -74,6 +110,33 @@ bool SocketServer::listen(int backlog) {
     return true;
 }
 
+bool SocketServer::adopt(int listener_socket) {
+    int type = 0;
+    int accepting = 0;
+    socklen_t length = sizeof(type);
+    if (getsockopt(listener_socket, SOL_SOCKET, SO_TYPE, &type, &length) < 0 || type != SOCK_STREAM) {
+        return false;
+    }
+    length = sizeof(accepting);
+    if (getsockopt(listener_socket, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &length) < 0 || !accepting) {
+        return false;
+    }
+    
+    struct sockaddr_in address;
+    length = sizeof(address);
+    if (getsockname(listener_socket, (struct sockaddr*)&address, &length) < 0 || address.sin_family != AF_INET) {
+        return false;
+    }
+    
+    closeSocket();
+    server_socket_ = listener_socket;
+    port_ = ntohs(address.sin_port);
+    char host[INET_ADDRSTRLEN];
+    host_ = inet_ntop(AF_INET, &address.sin_addr, host, sizeof(host)) ? host : "";
+    is_running_ = true;
+    return true;
+}
+
 void SocketServer::accept(ConnectionHandler handler) {
     if (!is_running_ || server_socket_ < 0) {
         return;
@@ -102,6 +165,138 @@ void SocketServer::accept(ConnectionHandler handler) {
     }
 }
 
+int SocketServer::acceptClient(std::string& remote_address, bool non_blocking) {
+    if (server_socket_ < 0) {
+        return -1;
+    }
+    
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    
+    // accept4 sets the flags atomically, saving two fcntl calls per client
+    int flags = SOCK_CLOEXEC | (non_blocking ? SOCK_NONBLOCK : 0);
+    int client_socket;
+    do {
+        client_socket = ::accept4(server_socket_, (struct sockaddr*)&client_addr, &client_len, flags);
+    } while (client_socket < 0 && errno == EINTR);
+    
+    if (client_socket < 0) {
+        return -1;
+    }
+
+    // Responses already leave in as few writes as possible (MSG_MORE corks
+    // a head ahead of its file); Nagle would only hold the last segment of
+    // a TLS flight or an HTTP/2 frame batch back for the peer's delayed ACK
+    int no_delay = 1;
+    setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+    char address[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &client_addr.sin_addr, address, sizeof(address))) {
+        remote_address = address;
+    } else {
+        remote_address.clear();
+    }
+    
+    return client_socket;
+}
+
+bool SocketServer::sendSockets(int channel, const std::vector<int>& sockets) {
+    if (sockets.empty() || sockets.size() > kMaxHandoffSockets) {
+        return false;
+    }
+    
+    // One byte of payload carries the descriptors
+    char byte = 0;
+    struct iovec data = {&byte, 1};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxHandoffSockets)];
+    std::memset(control, 0, sizeof(control));
+    
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * sockets.size());
+    
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * sockets.size());
+    std::memcpy(CMSG_DATA(header), sockets.data(), sizeof(int) * sockets.size());
+    
+    ssize_t sent;
+    do {
+        sent = sendmsg(channel, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == 1;
+}
+
+bool SocketServer::receiveSockets(int channel, std::vector<int>& sockets) {
+    char byte;
+    struct iovec data = {&byte, 1};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxHandoffSockets)];
+    
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    
+    ssize_t received;
+    do {
+        received = recvmsg(channel, &message, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received != 1) {
+        return false;
+    }
+    
+    size_t before = sockets.size();
+    for (struct cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; ++i) {
+            int descriptor;
+            std::memcpy(&descriptor, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+            sockets.push_back(descriptor);
+        }
+    }
+    
+    // A truncated message may still have delivered some descriptors; they
+    // are ours to close
+    if (message.msg_flags & MSG_CTRUNC) {
+        for (size_t i = before; i < sockets.size(); ++i) {
+            close(sockets[i]);
+        }
+        sockets.resize(before);
+        return false;
+    }
+    return sockets.size() > before;
+}
+
+std::vector<int> SocketServer::systemdSockets() {
+    std::vector<int> sockets;
+    const char* pid = std::getenv("LISTEN_PID");
+    const char* count = std::getenv("LISTEN_FDS");
+    if (!pid || !count || std::strtol(pid, nullptr, 10) != static_cast<long>(getpid())) {
+        return sockets;
+    }
+    
+    long passed = std::strtol(count, nullptr, 10);
+    for (long i = 0; i < passed && static_cast<size_t>(i) < kMaxHandoffSockets; ++i) {
+        int descriptor = kSystemdFirstSocket + static_cast<int>(i);
+        fcntl(descriptor, F_SETFD, FD_CLOEXEC);
+        sockets.push_back(descriptor);
+    }
+    
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+    return sockets;
+}
+
 void SocketServer::stop() {
     is_running_ = false;
     closeSocket();
@@ -3,9 +3,32 @@
 #ifdef ENABLE_SSL
 #ifndef BUILD_WASM
 
+#include <ctime>
+#include <cstring>
 #include <iostream>
+#include <unistd.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
-SslServer::SslServer() : ssl_context_(nullptr), is_initialized_(false) {
+namespace {
+
+// Sessions issued by this server are only resumed by it
+const unsigned char kSessionIdContext[] = "httpserver";
+
+// ALPN protocol lists in wire format (length-prefixed), in preference order
+const unsigned char kProtocolsWithHttp2[] = "\x02h2\x08http/1.1";
+const unsigned char kProtocolsHttp1[] = "\x08http/1.1";
+
+} // namespace
+
+SslServer::SslServer()
+    : ssl_context_(nullptr), is_initialized_(false), session_cache_size_(kDefaultSessionCacheSize),
+      session_timeout_seconds_(kDefaultSessionTimeoutSeconds), session_tickets_(true), max_early_data_(0),
+      http2_(true), full_handshakes_(0), resumed_handshakes_(0), failed_handshakes_(0),
+      early_data_accepted_(0), early_data_rejected_(0), ktls_send_(0) {
 }
 
 SslServer::~SslServer() {
@@ -24,6 +47,22 @@ bool SslServer::initialize(const std::string& cert_file, const std::string& key_
     // Set minimum protocol version
     SSL_CTX_set_min_proto_version(ssl_context_, TLS1_2_VERSION);
     
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    // Let the kernel do record encryption where it can, so file bodies can
+    // go out through SSL_sendfile without a userspace copy
+    SSL_CTX_set_options(ssl_context_, SSL_OP_ENABLE_KTLS);
+#endif
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // A client hanging up without close_notify is a normal close for HTTP
+    SSL_CTX_set_options(ssl_context_, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+    // Writes on non-blocking sockets report partial progress and may be
+    // retried from a buffer that has moved
+    SSL_CTX_set_mode(ssl_context_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    
+    configureSessions();
+    SSL_CTX_set_alpn_select_cb(ssl_context_, &SslServer::selectProtocol, this);
+    
     // Load certificate and private key
     if (!loadCertificate(cert_file) || !loadPrivateKey(key_file)) {
         cleanup();
@@ -65,6 +104,8 @@ SSL* SslServer::createSslConnection(int socket) {
         return nullptr;
     }
     
+    // SSL_do_handshake() needs to know which side it is on
+    SSL_set_accept_state(ssl);
     return ssl;
 }
 
@@ -73,14 +114,107 @@ bool SslServer::performHandshake(SSL* ssl) {
         return false;
     }
     
-    int result = SSL_accept(ssl);
-    return result == 1;
+    if (SSL_accept(ssl) != 1) {
+        failed_handshakes_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    recordHandshake(ssl);
+    return true;
+}
+
+SslServer::IoResult SslServer::acceptStep(SSL* ssl, bool& early_data_open, std::string& early_data) {
+    if (!ssl) {
+        return IoResult::FAILED;
+    }
+    
+    char buffer[4096];
+    while (early_data_open) {
+        size_t bytes_read = 0;
+        ERR_clear_error();
+        int status = SSL_read_early_data(ssl, buffer, sizeof(buffer), &bytes_read);
+        if (status == SSL_READ_EARLY_DATA_SUCCESS) {
+            early_data.append(buffer, bytes_read);
+            continue;
+        }
+        if (status == SSL_READ_EARLY_DATA_FINISH) {
+            early_data.append(buffer, bytes_read);
+            early_data_open = false;
+            break;
+        }
+        IoResult result = ioResult(ssl, status);
+        if (result != IoResult::WANT_READ && result != IoResult::WANT_WRITE) {
+            failed_handshakes_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return result;
+    }
+    
+    ERR_clear_error();
+    int status = SSL_do_handshake(ssl);
+    if (status == 1) {
+        recordHandshake(ssl);
+        return IoResult::DONE;
+    }
+    IoResult result = ioResult(ssl, status);
+    if (result != IoResult::WANT_READ && result != IoResult::WANT_WRITE) {
+        failed_handshakes_.fetch_add(1, std::memory_order_relaxed);
+        return IoResult::FAILED;
+    }
+    return result;
+}
+
+SslServer::IoResult SslServer::readStep(SSL* ssl, char* buffer, size_t size, size_t& bytes_read) {
+    ERR_clear_error();
+    int status = SSL_read_ex(ssl, buffer, size, &bytes_read);
+    return status == 1 ? IoResult::DONE : ioResult(ssl, status);
+}
+
+SslServer::IoResult SslServer::writeStep(SSL* ssl, const char* data, size_t size, bool early, size_t& written) {
+    ERR_clear_error();
+    int status = early ? SSL_write_early_data(ssl, data, size, &written) : SSL_write_ex(ssl, data, size, &written);
+    return status == 1 ? IoResult::DONE : ioResult(ssl, status);
+}
+
+SslServer::IoResult SslServer::sendFileStep(SSL* ssl, int fd, off_t offset, size_t size, size_t& written) {
+    ERR_clear_error();
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if (isKernelTlsSend(ssl)) {
+        ossl_ssize_t sent = SSL_sendfile(ssl, fd, offset, size, 0);
+        if (sent < 0) {
+            return ioResult(ssl, -1);
+        }
+        written = static_cast<size_t>(sent);
+        return IoResult::DONE;
+    }
+#endif
+    
+    // A retry after WANT_WRITE reads the same bytes again, which is what
+    // SSL_write requires of a repeated call
+    char buffer[16384];
+    size_t chunk = size < sizeof(buffer) ? size : sizeof(buffer);
+    ssize_t bytes_read = pread(fd, buffer, chunk, offset);
+    if (bytes_read <= 0) {
+        return IoResult::FAILED;
+    }
+    int status = SSL_write_ex(ssl, buffer, static_cast<size_t>(bytes_read), &written);
+    return status == 1 ? IoResult::DONE : ioResult(ssl, status);
+}
+
+bool SslServer::isKernelTlsSend(SSL* ssl) {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    return ssl && BIO_get_ktls_send(SSL_get_wbio(ssl));
+#else
+    (void)ssl;
+    return false;
+#endif
 }
 
 void SslServer::closeSslConnection(SSL* ssl) {
     if (ssl) {
-        SSL_shutdown(ssl);
+        if (SSL_is_init_finished(ssl)) {
+            SSL_shutdown(ssl);
+        }
         SSL_free(ssl);
+        ERR_clear_error(); // a failed close_notify must not leak into the next call
     }
 }
 
@@ -139,6 +273,149 @@ void SslServer::setCipherList(const std::string& ciphers) {
     }
 }
 
+SslServer::HandshakeStats SslServer::getHandshakeStats() const {
+    HandshakeStats stats;
+    stats.full = full_handshakes_.load(std::memory_order_relaxed);
+    stats.resumed = resumed_handshakes_.load(std::memory_order_relaxed);
+    stats.failed = failed_handshakes_.load(std::memory_order_relaxed);
+    stats.early_data_accepted = early_data_accepted_.load(std::memory_order_relaxed);
+    stats.early_data_rejected = early_data_rejected_.load(std::memory_order_relaxed);
+    stats.ktls_send = ktls_send_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void SslServer::configureSessions() {
+    if (session_cache_size_ > 0) {
+        SSL_CTX_set_session_cache_mode(ssl_context_, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ssl_context_, static_cast<long>(session_cache_size_));
+    } else {
+        SSL_CTX_set_session_cache_mode(ssl_context_, SSL_SESS_CACHE_OFF);
+    }
+    SSL_CTX_set_session_id_context(ssl_context_, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+    SSL_CTX_set_timeout(ssl_context_, session_timeout_seconds_);
+    
+    if (!session_tickets_) {
+        SSL_CTX_set_options(ssl_context_, SSL_OP_NO_TICKET);
+    } else {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        // Our own keys instead of OpenSSL's per-context random ones, so
+        // they rotate and outlive a single context
+        SSL_CTX_set_app_data(ssl_context_, this);
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ssl_context_, &SslServer::ticketKeyCallback);
+#endif
+    }
+    
+    // OpenSSL keeps its single-use anti-replay check on as long as the
+    // session cache is enabled; only then is 0-RTT safe to offer
+    if (max_early_data_ > 0 && session_cache_size_ > 0) {
+        SSL_CTX_set_max_early_data(ssl_context_, max_early_data_);
+        SSL_CTX_set_recv_max_early_data(ssl_context_, max_early_data_);
+    } else {
+        SSL_CTX_set_max_early_data(ssl_context_, 0);
+        max_early_data_ = 0;
+    }
+}
+
+void SslServer::recordHandshake(SSL* ssl) {
+    if (SSL_session_reused(ssl)) {
+        resumed_handshakes_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        full_handshakes_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    switch (SSL_get_early_data_status(ssl)) {
+        case SSL_EARLY_DATA_ACCEPTED:
+            early_data_accepted_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case SSL_EARLY_DATA_REJECTED:
+            early_data_rejected_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        default:
+            break;
+    }
+    
+    if (isKernelTlsSend(ssl)) {
+        ktls_send_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+SslServer::IoResult SslServer::ioResult(SSL* ssl, int result) {
+    switch (SSL_get_error(ssl, result)) {
+        case SSL_ERROR_WANT_READ:
+            return IoResult::WANT_READ;
+        case SSL_ERROR_WANT_WRITE:
+            return IoResult::WANT_WRITE;
+        case SSL_ERROR_ZERO_RETURN:
+            return IoResult::CLOSED;
+        case SSL_ERROR_SYSCALL:
+            // EOF without close_notify (before OpenSSL 3) or a reset
+            return IoResult::CLOSED;
+        default:
+            return IoResult::FAILED;
+    }
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int SslServer::ticketKeyCallback(SSL* ssl, unsigned char* key_name, unsigned char* iv,
+                                 EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int encrypt) {
+    auto* self = static_cast<SslServer*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    if (!self) {
+        return -1;
+    }
+    
+    TicketKeyRing::Key key;
+    bool renew = false;
+    time_t now = time(nullptr);
+    if (encrypt) {
+        if (!self->ticket_keys_.current(now, key) || RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+            return -1;
+        }
+        std::memcpy(key_name, key.name, TicketKeyRing::kNameSize);
+    } else if (!self->ticket_keys_.find(key_name, now, key, renew)) {
+        return 0; // unknown or expired key: fall back to a full handshake
+    }
+    
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac_key, sizeof(key.hmac_key)),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end(),
+    };
+    if (EVP_MAC_CTX_set_params(mac, params) != 1) {
+        return -1;
+    }
+    
+    int result = encrypt ? EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes_key, iv)
+                         : EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes_key, iv);
+    if (result != 1) {
+        return -1;
+    }
+    return renew ? 2 : 1;
+}
+#endif
+
+std::string_view SslServer::negotiatedProtocol(SSL* ssl) {
+    const unsigned char* protocol = nullptr;
+    unsigned int length = 0;
+    SSL_get0_alpn_selected(ssl, &protocol, &length);
+    return protocol ? std::string_view(reinterpret_cast<const char*>(protocol), length) : std::string_view();
+}
+
+int SslServer::selectProtocol(SSL*, const unsigned char** out, unsigned char* out_length,
+                              const unsigned char* in, unsigned int in_length, void* arg) {
+    const SslServer* server = static_cast<const SslServer*>(arg);
+    const unsigned char* ours = server->http2_ ? kProtocolsWithHttp2 : kProtocolsHttp1;
+    unsigned int ours_length = server->http2_ ? sizeof(kProtocolsWithHttp2) - 1 : sizeof(kProtocolsHttp1) - 1;
+    
+    // Our preference wins; a client offering neither continues without ALPN
+    unsigned char* selected = nullptr;
+    if (SSL_select_next_proto(&selected, out_length, ours, ours_length, in, in_length) != OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
 std::string SslServer::getLastError() const {
     return getSslError();
 }
@@ -2,7 +2,53 @@
 
 #ifndef BUILD_WASM
 
-ThreadPool::ThreadPool(size_t num_threads) : is_running_(false) {
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Rounds of yielding before an idle worker parks on the condition variable
+constexpr int kSpinRounds = 64;
+
+// Identifies the pool and slot of the worker running on this thread
+struct WorkerIdentity {
+    const void* pool = nullptr;
+    size_t index = 0;
+    uint32_t random_state = 0;
+};
+
+thread_local WorkerIdentity current_worker;
+
+uint32_t nextRandom(uint32_t& state) {
+    // xorshift32: victim selection only needs to spread load
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void pinCurrentThread(size_t index) {
+#ifdef __linux__
+    unsigned cpu_count = std::thread::hardware_concurrency();
+    if (cpu_count == 0) {
+        return;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % cpu_count, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+    (void)index;
+#endif
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : injection_(kInjectionCapacity), overflow_size_(0), pending_(0), sleeping_(0),
+      is_running_(false), draining_(false), pin_threads_(false), steals_(0) {
     resize(num_threads);
 }
 
@@ -14,93 +60,199 @@ void ThreadPool::start() {
     if (is_running_) {
         return;
     }
-    
+
     is_running_ = true;
-    
-    for (auto& thread : threads_) {
-        thread = std::thread(&ThreadPool::workerLoop, this);
+
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->thread = std::thread(&ThreadPool::workerLoop, this, i);
     }
 }
 
 void ThreadPool::stop() {
+    shutdown(false);
+}
+
+void ThreadPool::drain() {
+    shutdown(true);
+}
+
+void ThreadPool::shutdown(bool drain) {
     if (!is_running_) {
         return;
     }
-    
-    is_running_ = false;
-    condition_.notify_all();
-    
-    for (auto& thread : threads_) {
-        if (thread.joinable()) {
-            thread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        draining_ = drain;
+        is_running_ = false;
+    }
+    idle_condition_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    draining_ = false;
+
+    // Tasks left on worker deques move to the shared queue so they survive
+    // a resize and run after the next start()
+    for (auto& worker : workers_) {
+        Task* task;
+        while (worker->deque.pop(task)) {
+            std::lock_guard<std::mutex> lock(overflow_mutex_);
+            overflow_.push_back(std::move(*task));
+            overflow_size_.fetch_add(1);
+            delete task;
         }
     }
 }
 
 void ThreadPool::enqueue(Task task) {
-    if (!is_running_) {
-        return;
-    }
-    
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        tasks_.push(std::move(task));
+    // Tasks submitted before start() are kept and run once workers exist.
+    // Counting first means a worker that takes the task never sees the
+    // count drop below zero.
+    pending_.fetch_add(1);
+
+    if (current_worker.pool == this && is_running_) {
+        workers_[current_worker.index]->deque.push(new Task(std::move(task)));
+    } else if (!injection_.tryPush(std::move(task))) {
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        overflow_.push_back(std::move(task));
+        overflow_size_.fetch_add(1);
     }
-    
-    condition_.notify_one();
+
+    wakeOne();
 }
 
 void ThreadPool::resize(size_t new_size) {
     if (new_size == 0) {
         new_size = 1;
     }
-    
+
     bool was_running = is_running_;
-    
+
     if (was_running) {
         stop();
     }
-    
-    threads_.clear();
-    threads_.resize(new_size);
-    
+
+    workers_.clear();
+    for (size_t i = 0; i < new_size; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+
     if (was_running) {
         start();
     }
 }
 
-size_t ThreadPool::getQueueSize() const {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    return tasks_.size();
+void ThreadPool::wakeOne() {
+    // Pairs with the sleeping_ increment in workerLoop: either the worker
+    // sees pending_ > 0 before waiting, or we see it sleeping and notify
+    if (sleeping_.load() > 0) {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        idle_condition_.notify_one();
+    }
 }
 
-void ThreadPool::workerLoop() {
-    while (is_running_) {
-        Task task;
-        
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            condition_.wait(lock, [this] { return !tasks_.empty() || !is_running_; });
-            
-            if (!is_running_) {
-                break;
-            }
-            
-            if (!tasks_.empty()) {
-                task = std::move(tasks_.front());
-                tasks_.pop();
-            }
+bool ThreadPool::takeInjected(Task& task) {
+    if (injection_.tryPop(task)) {
+        return true;
+    }
+    if (overflow_size_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(overflow_mutex_);
+    if (overflow_.empty()) {
+        return false;
+    }
+    task = std::move(overflow_.front());
+    overflow_.pop_front();
+    overflow_size_.fetch_sub(1);
+    return true;
+}
+
+bool ThreadPool::stealTask(size_t index, Task& task) {
+    size_t count = workers_.size();
+    if (count < 2) {
+        return false;
+    }
+
+    size_t start = nextRandom(current_worker.random_state) % count;
+    for (size_t i = 0; i < count; ++i) {
+        size_t victim = (start + i) % count;
+        if (victim == index) {
+            continue;
         }
-        
-        if (task) {
+        Task* stolen;
+        if (workers_[victim]->deque.steal(stolen)) {
+            task = std::move(*stolen);
+            delete stolen;
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::takeTask(size_t index, Task& task) {
+    Task* local;
+    if (workers_[index]->deque.pop(local)) {
+        task = std::move(*local);
+        delete local;
+        return true;
+    }
+    return takeInjected(task) || stealTask(index, task);
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    current_worker.pool = this;
+    current_worker.index = index;
+    current_worker.random_state = static_cast<uint32_t>(index) * 2654435761u + 1;
+
+    if (pin_threads_) {
+        pinCurrentThread(index);
+    }
+
+    int idle_rounds = 0;
+    while (is_running_ || draining_) {
+        Task task;
+        if (takeTask(index, task)) {
+            pending_.fetch_sub(1);
+            idle_rounds = 0;
             try {
                 task();
             } catch (const std::exception& e) {
                 // Log exception if needed
                 // For now, just continue processing
             }
+            continue;
         }
+
+        if (!is_running_) {
+            // Draining: done once nothing is queued. A task counted but not
+            // yet visible (or on a peer's deque being popped) is worth a yield.
+            if (pending_.load() == 0) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (++idle_rounds < kSpinRounds) {
+            std::this_thread::yield();
+            continue;
+        }
+        idle_rounds = 0;
+
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        sleeping_.fetch_add(1);
+        idle_condition_.wait(lock, [this] { return pending_.load() > 0 || !is_running_; });
+        sleeping_.fetch_sub(1);
     }
+
+    current_worker = WorkerIdentity();
 }
 
 #endif // BUILD_WASM
@@ -0,0 +1,93 @@
+#include "timer_wheel.h"
+
+namespace {
+constexpr uint64_t kSlotMask = TimerWheel::kSlots - 1;
+constexpr uint64_t kMaxDelay = (uint64_t(1) << (TimerWheel::kLevels * TimerWheel::kSlotBits)) - 1;
+}
+
+void TimerWheel::Timer::unlink() {
+    if (next_) {
+        prev_->next_ = next_;
+        next_->prev_ = prev_;
+        prev_ = nullptr;
+        next_ = nullptr;
+    }
+}
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, Clock::time_point start)
+    : tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1)), start_(start), current_(0) {
+    for (auto& level : slots_) {
+        for (Timer& sentinel : level) {
+            sentinel.prev_ = &sentinel;
+            sentinel.next_ = &sentinel;
+        }
+    }
+}
+
+void TimerWheel::arm(Timer& timer, Clock::time_point deadline) {
+    timer.unlink();
+
+    // Rounded up, so a timer never fires before its deadline
+    uint64_t expiry = current_ + 1;
+    if (deadline > start_) {
+        auto ticks = static_cast<uint64_t>((deadline - start_ + tick_ - Clock::duration(1)) / tick_);
+        if (ticks > expiry) {
+            expiry = ticks - current_ > kMaxDelay ? current_ + kMaxDelay : ticks;
+        }
+    }
+    timer.expiry_ = expiry;
+    insert(timer);
+}
+
+void TimerWheel::advance(Clock::time_point now, std::vector<uint64_t>& expired) {
+    if (now <= start_) {
+        return;
+    }
+    auto target = static_cast<uint64_t>((now - start_) / tick_);
+    while (current_ < target) {
+        ++current_;
+
+        // A level below completing its turn brings the next slot of this one
+        // down; the timers in it land at lower levels
+        if ((current_ & kSlotMask) == 0) {
+            for (size_t level = 1; level < kLevels; ++level) {
+                size_t index = (current_ >> (level * kSlotBits)) & kSlotMask;
+                cascade(level, index);
+                if (index != 0) {
+                    break;
+                }
+            }
+        }
+
+        Timer& due = slots_[0][current_ & kSlotMask];
+        while (due.next_ != &due) {
+            Timer* timer = due.next_;
+            timer->unlink();
+            expired.push_back(timer->tag_);
+        }
+    }
+}
+
+void TimerWheel::insert(Timer& timer) {
+    // The lowest level whose span still covers the delay
+    uint64_t delay = timer.expiry_ - current_;
+    size_t level = 0;
+    while (level + 1 < kLevels && delay >= (uint64_t(1) << ((level + 1) * kSlotBits))) {
+        ++level;
+    }
+    Timer& sentinel = slots_[level][(timer.expiry_ >> (level * kSlotBits)) & kSlotMask];
+
+    timer.prev_ = sentinel.prev_;
+    timer.next_ = &sentinel;
+    sentinel.prev_->next_ = &timer;
+    sentinel.prev_ = &timer;
+}
+
+void TimerWheel::cascade(size_t level, size_t index) {
+    Timer& sentinel = slots_[level][index];
+    while (sentinel.next_ != &sentinel) {
+        Timer* timer = sentinel.next_;
+        timer->unlink();
+        insert(*timer);
+    }
+}
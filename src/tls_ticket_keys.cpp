@@ -0,0 +1,90 @@
+#include "tls_ticket_keys.h"
+
+#ifdef ENABLE_SSL
+#ifndef BUILD_WASM
+
+#include <cstring>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+
+TicketKeyRing::TicketKeyRing(int rotation_seconds, size_t retained_keys)
+    : rotation_seconds_(rotation_seconds > 0 ? rotation_seconds : kDefaultRotationSeconds),
+      retained_keys_(retained_keys), rotations_(0) {
+}
+
+void TicketKeyRing::setRotationInterval(int seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rotation_seconds_ = seconds > 0 ? seconds : kDefaultRotationSeconds;
+}
+
+int TicketKeyRing::getRotationInterval() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rotation_seconds_;
+}
+
+bool TicketKeyRing::current(time_t now, Key& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rotateIfDueLocked(now);
+    if (keys_.empty()) {
+        return false;
+    }
+    key = keys_.front();
+    return true;
+}
+
+bool TicketKeyRing::find(const unsigned char* name, time_t now, Key& key, bool& renew) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rotateIfDueLocked(now);
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        if (CRYPTO_memcmp(keys_[i].name, name, kNameSize) == 0) {
+            key = keys_[i];
+            renew = i != 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TicketKeyRing::rotate(time_t now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rotateLocked(now);
+}
+
+size_t TicketKeyRing::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return keys_.size();
+}
+
+uint64_t TicketKeyRing::getRotationCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rotations_;
+}
+
+bool TicketKeyRing::rotateLocked(time_t now) {
+    Key key;
+    if (RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+        RAND_bytes(key.aes_key, sizeof(key.aes_key)) != 1 ||
+        RAND_bytes(key.hmac_key, sizeof(key.hmac_key)) != 1) {
+        return false;
+    }
+    key.created = now;
+
+    if (!keys_.empty()) {
+        ++rotations_;
+    }
+    keys_.push_front(key);
+    while (keys_.size() > retained_keys_ + 1) {
+        OPENSSL_cleanse(&keys_.back(), sizeof(Key));
+        keys_.pop_back();
+    }
+    return true;
+}
+
+void TicketKeyRing::rotateIfDueLocked(time_t now) {
+    if (keys_.empty() || now - keys_.front().created >= rotation_seconds_) {
+        rotateLocked(now);
+    }
+}
+
+#endif // BUILD_WASM
+#endif // ENABLE_SSL
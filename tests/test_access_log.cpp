@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "access_log.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class AccessLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        entry.method = HttpRequest::Method::GET;
+        entry.path = "/api/items";
+        entry.version = "HTTP/1.1";
+        entry.status = 200;
+        entry.bytes = 1234;
+        entry.latency_us = 56;
+        entry.client_address = "192.168.1.20";
+        entry.tls = true;
+        entry.tls_resumed = true;
+    }
+
+    void TearDown() override {}
+
+    std::string format(AccessLog::Format format, uint64_t timestamp) {
+        std::vector<char> buffer(AccessLog::maxRecordSize(entry, format));
+        size_t size = format == AccessLog::Format::BINARY
+                          ? AccessLog::formatBinary(entry, timestamp, buffer.data())
+                          : AccessLog::formatJson(entry, timestamp, buffer.data());
+        EXPECT_LE(size, buffer.size());
+        return std::string(buffer.data(), size);
+    }
+
+    static uint64_t readLittleEndian(const std::string& record, size_t offset, size_t width) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < width; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(record[offset + i])) << (8 * i);
+        }
+        return value;
+    }
+
+    AccessLog::Entry entry;
+};
+
+TEST_F(AccessLogTest, FormatsJsonLine) {
+    EXPECT_EQ(format(AccessLog::Format::JSON_LINES, 1700000000123),
+              "{\"ts\":1700000000123,\"client\":\"192.168.1.20\",\"method\":\"GET\",\"path\":\"/api/items\","
+              "\"version\":\"HTTP/1.1\",\"status\":200,\"bytes\":1234,\"latency_us\":56,\"tls\":true,"
+              "\"resumed\":true}\n");
+}
+
+TEST_F(AccessLogTest, EscapesJsonStrings) {
+    entry.path = "/a\"b\\c\x01";
+    std::string line = format(AccessLog::Format::JSON_LINES, 0);
+    EXPECT_NE(line.find("\"path\":\"/a\\\"b\\\\c\\u0001\""), std::string::npos);
+}
+
+TEST_F(AccessLogTest, WorstCaseJsonFitsItsBound) {
+    std::string path(AccessLog::kMaxPathSize + 100, '\x02');
+    entry.path = path;
+    std::string line = format(AccessLog::Format::JSON_LINES, UINT64_MAX);
+    EXPECT_EQ(line.back(), '\n');
+    EXPECT_NE(line.find("\"resumed\":true}"), std::string::npos);
+}
+
+TEST_F(AccessLogTest, FormatsBinaryRecord) {
+    std::string record = format(AccessLog::Format::BINARY, 1700000000123456);
+
+    ASSERT_EQ(record.size(), AccessLog::kBinaryHeaderSize + entry.path.size());
+    EXPECT_EQ(readLittleEndian(record, 0, 2), record.size());
+    EXPECT_EQ(readLittleEndian(record, 2, 1), AccessLog::kBinaryVersion);
+    EXPECT_EQ(readLittleEndian(record, 3, 1), static_cast<uint64_t>(HttpRequest::Method::GET));
+    EXPECT_EQ(readLittleEndian(record, 4, 2), 200u);
+    EXPECT_EQ(readLittleEndian(record, 6, 1), uint64_t{AccessLog::kFlagTls | AccessLog::kFlagTlsResumed});
+    EXPECT_EQ(readLittleEndian(record, 8, 8), 1700000000123456u);
+    EXPECT_EQ(readLittleEndian(record, 16, 8), 1234u);
+    EXPECT_EQ(readLittleEndian(record, 24, 4), 56u);
+    EXPECT_EQ(record.substr(28, 4), std::string("\xc0\xa8\x01\x14", 4));
+    EXPECT_EQ(readLittleEndian(record, 32, 2), entry.path.size());
+    EXPECT_EQ(record.substr(AccessLog::kBinaryHeaderSize), "/api/items");
+}
+
+TEST_F(AccessLogTest, BinaryRecordZeroesNonIpv4Clients) {
+    entry.client_address = "::1";
+    entry.latency_us = UINT64_MAX;
+    std::string record = format(AccessLog::Format::BINARY, 0);
+    EXPECT_EQ(readLittleEndian(record, 28, 4), 0u);
+    EXPECT_EQ(readLittleEndian(record, 24, 4), UINT32_MAX);
+}
+
+TEST_F(AccessLogTest, SamplesAboutTheConfiguredRate) {
+    AccessLog log;
+    EXPECT_FALSE(log.sample());
+
+    log.enable(AccessLog::Format::JSON_LINES, 1.0);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(log.sample());
+    }
+
+    // The largest rate below 1 lands at the very top of the threshold range
+    log.enable(AccessLog::Format::JSON_LINES, std::nextafter(1.0, 0.0));
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(log.sample());
+    }
+
+    log.enable(AccessLog::Format::JSON_LINES, 0.01);
+    int sampled = 0;
+    for (int i = 0; i < 100000; ++i) {
+        sampled += log.sample() ? 1 : 0;
+    }
+    EXPECT_GT(sampled, 700);
+    EXPECT_LT(sampled, 1300);
+
+    log.enable(AccessLog::Format::JSON_LINES, 0.0);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_FALSE(log.sample());
+    }
+
+    log.disable();
+    EXPECT_FALSE(log.isEnabled());
+}
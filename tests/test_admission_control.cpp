@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include "admission_control.h"
+
+class AdmissionControlTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    AdmissionControl admission;
+};
+
+TEST_F(AdmissionControlTest, UnlimitedByDefault) {
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(admission.tryAdmit("10.0.0.1"));
+    }
+    EXPECT_EQ(admission.getActiveConnections(), 1000u);
+    EXPECT_EQ(admission.getRejectedCount(), 0u);
+}
+
+TEST_F(AdmissionControlTest, EnforcesGlobalLimit) {
+    admission.setMaxConnections(2);
+
+    EXPECT_TRUE(admission.tryAdmit("10.0.0.1"));
+    EXPECT_TRUE(admission.tryAdmit("10.0.0.2"));
+    EXPECT_FALSE(admission.tryAdmit("10.0.0.3"));
+    EXPECT_EQ(admission.getActiveConnections(), 2u);
+    EXPECT_EQ(admission.getRejectedCount(), 1u);
+
+    admission.release("10.0.0.1");
+    EXPECT_TRUE(admission.tryAdmit("10.0.0.3"));
+}
+
+TEST_F(AdmissionControlTest, EnforcesPerClientLimit) {
+    admission.setMaxConnectionsPerClient(2);
+
+    EXPECT_TRUE(admission.tryAdmit("10.0.0.1"));
+    EXPECT_TRUE(admission.tryAdmit("10.0.0.1"));
+    EXPECT_FALSE(admission.tryAdmit("10.0.0.1"));
+    EXPECT_TRUE(admission.tryAdmit("10.0.0.2")); // other clients are unaffected
+    EXPECT_EQ(admission.getActiveConnections("10.0.0.1"), 2u);
+    EXPECT_EQ(admission.getActiveConnections(), 3u);
+
+    admission.release("10.0.0.1");
+    EXPECT_EQ(admission.getActiveConnections("10.0.0.1"), 1u);
+    EXPECT_TRUE(admission.tryAdmit("10.0.0.1"));
+
+    admission.release("10.0.0.2");
+    EXPECT_EQ(admission.getActiveConnections("10.0.0.2"), 0u);
+}
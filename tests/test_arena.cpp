@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "arena.h"
+#include "http_request.h"
+#include "http_response.h"
+#include "request_parser.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ArenaTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static bool isAligned(const void* pointer, size_t alignment) {
+        return reinterpret_cast<uintptr_t>(pointer) % alignment == 0;
+    }
+};
+
+TEST_F(ArenaTest, AllocatesAlignedFromOneBlock) {
+    Arena arena(1024);
+    EXPECT_EQ(arena.getCapacity(), 0u);
+
+    void* first = arena.allocate(3, 1);
+    void* second = arena.allocate(16, 16);
+    void* third = arena.allocate(8, 8);
+    EXPECT_TRUE(isAligned(second, 16));
+    EXPECT_TRUE(isAligned(third, 8));
+    EXPECT_LT(first, second);
+    EXPECT_LT(second, third);
+    EXPECT_EQ(arena.getUsed(), 27u);
+    EXPECT_EQ(arena.getCapacity(), 1024u);
+}
+
+TEST_F(ArenaTest, ResetReusesTheSameMemory) {
+    Arena arena(256);
+    void* first = arena.allocate(100, 8);
+    EXPECT_NE(arena.allocate(200, 8), nullptr); // spills into a second block
+    size_t capacity = arena.getCapacity();
+    EXPECT_GT(capacity, 256u);
+
+    arena.reset();
+    EXPECT_EQ(arena.getUsed(), 0u);
+    EXPECT_EQ(arena.allocate(100, 8), first);
+    EXPECT_NE(arena.allocate(200, 8), nullptr);
+    EXPECT_EQ(arena.getCapacity(), capacity);
+}
+
+TEST_F(ArenaTest, OversizedAllocationsGetTheirOwnBlock) {
+    Arena arena(128);
+    char* large = static_cast<char*>(arena.allocate(4096, 64));
+    EXPECT_TRUE(isAligned(large, 64));
+    large[0] = 'a';
+    large[4095] = 'z';
+    EXPECT_GE(arena.getCapacity(), 4096u);
+}
+
+TEST_F(ArenaTest, ResetTrimsLongChains) {
+    Arena arena(64);
+    for (int i = 0; i < 32; ++i) {
+        ASSERT_NE(arena.allocate(64, 1), nullptr);
+    }
+    size_t grown = arena.getCapacity();
+
+    arena.reset();
+    EXPECT_LT(arena.getCapacity(), grown);
+    EXPECT_LE(arena.getCapacity(), (Arena::kMaxRetainedBlocks + 1) * (64 + 1));
+}
+
+TEST_F(ArenaTest, BacksStandardContainers) {
+    Arena arena;
+    std::pmr::vector<std::pmr::string> words(&arena);
+    for (int i = 0; i < 100; ++i) {
+        words.emplace_back("a string long enough to leave the small buffer " + std::to_string(i));
+    }
+    EXPECT_EQ(words[99], "a string long enough to leave the small buffer 99");
+    EXPECT_EQ(words[0].get_allocator().resource(), &arena);
+    EXPECT_GT(arena.getUsed(), 0u);
+}
+
+TEST_F(ArenaTest, RequestAndResponseLiveInTheArena) {
+    Arena arena;
+    {
+        std::string raw = "GET /search?q=arena%20test&page=2 HTTP/1.1\r\n"
+                          "Host: localhost\r\n"
+                          "X-Long-Header: a value that does not fit the small string buffer\r\n\r\n";
+        RequestParser parser;
+        ASSERT_EQ(parser.parse(raw, true), RequestParser::Status::COMPLETE);
+
+        HttpRequest request(&arena);
+        ASSERT_TRUE(request.load(raw, parser));
+        EXPECT_EQ(request.getPath(), "/search");
+        EXPECT_EQ(request.getQueryParam("q"), "arena test");
+        EXPECT_EQ(request.getQueryParam("page"), "2");
+        EXPECT_EQ(request.getHeader("host"), "localhost");
+        EXPECT_EQ(request.getQueryParams().get_allocator().resource(), &arena);
+
+        HttpResponse response(&arena);
+        response.setHeader("Content-Type", "application/json");
+        response.setHeader("X-Request-Path", request.getPath());
+        EXPECT_EQ(response.getHeader("x-request-path"), "/search");
+        EXPECT_GT(arena.getUsed(), 0u);
+
+        // Copies leave the arena
+        HeaderMap copy = request.getHeaders();
+        EXPECT_EQ(copy.get("host"), "localhost");
+    }
+    arena.reset();
+    EXPECT_EQ(arena.getUsed(), 0u);
+}
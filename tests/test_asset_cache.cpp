@@ -0,0 +1,237 @@
+#include <gtest/gtest.h>
+#include "asset_cache.h"
+#include "compression.h"
+#include "http_date.h"
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+class AssetCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char pattern[] = "/tmp/asset_cache_test_XXXXXX";
+        directory = mkdtemp(pattern);
+    }
+
+    void TearDown() override {
+        for (const auto& path : created) {
+            std::remove(path.c_str());
+        }
+        rmdir(directory.c_str());
+    }
+
+    std::string writeFile(const std::string& name, const std::string& content) {
+        std::string path = directory + "/" + name;
+        std::ofstream(path, std::ios::binary) << content;
+        created.push_back(path);
+        return path;
+    }
+
+    std::string directory;
+    std::vector<std::string> created;
+};
+
+TEST_F(AssetCacheTest, BuildsAssetWithStableValidators) {
+    std::string path = writeFile("index.html", "<html><body>hello</body></html>");
+    AssetCache cache;
+
+    auto asset = cache.get(CachedFile::open(path));
+    ASSERT_NE(asset, nullptr);
+    EXPECT_EQ(asset->content_type, "text/html");
+    EXPECT_EQ(*asset->variant(compression::Encoding::IDENTITY).body, "<html><body>hello</body></html>");
+
+    const std::string& etag = asset->variant(compression::Encoding::IDENTITY).etag;
+    ASSERT_GE(etag.size(), 2u);
+    EXPECT_EQ(etag.front(), '"');
+    EXPECT_EQ(etag.back(), '"');
+
+    // Too small to be worth compressing
+    EXPECT_FALSE(asset->hasCompressedVariants());
+
+    // Reopening the same file is a hit with the same asset
+    auto again = cache.get(CachedFile::open(path));
+    EXPECT_EQ(again, asset);
+    EXPECT_EQ(cache.getHits(), 1u);
+    EXPECT_EQ(cache.getMisses(), 1u);
+
+    // An identical file elsewhere gets the same ETag (content-derived)
+    std::string copy = writeFile("copy.html", "<html><body>hello</body></html>");
+    EXPECT_EQ(cache.get(CachedFile::open(copy))->variant(compression::Encoding::IDENTITY).etag, etag);
+}
+
+TEST_F(AssetCacheTest, MatchesEtagLists) {
+    EXPECT_TRUE(etagMatches("\"abc\"", "\"abc\""));
+    EXPECT_TRUE(etagMatches("\"x\", W/\"abc\"", "\"abc\""));
+    EXPECT_TRUE(etagMatches("*", "\"abc\""));
+    EXPECT_FALSE(etagMatches("\"abcd\"", "\"abc\""));
+    EXPECT_FALSE(etagMatches("", "\"abc\""));
+}
+
+TEST_F(AssetCacheTest, SelectsAcceptedEncoding) {
+    if (!compression::isAvailable(compression::Encoding::GZIP)) {
+        GTEST_SKIP() << "built without zlib";
+    }
+
+    std::string text;
+    for (int i = 0; i < 200; ++i) {
+        text += "body { margin: 0; padding: 0; }\n";
+    }
+    std::string path = writeFile("site.css", text);
+    AssetCache cache;
+
+    auto asset = cache.get(CachedFile::open(path));
+    ASSERT_NE(asset, nullptr);
+    ASSERT_TRUE(asset->hasCompressedVariants());
+
+    EXPECT_EQ(asset->selectEncoding(""), compression::Encoding::IDENTITY);
+    EXPECT_EQ(asset->selectEncoding("gzip"), compression::Encoding::GZIP);
+    EXPECT_EQ(asset->selectEncoding("gzip;q=0, deflate"), compression::Encoding::IDENTITY);
+    if (compression::isAvailable(compression::Encoding::BROTLI)) {
+        EXPECT_EQ(asset->selectEncoding("gzip, deflate, br"), compression::Encoding::BROTLI);
+        EXPECT_EQ(asset->selectEncoding("gzip, br;q=0.5"), compression::Encoding::GZIP);
+    }
+
+    // Every variant has its own validator, and any of them revalidates
+    const std::string& gzip_etag = asset->variant(compression::Encoding::GZIP).etag;
+    EXPECT_NE(gzip_etag, asset->variant(compression::Encoding::IDENTITY).etag);
+    EXPECT_TRUE(asset->matchesEtag(gzip_etag));
+
+#ifdef HAVE_ZLIB
+    const std::string& compressed = *asset->variant(compression::Encoding::GZIP).body;
+    EXPECT_LT(compressed.size(), text.size());
+
+    std::string inflated(text.size(), '\0');
+    z_stream stream{};
+    ASSERT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&inflated[0]);
+    stream.avail_out = static_cast<uInt>(inflated.size());
+    EXPECT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+    inflateEnd(&stream);
+    EXPECT_EQ(inflated, text);
+#endif
+}
+
+TEST_F(AssetCacheTest, RebuildsWhenFileChanges) {
+    std::string path = writeFile("app.js", "console.log(1);");
+    AssetCache cache;
+
+    auto original = cache.get(CachedFile::open(path));
+    ASSERT_NE(original, nullptr);
+
+    std::string replacement = writeFile("app.js.new", "console.log(2);");
+    ASSERT_EQ(std::rename(replacement.c_str(), path.c_str()), 0);
+
+    auto rebuilt = cache.get(CachedFile::open(path));
+    ASSERT_NE(rebuilt, nullptr);
+    EXPECT_NE(rebuilt, original);
+    EXPECT_EQ(*rebuilt->variant(compression::Encoding::IDENTITY).body, "console.log(2);");
+    EXPECT_NE(rebuilt->variant(compression::Encoding::IDENTITY).etag,
+              original->variant(compression::Encoding::IDENTITY).etag);
+    EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST_F(AssetCacheTest, StaysWithinMemoryBound) {
+    AssetCache cache(4096, 2048);
+    std::string a = writeFile("a.bin", std::string(1500, 'a'));
+    std::string b = writeFile("b.bin", std::string(1500, 'b'));
+    std::string c = writeFile("c.bin", std::string(1500, 'c'));
+    std::string big = writeFile("big.bin", std::string(3000, 'x'));
+
+    cache.get(CachedFile::open(a));
+    cache.get(CachedFile::open(b));
+    cache.get(CachedFile::open(c));
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_LE(cache.getMemoryUsage(), 4096u);
+
+    // Over the per-asset limit: left to the sendfile path
+    EXPECT_EQ(cache.get(CachedFile::open(big)), nullptr);
+}
+
+TEST_F(AssetCacheTest, CompressesLargeFilesOnce) {
+    if (!compression::isAvailable(compression::Encoding::GZIP)) {
+        GTEST_SKIP() << "built without zlib";
+    }
+
+    std::string text;
+    for (int i = 0; i < 20000; ++i) {
+        text += "line " + std::to_string(i % 100) + " of a large log file\n";
+    }
+    std::string path = writeFile("large.log", text);
+    CompressedFileCache cache;
+
+    auto compressed = cache.get(CachedFile::open(path), compression::Encoding::GZIP);
+    ASSERT_NE(compressed, nullptr);
+    EXPECT_LT(compressed->size(), text.size() / 4);
+
+    // Later requests share the same bytes instead of redoing the work
+    EXPECT_EQ(cache.get(CachedFile::open(path), compression::Encoding::GZIP), compressed);
+    EXPECT_EQ(cache.getHits(), 1u);
+    EXPECT_EQ(cache.getMisses(), 1u);
+    EXPECT_EQ(cache.get(CachedFile::open(path), compression::Encoding::IDENTITY), nullptr);
+
+#ifdef HAVE_ZLIB
+    std::string inflated(text.size(), '\0');
+    z_stream stream{};
+    ASSERT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed->data()));
+    stream.avail_in = static_cast<uInt>(compressed->size());
+    stream.next_out = reinterpret_cast<Bytef*>(&inflated[0]);
+    stream.avail_out = static_cast<uInt>(inflated.size());
+    EXPECT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+    inflateEnd(&stream);
+    EXPECT_EQ(inflated, text);
+#endif
+
+    // A changed file is compressed again
+    std::string replacement = writeFile("large.log.new", text + "one more line\n");
+    ASSERT_EQ(std::rename(replacement.c_str(), path.c_str()), 0);
+    auto rebuilt = cache.get(CachedFile::open(path), compression::Encoding::GZIP);
+    ASSERT_NE(rebuilt, nullptr);
+    EXPECT_NE(rebuilt, compressed);
+    EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST_F(AssetCacheTest, CompressedFilesStayWithinLimits) {
+    if (!compression::isAvailable(compression::Encoding::GZIP)) {
+        GTEST_SKIP() << "built without zlib";
+    }
+
+    // Random-looking bytes do not shrink; the verdict is remembered
+    std::string noise;
+    uint32_t state = 12345;
+    for (int i = 0; i < 200000; ++i) {
+        state = state * 1103515245 + 12345;
+        noise.push_back(static_cast<char>(state >> 24));
+    }
+    std::string noisy = writeFile("noise.txt", noise);
+    CompressedFileCache cache(64 * 1024, 16 * 1024);
+    EXPECT_EQ(cache.get(CachedFile::open(noisy), compression::Encoding::GZIP), nullptr);
+    EXPECT_EQ(cache.get(CachedFile::open(noisy), compression::Encoding::GZIP), nullptr);
+    EXPECT_EQ(cache.getHits(), 1u);
+
+    // Compressible, but its compressed form outgrows the entry limit
+    std::string text;
+    for (int i = 0; i < 200000; ++i) {
+        text += std::to_string(state = state * 1103515245 + 12345) + "\n";
+    }
+    EXPECT_EQ(cache.get(CachedFile::open(writeFile("big.txt", text)), compression::Encoding::GZIP), nullptr);
+    EXPECT_LE(cache.getMemoryUsage(), 64u * 1024);
+}
+
+TEST_F(AssetCacheTest, FormatsAndParsesHttpDates) {
+    EXPECT_EQ(http_date::format(784111777), "Sun, 06 Nov 1994 08:49:37 GMT");
+
+    time_t parsed = 0;
+    ASSERT_TRUE(http_date::parse("Sun, 06 Nov 1994 08:49:37 GMT", parsed));
+    EXPECT_EQ(parsed, 784111777);
+
+    EXPECT_FALSE(http_date::parse("Sunday, 06-Nov-94 08:49:37 GMT", parsed));
+    EXPECT_FALSE(http_date::parse("Sun, 06 Foo 1994 08:49:37 GMT", parsed));
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "body_stream.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+class BodyStreamTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(BodyStreamTest, TakesWhatWasWrittenInOrder) {
+    int notifications = 0;
+    BodyStream stream([&notifications]() { ++notifications; });
+
+    EXPECT_FALSE(stream.isReady());
+    EXPECT_TRUE(stream.write("hello "));
+    EXPECT_TRUE(stream.write("world"));
+    EXPECT_EQ(notifications, 1); // once until the loop has taken
+    EXPECT_TRUE(stream.isReady());
+
+    std::string out;
+    EXPECT_EQ(stream.take(out), BodyStream::State::OPEN);
+    EXPECT_EQ(out, "hello world");
+    EXPECT_FALSE(stream.isReady());
+
+    EXPECT_TRUE(stream.write("!"));
+    EXPECT_EQ(notifications, 2);
+    stream.close();
+    EXPECT_FALSE(stream.isOpen());
+    EXPECT_FALSE(stream.write("ignored"));
+
+    EXPECT_EQ(stream.take(out), BodyStream::State::ENDED);
+    EXPECT_EQ(out, "hello world!");
+}
+
+TEST_F(BodyStreamTest, WritersWaitForTheLoopToDrain) {
+    BodyStream stream(nullptr);
+    std::string block(BodyStream::kHighWaterMark, 'x');
+    ASSERT_TRUE(stream.write(block));
+
+    std::atomic<bool> written{false};
+    std::thread writer([&]() {
+        stream.write("more");
+        written = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(written);
+
+    std::string out;
+    stream.take(out);
+    writer.join();
+    EXPECT_TRUE(written);
+    out.clear();
+    stream.take(out);
+    EXPECT_EQ(out, "more");
+}
+
+TEST_F(BodyStreamTest, AbortWakesBlockedWriters) {
+    int notifications = 0;
+    BodyStream stream([&notifications]() { ++notifications; });
+    ASSERT_TRUE(stream.write(std::string(BodyStream::kHighWaterMark, 'x')));
+
+    std::atomic<bool> result{true};
+    std::thread writer([&]() { result = stream.write("more"); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    stream.abort();
+    writer.join();
+
+    EXPECT_FALSE(result);
+    EXPECT_FALSE(stream.isOpen());
+    stream.close();
+    EXPECT_EQ(notifications, 1);
+}
+
+TEST_F(BodyStreamTest, FailureIsNotAnEnd) {
+    BodyStream stream(nullptr);
+    ASSERT_TRUE(stream.write("partial"));
+    stream.fail();
+    stream.close();
+
+    std::string out;
+    EXPECT_EQ(stream.take(out), BodyStream::State::FAILED);
+    EXPECT_TRUE(out.empty());
+}
+
+TEST_F(BodyStreamTest, FormatsServerSentEvents) {
+    std::string out;
+    BodyStream::appendEvent(out, "one");
+    EXPECT_EQ(out, "data: one\n\n");
+
+    out.clear();
+    BodyStream::appendEvent(out, "first line\nsecond line", "update", "42");
+    EXPECT_EQ(out, "event: update\nid: 42\ndata: first line\ndata: second line\n\n");
+
+    BodyStream stream(nullptr);
+    ASSERT_TRUE(stream.sendEvent("{\"n\":1}", "tick"));
+    out.clear();
+    stream.take(out);
+    EXPECT_EQ(out, "event: tick\ndata: {\"n\":1}\n\n");
+}
+
+TEST_F(BodyStreamTest, EncodedBatchesDecodeAsTheyAreTaken) {
+    BodyStream identity(nullptr);
+    EXPECT_FALSE(identity.encode(compression::Encoding::IDENTITY));
+#ifdef HAVE_ZLIB
+    BodyStream stream(nullptr);
+    ASSERT_TRUE(stream.encode(compression::Encoding::GZIP));
+
+    z_stream inflater{};
+    ASSERT_EQ(inflateInit2(&inflater, 15 + 16), Z_OK);
+    auto inflateTaken = [&inflater](std::string& taken, int& result) {
+        std::string inflated(256, '\0');
+        inflater.next_in = reinterpret_cast<Bytef*>(&taken[0]);
+        inflater.avail_in = static_cast<uInt>(taken.size());
+        inflater.next_out = reinterpret_cast<Bytef*>(&inflated[0]);
+        inflater.avail_out = static_cast<uInt>(inflated.size());
+        result = inflate(&inflater, Z_SYNC_FLUSH);
+        inflated.resize(inflated.size() - inflater.avail_out);
+        taken.clear();
+        return inflated;
+    };
+
+    // Each batch is flushed: the first event decodes before the second exists
+    std::string taken;
+    int result = Z_OK;
+    ASSERT_TRUE(stream.sendEvent("one"));
+    EXPECT_EQ(stream.take(taken), BodyStream::State::OPEN);
+    EXPECT_EQ(inflateTaken(taken, result), "data: one\n\n");
+
+    ASSERT_TRUE(stream.sendEvent("two"));
+    stream.close();
+    EXPECT_EQ(stream.take(taken), BodyStream::State::ENDED);
+    EXPECT_EQ(inflateTaken(taken, result), "data: two\n\n");
+    EXPECT_EQ(result, Z_STREAM_END);
+    inflateEnd(&inflater);
+#endif
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include "compression.h"
+
+#include <string>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+class CompressionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (int i = 0; i < 2000; ++i) {
+            text += "{\"id\":" + std::to_string(i) + ",\"status\":\"active\"}\n";
+        }
+    }
+
+    void TearDown() override {}
+
+    // Feed `text` through `compressor` in uneven pieces
+    std::string compressInPieces(compression::Compressor& compressor) {
+        std::string output;
+        EXPECT_TRUE(compressor.begin());
+        for (size_t offset = 0; offset < text.size(); offset += 7001) {
+            EXPECT_TRUE(compressor.update(std::string_view(text).substr(offset, 7001), output));
+        }
+        EXPECT_TRUE(compressor.finish(output));
+        return output;
+    }
+
+    std::string text;
+};
+
+TEST_F(CompressionTest, NegotiatesTheBestAvailableCoding) {
+    using compression::Encoding;
+    EXPECT_EQ(compression::negotiate(""), Encoding::IDENTITY);
+    EXPECT_EQ(compression::negotiate("identity, deflate"), Encoding::IDENTITY);
+    if (compression::isAvailable(Encoding::GZIP)) {
+        EXPECT_EQ(compression::negotiate("gzip"), Encoding::GZIP);
+        EXPECT_EQ(compression::negotiate("gzip;q=0"), Encoding::IDENTITY);
+    }
+    if (compression::isAvailable(Encoding::BROTLI)) {
+        EXPECT_EQ(compression::negotiate("gzip, br"), Encoding::BROTLI);
+        if (compression::isAvailable(Encoding::GZIP)) {
+            EXPECT_EQ(compression::negotiate("gzip, br;q=0.5"), Encoding::GZIP);
+        }
+    }
+    if (compression::isAvailable(Encoding::ZSTD)) {
+        EXPECT_EQ(compression::negotiate("gzip, br, zstd"), Encoding::ZSTD);
+    }
+}
+
+TEST_F(CompressionTest, ThreadCompressorsAreReused) {
+    using compression::Encoding;
+    EXPECT_EQ(compression::Compressor::forThread(Encoding::IDENTITY), nullptr);
+    for (Encoding encoding : {Encoding::GZIP, Encoding::BROTLI, Encoding::ZSTD}) {
+        compression::Compressor* compressor = compression::Compressor::forThread(encoding);
+        if (!compression::isAvailable(encoding)) {
+            EXPECT_EQ(compressor, nullptr);
+            continue;
+        }
+        ASSERT_NE(compressor, nullptr);
+        EXPECT_EQ(compression::Compressor::forThread(encoding), compressor);
+        EXPECT_EQ(compressor->getEncoding(), encoding);
+
+        // A rewound stream produces the same bytes as a fresh one
+        std::string first = compressInPieces(*compressor);
+        std::string second = compressInPieces(*compressor);
+        EXPECT_FALSE(first.empty());
+        EXPECT_LT(first.size(), text.size() / 4);
+        EXPECT_EQ(first, second);
+    }
+}
+
+#ifdef HAVE_ZLIB
+TEST_F(CompressionTest, StreamedGzipRoundTrips) {
+    compression::Compressor compressor(compression::Encoding::GZIP);
+    std::string compressed = compressInPieces(compressor);
+
+    z_stream stream{};
+    ASSERT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+    std::string inflated(text.size() + 1, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&inflated[0]);
+    stream.avail_out = static_cast<uInt>(inflated.size());
+    EXPECT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+    inflated.resize(stream.total_out);
+    inflateEnd(&stream);
+    EXPECT_EQ(inflated, text);
+}
+TEST_F(CompressionTest, FlushedOutputDecodesBeforeTheEnd) {
+    compression::Compressor compressor(compression::Encoding::GZIP);
+    std::string compressed;
+    ASSERT_TRUE(compressor.begin());
+    ASSERT_TRUE(compressor.update("first piece\n", compressed));
+    ASSERT_TRUE(compressor.flush(compressed));
+
+    // Everything given so far comes back out of what was emitted
+    z_stream stream{};
+    ASSERT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+    std::string inflated(64, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&inflated[0]);
+    stream.avail_out = static_cast<uInt>(inflated.size());
+    EXPECT_EQ(inflate(&stream, Z_SYNC_FLUSH), Z_OK);
+    inflated.resize(stream.total_out);
+    inflateEnd(&stream);
+    EXPECT_EQ(inflated, "first piece\n");
+
+    EXPECT_TRUE(compressor.flush(compressed));
+    EXPECT_TRUE(compressor.finish(compressed));
+}
+#endif
+
+TEST_F(CompressionTest, UnstartedCompressorFails) {
+    compression::Compressor compressor(compression::Encoding::IDENTITY);
+    std::string output;
+    EXPECT_FALSE(compressor.begin());
+    EXPECT_FALSE(compressor.update(text, output));
+    EXPECT_FALSE(compressor.flush(output));
+    EXPECT_FALSE(compressor.finish(output));
+    EXPECT_TRUE(output.empty());
+}
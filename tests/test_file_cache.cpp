@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include "file_cache.h"
+#include "http_response.h"
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+class FileCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char pattern[] = "/tmp/file_cache_test_XXXXXX";
+        directory = mkdtemp(pattern);
+    }
+
+    void TearDown() override {
+        for (const auto& path : created) {
+            std::remove(path.c_str());
+        }
+        rmdir(directory.c_str());
+    }
+
+    std::string writeFile(const std::string& name, const std::string& content) {
+        std::string path = directory + "/" + name;
+        std::ofstream(path, std::ios::binary) << content;
+        created.push_back(path);
+        return path;
+    }
+
+    std::string directory;
+    std::vector<std::string> created;
+};
+
+TEST_F(FileCacheTest, OpensRegularFilesOnly) {
+    std::string path = writeFile("a.txt", "hello");
+
+    auto file = CachedFile::open(path);
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(file->getSize(), 5u);
+    EXPECT_GE(file->getFd(), 0);
+
+    std::string content = "prefix:";
+    EXPECT_TRUE(file->readInto(content, 1, 3));
+    EXPECT_EQ(content, "prefix:ell");
+
+    EXPECT_EQ(CachedFile::open(directory), nullptr);
+    EXPECT_EQ(CachedFile::open(directory + "/missing"), nullptr);
+}
+
+TEST_F(FileCacheTest, HotFilesAreServedFromCache) {
+    std::string path = writeFile("hot.css", "body{}");
+    FileCache cache(4, std::chrono::milliseconds(60000));
+
+    auto first = cache.open(path);
+    auto second = cache.open(path);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(cache.getMisses(), 1u);
+    EXPECT_EQ(cache.getHits(), 1u);
+
+    EXPECT_EQ(cache.open(directory + "/missing"), nullptr);
+    EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST_F(FileCacheTest, ChangedFilesAreReopenedAfterRevalidation) {
+    std::string path = writeFile("app.js", "v1");
+    FileCache cache(4, std::chrono::milliseconds(0));
+
+    auto original = cache.open(path);
+    ASSERT_NE(original, nullptr);
+
+    // Replace the file (new inode), as deployments usually do
+    std::string replacement = writeFile("app.js.new", "version2");
+    ASSERT_EQ(std::rename(replacement.c_str(), path.c_str()), 0);
+
+    auto reopened = cache.open(path);
+    ASSERT_NE(reopened, nullptr);
+    EXPECT_NE(reopened, original);
+    EXPECT_EQ(reopened->getSize(), 8u);
+
+    // The old descriptor is still usable by whoever holds it
+    std::string content;
+    EXPECT_TRUE(original->readInto(content, 0, 2));
+    EXPECT_EQ(content, "v1");
+}
+
+TEST_F(FileCacheTest, EvictsLeastRecentlyUsed) {
+    FileCache cache(2, std::chrono::milliseconds(60000));
+    std::string a = writeFile("a", "a");
+    std::string b = writeFile("b", "b");
+    std::string c = writeFile("c", "c");
+
+    cache.open(a);
+    cache.open(b);
+    cache.open(a); // b is now least recently used
+    cache.open(c);
+    EXPECT_EQ(cache.size(), 2u);
+
+    uint64_t misses = cache.getMisses();
+    cache.open(a);
+    EXPECT_EQ(cache.getMisses(), misses);
+    cache.open(b);
+    EXPECT_EQ(cache.getMisses(), misses + 1);
+}
+
+TEST_F(FileCacheTest, ResponseKeepsFileBodyOutOfMemory) {
+    std::string path = writeFile("clip.mp4", std::string(1000, 'v'));
+
+    HttpResponse response;
+    response.setFileContent(path);
+    EXPECT_EQ(response.getHeader("Content-Type"), "video/mp4");
+    EXPECT_EQ(response.getHeader("Content-Length"), "1000");
+    EXPECT_TRUE(response.getBody().empty());
+    ASSERT_NE(response.getFileBody(), nullptr);
+    EXPECT_EQ(response.getBodySize(), 1000u);
+
+    std::string serialized = response.toString();
+    EXPECT_EQ(serialized.compare(serialized.size() - 1000, 1000, std::string(1000, 'v')), 0);
+
+    response.setTextContent("replaced");
+    EXPECT_EQ(response.getFileBody(), nullptr);
+    EXPECT_EQ(response.getHeader("Content-Length"), "8");
+}
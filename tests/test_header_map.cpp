@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "header_map.h"
+#include "http_request.h"
+#include "http_response.h"
+
+class HeaderMapTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    HeaderMap headers;
+};
+
+TEST_F(HeaderMapTest, LookupIgnoresCase) {
+    headers.add("Content-Length", "42");
+    headers.add("X-Custom", "value");
+
+    EXPECT_EQ(headers.get("content-length"), "42");
+    EXPECT_EQ(headers.get("CONTENT-LENGTH"), "42");
+    EXPECT_EQ(headers.get(HeaderId::CONTENT_LENGTH), "42");
+    EXPECT_EQ(headers.get("x-custom"), "value");
+    EXPECT_EQ(headers.get("Missing").data(), nullptr);
+    EXPECT_EQ(headers.get(HeaderId::HOST).data(), nullptr);
+}
+
+TEST_F(HeaderMapTest, KnownNamesResolveToIds) {
+    EXPECT_EQ(HeaderMap::idOf("Host"), HeaderId::HOST);
+    EXPECT_EQ(HeaderMap::idOf("transfer-ENCODING"), HeaderId::TRANSFER_ENCODING);
+    EXPECT_EQ(HeaderMap::idOf("If-Modified-Since"), HeaderId::IF_MODIFIED_SINCE);
+    EXPECT_EQ(HeaderMap::idOf("X-Host"), HeaderId::OTHER);
+    EXPECT_EQ(HeaderMap::idOf(""), HeaderId::OTHER);
+}
+
+TEST_F(HeaderMapTest, SetReplacesAllDuplicates) {
+    headers.add("Vary", "Accept");
+    headers.add("X-Other", "1");
+    headers.add("vary", "Origin");
+
+    headers.set("VARY", "Accept-Encoding, Origin");
+    ASSERT_EQ(headers.size(), 2u);
+    EXPECT_EQ(headers.get(HeaderId::VARY), "Accept-Encoding, Origin");
+
+    headers.set("X-Other", "2");
+    EXPECT_EQ(headers.get("x-other"), "2");
+    EXPECT_EQ(headers.size(), 2u);
+}
+
+TEST_F(HeaderMapTest, PreservesInsertionOrderBeyondInlineCapacity) {
+    for (size_t i = 0; i < HeaderMap::kInlineFields + 8; ++i) {
+        headers.add("X-Field-" + std::to_string(i), std::to_string(i));
+    }
+    headers.add("Host", "example.com");
+
+    size_t index = 0;
+    for (const auto& field : headers) {
+        if (index < HeaderMap::kInlineFields + 8) {
+            EXPECT_EQ(field.value, std::to_string(index));
+        }
+        ++index;
+    }
+    EXPECT_EQ(index, headers.size());
+    EXPECT_EQ(headers.get(HeaderId::HOST), "example.com");
+
+    EXPECT_TRUE(headers.remove("x-field-3"));
+    EXPECT_FALSE(headers.contains("X-Field-3"));
+    EXPECT_EQ(headers.at(3).value, "4");
+    EXPECT_EQ(headers.get(HeaderId::HOST), "example.com");
+}
+
+TEST_F(HeaderMapTest, ValueFromSameMapSurvivesGrowth) {
+    headers.add("A", "first");
+    for (int i = 0; i < 64; ++i) {
+        headers.add("B", headers.get("A"));
+    }
+    EXPECT_EQ(headers.at(64).value, "first");
+}
+
+TEST_F(HeaderMapTest, CopiesAreIndependent) {
+    headers.add("Content-Type", "text/plain");
+    HeaderMap copy = headers;
+    headers.set("Content-Type", "application/json");
+
+    EXPECT_EQ(copy.get(HeaderId::CONTENT_TYPE), "text/plain");
+    EXPECT_EQ(headers.get(HeaderId::CONTENT_TYPE), "application/json");
+}
+
+TEST_F(HeaderMapTest, RequestAndResponseLookupsIgnoreCase) {
+    HttpRequest request("POST / HTTP/1.1\r\ncontent-type: text/csv\r\nCONTENT-LENGTH: 3\r\n\r\na,b");
+    ASSERT_TRUE(request.isValid());
+    EXPECT_EQ(request.getContentType(), "text/csv");
+    EXPECT_EQ(request.getContentLength(), 3u);
+    EXPECT_EQ(request.getHeader("Content-Type"), "text/csv");
+
+    HttpRequest copy = request;
+    EXPECT_EQ(copy.getHeader("content-length"), "3");
+
+    HttpResponse response;
+    response.setTextContent("hi");
+    EXPECT_EQ(response.getHeader("content-length"), "2");
+    EXPECT_EQ(response.getHeaders().size(), 2u);
+}
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include "hpack.h"
+
+#include <utility>
+#include <vector>
+
+class HpackTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    using Fields = std::vector<std::pair<std::string, std::string>>;
+
+    static std::string bytes(std::initializer_list<uint8_t> values) {
+        return std::string(values.begin(), values.end());
+    }
+
+    bool decode(const std::string& block, Fields& fields) {
+        fields.clear();
+        return decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size(),
+                              [&](std::string_view name, std::string_view value) {
+                                  fields.emplace_back(std::string(name), std::string(value));
+                                  return true;
+                              });
+    }
+
+    hpack::Decoder decoder;
+};
+
+// RFC 7541 appendix C.1
+TEST_F(HpackTest, IntegersUsePrefixAndContinuationBytes) {
+    std::string out;
+    hpack::encodeInteger(10, 5, 0, out);
+    EXPECT_EQ(out, bytes({0x0a}));
+
+    out.clear();
+    hpack::encodeInteger(1337, 5, 0, out);
+    EXPECT_EQ(out, bytes({0x1f, 0x9a, 0x0a}));
+
+    out.clear();
+    hpack::encodeInteger(42, 8, 0, out);
+    EXPECT_EQ(out, bytes({0x2a}));
+
+    const uint8_t encoded[] = {0x1f, 0x9a, 0x0a};
+    const uint8_t* cursor = encoded;
+    uint64_t value = 0;
+    ASSERT_TRUE(hpack::decodeInteger(cursor, encoded + sizeof(encoded), 5, value));
+    EXPECT_EQ(value, 1337u);
+    EXPECT_EQ(cursor, encoded + sizeof(encoded));
+
+    // Truncated continuation
+    cursor = encoded;
+    EXPECT_FALSE(hpack::decodeInteger(cursor, encoded + 2, 5, value));
+}
+
+TEST_F(HpackTest, HuffmanRoundTrip) {
+    std::string out;
+    hpack::huffmanEncode("www.example.com", out);
+    EXPECT_EQ(out, bytes({0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff}));
+    EXPECT_EQ(hpack::huffmanEncodedLength("www.example.com"), out.size());
+
+    std::string decoded;
+    ASSERT_TRUE(hpack::huffmanDecode(reinterpret_cast<const uint8_t*>(out.data()), out.size(), decoded));
+    EXPECT_EQ(decoded, "www.example.com");
+}
+
+TEST_F(HpackTest, HuffmanRejectsBadPadding) {
+    // '0' is 00000; the three padding bits must be ones
+    const uint8_t zero_padding[] = {0x00};
+    std::string decoded;
+    EXPECT_FALSE(hpack::huffmanDecode(zero_padding, sizeof(zero_padding), decoded));
+
+    // A whole byte of padding is more than the 7 bits allowed
+    const uint8_t long_padding[] = {0x07, 0xff};
+    decoded.clear();
+    EXPECT_FALSE(hpack::huffmanDecode(long_padding, sizeof(long_padding), decoded));
+}
+
+// RFC 7541 appendix C.4: three requests on one connection
+TEST_F(HpackTest, DecodesRfcRequestSequence) {
+    Fields fields;
+    ASSERT_TRUE(decode(bytes({0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab,
+                              0x90, 0xf4, 0xff}),
+                       fields));
+    Fields first = {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}};
+    EXPECT_EQ(fields, first);
+    EXPECT_EQ(decoder.getTable().getSize(), 57u);
+
+    ASSERT_TRUE(decode(bytes({0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf}), fields));
+    Fields second = {{":method", "GET"},
+                     {":scheme", "http"},
+                     {":path", "/"},
+                     {":authority", "www.example.com"},
+                     {"cache-control", "no-cache"}};
+    EXPECT_EQ(fields, second);
+    EXPECT_EQ(decoder.getTable().getSize(), 110u);
+
+    ASSERT_TRUE(decode(bytes({0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9, 0x7d, 0x7f,
+                              0x89, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xb8, 0xe8, 0xb4, 0xbf}),
+                       fields));
+    Fields third = {{":method", "GET"},
+                    {":scheme", "https"},
+                    {":path", "/index.html"},
+                    {":authority", "www.example.com"},
+                    {"custom-key", "custom-value"}};
+    EXPECT_EQ(fields, third);
+    EXPECT_EQ(decoder.getTable().getSize(), 164u);
+    EXPECT_EQ(decoder.getTable().getDynamicCount(), 3u);
+}
+
+TEST_F(HpackTest, RejectsIndexBeyondTable) {
+    Fields fields;
+    // Indexed field 70: past the static table with an empty dynamic one
+    EXPECT_FALSE(decode(bytes({0xc6}), fields));
+}
+
+TEST_F(HpackTest, TableEvictsOldestEntries) {
+    hpack::HeaderTable table(100);
+    table.insert("a", std::string(30, 'x')); // 63 bytes
+    table.insert("b", std::string(30, 'y')); // evicts "a"
+    EXPECT_EQ(table.getDynamicCount(), 1u);
+
+    std::string_view name;
+    std::string_view value;
+    ASSERT_TRUE(table.lookup(hpack::HeaderTable::kStaticEntries + 1, name, value));
+    EXPECT_EQ(name, "b");
+
+    // Larger than the whole table: empties it
+    table.insert("c", std::string(200, 'z'));
+    EXPECT_EQ(table.getDynamicCount(), 0u);
+    EXPECT_EQ(table.getSize(), 0u);
+}
+
+TEST_F(HpackTest, EncoderOutputDecodesAndShrinksOnRepeat) {
+    hpack::Encoder encoder;
+    Fields response = {{":status", "200"},
+                       {"content-type", "text/html"},
+                       {"x-request-id", "abc"},
+                       {"content-length", "1234"}};
+
+    std::string first;
+    encoder.beginBlock(first);
+    for (const auto& field : response) {
+        encoder.encode(field.first, field.second, first);
+    }
+    std::string second;
+    encoder.beginBlock(second);
+    for (const auto& field : response) {
+        encoder.encode(field.first, field.second, second);
+    }
+    EXPECT_LT(second.size(), first.size());
+
+    Fields fields;
+    ASSERT_TRUE(decode(first, fields));
+    EXPECT_EQ(fields, response);
+    ASSERT_TRUE(decode(second, fields));
+    EXPECT_EQ(fields, response);
+}
+
+TEST_F(HpackTest, EncoderAnnouncesTableSizeChange) {
+    hpack::Encoder encoder;
+    encoder.setMaxTableSize(0);
+
+    std::string block;
+    encoder.beginBlock(block);
+    encoder.encode("x-custom", "value", block);
+    EXPECT_EQ(encoder.getTable().getDynamicCount(), 0u);
+
+    Fields fields;
+    ASSERT_TRUE(decode(block, fields));
+    EXPECT_EQ(decoder.getTable().getMaxSize(), 0u);
+    ASSERT_EQ(fields.size(), 1u);
+    EXPECT_EQ(fields[0].second, "value");
+}
@@ -0,0 +1,290 @@
+#include <gtest/gtest.h>
+#include "http2_session.h"
+
+#include <vector>
+
+class Http2SessionTest : public ::testing::Test {
+protected:
+    struct Frame {
+        uint8_t type;
+        uint8_t flags;
+        uint32_t stream_id;
+        std::string payload;
+    };
+
+    struct Received {
+        uint32_t stream_id;
+        std::shared_ptr<HttpRequest> request;
+    };
+
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static std::string frame(uint8_t type, uint8_t flags, uint32_t stream_id, const std::string& payload) {
+        std::string out;
+        out.push_back(static_cast<char>(payload.size() >> 16));
+        out.push_back(static_cast<char>(payload.size() >> 8));
+        out.push_back(static_cast<char>(payload.size()));
+        out.push_back(static_cast<char>(type));
+        out.push_back(static_cast<char>(flags));
+        out.push_back(static_cast<char>(stream_id >> 24));
+        out.push_back(static_cast<char>(stream_id >> 16));
+        out.push_back(static_cast<char>(stream_id >> 8));
+        out.push_back(static_cast<char>(stream_id));
+        return out + payload;
+    }
+
+    static std::string uint32Bytes(uint32_t value) {
+        std::string out;
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<char>(value >> shift));
+        }
+        return out;
+    }
+
+    static std::string setting(uint16_t id, uint32_t value) {
+        return std::string{static_cast<char>(id >> 8), static_cast<char>(id)} + uint32Bytes(value);
+    }
+
+    std::string requestHeaders(const std::string& method, const std::string& path,
+                               const std::vector<std::pair<std::string, std::string>>& extra = {}) {
+        std::string block;
+        encoder.beginBlock(block);
+        encoder.encode(":method", method, block);
+        encoder.encode(":scheme", "https", block);
+        encoder.encode(":path", path, block);
+        encoder.encode(":authority", "example.com", block);
+        for (const auto& field : extra) {
+            encoder.encode(field.first, field.second, block);
+        }
+        return block;
+    }
+
+    // Client preface plus empty SETTINGS
+    bool open() {
+        std::string input = std::string(Http2Session::kPreface) + frame(0x4, 0, 0, "");
+        return session.receive(input);
+    }
+
+    bool feed(const std::string& bytes) {
+        std::string input = bytes;
+        return session.receive(input);
+    }
+
+    std::vector<Frame> drain() {
+        std::string out;
+        session.takeOutput(out, 1 << 20);
+        std::vector<Frame> frames;
+        size_t offset = 0;
+        while (out.size() - offset >= 9) {
+            const uint8_t* header = reinterpret_cast<const uint8_t*>(out.data() + offset);
+            size_t length = (static_cast<size_t>(header[0]) << 16) | (header[1] << 8) | header[2];
+            uint32_t id = ((header[5] & 0x7f) << 24) | (header[6] << 16) | (header[7] << 8) | header[8];
+            frames.push_back({header[3], header[4], id, out.substr(offset + 9, length)});
+            offset += 9 + length;
+        }
+        EXPECT_EQ(offset, out.size());
+        return frames;
+    }
+
+    static const Frame* findFrame(const std::vector<Frame>& frames, uint8_t type, uint32_t stream_id) {
+        for (const auto& f : frames) {
+            if (f.type == type && f.stream_id == stream_id) {
+                return &f;
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<Received> received;
+    hpack::Encoder encoder;
+    hpack::Decoder response_decoder;
+    Http2Session session{1024, [this](uint32_t stream_id, std::shared_ptr<HttpRequest> request) {
+        received.push_back({stream_id, std::move(request)});
+    }};
+};
+
+TEST_F(Http2SessionTest, AnnouncesSettingsAndAcknowledgesPeer) {
+    ASSERT_TRUE(open());
+    std::vector<Frame> frames = drain();
+
+    ASSERT_GE(frames.size(), 3u);
+    EXPECT_EQ(frames[0].type, 0x4); // our SETTINGS
+    EXPECT_EQ(frames[0].flags, 0);
+    EXPECT_EQ(frames[1].type, 0x8); // connection WINDOW_UPDATE
+    EXPECT_EQ(frames[1].payload, uint32Bytes(Http2Session::kConnectionWindowSize - 65535));
+    EXPECT_EQ(frames[2].type, 0x4); // ACK of theirs
+    EXPECT_EQ(frames[2].flags, 0x1);
+}
+
+TEST_F(Http2SessionTest, DispatchesRequestAndSendsResponse) {
+    ASSERT_TRUE(open());
+    drain();
+
+    ASSERT_TRUE(feed(frame(0x1, 0x5, 1, requestHeaders("GET", "/items?id=7", {{"accept", "text/plain"}}))));
+    ASSERT_EQ(received.size(), 1u);
+    EXPECT_EQ(received[0].stream_id, 1u);
+    const HttpRequest& request = *received[0].request;
+    EXPECT_EQ(request.getMethod(), HttpRequest::Method::GET);
+    EXPECT_EQ(request.getPath(), "/items");
+    EXPECT_EQ(request.getQueryParam("id"), "7");
+    EXPECT_EQ(request.getHeader("Host"), "example.com");
+    EXPECT_EQ(request.getHeader("Accept"), "text/plain");
+
+    HttpResponse response;
+    response.setHeader("Connection", "keep-alive"); // not allowed in HTTP/2; dropped
+    response.setTextContent("hello");
+    session.submitResponse(1, std::move(response));
+    std::vector<Frame> frames = drain();
+
+    const Frame* headers = findFrame(frames, 0x1, 1);
+    ASSERT_NE(headers, nullptr);
+    EXPECT_EQ(headers->flags, 0x4); // END_HEADERS only; DATA follows
+    std::vector<std::pair<std::string, std::string>> fields;
+    ASSERT_TRUE(response_decoder.decode(reinterpret_cast<const uint8_t*>(headers->payload.data()),
+                                        headers->payload.size(), [&](std::string_view name, std::string_view value) {
+                                            fields.emplace_back(std::string(name), std::string(value));
+                                            return true;
+                                        }));
+    ASSERT_FALSE(fields.empty());
+    EXPECT_EQ(fields[0], std::make_pair(std::string(":status"), std::string("200")));
+    for (const auto& field : fields) {
+        EXPECT_NE(field.first, "connection");
+    }
+
+    const Frame* data = findFrame(frames, 0x0, 1);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(data->payload, "hello");
+    EXPECT_EQ(data->flags, 0x1);
+    EXPECT_FALSE(session.hasOpenStreams());
+}
+
+TEST_F(Http2SessionTest, CollectsRequestBodyAcrossDataFrames) {
+    ASSERT_TRUE(open());
+    drain();
+
+    ASSERT_TRUE(feed(frame(0x1, 0x4, 1, requestHeaders("POST", "/upload"))));
+    EXPECT_TRUE(received.empty());
+    ASSERT_TRUE(feed(frame(0x0, 0, 1, "abc") + frame(0x0, 0x1, 1, "def")));
+    ASSERT_EQ(received.size(), 1u);
+    EXPECT_EQ(received[0].request->getBody(), "abcdef");
+}
+
+TEST_F(Http2SessionTest, OversizedBodyIsRefused) {
+    ASSERT_TRUE(open());
+    drain();
+
+    ASSERT_TRUE(feed(frame(0x1, 0x4, 1, requestHeaders("POST", "/upload"))));
+    ASSERT_TRUE(feed(frame(0x0, 0, 1, std::string(2000, 'x'))));
+    EXPECT_TRUE(received.empty());
+
+    std::vector<Frame> frames = drain();
+    const Frame* headers = findFrame(frames, 0x1, 1);
+    ASSERT_NE(headers, nullptr);
+    std::string status;
+    response_decoder.decode(reinterpret_cast<const uint8_t*>(headers->payload.data()), headers->payload.size(),
+                            [&](std::string_view name, std::string_view value) {
+                                if (name == ":status") {
+                                    status.assign(value);
+                                }
+                                return true;
+                            });
+    EXPECT_EQ(status, "413");
+
+    // The upload is cut short once the answer is out
+    const Frame* reset = findFrame(frames, 0x3, 1);
+    ASSERT_NE(reset, nullptr);
+    EXPECT_EQ(reset->payload, uint32Bytes(0));
+}
+
+TEST_F(Http2SessionTest, RespectsPeerFlowControlWindow) {
+    ASSERT_TRUE(open());
+    ASSERT_TRUE(feed(frame(0x4, 0, 0, setting(0x4, 10)))); // INITIAL_WINDOW_SIZE
+    ASSERT_TRUE(feed(frame(0x1, 0x5, 1, requestHeaders("GET", "/"))));
+    drain();
+
+    HttpResponse response;
+    response.setTextContent(std::string(25, 'z'));
+    session.submitResponse(1, std::move(response));
+    std::vector<Frame> frames = drain();
+    const Frame* data = findFrame(frames, 0x0, 1);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(data->payload.size(), 10u);
+    EXPECT_EQ(data->flags, 0);
+    EXPECT_FALSE(session.hasOutput());
+
+    ASSERT_TRUE(feed(frame(0x8, 0, 1, uint32Bytes(100))));
+    frames = drain();
+    data = findFrame(frames, 0x0, 1);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(data->payload.size(), 15u);
+    EXPECT_EQ(data->flags, 0x1);
+}
+
+TEST_F(Http2SessionTest, MalformedRequestResetsOnlyItsStream) {
+    ASSERT_TRUE(open());
+    drain();
+
+    std::string block;
+    encoder.beginBlock(block);
+    encoder.encode(":method", "GET", block);
+    encoder.encode(":scheme", "https", block);
+    encoder.encode(":path", "/", block);
+    encoder.encode("connection", "keep-alive", block);
+    ASSERT_TRUE(feed(frame(0x1, 0x5, 1, block)));
+    EXPECT_TRUE(received.empty());
+
+    std::vector<Frame> frames = drain();
+    const Frame* reset = findFrame(frames, 0x3, 1);
+    ASSERT_NE(reset, nullptr);
+    EXPECT_EQ(reset->payload, uint32Bytes(0x1));
+
+    ASSERT_TRUE(feed(frame(0x1, 0x5, 3, requestHeaders("GET", "/"))));
+    EXPECT_EQ(received.size(), 1u);
+}
+
+TEST_F(Http2SessionTest, AnswersPing) {
+    ASSERT_TRUE(open());
+    drain();
+
+    ASSERT_TRUE(feed(frame(0x6, 0, 0, "12345678")));
+    std::vector<Frame> frames = drain();
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].type, 0x6);
+    EXPECT_EQ(frames[0].flags, 0x1);
+    EXPECT_EQ(frames[0].payload, "12345678");
+}
+
+TEST_F(Http2SessionTest, BadPrefaceEndsConnection) {
+    std::string input = "GET / HTTP/1.1\r\nHost: x\r\n\r\n";
+    EXPECT_FALSE(session.receive(input));
+
+    std::vector<Frame> frames = drain();
+    const Frame* goaway = findFrame(frames, 0x7, 0);
+    ASSERT_NE(goaway, nullptr);
+    EXPECT_EQ(goaway->payload.substr(4), uint32Bytes(0x1));
+    EXPECT_TRUE(session.isFinished());
+}
+
+TEST_F(Http2SessionTest, DecreasingStreamIdIsProtocolError) {
+    ASSERT_TRUE(open());
+    ASSERT_TRUE(feed(frame(0x1, 0x5, 5, requestHeaders("GET", "/"))));
+    EXPECT_FALSE(feed(frame(0x1, 0x5, 3, requestHeaders("GET", "/"))));
+}
+
+TEST_F(Http2SessionTest, RapidResetIsCutOff) {
+    ASSERT_TRUE(open());
+
+    bool ok = true;
+    uint32_t stream_id = 1;
+    for (int i = 0; ok && i < 1000; ++i, stream_id += 2) {
+        ok = feed(frame(0x1, 0x5, stream_id, requestHeaders("GET", "/")) +
+                  frame(0x3, 0, stream_id, uint32Bytes(0x8)));
+    }
+    EXPECT_FALSE(ok);
+
+    std::vector<Frame> frames = drain();
+    const Frame* goaway = findFrame(frames, 0x7, 0);
+    ASSERT_NE(goaway, nullptr);
+    EXPECT_EQ(goaway->payload.substr(4), uint32Bytes(0xb));
+}
@@ -145,3 +145,52 @@ TEST_F(HttpResponseTest, ErrorStatusCodes) {
     response.setStatusCode(HttpResponse::StatusCode::NO_CONTENT);
     EXPECT_FALSE(response.isError());
 }
+
+TEST_F(HttpResponseTest, PreRenderedStatusLines) {
+    EXPECT_EQ(HttpResponse::statusLine(HttpResponse::StatusCode::OK), "HTTP/1.1 200 OK\r\n");
+    EXPECT_EQ(HttpResponse::statusLine(HttpResponse::StatusCode::NOT_FOUND), "HTTP/1.1 404 Not Found\r\n");
+    EXPECT_TRUE(HttpResponse::statusLine(static_cast<HttpResponse::StatusCode>(299)).empty());
+    
+    HttpResponse response(HttpResponse::StatusCode::SERVICE_UNAVAILABLE);
+    EXPECT_EQ(response.getStatusText(), "Service Unavailable");
+    
+    response.setStatusCode(static_cast<HttpResponse::StatusCode>(299));
+    EXPECT_EQ(response.getStatusText(), "Unknown");
+    EXPECT_EQ(response.toString().find("HTTP/1.1 299 Unknown\r\n"), 0u);
+}
+
+TEST_F(HttpResponseTest, SerializeHeadLeavesBodySeparate) {
+    HttpResponse response;
+    response.setHeader("X-First", "1");
+    response.setTextContent("payload");
+    
+    std::string head = "stale";
+    head.clear();
+    response.serializeHeadTo(head);
+    EXPECT_EQ(head,
+              "HTTP/1.1 200 OK\r\n"
+              "X-First: 1\r\n"
+              "Content-Type: text/plain; charset=utf-8\r\n"
+              "Content-Length: 7\r\n"
+              "\r\n");
+    
+    std::string full;
+    response.serializeTo(full);
+    EXPECT_EQ(full, head + "payload");
+    EXPECT_EQ(response.toString(), full);
+    
+    EXPECT_EQ(response.takeBody(), "payload");
+}
+
+TEST_F(HttpResponseTest, SerializesIntoCallerMemory) {
+    HttpResponse response(static_cast<HttpResponse::StatusCode>(299));
+    response.setHeader("X-First", "1");
+    response.setJsonContent("{\"ok\":true}");
+    
+    std::string expected = response.toString();
+    ASSERT_EQ(response.getSerializedSize(), expected.size());
+    
+    std::string buffer(expected.size() + 1, '#');
+    ASSERT_TRUE(response.serializeTo(&buffer[0]));
+    EXPECT_EQ(buffer, expected + "#"); // nothing past the size reported
+}
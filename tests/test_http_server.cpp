@@ -1,11 +1,266 @@
 #include <gtest/gtest.h>
 #include "http_server.h"
+#include "hpack.h"
+#include "logger.h"
+#include <algorithm>
 #include <thread>
 #include <chrono>
+#include <csignal>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifndef BUILD_WASM
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef ENABLE_SSL
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#endif
+
+namespace {
+
+int connectToServer(int port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    
+    struct timeval timeout{2, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+}
+
+// Read until the server closes the connection or the receive timeout fires
+std::string readAll(int sock) {
+    std::string data;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        data.append(buffer, n);
+    }
+    return data;
+}
+
+// Read exactly one response framed by its Content-Length header
+std::string readResponse(int sock, std::string& leftover) {
+    std::string data = std::move(leftover);
+    leftover.clear();
+    char buffer[4096];
+    
+    while (true) {
+        size_t header_end = data.find("\r\n\r\n");
+        if (header_end != std::string::npos) {
+            size_t length = 0;
+            size_t pos = data.find("Content-Length: ");
+            if (pos != std::string::npos && pos < header_end) {
+                length = std::stoul(data.substr(pos + 16));
+            }
+            size_t total = header_end + 4 + length;
+            if (data.size() >= total) {
+                leftover = data.substr(total);
+                return data.substr(0, total);
+            }
+        }
+        
+        ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return data;
+        }
+        data.append(buffer, n);
+    }
+}
+
+std::string sendRequest(int port, const std::string& raw_request) {
+    int sock = connectToServer(port);
+    if (sock < 0) {
+        return "";
+    }
+    
+    send(sock, raw_request.data(), raw_request.size(), 0);
+    std::string response = readAll(sock);
+    close(sock);
+    return response;
+}
+
+// One HTTP/2 frame as written on the wire
+std::string http2Frame(uint8_t type, uint8_t flags, uint32_t stream_id, const std::string& payload) {
+    std::string frame;
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    frame.push_back(static_cast<char>(length >> 16));
+    frame.push_back(static_cast<char>(length >> 8));
+    frame.push_back(static_cast<char>(length));
+    frame.push_back(static_cast<char>(type));
+    frame.push_back(static_cast<char>(flags));
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        frame.push_back(static_cast<char>(stream_id >> shift));
+    }
+    return frame + payload;
+}
+
+// Client preface, empty SETTINGS and one GET per path on streams 1, 3, ...
+std::string http2Requests(const std::vector<std::string>& paths) {
+    std::string out = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n" + http2Frame(0x4, 0, 0, "");
+    hpack::Encoder encoder;
+    uint32_t stream_id = 1;
+    for (const auto& path : paths) {
+        std::string block;
+        encoder.beginBlock(block);
+        encoder.encode(":method", "GET", block);
+        encoder.encode(":scheme", "http", block);
+        encoder.encode(":path", path, block);
+        encoder.encode(":authority", "localhost", block);
+        out += http2Frame(0x1, 0x5, stream_id, block); // END_STREAM | END_HEADERS
+        stream_id += 2;
+    }
+    return out;
+}
+
+// Collects response bodies by stream from the server's frames; records the
+// order in which streams finished
+struct Http2Responses {
+    std::string buffer;
+    std::vector<std::pair<uint32_t, std::string>> bodies;
+    std::vector<uint32_t> finished;
+
+    void consume() {
+        while (buffer.size() >= 9) {
+            const unsigned char* header = reinterpret_cast<const unsigned char*>(buffer.data());
+            size_t length = (static_cast<size_t>(header[0]) << 16) | (header[1] << 8) | header[2];
+            if (buffer.size() < 9 + length) {
+                return;
+            }
+            uint32_t stream_id = ((header[5] & 0x7fu) << 24) | (header[6] << 16) | (header[7] << 8) | header[8];
+            if (header[3] == 0x0) {
+                auto it = std::find_if(bodies.begin(), bodies.end(),
+                                       [&](const auto& body) { return body.first == stream_id; });
+                if (it == bodies.end()) {
+                    bodies.emplace_back(stream_id, std::string());
+                    it = std::prev(bodies.end());
+                }
+                it->second.append(buffer, 9, length);
+                if (header[4] & 0x1) {
+                    finished.push_back(stream_id);
+                }
+            }
+            buffer.erase(0, 9 + length);
+        }
+    }
+
+    std::string body(uint32_t stream_id) const {
+        for (const auto& entry : bodies) {
+            if (entry.first == stream_id) {
+                return entry.second;
+            }
+        }
+        return "";
+    }
+};
+
+#if defined(ENABLE_SSL) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+// Self-signed P-256 certificate for localhost
+bool writeTestCertificate(const std::string& cert_file, const std::string& key_file) {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    bool ok = key && cert;
+    if (ok) {
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"),
+                                   -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        ok = X509_sign(cert, key, EVP_sha256()) > 0;
+    }
+    
+    FILE* cert_out = ok ? std::fopen(cert_file.c_str(), "w") : nullptr;
+    FILE* key_out = ok ? std::fopen(key_file.c_str(), "w") : nullptr;
+    ok = cert_out && key_out && PEM_write_X509(cert_out, cert) == 1 &&
+         PEM_write_PrivateKey(key_out, key, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+    if (cert_out) std::fclose(cert_out);
+    if (key_out) std::fclose(key_out);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ok;
+}
+
+// One request over a fresh TLS connection, resuming `session` when given
+// and sending the request as 0-RTT data when `early` is set. Returns the
+// connection's session (caller frees) for the next call.
+SSL_SESSION* tlsRequest(SSL_CTX* context, int port, const std::string& request, SSL_SESSION* session,
+                        bool early, std::string& response, bool& resumed) {
+    response.clear();
+    resumed = false;
+    int sock = connectToServer(port);
+    if (sock < 0) {
+        return nullptr;
+    }
+    
+    SSL* ssl = SSL_new(context);
+    SSL_set_fd(ssl, sock);
+    if (session) {
+        SSL_set_session(ssl, session);
+    }
+    
+    bool sent = false;
+    if (early && session && SSL_SESSION_get_max_early_data(session) > 0) {
+        size_t written = 0;
+        sent = SSL_write_early_data(ssl, request.data(), request.size(), &written) == 1;
+    }
+    if (SSL_connect(ssl) == 1) {
+        resumed = SSL_session_reused(ssl) == 1;
+        if (!sent || SSL_get_early_data_status(ssl) != SSL_EARLY_DATA_ACCEPTED) {
+            SSL_write(ssl, request.data(), static_cast<int>(request.size()));
+        }
+        char buffer[4096];
+        int n;
+        while ((n = SSL_read(ssl, buffer, sizeof(buffer))) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+    }
+    
+    // Without a close_notify the session would be marked unresumable
+    SSL_shutdown(ssl);
+    SSL_SESSION* next = SSL_get1_session(ssl);
+    SSL_free(ssl);
+    close(sock);
+    return next;
+}
+#endif
+
+} // namespace
+#endif
 
 class HttpServerTest : public ::testing::Test {
 protected:
     void SetUp() override {
+#if defined(ENABLE_SSL) && !defined(BUILD_WASM)
+        // Like main(): TLS writes to a closed client must not end the binary
+        signal(SIGPIPE, SIG_IGN);
+#endif
         server = std::make_unique<HttpServer>();
     }
     
@@ -13,9 +268,51 @@ protected:
         if (server && server->isRunning()) {
             server->stop();
         }
+#ifndef BUILD_WASM
+        if (server_thread.joinable()) {
+            server_thread.join();
+        }
+#endif
     }
     
     std::unique_ptr<HttpServer> server;
+    
+#ifndef BUILD_WASM
+    std::thread server_thread;
+    
+    void startInBackground(int port) {
+        server_thread = std::thread([this, port]() {
+            server->start(port, "127.0.0.1");
+        });
+        
+        for (int i = 0; i < 200 && !server->isRunning(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    
+#if defined(ENABLE_SSL) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+    std::string cert_file = "/tmp/httpserver_test_tls.crt";
+    std::string key_file = "/tmp/httpserver_test_tls.key";
+    
+    void startHttpsInBackground(int port) {
+        ASSERT_TRUE(writeTestCertificate(cert_file, key_file));
+        server_thread = std::thread([this, port]() {
+            server->startHttps(port, cert_file, key_file, "127.0.0.1");
+        });
+        
+        for (int i = 0; i < 200 && !server->isRunning(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+#endif
+    
+    void stopBackground() {
+        server->stop();
+        if (server_thread.joinable()) {
+            server_thread.join();
+        }
+    }
+#endif
 };
 
 TEST_F(HttpServerTest, ServerInitialization) {
@@ -137,6 +434,29 @@ TEST_F(HttpServerTest, WebAssemblyNotFoundHandling) {
     
     EXPECT_NE(response_output.find("HTTP/1.1 404"), std::string::npos);
 }
+
+TEST_F(HttpServerTest, WebAssemblyRequestsParsedInPlace) {
+    server->post("/echo", [](const HttpRequest& req, HttpResponse& res) {
+        res.setTextContent(req.getHeader("X-Tag") + ":" + req.getBody());
+    });
+    EXPECT_TRUE(server->start(8080, "0.0.0.0"));
+    
+    // Views into one buffer holding two requests back to back, as the
+    // batch ABI passes them
+    std::string buffer = "POST /echo HTTP/1.1\r\nX-Tag: a\r\n\r\nfirst"
+                         "POST /echo HTTP/1.1\r\nX-Tag: b\r\n\r\nsecond";
+    std::string_view view(buffer);
+    size_t split = view.find("POST", 1);
+    
+    HttpResponse first;
+    HttpResponse second;
+    server->handleRequest(view.substr(0, split), first);
+    server->handleRequest(view.substr(split), second);
+    buffer.assign(buffer.size(), '\0'); // nothing may still point into it
+    
+    EXPECT_EQ(first.getBody(), "a:first");
+    EXPECT_EQ(second.getBody(), "b:second");
+}
 #endif
 
 // Integration test for route matching
@@ -178,3 +498,1381 @@ TEST_F(HttpServerTest, ServerLifecycle) {
     EXPECT_FALSE(server->isRunning());
 #endif
 }
+
+#ifndef BUILD_WASM
+TEST_F(HttpServerTest, ServesRequestsThroughEventLoop) {
+    server->get("/hello", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("hello");
+    });
+    
+    startInBackground(18081);
+    ASSERT_TRUE(server->isRunning());
+    
+    std::string response = sendRequest(18081, "GET /hello HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    EXPECT_NE(response.find("HTTP/1.1 200 OK"), std::string::npos);
+    EXPECT_NE(response.find("hello"), std::string::npos);
+    
+    stopBackground();
+    EXPECT_FALSE(server->isRunning());
+}
+
+TEST_F(HttpServerTest, IdleConnectionsDoNotStallWorkers) {
+    server->setThreadPoolSize(1);
+    server->get("/ping", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("pong");
+    });
+    
+    startInBackground(18082);
+    ASSERT_TRUE(server->isRunning());
+    
+    // More idle clients than worker threads; none of them sends a request
+    std::vector<int> idle_clients;
+    for (int i = 0; i < 16; ++i) {
+        idle_clients.push_back(connectToServer(18082));
+    }
+    
+    std::string response = sendRequest(18082, "GET /ping HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    EXPECT_NE(response.find("pong"), std::string::npos);
+    
+    for (int sock : idle_clients) {
+        if (sock >= 0) {
+            close(sock);
+        }
+    }
+    stopBackground();
+}
+TEST_F(HttpServerTest, KeepAliveServesMultipleRequests) {
+    server->get("/count", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("counted");
+    });
+    
+    startInBackground(18083);
+    ASSERT_TRUE(server->isRunning());
+    
+    int sock = connectToServer(18083);
+    ASSERT_GE(sock, 0);
+    
+    std::string leftover;
+    for (int i = 0; i < 3; ++i) {
+        std::string request = "GET /count HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        send(sock, request.data(), request.size(), 0);
+        
+        std::string response = readResponse(sock, leftover);
+        EXPECT_NE(response.find("HTTP/1.1 200 OK"), std::string::npos);
+        EXPECT_NE(response.find("Connection: keep-alive"), std::string::npos);
+        EXPECT_NE(response.find("counted"), std::string::npos);
+    }
+    
+    close(sock);
+    stopBackground();
+}
+
+TEST_F(HttpServerTest, HeadAndNoContentResponsesCarryNoBody) {
+    auto handler = [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("BODY");
+    };
+    server->get("/x", handler);
+    server->head("/x", handler);
+    server->get("/empty", [](const HttpRequest&, HttpResponse& res) {
+        res.setBody("ignored");
+        res.setStatusCode(HttpResponse::StatusCode::NO_CONTENT);
+    });
+    startInBackground(18111);
+    ASSERT_TRUE(server->isRunning());
+    
+    // On one keep-alive connection each response must start right where
+    // the previous one's head ended
+    int sock = connectToServer(18111);
+    ASSERT_GE(sock, 0);
+    std::string requests = "HEAD /x HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                           "GET /empty HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                           "GET /x HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    send(sock, requests.data(), requests.size(), 0);
+    std::string data = readAll(sock);
+    close(sock);
+    stopBackground();
+    
+    size_t head_end = data.find("\r\n\r\n");
+    ASSERT_NE(head_end, std::string::npos);
+    std::string head = data.substr(0, head_end);
+    EXPECT_NE(head.find("HTTP/1.1 200 OK"), std::string::npos);
+    EXPECT_NE(head.find("Content-Length: 4"), std::string::npos);
+    
+    std::string rest = data.substr(head_end + 4);
+    EXPECT_EQ(rest.find("HTTP/1.1 204 No Content\r\n"), 0u) << rest;
+    size_t empty_end = rest.find("\r\n\r\n");
+    ASSERT_NE(empty_end, std::string::npos);
+    rest = rest.substr(empty_end + 4);
+    EXPECT_EQ(rest.find("HTTP/1.1 200 OK\r\n"), 0u) << rest;
+    EXPECT_EQ(rest.substr(rest.size() - 4), "BODY");
+    EXPECT_EQ(data.find("BODY"), data.size() - 4);
+    EXPECT_EQ(data.find("ignored"), std::string::npos);
+}
+
+TEST_F(HttpServerTest, PipelinedRequestsAnsweredInOrder) {
+    server->get("/first", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("first");
+    });
+    server->post("/second", [](const HttpRequest& req, HttpResponse& res) {
+        res.setTextContent("second:" + req.getBody());
+    });
+    
+    startInBackground(18084);
+    ASSERT_TRUE(server->isRunning());
+    
+    std::string pipelined =
+        "GET /first HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "POST /second HTTP/1.1\r\nHost: localhost\r\nContent-Length: 4\r\n\r\nbody"
+        "GET /first HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    
+    std::string responses = sendRequest(18084, pipelined);
+    size_t first = responses.find("first");
+    size_t second = responses.find("second:body");
+    size_t third = responses.find("first", second);
+    
+    EXPECT_NE(first, std::string::npos);
+    EXPECT_NE(second, std::string::npos);
+    EXPECT_NE(third, std::string::npos);
+    EXPECT_LT(first, second);
+    EXPECT_NE(responses.find("Connection: close"), std::string::npos);
+    
+    stopBackground();
+}
+
+TEST_F(HttpServerTest, Http10ClosesByDefault) {
+    server->get("/old", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("old");
+    });
+    
+    startInBackground(18085);
+    ASSERT_TRUE(server->isRunning());
+    
+    auto begin = std::chrono::steady_clock::now();
+    std::string response = sendRequest(18085, "GET /old HTTP/1.0\r\n\r\n");
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    
+    EXPECT_NE(response.find("Connection: close"), std::string::npos);
+    EXPECT_LT(elapsed, std::chrono::seconds(1)); // closed by the server, not the client timeout
+    
+    stopBackground();
+}
+TEST_F(HttpServerTest, IdleKeepAliveConnectionTimesOut) {
+    server->setTimeoutSeconds(1);
+    startInBackground(18086);
+    ASSERT_TRUE(server->isRunning());
+    
+    int sock = connectToServer(18086);
+    ASSERT_GE(sock, 0);
+    
+    struct timeval timeout{4, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    auto begin = std::chrono::steady_clock::now();
+    char byte;
+    EXPECT_EQ(recv(sock, &byte, 1, 0), 0); // orderly close from the server
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(4));
+    
+    close(sock);
+    stopBackground();
+}
+TEST_F(HttpServerTest, BodySentInSeveralPiecesIsReadCompletely) {
+    server->post("/size", [](const HttpRequest& req, HttpResponse& res) {
+        res.setTextContent("size=" + std::to_string(req.getBody().size()));
+    });
+    
+    startInBackground(18087);
+    ASSERT_TRUE(server->isRunning());
+    
+    int sock = connectToServer(18087);
+    ASSERT_GE(sock, 0);
+    
+    std::string head = "POST /size HTTP/1.1\r\nConnection: close\r\nContent-Length: 100000\r\n\r\n";
+    send(sock, head.data(), head.size(), 0);
+    
+    std::string chunk(20000, 'x');
+    chunk[5] = '\0';
+    for (int i = 0; i < 5; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        send(sock, chunk.data(), chunk.size(), 0);
+    }
+    
+    std::string response = readAll(sock);
+    EXPECT_NE(response.find("size=100000"), std::string::npos);
+    
+    close(sock);
+    stopBackground();
+}
+
+TEST_F(HttpServerTest, OversizedBodyIsRejected) {
+    server->setMaxBodySize(16);
+    server->post("/small", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("accepted");
+    });
+    
+    startInBackground(18088);
+    ASSERT_TRUE(server->isRunning());
+    
+    std::string response = sendRequest(18088,
+        "POST /small HTTP/1.1\r\nContent-Length: 17\r\n\r\n01234567890123456");
+    EXPECT_NE(response.find("HTTP/1.1 413 Payload Too Large"), std::string::npos);
+    EXPECT_EQ(response.find("accepted"), std::string::npos);
+    
+    stopBackground();
+}
+
+TEST_F(HttpServerTest, RouteParametersReachHandlers) {
+    server->get("/users/:id", [](const HttpRequest& req, HttpResponse& res) {
+        res.setTextContent("user=" + std::string(req.getParam("id")));
+    });
+    server->options("/users/:id", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("options");
+    });
+    
+    startInBackground(18089);
+    ASSERT_TRUE(server->isRunning());
+    
+    std::string response = sendRequest(18089, "GET /users/42 HTTP/1.1\r\nConnection: close\r\n\r\n");
+    EXPECT_NE(response.find("HTTP/1.1 200 OK"), std::string::npos);
+    EXPECT_NE(response.find("user=42"), std::string::npos);
+    
+    // The OPTIONS route must not answer a DELETE
+    response = sendRequest(18089, "DELETE /users/42 HTTP/1.1\r\nConnection: close\r\n\r\n");
+    EXPECT_NE(response.find("HTTP/1.1 404"), std::string::npos);
+    EXPECT_EQ(response.find("options"), std::string::npos);
+    
+    stopBackground();
+}
+TEST_F(HttpServerTest, LargeBodyIsWrittenCompletely) {
+    const std::string payload(4 * 1024 * 1024, 'z');
+    server->get("/large", [&payload](const HttpRequest&, HttpResponse& res) {
+        res.setBody(payload);
+    });
+    
+    startInBackground(18090);
+    ASSERT_TRUE(server->isRunning());
+    
+    int sock = connectToServer(18090);
+    ASSERT_GE(sock, 0);
+    
+    std::string request = "GET /large HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(sock, request.data(), request.size(), 0);
+    
+    std::string leftover;
+    std::string response = readResponse(sock, leftover);
+    ASSERT_GE(response.size(), payload.size());
+    EXPECT_EQ(response.find("HTTP/1.1 200 OK"), 0u);
+    EXPECT_EQ(response.compare(response.size() - payload.size(), payload.size(), payload), 0);
+    
+    close(sock);
+    stopBackground();
+}
+
+TEST_F(HttpServerTest, StaticFilesAreSentFromDisk) {
+    char pattern[] = "/tmp/static_test_XXXXXX";
+    std::string directory = mkdtemp(pattern);
+    std::string path = directory + "/asset.wasm";
+    const std::string content(3 * 1024 * 1024 + 17, 'w');
+    std::ofstream(path, std::ios::binary) << content;
+    
+    server->serveStatic("/assets", directory);
+    startInBackground(18091);
+    ASSERT_TRUE(server->isRunning());
+    
+    int sock = connectToServer(18091);
+    ASSERT_GE(sock, 0);
+    
+    std::string leftover;
+    for (int i = 0; i < 2; ++i) {
+        std::string request = "GET /assets/asset.wasm HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        send(sock, request.data(), request.size(), 0);
+        
+        std::string response = readResponse(sock, leftover);
+        EXPECT_EQ(response.find("HTTP/1.1 200 OK"), 0u);
+        EXPECT_NE(response.find("Content-Type: application/wasm"), std::string::npos);
+        ASSERT_GE(response.size(), content.size());
+        EXPECT_EQ(response.compare(response.size() - content.size(), content.size(), content), 0);
+    }
+    
+    std::string missing = sendRequest(18091, "GET /assets/none.js HTTP/1.1\r\nConnection: close\r\n\r\n");
+    EXPECT_NE(missing.find("HTTP/1.1 404"), std::string::npos);
+    
+    close(sock);
+    stopBackground();
+    std::remove(path.c_str());
+    rmdir(directory.c_str());
+}
+
+TEST_F(HttpServerTest, StaticFileHeadSendsNoBody) {
+    char pattern[] = "/tmp/static_head_XXXXXX";
+    std::string directory = mkdtemp(pattern);
+    std::string path = directory + "/a.txt";
+    const std::string content(3 * 1024 * 1024 + 5, 'a');
+    std::ofstream(path, std::ios::binary) << content;
+    
+    server->serveStatic("/static", directory);
+    startInBackground(18112);
+    ASSERT_TRUE(server->isRunning());
+    
+    // The file is too large for the asset cache, so a GET would sendfile
+    // it; the HEAD must announce its length and stop at the head
+    int sock = connectToServer(18112);
+    ASSERT_GE(sock, 0);
+    std::string requests = "HEAD /static/a.txt HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                           "GET /static/a.txt HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    send(sock, requests.data(), requests.size(), 0);
+    std::string data = readAll(sock);
+    close(sock);
+    stopBackground();
+    std::remove(path.c_str());
+    rmdir(directory.c_str());
+    
+    size_t head_end = data.find("\r\n\r\n");
+    ASSERT_NE(head_end, std::string::npos);
+    std::string head = data.substr(0, head_end);
+    EXPECT_EQ(head.find("HTTP/1.1 200 OK"), 0u);
+    EXPECT_NE(head.find("Content-Length: " + std::to_string(content.size())), std::string::npos);
+    
+    std::string rest = data.substr(head_end + 4);
+    EXPECT_EQ(rest.find("HTTP/1.1 200 OK\r\n"), 0u) << rest.substr(0, 64);
+    size_t get_end = rest.find("\r\n\r\n");
+    ASSERT_NE(get_end, std::string::npos);
+    EXPECT_EQ(rest.size() - get_end - 4, content.size());
+}
+
+TEST_F(HttpServerTest, StaticAssetsRevalidateAndCompress) {
+    char pattern[] = "/tmp/asset_test_XXXXXX";
+    std::string directory = mkdtemp(pattern);
+    std::string path = directory + "/app.js";
+    std::string content;
+    for (int i = 0; i < 100; ++i) {
+        content += "console.log('line " + std::to_string(i) + "');\n";
+    }
+    std::ofstream(path, std::ios::binary) << content;
+    
+    server->serveStatic("/assets", directory);
+    startInBackground(18092);
+    ASSERT_TRUE(server->isRunning());
+    
+    int sock = connectToServer(18092);
+    ASSERT_GE(sock, 0);
+    std::string leftover;
+    
+    std::string request = "GET /assets/app.js HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(sock, request.data(), request.size(), 0);
+    std::string response = readResponse(sock, leftover);
+    EXPECT_EQ(response.find("HTTP/1.1 200 OK"), 0u);
+    EXPECT_EQ(response.compare(response.size() - content.size(), content.size(), content), 0);
+    EXPECT_NE(response.find("Last-Modified: "), std::string::npos);
+    
+    size_t etag_pos = response.find("ETag: ");
+    ASSERT_NE(etag_pos, std::string::npos);
+    std::string etag = response.substr(etag_pos + 6, response.find("\r\n", etag_pos) - etag_pos - 6);
+    
+    // A matching validator is answered with 304 and no body
+    request = "GET /assets/app.js HTTP/1.1\r\nHost: localhost\r\nIf-None-Match: " + etag + "\r\n\r\n";
+    send(sock, request.data(), request.size(), 0);
+    response = readResponse(sock, leftover);
+    EXPECT_EQ(response.find("HTTP/1.1 304 Not Modified"), 0u);
+    EXPECT_NE(response.find("ETag: " + etag), std::string::npos);
+    EXPECT_EQ(response.size(), response.find("\r\n\r\n") + 4);
+    
+    request = "GET /assets/app.js HTTP/1.1\r\nHost: localhost\r\n"
+              "If-Modified-Since: Fri, 01 Jan 2100 00:00:00 GMT\r\n\r\n";
+    send(sock, request.data(), request.size(), 0);
+    response = readResponse(sock, leftover);
+    EXPECT_EQ(response.find("HTTP/1.1 304 Not Modified"), 0u);
+    
+    request = "GET /assets/app.js HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: gzip\r\n\r\n";
+    send(sock, request.data(), request.size(), 0);
+    response = readResponse(sock, leftover);
+    EXPECT_EQ(response.find("HTTP/1.1 200 OK"), 0u);
+    if (compression::isAvailable(compression::Encoding::GZIP)) {
+        EXPECT_NE(response.find("Content-Encoding: gzip"), std::string::npos);
+        EXPECT_NE(response.find("Vary: Accept-Encoding"), std::string::npos);
+        EXPECT_LT(response.size() - response.find("\r\n\r\n") - 4, content.size());
+    }
+    
+    close(sock);
+    stopBackground();
+    std::remove(path.c_str());
+    rmdir(directory.c_str());
+}
+
+TEST_F(HttpServerTest, ShardedListenersServeAllConnections) {
+    server->setListenerShards(4);
+    server->setDeferAccept(1);
+    server->get("/shard", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("sharded");
+    });
+    
+    startInBackground(18093);
+    ASSERT_TRUE(server->isRunning());
+    
+    // Enough connections that the kernel spreads them over several shards
+    std::vector<int> sockets;
+    for (int i = 0; i < 32; ++i) {
+        int sock = connectToServer(18093);
+        ASSERT_GE(sock, 0);
+        sockets.push_back(sock);
+    }
+    
+    for (int sock : sockets) {
+        std::string leftover;
+        for (int i = 0; i < 2; ++i) {
+            std::string request = "GET /shard HTTP/1.1\r\nHost: localhost\r\n\r\n";
+            send(sock, request.data(), request.size(), 0);
+            std::string response = readResponse(sock, leftover);
+            EXPECT_EQ(response.find("HTTP/1.1 200 OK"), 0u);
+            EXPECT_NE(response.find("sharded"), std::string::npos);
+        }
+        close(sock);
+    }
+    
+    stopBackground();
+    EXPECT_FALSE(server->isRunning());
+}
+
+TEST_F(HttpServerTest, OverloadIsShedWithServiceUnavailable) {
+    server->setThreadPoolSize(1);
+    server->setMaxConnections(3);
+    server->setMaxQueuedRequests(1);
+    server->setRetryAfterSeconds(7);
+    server->get("/slow", [](const HttpRequest&, HttpResponse& res) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        res.setTextContent("done");
+    });
+    
+    startInBackground(18094);
+    ASSERT_TRUE(server->isRunning());
+    
+    int busy = connectToServer(18094);
+    int queued = connectToServer(18094);
+    int shed = connectToServer(18094);
+    ASSERT_GE(busy, 0);
+    ASSERT_GE(queued, 0);
+    ASSERT_GE(shed, 0);
+    
+    // A fourth connection is over the connection limit
+    int refused = connectToServer(18094);
+    ASSERT_GE(refused, 0);
+    std::string response = readAll(refused);
+    close(refused);
+    EXPECT_EQ(response.find("HTTP/1.1 503 Service Unavailable"), 0u);
+    EXPECT_NE(response.find("Retry-After: 7"), std::string::npos);
+    
+    // One request runs, one waits, and the next finds the queue full
+    std::string request = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(busy, request.data(), request.size(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    send(queued, request.data(), request.size(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    send(shed, request.data(), request.size(), 0);
+    
+    response = readAll(shed);
+    EXPECT_EQ(response.find("HTTP/1.1 503 Service Unavailable"), 0u);
+    EXPECT_NE(response.find("Retry-After: 7"), std::string::npos);
+    
+    std::string leftover;
+    EXPECT_EQ(readResponse(busy, leftover).find("HTTP/1.1 200 OK"), 0u);
+    leftover.clear();
+    EXPECT_EQ(readResponse(queued, leftover).find("HTTP/1.1 200 OK"), 0u);
+    EXPECT_GE(server->getRejectedCount(), 2u);
+    
+    close(busy);
+    close(queued);
+    close(shed);
+    stopBackground();
+}
+
+#if defined(ENABLE_SSL) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+TEST_F(HttpServerTest, TlsSessionsResumeAndGateEarlyData) {
+    server->setTlsEarlyData(16384);
+    server->get("/early", [](const HttpRequest& req, HttpResponse& res) {
+        res.setTextContent(req.isEarlyData() ? "early" : "late");
+    });
+    server->post("/submit", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("submitted");
+    });
+    startHttpsInBackground(18095);
+    ASSERT_TRUE(server->isRunning());
+    
+    SSL_CTX* client = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_min_proto_version(client, TLS1_3_VERSION);
+    SSL_CTX_set_session_cache_mode(client, SSL_SESS_CACHE_CLIENT);
+    
+    std::string get = "GET /early HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    std::string post = "POST /submit HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    std::string response;
+    bool resumed = false;
+    
+    SSL_SESSION* session = tlsRequest(client, 18095, get, nullptr, false, response, resumed);
+    ASSERT_NE(session, nullptr);
+    EXPECT_FALSE(resumed);
+    EXPECT_NE(response.find("late"), std::string::npos);
+    
+    // Resumed with the GET in 0-RTT: allowed for an idempotent route
+    SSL_SESSION* next = tlsRequest(client, 18095, get, session, true, response, resumed);
+    EXPECT_TRUE(resumed);
+    EXPECT_NE(response.find("early"), std::string::npos);
+    SSL_SESSION_free(session);
+    session = next;
+    
+    // A POST sent as early data is refused until after the handshake
+    next = tlsRequest(client, 18095, post, session, true, response, resumed);
+    EXPECT_TRUE(resumed);
+    EXPECT_EQ(response.find("HTTP/1.1 425 Too Early"), 0u);
+    SSL_SESSION_free(session);
+    session = next;
+    
+    // ...and accepted when sent normally on a resumed connection
+    next = tlsRequest(client, 18095, post, session, false, response, resumed);
+    EXPECT_TRUE(resumed);
+    EXPECT_NE(response.find("submitted"), std::string::npos);
+    SSL_SESSION_free(session);
+    SSL_SESSION_free(next);
+    
+    SslServer::HandshakeStats stats = server->getTlsHandshakeStats();
+    EXPECT_EQ(stats.full, 1u);
+    EXPECT_EQ(stats.resumed, 3u);
+    EXPECT_EQ(stats.early_data_accepted, 2u);
+    
+    SSL_CTX_free(client);
+    stopBackground();
+    std::remove(cert_file.c_str());
+    std::remove(key_file.c_str());
+}
+
+TEST_F(HttpServerTest, TlsHandshakesRunOnTheEventLoop) {
+    // One worker: with blocking handshakes a single silent client would stall everyone
+    server->setThreadPoolSize(1);
+    std::string large(200000, 'x');
+    server->get("/large", [&large](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent(large);
+    });
+    startHttpsInBackground(18096);
+    ASSERT_TRUE(server->isRunning());
+    
+    std::vector<int> silent;
+    for (int i = 0; i < 4; ++i) {
+        silent.push_back(connectToServer(18096));
+        ASSERT_GE(silent.back(), 0);
+    }
+    
+    SSL_CTX* client = SSL_CTX_new(TLS_client_method());
+    std::string request = "GET /large HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    std::string response;
+    bool resumed = false;
+    
+    auto started = std::chrono::steady_clock::now();
+    SSL_SESSION* session = tlsRequest(client, 18096, request, nullptr, false, response, resumed);
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    
+    EXPECT_LT(elapsed, std::chrono::seconds(1));
+    EXPECT_EQ(response.find("HTTP/1.1 200 OK"), 0u);
+    EXPECT_EQ(response.size() - (response.find("\r\n\r\n") + 4), large.size());
+    
+    SSL_SESSION_free(session);
+    SSL_CTX_free(client);
+    for (int sock : silent) {
+        close(sock);
+    }
+    stopBackground();
+    std::remove(cert_file.c_str());
+    std::remove(key_file.c_str());
+}
+#endif
+
+TEST_F(HttpServerTest, Http2PriorKnowledgeMultiplexesStreams) {
+    server->setThreadPoolSize(2);
+    server->get("/slow", [](const HttpRequest&, HttpResponse& res) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        res.setTextContent("slow");
+    });
+    server->get("/fast", [](const HttpRequest& req, HttpResponse& res) {
+        res.setTextContent("fast " + req.getHeader("Host"));
+    });
+    startInBackground(18097);
+    ASSERT_TRUE(server->isRunning());
+    
+    int sock = connectToServer(18097);
+    ASSERT_GE(sock, 0);
+    std::string request = http2Requests({"/slow", "/fast"});
+    send(sock, request.data(), request.size(), 0);
+    
+    Http2Responses responses;
+    char buffer[4096];
+    ssize_t n;
+    while (responses.finished.size() < 2 && (n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        responses.buffer.append(buffer, static_cast<size_t>(n));
+        responses.consume();
+    }
+    
+    // Both on one connection, and the slow stream does not hold up the fast one
+    ASSERT_EQ(responses.finished.size(), 2u);
+    EXPECT_EQ(responses.finished[0], 3u);
+    EXPECT_EQ(responses.body(1), "slow");
+    EXPECT_EQ(responses.body(3), "fast localhost");
+    
+    close(sock);
+    stopBackground();
+}
+
+#if defined(ENABLE_SSL) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+TEST_F(HttpServerTest, TlsNegotiatesHttp2ThroughAlpn) {
+    server->get("/proto", [](const HttpRequest& req, HttpResponse& res) {
+        res.setTextContent(req.getVersion());
+    });
+    startHttpsInBackground(18098);
+    ASSERT_TRUE(server->isRunning());
+    
+    SSL_CTX* client = SSL_CTX_new(TLS_client_method());
+    const unsigned char protocols[] = "\x02h2\x08http/1.1";
+    SSL_CTX_set_alpn_protos(client, protocols, sizeof(protocols) - 1);
+    
+    int sock = connectToServer(18098);
+    ASSERT_GE(sock, 0);
+    SSL* ssl = SSL_new(client);
+    SSL_set_fd(ssl, sock);
+    ASSERT_EQ(SSL_connect(ssl), 1);
+    
+    const unsigned char* selected = nullptr;
+    unsigned int selected_length = 0;
+    SSL_get0_alpn_selected(ssl, &selected, &selected_length);
+    ASSERT_EQ(std::string(reinterpret_cast<const char*>(selected), selected_length), "h2");
+    
+    std::string request = http2Requests({"/proto"});
+    SSL_write(ssl, request.data(), static_cast<int>(request.size()));
+    Http2Responses responses;
+    char buffer[4096];
+    int n;
+    while (responses.finished.empty() && (n = SSL_read(ssl, buffer, sizeof(buffer))) > 0) {
+        responses.buffer.append(buffer, static_cast<size_t>(n));
+        responses.consume();
+    }
+    EXPECT_EQ(responses.body(1), "HTTP/2");
+    
+    SSL_free(ssl);
+    close(sock);
+    SSL_CTX_free(client);
+    
+    // A client that does not offer h2 keeps HTTP/1.1
+    std::string response;
+    bool resumed = false;
+    client = SSL_CTX_new(TLS_client_method());
+    SSL_SESSION* session = tlsRequest(client, 18098,
+                                      "GET /proto HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n",
+                                      nullptr, false, response, resumed);
+    EXPECT_EQ(response.find("HTTP/1.1 200 OK"), 0u);
+    EXPECT_NE(response.find("HTTP/1.1", 8), std::string::npos);
+    
+    SSL_SESSION_free(session);
+    SSL_CTX_free(client);
+    stopBackground();
+    std::remove(cert_file.c_str());
+    std::remove(key_file.c_str());
+}
+#endif
+
+TEST_F(HttpServerTest, MetricsEndpointExportsPrometheusText) {
+    server->enableMetrics();
+    server->enableMetrics();
+    server->get("/users/:id", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("user");
+    });
+    startInBackground(18101);
+    ASSERT_TRUE(server->isRunning());
+    
+    for (int i = 0; i < 3; ++i) {
+        sendRequest(18101, "GET /users/" + std::to_string(i) + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    }
+    sendRequest(18101, "GET /missing HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    std::string response = sendRequest(18101, "GET /metrics HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    stopBackground();
+    
+    EXPECT_NE(response.find("Content-Type: text/plain; version=0.0.4; charset=utf-8"), std::string::npos);
+    EXPECT_NE(response.find("http_requests_total{code=\"2xx\"} 3\n"), std::string::npos);
+    EXPECT_NE(response.find("http_requests_total{code=\"4xx\"} 1\n"), std::string::npos);
+    EXPECT_NE(response.find("http_request_duration_seconds_count{method=\"GET\",route=\"/users/:id\"} 3\n"),
+              std::string::npos);
+    EXPECT_NE(response.find("http_request_duration_seconds_count{method=\"\",route=\"(unmatched)\"} 1\n"),
+              std::string::npos);
+    EXPECT_NE(response.find("http_connections_accepted_total 5\n"), std::string::npos);
+    EXPECT_NE(response.find("\nthread_pool_queued_tasks "), std::string::npos);
+    
+    // Enabling twice still registers a single metrics route
+    const std::string metrics_count = "http_request_duration_seconds_count{method=\"GET\",route=\"/metrics\"}";
+    size_t first = response.find(metrics_count);
+    ASSERT_NE(first, std::string::npos);
+    EXPECT_EQ(response.find(metrics_count, first + 1), std::string::npos);
+}
+
+TEST_F(HttpServerTest, CompressesLargeTextResponses) {
+    server->enableCompression(256);
+    std::string json = "[";
+    for (int i = 0; i < 200; ++i) {
+        json += "{\"id\":" + std::to_string(i) + ",\"name\":\"item\"},";
+    }
+    json.back() = ']';
+    server->get("/items", [&json](const HttpRequest&, HttpResponse& res) {
+        res.setJsonContent(json);
+        res.setHeader("ETag", "\"v1\"");
+    });
+    server->get("/small", [](const HttpRequest&, HttpResponse& res) {
+        res.setJsonContent("{\"ok\":true}");
+    });
+    startInBackground(18102);
+    ASSERT_TRUE(server->isRunning());
+    
+    std::string plain = sendRequest(18102, "GET /items HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    std::string gzip = sendRequest(18102, "GET /items HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: gzip\r\n"
+                                          "Connection: close\r\n\r\n");
+    std::string small = sendRequest(18102, "GET /small HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: gzip\r\n"
+                                           "Connection: close\r\n\r\n");
+    stopBackground();
+    
+    EXPECT_EQ(plain.find("Content-Encoding"), std::string::npos);
+    EXPECT_NE(plain.find("Vary: Accept-Encoding"), std::string::npos);
+    EXPECT_NE(plain.find("ETag: \"v1\""), std::string::npos);
+    EXPECT_EQ(plain.substr(plain.find("\r\n\r\n") + 4), json);
+    
+    if (compression::isAvailable(compression::Encoding::GZIP)) {
+        size_t body_start = gzip.find("\r\n\r\n") + 4;
+        EXPECT_NE(gzip.find("Content-Encoding: gzip"), std::string::npos);
+        EXPECT_NE(gzip.find("ETag: W/\"v1\""), std::string::npos);
+        EXPECT_NE(gzip.find("Content-Length: " + std::to_string(gzip.size() - body_start)), std::string::npos);
+        EXPECT_LT(gzip.size() - body_start, json.size() / 4);
+    }
+    
+    EXPECT_EQ(small.find("Content-Encoding"), std::string::npos);
+    EXPECT_EQ(small.find("Vary"), std::string::npos);
+}
+
+TEST_F(HttpServerTest, CompressedFileBodiesAreShared) {
+    char pattern[] = "/tmp/compress_file_XXXXXX";
+    std::string directory = mkdtemp(pattern);
+    std::string path = directory + "/big.txt";
+    std::string content;
+    while (content.size() < 2 * 1024 * 1024) {
+        content += "a line of text that repeats " + std::to_string(content.size() % 97) + "\n";
+    }
+    std::ofstream(path, std::ios::binary) << content;
+    
+    server->enableCompression();
+    server->serveStatic("/files", directory);
+    startInBackground(18113);
+    ASSERT_TRUE(server->isRunning());
+    
+    // Too large for the asset cache: compressed on the first request and
+    // served from the stored copy afterwards
+    std::string request = "GET /files/big.txt HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: gzip\r\n"
+                          "Connection: close\r\n\r\n";
+    std::string first = sendRequest(18113, request);
+    std::string second = sendRequest(18113, request);
+    std::string plain = sendRequest(18113, "GET /files/big.txt HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    stopBackground();
+    std::remove(path.c_str());
+    rmdir(directory.c_str());
+    
+    EXPECT_EQ(plain.find("Content-Encoding"), std::string::npos);
+    EXPECT_EQ(plain.substr(plain.find("\r\n\r\n") + 4), content);
+    if (compression::isAvailable(compression::Encoding::GZIP)) {
+        size_t body_start = first.find("\r\n\r\n") + 4;
+        EXPECT_NE(first.find("Content-Encoding: gzip"), std::string::npos);
+        EXPECT_NE(first.find("Content-Length: " + std::to_string(first.size() - body_start)), std::string::npos);
+        EXPECT_LT(first.size() - body_start, content.size() / 4);
+        EXPECT_EQ(second.substr(second.find("\r\n\r\n")), first.substr(body_start - 4));
+    }
+}
+
+TEST_F(HttpServerTest, CachesRouteResponses) {
+    server->enableCompression(256);
+    std::atomic<int> runs{0};
+    server->use([](const HttpRequest&, HttpResponse& res) {
+        res.setHeader("X-Served-By", "test");
+        return true;
+    });
+    server->get("/report", [&runs](const HttpRequest& req, HttpResponse& res) {
+        ++runs;
+        res.setTextContent("page " + req.getQueryParam("page") + ": " + std::string(1000, 'r'));
+    });
+    server->cacheRoute(HttpRequest::Method::GET, "/report", {std::chrono::seconds(60), {"page"}, {}});
+    startInBackground(18105);
+    ASSERT_TRUE(server->isRunning());
+    
+    auto get = [](const std::string& target, const std::string& extra = "") {
+        return sendRequest(18105, "GET " + target + " HTTP/1.1\r\nHost: localhost\r\n" + extra +
+                                  "Connection: close\r\n\r\n");
+    };
+    std::string first = get("/report?page=1");
+    std::string hit = get("/report?page=1&utm=x");
+    std::string other = get("/report?page=2");
+    std::string gzip = get("/report?page=1", "Accept-Encoding: gzip\r\n");
+    std::string gzip_hit = get("/report?page=1", "Accept-Encoding: gzip\r\n");
+    stopBackground();
+    
+    bool gzip_available = compression::isAvailable(compression::Encoding::GZIP);
+    EXPECT_EQ(runs.load(), gzip_available ? 3 : 2);
+    EXPECT_EQ(first.find("Age:"), std::string::npos);
+    EXPECT_NE(hit.find("Age: 0"), std::string::npos);
+    EXPECT_NE(hit.find("X-Served-By: test"), std::string::npos);
+    EXPECT_EQ(hit.substr(hit.find("\r\n\r\n")), first.substr(first.find("\r\n\r\n")));
+    EXPECT_NE(other.find("page 2: "), std::string::npos);
+    if (gzip_available) {
+        EXPECT_NE(gzip_hit.find("Content-Encoding: gzip"), std::string::npos);
+        EXPECT_EQ(gzip_hit.substr(gzip_hit.find("\r\n\r\n")), gzip.substr(gzip.find("\r\n\r\n")));
+    }
+    EXPECT_EQ(server->getResponseCache().getHits(), gzip_available ? 2u : 3u);
+}
+
+TEST_F(HttpServerTest, AsynchronousHandlersFreeTheWorker) {
+    server->setThreadPoolSize(1);
+    std::mutex mutex;
+    std::vector<std::thread> backends;
+    server->get("/slow", [&](const HttpRequest& req, HttpResponse& res, ResponseCompletion done) {
+        std::string path = req.getPath();
+        std::lock_guard<std::mutex> lock(mutex);
+        backends.emplace_back([&res, done, path]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            res.setTextContent("answered " + path);
+            done();
+        });
+    });
+    server->get("/fast", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("fast");
+    });
+    server->get("/dropped", [](const HttpRequest&, HttpResponse&, ResponseCompletion) {});
+    server->get("/throws", [](const HttpRequest&, HttpResponse&, ResponseCompletion) {
+        throw std::runtime_error("backend unreachable");
+    });
+    startInBackground(18106);
+    ASSERT_TRUE(server->isRunning());
+    
+    // The only worker is free as soon as the slow handler returns
+    std::string slow;
+    std::thread client([&slow]() {
+        slow = sendRequest(18106, "GET /slow HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto started = std::chrono::steady_clock::now();
+    std::string fast = sendRequest(18106, "GET /fast HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    auto fast_time = std::chrono::steady_clock::now() - started;
+    client.join();
+    
+    // Over HTTP/2 the streams finish out of order
+    int sock = connectToServer(18106);
+    ASSERT_GE(sock, 0);
+    std::string request = http2Requests({"/slow", "/fast"});
+    send(sock, request.data(), request.size(), 0);
+    Http2Responses responses;
+    char buffer[16384];
+    ssize_t n;
+    while (responses.finished.size() < 2 && (n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        responses.buffer.append(buffer, static_cast<size_t>(n));
+        responses.consume();
+    }
+    close(sock);
+    
+    std::string dropped = sendRequest(18106, "GET /dropped HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    std::string thrown = sendRequest(18106, "GET /throws HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    for (auto& backend : backends) {
+        backend.join();
+    }
+    stopBackground();
+    
+    EXPECT_NE(slow.find("200 OK"), std::string::npos);
+    EXPECT_NE(slow.find("answered /slow"), std::string::npos);
+    EXPECT_NE(fast.find("fast"), std::string::npos);
+    EXPECT_LT(fast_time, std::chrono::milliseconds(200));
+    
+    ASSERT_EQ(responses.finished.size(), 2u);
+    EXPECT_EQ(responses.finished[0], 3u);
+    EXPECT_EQ(responses.body(1), "answered /slow");
+    
+    EXPECT_NE(dropped.find("500 Internal Server Error"), std::string::npos);
+    EXPECT_NE(thrown.find("500 Internal Server Error"), std::string::npos);
+}
+
+TEST_F(HttpServerTest, StreamsBodiesAsTheyAreWritten) {
+    server->get("/events", [](const HttpRequest&, HttpResponse& res) {
+        res.setEventStream([](const std::shared_ptr<BodyStream>& stream) {
+            // Written later from a thread of its own, like a live feed
+            std::thread([stream]() {
+                for (int i = 1; i <= 3; ++i) {
+                    stream->sendEvent(std::to_string(i), "tick");
+                }
+                stream->close();
+            }).detach();
+        });
+    });
+    server->get("/fails", [](const HttpRequest&, HttpResponse& res) {
+        res.setStreamingBody([](const std::shared_ptr<BodyStream>& stream) {
+            stream->write("partial");
+            throw std::runtime_error("producer failed");
+        });
+    });
+    startInBackground(18103);
+    ASSERT_TRUE(server->isRunning());
+    
+    std::string chunked = sendRequest(18103, "GET /events HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    std::string close_delimited = sendRequest(18103, "GET /events HTTP/1.0\r\nHost: localhost\r\n\r\n");
+    std::string failed = sendRequest(18103, "GET /fails HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    
+    int sock = connectToServer(18103);
+    ASSERT_GE(sock, 0);
+    std::string request = http2Requests({"/events"});
+    send(sock, request.data(), request.size(), 0);
+    Http2Responses responses;
+    char buffer[4096];
+    ssize_t n;
+    while (responses.finished.empty() && (n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        responses.buffer.append(buffer, static_cast<size_t>(n));
+        responses.consume();
+    }
+    close(sock);
+    stopBackground();
+    
+    std::string events = "event: tick\ndata: 1\n\nevent: tick\ndata: 2\n\nevent: tick\ndata: 3\n\n";
+    EXPECT_NE(chunked.find("Transfer-Encoding: chunked"), std::string::npos);
+    EXPECT_NE(chunked.find("Content-Type: text/event-stream"), std::string::npos);
+    EXPECT_EQ(chunked.find("Content-Length"), std::string::npos);
+    
+    // De-chunk: the body is the events, ended by the zero-size chunk
+    std::string body;
+    size_t pos = chunked.find("\r\n\r\n") + 4;
+    while (pos < chunked.size()) {
+        size_t line_end = chunked.find("\r\n", pos);
+        ASSERT_NE(line_end, std::string::npos);
+        size_t size = std::stoul(chunked.substr(pos, line_end - pos), nullptr, 16);
+        if (size == 0) {
+            EXPECT_EQ(chunked.substr(line_end), "\r\n\r\n");
+            break;
+        }
+        body += chunked.substr(line_end + 2, size);
+        pos = line_end + 2 + size + 2;
+    }
+    EXPECT_EQ(body, events);
+    
+    EXPECT_EQ(close_delimited.find("Transfer-Encoding"), std::string::npos);
+    EXPECT_NE(close_delimited.find("Connection: close"), std::string::npos);
+    EXPECT_EQ(close_delimited.substr(close_delimited.find("\r\n\r\n") + 4), events);
+    
+    // Cut off without the terminating chunk
+    EXPECT_NE(failed.find("Transfer-Encoding: chunked"), std::string::npos);
+    EXPECT_EQ(failed.find("0\r\n\r\n"), std::string::npos);
+    
+    ASSERT_EQ(responses.finished.size(), 1u);
+    EXPECT_EQ(responses.body(1), events);
+}
+
+#ifdef HAVE_ZLIB
+TEST_F(HttpServerTest, StreamedBodiesAreCompressedPerChunk) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool first_seen = false;
+    server->enableCompression();
+    server->get("/events", [&](const HttpRequest&, HttpResponse& res) {
+        res.setEventStream([&](const std::shared_ptr<BodyStream>& stream) {
+            // The second event waits for the client to have decoded the
+            // first, which only a per-chunk flush makes possible
+            stream->sendEvent("first", "tick");
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait_for(lock, std::chrono::seconds(3), [&]() { return first_seen; });
+            lock.unlock();
+            stream->sendEvent("second", "tick");
+            stream->close();
+        });
+    });
+    startInBackground(18114);
+    ASSERT_TRUE(server->isRunning());
+    
+    int sock = connectToServer(18114);
+    ASSERT_GE(sock, 0);
+    std::string request = "GET /events HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: gzip\r\n"
+                          "Connection: close\r\n\r\n";
+    send(sock, request.data(), request.size(), 0);
+    
+    z_stream inflater{};
+    ASSERT_EQ(inflateInit2(&inflater, 15 + 16), Z_OK);
+    std::string data;
+    std::string head;
+    std::string decoded;
+    int result = Z_OK;
+    size_t pos = std::string::npos;
+    char buffer[4096];
+    ssize_t n;
+    bool ended = false;
+    while (!ended && (n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        data.append(buffer, static_cast<size_t>(n));
+        if (pos == std::string::npos) {
+            size_t head_end = data.find("\r\n\r\n");
+            if (head_end == std::string::npos) {
+                continue;
+            }
+            head = data.substr(0, head_end);
+            pos = head_end + 4;
+        }
+        // Inflate every complete chunk as it arrives
+        size_t line_end;
+        while ((line_end = data.find("\r\n", pos)) != std::string::npos) {
+            size_t size = std::stoul(data.substr(pos, line_end - pos), nullptr, 16);
+            if (size == 0) {
+                ended = true;
+                break;
+            }
+            if (data.size() < line_end + 2 + size + 2) {
+                break;
+            }
+            std::string chunk = data.substr(line_end + 2, size);
+            std::string inflated(4096, '\0');
+            inflater.next_in = reinterpret_cast<Bytef*>(&chunk[0]);
+            inflater.avail_in = static_cast<uInt>(chunk.size());
+            inflater.next_out = reinterpret_cast<Bytef*>(&inflated[0]);
+            inflater.avail_out = static_cast<uInt>(inflated.size());
+            result = inflate(&inflater, Z_SYNC_FLUSH);
+            decoded.append(inflated, 0, inflated.size() - inflater.avail_out);
+            pos = line_end + 2 + size + 2;
+        }
+        if (decoded.find("data: first") != std::string::npos) {
+            std::lock_guard<std::mutex> lock(mutex);
+            first_seen = true;
+            cv.notify_all();
+        }
+    }
+    inflateEnd(&inflater);
+    close(sock);
+    stopBackground();
+    
+    EXPECT_NE(head.find("Content-Encoding: gzip"), std::string::npos);
+    EXPECT_NE(head.find("Transfer-Encoding: chunked"), std::string::npos);
+    EXPECT_NE(head.find("Vary: Accept-Encoding"), std::string::npos);
+    EXPECT_TRUE(first_seen);
+    EXPECT_TRUE(ended);
+    EXPECT_EQ(result, Z_STREAM_END);
+    EXPECT_EQ(decoded, "event: tick\ndata: first\n\nevent: tick\ndata: second\n\n");
+}
+#endif
+
+TEST_F(HttpServerTest, Http2ResumesWritesTheSocketRefused) {
+    std::string large(8 << 20, 'x');
+    server->get("/large", [&large](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent(large);
+    });
+    startInBackground(18104);
+    ASSERT_TRUE(server->isRunning());
+    
+    // Open the windows wide so only the socket holds the server back
+    std::string settings = {0x0, 0x4, 0x40, 0x0, 0x0, 0x0}; // INITIAL_WINDOW_SIZE 2^30
+    std::string increment = {0x40, 0x0, 0x0, 0x0};
+    std::string request = http2Requests({"/large"});
+    request.insert(24, http2Frame(0x4, 0, 0, settings) + http2Frame(0x8, 0, 0, increment));
+    
+    int sock = connectToServer(18104);
+    ASSERT_GE(sock, 0);
+    send(sock, request.data(), request.size(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // let the socket fill up
+    
+    Http2Responses responses;
+    char buffer[65536];
+    ssize_t n;
+    while (responses.finished.empty() && (n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        responses.buffer.append(buffer, static_cast<size_t>(n));
+        responses.consume();
+    }
+    close(sock);
+    stopBackground();
+    
+    ASSERT_EQ(responses.finished.size(), 1u);
+    EXPECT_EQ(responses.body(1).size(), large.size());
+}
+
+TEST_F(HttpServerTest, AccessLogRecordsEachResponse) {
+    std::string log_file = "/tmp/httpserver_test_access.log";
+    std::remove(log_file.c_str());
+    server->enableAccessLog(log_file);
+    server->get("/hello", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("hello");
+    });
+    startInBackground(18099);
+    ASSERT_TRUE(server->isRunning());
+    
+    sendRequest(18099, "GET /hello HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    sendRequest(18099, "GET /missing?q=1 HTTP/1.0\r\nHost: localhost\r\n\r\n");
+    stopBackground();
+    
+    Logger::getInstance().flush();
+    std::ifstream in(log_file);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::string log = contents.str();
+    
+    // The status comes from the handler, which a middleware never sees
+    EXPECT_NE(log.find("\"client\":\"127.0.0.1\",\"method\":\"GET\",\"path\":\"/hello\",\"version\":\"HTTP/1.1\","
+                       "\"status\":200,\"bytes\":5,\"latency_us\":"),
+              std::string::npos);
+    EXPECT_NE(log.find("\"path\":\"/missing\",\"version\":\"HTTP/1.0\",\"status\":404,"), std::string::npos);
+    EXPECT_NE(log.find("\"tls\":false,\"resumed\":false}\n"), std::string::npos);
+    EXPECT_EQ(std::count(log.begin(), log.end(), '\n'), 2);
+    
+    Logger::getInstance().setAccessLogFile("");
+    std::remove(log_file.c_str());
+}
+
+#if defined(ENABLE_SSL) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+TEST_F(HttpServerTest, AccessLogMarksResumedTlsSessions) {
+    std::string log_file = "/tmp/httpserver_test_access.log";
+    std::remove(log_file.c_str());
+    server->enableAccessLog(log_file, AccessLog::Format::BINARY);
+    server->get("/hello", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("hello");
+    });
+    startHttpsInBackground(18100);
+    ASSERT_TRUE(server->isRunning());
+    
+    SSL_CTX* client = SSL_CTX_new(TLS_client_method());
+    std::string request = "GET /hello HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    std::string response;
+    bool resumed = false;
+    SSL_SESSION* session = tlsRequest(client, 18100, request, nullptr, false, response, resumed);
+    ASSERT_NE(session, nullptr);
+    SSL_SESSION* second = tlsRequest(client, 18100, request, session, false, response, resumed);
+    EXPECT_TRUE(resumed);
+    SSL_SESSION_free(session);
+    SSL_SESSION_free(second);
+    SSL_CTX_free(client);
+    stopBackground();
+    
+    Logger::getInstance().flush();
+    std::ifstream in(log_file, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::string log = contents.str();
+    
+    std::vector<uint8_t> flags;
+    for (size_t offset = 0; offset + AccessLog::kBinaryHeaderSize <= log.size();) {
+        size_t size = static_cast<unsigned char>(log[offset]) | static_cast<unsigned char>(log[offset + 1]) << 8;
+        ASSERT_GE(size, AccessLog::kBinaryHeaderSize);
+        EXPECT_EQ(log.substr(offset + AccessLog::kBinaryHeaderSize, size - AccessLog::kBinaryHeaderSize), "/hello");
+        flags.push_back(static_cast<uint8_t>(log[offset + 6]));
+        offset += size;
+    }
+    ASSERT_EQ(flags.size(), 2u);
+    EXPECT_EQ(flags[0], AccessLog::kFlagTls);
+    EXPECT_EQ(flags[1], AccessLog::kFlagTls | AccessLog::kFlagTlsResumed);
+    
+    Logger::getInstance().setAccessLogFile("");
+    std::remove(log_file.c_str());
+    std::remove(cert_file.c_str());
+    std::remove(key_file.c_str());
+}
+#endif
+
+TEST_F(HttpServerTest, AcceptSurvivesDescriptorExhaustion) {
+    server->get("/ping", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("pong");
+    });
+    startInBackground(18110);
+    ASSERT_TRUE(server->isRunning());
+    
+    // Clients are created first: once the limit sits at the lowest free
+    // descriptor, the server's accept4 fails with EMFILE
+    int refused = socket(AF_INET, SOCK_STREAM, 0);
+    int served = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(refused, 0);
+    ASSERT_GE(served, 0);
+    struct timeval timeout{2, 0};
+    setsockopt(refused, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(served, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(18110);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    
+    struct rlimit original;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &original), 0);
+    int lowest_free = dup(0);
+    ASSERT_GE(lowest_free, 0);
+    close(lowest_free);
+    struct rlimit exhausted = original;
+    exhausted.rlim_cur = static_cast<rlim_t>(lowest_free);
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &exhausted), 0);
+    
+    // Refused with a 503 rather than left in the backlog
+    ASSERT_EQ(connect(refused, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    std::string refusal = readAll(refused);
+    setrlimit(RLIMIT_NOFILE, &original);
+    close(refused);
+    
+    // The listener still fires once descriptors are back
+    ASSERT_EQ(connect(served, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    std::string request = "GET /ping HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    send(served, request.data(), request.size(), 0);
+    std::string response = readAll(served);
+    close(served);
+    stopBackground();
+    
+    EXPECT_NE(refusal.find("503 Service Unavailable"), std::string::npos);
+    EXPECT_NE(response.find("pong"), std::string::npos);
+}
+
+TEST_F(HttpServerTest, SlowClientsAreCutOff) {
+    server->setHeaderTimeoutSeconds(1);
+    server->setWriteTimeoutSeconds(1);
+    server->get("/ping", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("pong");
+    });
+    server->get("/big", [](const HttpRequest&, HttpResponse& res) {
+        res.setBody(std::string(64 * 1024 * 1024, 'x'));
+    });
+    startInBackground(18107);
+    ASSERT_TRUE(server->isRunning());
+    
+    // A head trickled in a byte at a time keeps the connection active, but
+    // not past the header deadline
+    int slow = connectToServer(18107);
+    ASSERT_GE(slow, 0);
+    std::string head = "GET /ping HTTP/1.1\r\nHost: localhost\r\n";
+    send(slow, head.data(), head.size(), MSG_NOSIGNAL);
+    auto begin = std::chrono::steady_clock::now();
+    bool closed = false;
+    while (!closed && std::chrono::steady_clock::now() - begin < std::chrono::seconds(4)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        send(slow, "X", 1, MSG_NOSIGNAL);
+        char byte;
+        closed = recv(slow, &byte, 1, MSG_DONTWAIT) == 0;
+    }
+    auto slow_time = std::chrono::steady_clock::now() - begin;
+    close(slow);
+    
+    // Idling between requests is bounded by the keep-alive timeout instead
+    int idle = connectToServer(18107);
+    ASSERT_GE(idle, 0);
+    std::string leftover;
+    std::string request = "GET /ping HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(idle, request.data(), request.size(), 0);
+    std::string first = readResponse(idle, leftover);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    send(idle, request.data(), request.size(), MSG_NOSIGNAL);
+    std::string second = readResponse(idle, leftover);
+    close(idle);
+    
+    // A client that stops reading its response is dropped once the write stalls
+    int stalled = connectToServer(18107);
+    ASSERT_GE(stalled, 0);
+    request = "GET /big HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(stalled, request.data(), request.size(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    std::string partial = readAll(stalled);
+    close(stalled);
+    stopBackground();
+    
+    EXPECT_TRUE(closed);
+    EXPECT_LT(slow_time, std::chrono::milliseconds(2500));
+    EXPECT_NE(first.find("pong"), std::string::npos);
+    EXPECT_NE(second.find("pong"), std::string::npos);
+    EXPECT_NE(partial.find("200 OK"), std::string::npos);
+    EXPECT_LT(partial.size(), 64u * 1024 * 1024);
+}
+
+TEST_F(HttpServerTest, DrainFinishesRequestsInFlight) {
+    server->get("/ping", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("pong");
+    });
+    server->get("/slow", [](const HttpRequest&, HttpResponse& res) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        res.setTextContent("finished");
+    });
+    startInBackground(18108);
+    ASSERT_TRUE(server->isRunning());
+    
+    // One keep-alive connection between requests, one waiting on a handler
+    int idle = connectToServer(18108);
+    ASSERT_GE(idle, 0);
+    std::string leftover;
+    std::string request = "GET /ping HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(idle, request.data(), request.size(), 0);
+    std::string first = readResponse(idle, leftover);
+    
+    int busy = connectToServer(18108);
+    ASSERT_GE(busy, 0);
+    request = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(busy, request.data(), request.size(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    
+    auto begin = std::chrono::steady_clock::now();
+    server->drain(5);
+    EXPECT_TRUE(server->isDraining());
+    std::string idle_rest = readAll(idle);
+    std::string slow = readAll(busy);
+    close(idle);
+    close(busy);
+    
+    // start() returns by itself once the last connection is gone
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+    auto drain_time = std::chrono::steady_clock::now() - begin;
+    int refused = connectToServer(18108);
+    if (refused >= 0) {
+        close(refused);
+    }
+    
+    EXPECT_NE(first.find("keep-alive"), std::string::npos);
+    EXPECT_TRUE(idle_rest.empty());
+    EXPECT_NE(slow.find("200 OK"), std::string::npos);
+    EXPECT_NE(slow.find("Connection: close"), std::string::npos);
+    EXPECT_NE(slow.find("finished"), std::string::npos);
+    EXPECT_LT(drain_time, std::chrono::seconds(2));
+    EXPECT_FALSE(server->isRunning());
+    EXPECT_LT(refused, 0);
+}
+
+TEST_F(HttpServerTest, SuccessorServesOnHandedOverListeners) {
+    server->get("/who", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("first");
+    });
+    startInBackground(18109);
+    ASSERT_TRUE(server->isRunning());
+    
+    // The successor gets the listener over a Unix channel, as the hot
+    // restart in main() passes it to a new process
+    int channel[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+    ASSERT_TRUE(SocketServer::sendSockets(channel[0], server->getListenerSockets()));
+    std::vector<int> sockets;
+    ASSERT_TRUE(SocketServer::receiveSockets(channel[1], sockets));
+    close(channel[0]);
+    close(channel[1]);
+    
+    HttpServer successor;
+    successor.setThreadPoolSize(2);
+    successor.get("/who", [](const HttpRequest&, HttpResponse& res) {
+        res.setTextContent("second");
+    });
+    successor.setInheritedListeners(sockets);
+    std::thread successor_thread([&successor]() {
+        successor.start(0, "127.0.0.1"); // the port is the inherited socket's
+    });
+    for (int i = 0; i < 200 && !successor.isRunning(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_TRUE(successor.isRunning());
+    
+    server->drain(5);
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+    
+    // Nothing was re-bound, and no connection is refused along the way
+    std::vector<std::string> responses;
+    for (int i = 0; i < 3; ++i) {
+        responses.push_back(sendRequest(18109, "GET /who HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"));
+    }
+    successor.stop();
+    successor_thread.join();
+    
+    for (const auto& response : responses) {
+        EXPECT_NE(response.find("second"), std::string::npos);
+    }
+}
+
+#endif
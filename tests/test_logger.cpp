@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include "log_ring.h"
+#include "logger.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LoggerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::remove(log_file.c_str());
+        logger.enableConsoleOutput(false);
+        logger.setOutputFile(log_file);
+    }
+
+    void TearDown() override {
+        logger.flush();
+        logger.setLevel(Logger::Level::INFO);
+        logger.setOverflowPolicy(Logger::OverflowPolicy::DROP);
+        logger.setThreadBufferSize(Logger::kDefaultThreadBufferSize);
+        logger.enableConsoleOutput(true);
+        std::remove(log_file.c_str());
+    }
+
+    std::string readLog() {
+        logger.flush();
+        std::ifstream in(log_file);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        return contents.str();
+    }
+
+    static size_t countLines(const std::string& text, const std::string& needle) {
+        size_t count = 0;
+        for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) {
+            ++count;
+        }
+        return count;
+    }
+
+    Logger& logger = Logger::getInstance();
+    std::string log_file = "/tmp/httpserver_test_logger.log";
+};
+
+TEST_F(LoggerTest, RingDrainsRecordsInOrder) {
+    LogRing ring(4096);
+    for (int i = 0; i < 3; ++i) {
+        std::string text = "record " + std::to_string(i);
+        char* out = ring.reserve(64);
+        ASSERT_NE(out, nullptr);
+        std::memcpy(out, text.data(), text.size());
+        ring.commit(text.size());
+    }
+
+    std::vector<std::string> records;
+    EXPECT_EQ(ring.drain([&](const char* data, size_t size) { records.emplace_back(data, size); }), 3u);
+    EXPECT_EQ(records, (std::vector<std::string>{"record 0", "record 1", "record 2"}));
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST_F(LoggerTest, RingWrapsAndRefusesWhenFull) {
+    LogRing ring(4096);
+    size_t record = ring.maxRecordSize() - 8;
+
+    // Fill, free, and go round several times; records that would straddle
+    // the end restart at the front
+    for (int round = 0; round < 10; ++round) {
+        int stored = 0;
+        while (char* out = ring.reserve(record)) {
+            std::memset(out, 'a' + round, record);
+            ring.commit(record);
+            ++stored;
+        }
+        EXPECT_GE(stored, 3);
+
+        size_t drained = 0;
+        ring.drain([&](const char* data, size_t size) {
+            EXPECT_EQ(size, record);
+            EXPECT_EQ(data[0], 'a' + round);
+            EXPECT_EQ(data[size - 1], 'a' + round);
+            ++drained;
+        });
+        EXPECT_EQ(drained, static_cast<size_t>(stored));
+    }
+
+    EXPECT_EQ(ring.reserve(ring.maxRecordSize() + 1), nullptr);
+}
+
+TEST_F(LoggerTest, WritesFormattedLines) {
+    logger.info("hello from the test");
+    logger.debug("filtered out");
+
+    std::string contents = readLog();
+    EXPECT_NE(contents.find("] [INFO] hello from the test\n"), std::string::npos);
+    EXPECT_EQ(contents.find("filtered out"), std::string::npos);
+    // "[YYYY-MM-DD HH:MM:SS.mmm] "
+    ASSERT_GE(contents.size(), 26u);
+    EXPECT_EQ(contents[0], '[');
+    EXPECT_EQ(contents[20], '.');
+    EXPECT_EQ(contents[24], ']');
+}
+
+TEST_F(LoggerTest, LinesFromManyThreadsAreAllWritten) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([this, t]() {
+            for (int i = 0; i < 500; ++i) {
+                logger.warning("thread " + std::to_string(t) + " line " + std::to_string(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::string contents = readLog();
+    EXPECT_EQ(countLines(contents, "[WARNING] thread "), 2000u);
+    EXPECT_NE(contents.find("thread 3 line 499\n"), std::string::npos);
+}
+
+TEST_F(LoggerTest, FullBufferDropsAndCounts) {
+    logger.setThreadBufferSize(4096);
+    uint64_t dropped_before = logger.getDroppedCount();
+
+    // A fresh thread gets the small ring; a burst overruns it before the
+    // flusher's next pass
+    std::thread burst([this]() {
+        for (int i = 0; i < 2000; ++i) {
+            logger.error("burst line " + std::to_string(i));
+        }
+    });
+    burst.join();
+
+    EXPECT_GT(logger.getDroppedCount(), dropped_before);
+    std::string contents = readLog();
+    EXPECT_NE(contents.find("log lines dropped"), std::string::npos);
+    EXPECT_LT(countLines(contents, "burst line "), 2000u);
+}
+
+TEST_F(LoggerTest, BlockingPolicyLosesNothing) {
+    logger.setThreadBufferSize(4096);
+    logger.setOverflowPolicy(Logger::OverflowPolicy::BLOCK);
+    uint64_t dropped_before = logger.getDroppedCount();
+
+    std::thread burst([this]() {
+        for (int i = 0; i < 2000; ++i) {
+            logger.error("blocking line " + std::to_string(i));
+        }
+    });
+    burst.join();
+
+    EXPECT_EQ(logger.getDroppedCount(), dropped_before);
+    EXPECT_EQ(countLines(readLog(), "blocking line "), 2000u);
+}
+
+TEST_F(LoggerTest, FormatsPiecesInPlace) {
+    std::string path = "/api/items";
+    LOG_WARNING("GET ", path, " status=", 404, ' ', -7, " bytes=", 123456789012ull, " ok=", false, " ratio=", 0.25);
+
+    EXPECT_NE(readLog().find("[WARNING] GET /api/items status=404 -7 bytes=123456789012 ok=false ratio=0.25\n"),
+              std::string::npos);
+}
+
+TEST_F(LoggerTest, DisabledLevelSkipsFormatting) {
+    int evaluated = 0;
+    auto piece = [&evaluated]() {
+        ++evaluated;
+        return std::string("computed");
+    };
+
+    LOG_DEBUG("debug ", piece());
+    EXPECT_EQ(evaluated, 0);
+
+    logger.setLevel(Logger::Level::DEBUG);
+    LOG_DEBUG("debug ", piece());
+    EXPECT_EQ(evaluated, 1);
+    EXPECT_NE(readLog().find("[DEBUG] debug computed\n"), std::string::npos);
+}
+
+TEST_F(LoggerTest, OverlongLineIsCutAtTheRecordLimit) {
+    std::string long_piece(Logger::kDefaultThreadBufferSize, 'x');
+    LOG_ERROR("start ", long_piece, " end");
+
+    std::string contents = readLog();
+    size_t start = contents.find("[ERROR] start x");
+    ASSERT_NE(start, std::string::npos);
+    size_t newline = contents.find('\n', start);
+    ASSERT_NE(newline, std::string::npos);
+    EXPECT_LT(newline - start, Logger::kDefaultThreadBufferSize / 4);
+    EXPECT_EQ(contents.find(" end"), std::string::npos);
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "metrics.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+class MetricsTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(MetricsTest, CounterSumsAcrossThreads) {
+    metrics::Counter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 12; ++t) {
+        threads.emplace_back([&counter]() {
+            for (int i = 0; i < 10000; ++i) {
+                counter.add();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    counter.add(5);
+    EXPECT_EQ(counter.value(), 120005u);
+}
+
+TEST_F(MetricsTest, BucketsCoverEveryValueWithinResolution) {
+    using metrics::LatencyHistogram;
+    for (uint64_t value : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 17ull, 100ull, 1023ull, 1024ull,
+                           123456ull, 4000000000ull}) {
+        size_t bucket = LatencyHistogram::bucketFor(value);
+        ASSERT_LT(bucket, LatencyHistogram::kBucketCount);
+        uint64_t upper = LatencyHistogram::bucketUpperBound(bucket);
+        uint64_t lower = bucket == 0 ? 0 : LatencyHistogram::bucketUpperBound(bucket - 1) + 1;
+        EXPECT_LE(lower, value);
+        EXPECT_GE(upper, value);
+        EXPECT_LE(upper - lower, lower / 8) << value;
+    }
+    EXPECT_EQ(LatencyHistogram::bucketFor(UINT64_MAX), LatencyHistogram::kBucketCount - 1);
+}
+
+TEST_F(MetricsTest, HistogramReportsPercentiles) {
+    metrics::LatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.record(value);
+    }
+    std::thread other([&histogram]() { histogram.record(1000000); });
+    other.join();
+
+    metrics::LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.count, 1001u);
+    EXPECT_EQ(snapshot.sum_us, 500500u + 1000000u);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.5)), 500.0, 500.0 / 8);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.99)), 990.0, 990.0 / 8);
+    EXPECT_GE(snapshot.percentile(1.0), 1000000u);
+    EXPECT_EQ(snapshot.countAtOrBelow(7), 7u);
+}
+
+TEST_F(MetricsTest, WritesPrometheusText) {
+    metrics::LatencyHistogram histogram;
+    histogram.record(50);
+    histogram.record(2000);
+
+    std::string out;
+    metrics::PrometheusWriter writer(out);
+    writer.family("requests_total", "counter", "Requests.");
+    writer.sample("requests_total", "code=\"2xx\"", uint64_t{42});
+    writer.family("latency_seconds", "histogram", "Latency.");
+    std::string labels = "route=";
+    metrics::PrometheusWriter::appendLabelValue(labels, "/a\"b");
+    writer.histogram("latency_seconds", labels, histogram);
+
+    EXPECT_NE(out.find("# HELP requests_total Requests.\n# TYPE requests_total counter\n"), std::string::npos);
+    EXPECT_NE(out.find("requests_total{code=\"2xx\"} 42\n"), std::string::npos);
+    EXPECT_NE(out.find("latency_seconds_bucket{route=\"/a\\\"b\",le=\"0.0001\"} 1\n"), std::string::npos);
+    EXPECT_NE(out.find("latency_seconds_bucket{route=\"/a\\\"b\",le=\"0.0025\"} 2\n"), std::string::npos);
+    EXPECT_NE(out.find("latency_seconds_bucket{route=\"/a\\\"b\",le=\"+Inf\"} 2\n"), std::string::npos);
+    EXPECT_NE(out.find("latency_seconds_sum{route=\"/a\\\"b\"} 0.002050\n"), std::string::npos);
+    EXPECT_NE(out.find("latency_seconds_count{route=\"/a\\\"b\"} 2\n"), std::string::npos);
+}
@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include "request_framer.h"
+#include "http_request.h"
+
+class RequestFramerTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    RequestFramer framer;
+};
+
+TEST_F(RequestFramerTest, RequestWithoutBody) {
+    std::string buffer = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+    EXPECT_EQ(framer.takeMessage(buffer), "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST_F(RequestFramerTest, HeadersSplitAcrossReads) {
+    std::string buffer = "GET / HTTP/1.1\r\nHost: localhost\r";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::NEED_MORE);
+
+    buffer += "\n\r";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::NEED_MORE);
+
+    buffer += "\n";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+}
+
+TEST_F(RequestFramerTest, ContentLengthBodyArrivesLater) {
+    std::string buffer = "POST /upload HTTP/1.1\r\nContent-Length: 10\r\n\r\n01234";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::NEED_MORE);
+
+    buffer += "56789";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+
+    HttpRequest request(framer.takeMessage(buffer));
+    EXPECT_EQ(request.getBody(), "0123456789");
+}
+
+TEST_F(RequestFramerTest, BinaryBodyKeepsNulBytes) {
+    std::string body("a\0b\0\r\nc", 7);
+    std::string buffer = "POST /bin HTTP/1.1\r\nContent-Length: 7\r\n\r\n" + body;
+
+    ASSERT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+
+    HttpRequest request(framer.takeMessage(buffer));
+    EXPECT_EQ(request.getBody(), body);
+}
+
+TEST_F(RequestFramerTest, PipelinedRequestsAreSeparated) {
+    std::string buffer =
+        "POST /a HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+        "GET /b HTTP/1.1\r\n\r\n";
+
+    ASSERT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+    EXPECT_EQ(HttpRequest(framer.takeMessage(buffer)).getBody(), "abc");
+
+    ASSERT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+    EXPECT_EQ(HttpRequest(framer.takeMessage(buffer)).getPath(), "/b");
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST_F(RequestFramerTest, ChunkedBodyIsDecoded) {
+    std::string buffer =
+        "POST /chunked HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5;ext=1\r\nhello\r\n"
+        "6\r\n wor";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::NEED_MORE);
+
+    buffer += "ld\r\n0\r\nX-Trailer: yes\r\n\r\nGET /next HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+
+    HttpRequest request(framer.takeMessage(buffer));
+    EXPECT_EQ(request.getBody(), "hello world");
+    EXPECT_EQ(buffer, "GET /next HTTP/1.1\r\n\r\n");
+}
+
+TEST_F(RequestFramerTest, BodyLargerThanLimitIsRejected) {
+    RequestFramer small(8);
+
+    std::string buffer = "POST / HTTP/1.1\r\nContent-Length: 9\r\n\r\n";
+    EXPECT_EQ(small.frame(buffer), RequestFramer::Status::PAYLOAD_TOO_LARGE);
+
+    small.reset();
+    buffer = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\n12345\r\n5\r\n";
+    EXPECT_EQ(small.frame(buffer), RequestFramer::Status::PAYLOAD_TOO_LARGE);
+}
+
+TEST_F(RequestFramerTest, ConflictingFramingIsRejected) {
+    std::string buffer =
+        "POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::BAD_REQUEST);
+
+    framer.reset();
+    buffer = "POST / HTTP/1.1\r\nContent-Length: 12abc\r\n\r\n";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::BAD_REQUEST);
+}
+
+TEST_F(RequestFramerTest, RepeatedContentLengthMustAgree) {
+    std::string buffer =
+        "POST / HTTP/1.1\r\nContent-Length: 0\r\nContent-Length: 24\r\n\r\n"
+        "GET /smuggled HTTP/1.1\r\n\r\n";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::BAD_REQUEST);
+
+    framer.reset();
+    buffer = "POST / HTTP/1.1\r\nContent-Length: 3, 4\r\n\r\nabcd";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::BAD_REQUEST);
+
+    framer.reset();
+    buffer = "POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3, 3\r\n\r\nabc";
+    ASSERT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+    EXPECT_EQ(HttpRequest(framer.takeMessage(buffer)).getBody(), "abc");
+}
+
+TEST_F(RequestFramerTest, TransferEncodingFieldsAreCombined) {
+    std::string buffer =
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: gzip\r\n\r\n"
+        "0\r\n\r\n";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::BAD_REQUEST);
+
+    framer.reset();
+    buffer = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked, chunked\r\n\r\n0\r\n\r\n";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::BAD_REQUEST);
+
+    framer.reset();
+    buffer =
+        "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "3\r\nabc\r\n0\r\n\r\n";
+    ASSERT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+    EXPECT_EQ(HttpRequest(framer.takeMessage(buffer)).getBody(), "abc");
+}
+
+TEST_F(RequestFramerTest, ChunkSizeWithTrailingGarbageIsRejected) {
+    std::string buffer = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5x\r\nhello\r\n0\r\n\r\n";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::BAD_REQUEST);
+
+    framer.reset();
+    buffer = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5 6\r\nhello\r\n0\r\n\r\n";
+    EXPECT_EQ(framer.frame(buffer), RequestFramer::Status::BAD_REQUEST);
+
+    framer.reset();
+    buffer = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5 ;ext\r\nhello\r\n0\r\n\r\n";
+    ASSERT_EQ(framer.frame(buffer), RequestFramer::Status::COMPLETE);
+    EXPECT_EQ(HttpRequest(framer.takeMessage(buffer)).getBody(), "hello");
+}
+
+TEST_F(RequestFramerTest, ChunkFramingCountsAgainstTheLimit) {
+    RequestFramer small(1024, 1024);
+    std::string buffer = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+    std::string chunk = "1;" + std::string(1000, 'x') + "\r\na\r\n";
+
+    // One byte of body per kilobyte of extension: the body stays tiny
+    // while the buffer would grow without bound
+    RequestFramer::Status status = RequestFramer::Status::NEED_MORE;
+    for (int i = 0; i < 100 && status == RequestFramer::Status::NEED_MORE; ++i) {
+        buffer += chunk;
+        status = small.frame(buffer);
+    }
+    EXPECT_EQ(status, RequestFramer::Status::PAYLOAD_TOO_LARGE);
+    EXPECT_LT(buffer.size(), 4u * 1024);
+}
+
+TEST_F(RequestFramerTest, TrailerSectionIsLimited) {
+    RequestFramer small(1024, 1024);
+    std::string buffer = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n";
+
+    RequestFramer::Status status = RequestFramer::Status::NEED_MORE;
+    for (int i = 0; i < 100 && status == RequestFramer::Status::NEED_MORE; ++i) {
+        buffer += "X-Trailer: " + std::to_string(i) + "\r\n";
+        status = small.frame(buffer);
+    }
+    EXPECT_EQ(status, RequestFramer::Status::HEADERS_TOO_LARGE);
+
+    // A trailer section within the limit still completes the request
+    std::string ok = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\nX-A: 1\r\nX-B: 2\r\n\r\n";
+    EXPECT_EQ(framer.frame(ok), RequestFramer::Status::COMPLETE);
+}
+
+TEST_F(RequestFramerTest, OversizedHeadersAreRejected) {
+    RequestFramer small(1024, 64);
+
+    std::string buffer = "GET / HTTP/1.1\r\nX-Long: " + std::string(100, 'x');
+    EXPECT_EQ(small.frame(buffer), RequestFramer::Status::HEADERS_TOO_LARGE);
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include "request_parser.h"
+#include "simd_scan.h"
+#include "http_request.h"
+
+class RequestParserTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    RequestParser parser;
+};
+
+TEST_F(RequestParserTest, ParsesRequestLineAndHeaders) {
+    std::string buffer =
+        "POST /api/items?id=7 HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Type:   application/json \r\n"
+        "\r\n"
+        "{}";
+
+    ASSERT_EQ(parser.parse(buffer), RequestParser::Status::COMPLETE);
+    EXPECT_EQ(parser.getMethod().in(buffer), "POST");
+    EXPECT_EQ(parser.getTarget().in(buffer), "/api/items?id=7");
+    EXPECT_EQ(parser.getVersion().in(buffer), "HTTP/1.1");
+    EXPECT_EQ(parser.getHeadLength(), buffer.size() - 2);
+
+    ASSERT_EQ(parser.getHeaders().size(), 2u);
+    EXPECT_EQ(parser.getHeaders()[1].name.in(buffer), "Content-Type");
+    EXPECT_EQ(parser.getHeaders()[1].value.in(buffer), "application/json");
+}
+
+TEST_F(RequestParserTest, ResumesAcrossSingleByteReads) {
+    const std::string full =
+        "GET /resume HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "X-Empty:\r\n"
+        "\r\n";
+
+    std::string buffer;
+    for (size_t i = 0; i + 1 < full.size(); ++i) {
+        buffer += full[i];
+        ASSERT_EQ(parser.parse(buffer), RequestParser::Status::NEED_MORE) << "at byte " << i;
+    }
+
+    buffer += full.back();
+    ASSERT_EQ(parser.parse(buffer), RequestParser::Status::COMPLETE);
+    EXPECT_EQ(parser.getTarget().in(buffer), "/resume");
+    EXPECT_EQ(parser.findHeader(buffer, "host"), "example.com");
+    EXPECT_EQ(parser.findHeader(buffer, "X-Empty"), "");
+    EXPECT_NE(parser.findHeader(buffer, "X-Empty").data(), nullptr);
+    EXPECT_EQ(parser.findHeader(buffer, "Missing").data(), nullptr);
+}
+
+TEST_F(RequestParserTest, AcceptsBareLineFeeds) {
+    std::string buffer = "\r\nGET / HTTP/1.0\nAccept: */*\n\n";
+
+    ASSERT_EQ(parser.parse(buffer), RequestParser::Status::COMPLETE);
+    EXPECT_EQ(parser.getVersion().in(buffer), "HTTP/1.0");
+    EXPECT_EQ(parser.findHeader(buffer, "ACCEPT"), "*/*");
+    EXPECT_EQ(parser.getHeadLength(), buffer.size());
+}
+
+TEST_F(RequestParserTest, RejectsMalformedHeads) {
+    const char* invalid[] = {
+        "GET /\r\n\r\n",
+        "GET / HTTX/1.1\r\n\r\n",
+        "G(T / HTTP/1.1\r\n\r\n",
+        "GET / HTTP/1.1\r\nNo colon here\r\n\r\n",
+        "GET / HTTP/1.1\r\nBad Name: x\r\n\r\n",
+        "GET / HTTP/1.1\r\nX-A: 1\r\n  folded\r\n\r\n",
+    };
+
+    for (const char* request : invalid) {
+        parser.reset();
+        EXPECT_EQ(parser.parse(request), RequestParser::Status::ERROR) << request;
+    }
+}
+
+TEST_F(RequestParserTest, ResetAllowsReuse) {
+    std::string first = "GET /a HTTP/1.1\r\nA: 1\r\n\r\n";
+    ASSERT_EQ(parser.parse(first), RequestParser::Status::COMPLETE);
+
+    parser.reset();
+    std::string second = "GET /b HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(parser.parse(second), RequestParser::Status::COMPLETE);
+    EXPECT_EQ(parser.getTarget().in(second), "/b");
+    EXPECT_TRUE(parser.getHeaders().empty());
+}
+
+TEST_F(RequestParserTest, LoadReusesParsedHead) {
+    std::string message = "PUT /path%20x?k=v HTTP/1.1\r\nContent-Length: 3\r\n\r\na\r\n";
+    ASSERT_EQ(parser.parse(message), RequestParser::Status::COMPLETE);
+
+    HttpRequest request;
+    ASSERT_TRUE(request.load(message, parser));
+    EXPECT_EQ(request.getMethod(), HttpRequest::Method::PUT);
+    EXPECT_EQ(request.getPath(), "/path x");
+    EXPECT_EQ(request.getQueryParam("k"), "v");
+    EXPECT_EQ(request.getHeader("Content-Length"), "3");
+    EXPECT_EQ(request.getBody(), "a\r\n");
+}
+
+TEST_F(RequestParserTest, SimdScanMatchesScalarSearch) {
+    for (size_t size = 0; size < 80; ++size) {
+        for (size_t hit = 0; hit <= size; ++hit) {
+            std::string data(size, 'x');
+            if (hit < size) {
+                data[hit] = (hit % 2) ? '\r' : '\n';
+            }
+
+            EXPECT_EQ(simd::findAny(data.data(), data.size(), '\r', '\n'), hit)
+                << "size " << size << " (" << simd::instructionSet() << ")";
+        }
+    }
+
+    std::string header = "Content-Type: text/html";
+    EXPECT_EQ(simd::findByte(header.data(), header.size(), ':'), 12u);
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "request_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+class RequestRingTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(RequestRingTest, AnswersEverySubmittedRequest) {
+    std::atomic<int> notifications{0};
+    RequestRing ring([](std::string_view request, std::string& response) { response = "re: " + std::string(request); },
+                     64, [&notifications]() { ++notifications; });
+    ring.start(4);
+    EXPECT_EQ(ring.getWorkerCount(), 4u);
+
+    std::vector<std::string> requests;
+    for (int i = 0; i < 1000; ++i) {
+        requests.push_back("request " + std::to_string(i));
+    }
+
+    std::map<uint32_t, std::string> responses;
+    size_t next = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (responses.size() < requests.size() && std::chrono::steady_clock::now() < deadline) {
+        while (next < requests.size() && ring.submit(static_cast<uint32_t>(next), requests[next].data(), requests[next].size())) {
+            ++next;
+        }
+        RequestRing::Response response;
+        while (ring.poll(response)) {
+            responses[response.tag] = response.data;
+        }
+    }
+
+    ASSERT_EQ(responses.size(), requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        EXPECT_EQ(responses[static_cast<uint32_t>(i)], "re: " + requests[i]);
+    }
+    EXPECT_EQ(ring.getCompletionCount().load(), 1000);
+    EXPECT_EQ(notifications.load(), 1000);
+}
+
+TEST_F(RequestRingTest, RefusesMoreThanItsCapacityInFlight) {
+    RequestRing ring([](std::string_view request, std::string& response) { response = std::string(request); }, 2);
+
+    // No workers yet: submissions wait in the ring
+    EXPECT_TRUE(ring.submit(1, "a", 1));
+    EXPECT_TRUE(ring.submit(2, "b", 1));
+    EXPECT_FALSE(ring.submit(3, "c", 1));
+
+    // Stopping answers what was queued first
+    ring.start(1);
+    ring.stop();
+    EXPECT_EQ(ring.getWorkerCount(), 0u);
+    EXPECT_FALSE(ring.submit(3, "c", 1)); // answered but not yet polled
+
+    RequestRing::Response response;
+    ASSERT_TRUE(ring.poll(response));
+    EXPECT_EQ(response.tag, 1u);
+    EXPECT_EQ(response.data, "a");
+    EXPECT_TRUE(ring.submit(3, "c", 1));
+}
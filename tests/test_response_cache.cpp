@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include "response_cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ResponseCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(ResponseCacheTest, ServesStoredResponsesUntilTheyExpire) {
+    ResponseCache cache;
+    int runs = 0;
+    auto load = [&runs](HttpResponse& response) {
+        ++runs;
+        response.setJsonContent("{\"run\":" + std::to_string(runs) + "}");
+    };
+
+    HttpResponse first;
+    EXPECT_FALSE(cache.fetch("GET /a", std::chrono::seconds(1), load, first));
+    HttpResponse second;
+    second.setHeader("X-Request-Id", "2"); // a middleware's, kept
+    EXPECT_TRUE(cache.fetch("GET /a", std::chrono::seconds(1), load, second));
+
+    EXPECT_EQ(runs, 1);
+    EXPECT_EQ(second.getBody(), "{\"run\":1}");
+    EXPECT_EQ(second.getSharedBody(), first.getSharedBody()); // not copied
+    EXPECT_EQ(second.getHeader("Content-Type"), "application/json; charset=utf-8");
+    EXPECT_EQ(second.getHeader("X-Request-Id"), "2");
+    EXPECT_EQ(second.getHeader("Age"), "0");
+    EXPECT_EQ(cache.getHits(), 1u);
+    EXPECT_EQ(cache.getMisses(), 1u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    HttpResponse third;
+    EXPECT_FALSE(cache.fetch("GET /a", std::chrono::seconds(1), load, third));
+    EXPECT_EQ(third.getBody(), "{\"run\":2}");
+}
+
+TEST_F(ResponseCacheTest, CoalescesConcurrentMisses) {
+    ResponseCache cache;
+    std::atomic<int> runs{0};
+    auto load = [&runs](HttpResponse& response) {
+        ++runs;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        response.setTextContent("slow");
+    };
+
+    std::vector<std::thread> callers;
+    std::vector<std::string> bodies(8);
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        callers.emplace_back([&, i]() {
+            HttpResponse response;
+            cache.fetch("GET /slow", std::chrono::seconds(60), load, response);
+            bodies[i] = response.getBody();
+        });
+    }
+    for (auto& caller : callers) {
+        caller.join();
+    }
+
+    EXPECT_EQ(runs.load(), 1);
+    for (const auto& body : bodies) {
+        EXPECT_EQ(body, "slow");
+    }
+    EXPECT_EQ(cache.getMisses() + cache.getCoalesced() + cache.getHits(), 8u);
+    EXPECT_EQ(cache.getMisses(), 1u);
+}
+
+TEST_F(ResponseCacheTest, StoresOnlyWhatMayBeShared) {
+    ResponseCache cache;
+    const std::pair<const char*, std::function<void(HttpResponse&)>> uncacheable[] = {
+        {"no-store", [](HttpResponse& r) { r.setHeader("Cache-Control", "no-store"); }},
+        {"private", [](HttpResponse& r) { r.setHeader("Cache-Control", "private, max-age=60"); }},
+        {"max-age=0", [](HttpResponse& r) { r.setHeader("Cache-Control", "max-age=0"); }},
+        {"cookie", [](HttpResponse& r) { r.setHeader("Set-Cookie", "session=1"); }},
+        {"error", [](HttpResponse& r) { r.setStatusCode(HttpResponse::StatusCode::INTERNAL_SERVER_ERROR); }},
+    };
+    for (const auto& test : uncacheable) {
+        int runs = 0;
+        auto load = [&](HttpResponse& response) {
+            ++runs;
+            response.setTextContent("body");
+            test.second(response);
+        };
+        HttpResponse response;
+        response.setHeader("X-Request-Id", "1");
+        cache.fetch(test.first, std::chrono::seconds(60), load, response);
+        EXPECT_EQ(response.getBody(), "body") << test.first;
+        EXPECT_EQ(response.getHeader("X-Request-Id"), "1") << test.first;
+        cache.fetch(test.first, std::chrono::seconds(60), load, response);
+        EXPECT_EQ(runs, 2) << test.first;
+    }
+    EXPECT_EQ(cache.size(), 0u);
+
+    // A response's own max-age overrides the route's TTL
+    int runs = 0;
+    auto load = [&runs](HttpResponse& response) {
+        ++runs;
+        response.setHeader("Cache-Control", "public, max-age=60");
+        response.setTextContent("body");
+    };
+    HttpResponse response;
+    cache.fetch("max-age=60", std::chrono::seconds(0), load, response);
+    cache.fetch("max-age=60", std::chrono::seconds(0), load, response);
+    EXPECT_EQ(runs, 1);
+}
+
+TEST_F(ResponseCacheTest, EvictsLeastRecentlyUsedBeyondItsLimit) {
+    ResponseCache cache(4096);
+    auto load = [](HttpResponse& response) { response.setBody(std::string(1500, 'x')); };
+    HttpResponse response;
+    cache.fetch("a", std::chrono::seconds(60), load, response);
+    cache.fetch("b", std::chrono::seconds(60), load, response);
+    cache.fetch("a", std::chrono::seconds(60), load, response); // a is now the most recent
+    cache.fetch("c", std::chrono::seconds(60), load, response);
+
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_LE(cache.getMemoryUsage(), 4096u);
+    EXPECT_TRUE(cache.fetch("a", std::chrono::seconds(60), load, response));
+    EXPECT_FALSE(cache.fetch("b", std::chrono::seconds(60), load, response));
+
+    cache.setMaxBytes(0);
+    EXPECT_EQ(cache.size(), 0u);
+}
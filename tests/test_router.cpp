@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "router.h"
+
+class RouterTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static std::string_view param(const Router::Match& match, std::string_view path, size_t index) {
+        return path.substr(match.params[index].offset, match.params[index].length);
+    }
+
+    Router router;
+    Router::Match match;
+};
+
+TEST_F(RouterTest, MatchesLiteralPaths) {
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/api/users", 1));
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/api/user", 2));
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/api/status", 3));
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/", 4));
+
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, "/api/users", match));
+    EXPECT_EQ(match.value, 1);
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, "/api/user", match));
+    EXPECT_EQ(match.value, 2);
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, "/api/status", match));
+    EXPECT_EQ(match.value, 3);
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, "/", match));
+    EXPECT_EQ(match.value, 4);
+
+    EXPECT_FALSE(router.find(HttpRequest::Method::GET, "/api", match));
+    EXPECT_FALSE(router.find(HttpRequest::Method::GET, "/api/users/", match));
+}
+
+TEST_F(RouterTest, RoutesAreSeparatedByMethod) {
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/item", 1));
+    ASSERT_TRUE(router.add(HttpRequest::Method::OPTIONS, "/item", 2));
+
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, "/item", match));
+    EXPECT_EQ(match.value, 1);
+    ASSERT_TRUE(router.find(HttpRequest::Method::OPTIONS, "/item", match));
+    EXPECT_EQ(match.value, 2);
+
+    // An OPTIONS route must not answer other methods
+    EXPECT_FALSE(router.find(HttpRequest::Method::POST, "/item", match));
+}
+
+TEST_F(RouterTest, CapturesParameters) {
+    std::string_view path = "/users/42/posts/hello-world";
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/users/:id/posts/:slug", 7));
+
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, path, match));
+    EXPECT_EQ(match.value, 7);
+    ASSERT_EQ(match.param_count, 2u);
+    EXPECT_EQ(match.params[0].name, "id");
+    EXPECT_EQ(param(match, path, 0), "42");
+    EXPECT_EQ(match.params[1].name, "slug");
+    EXPECT_EQ(param(match, path, 1), "hello-world");
+
+    EXPECT_FALSE(router.find(HttpRequest::Method::GET, "/users//posts/x", match));
+}
+
+TEST_F(RouterTest, LiteralsWinOverParametersAndWildcards) {
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/api/*", 1));
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/api/users/:id", 2));
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/api/users/me", 3));
+
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, "/api/users/me", match));
+    EXPECT_EQ(match.value, 3);
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, "/api/users/9", match));
+    EXPECT_EQ(match.value, 2);
+
+    // Backtracks out of the parameter branch into the wildcard
+    std::string_view path = "/api/users/9/avatar";
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, path, match));
+    EXPECT_EQ(match.value, 1);
+    ASSERT_EQ(match.param_count, 1u);
+    EXPECT_EQ(param(match, path, 0), "users/9/avatar");
+
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, "/api/", match));
+    EXPECT_EQ(match.value, 1);
+}
+
+TEST_F(RouterTest, NamedWildcardCapturesRest) {
+    std::string_view path = "/static/css/site.css";
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/static/*file", 5));
+
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, path, match));
+    EXPECT_EQ(match.params[0].name, "file");
+    EXPECT_EQ(param(match, path, 0), "css/site.css");
+}
+
+TEST_F(RouterTest, FirstRegistrationWinsAndBadPatternsAreRejected) {
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/dup", 1));
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/dup", 2));
+    ASSERT_TRUE(router.find(HttpRequest::Method::GET, "/dup", match));
+    EXPECT_EQ(match.value, 1);
+
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/users/:id", 3));
+    EXPECT_FALSE(router.add(HttpRequest::Method::GET, "/users/:name/x", 4));
+    EXPECT_FALSE(router.add(HttpRequest::Method::GET, "/a/:/b", 5));
+    EXPECT_FALSE(router.add(HttpRequest::Method::GET, "/a/*rest/b", 6));
+}
+
+TEST_F(RouterTest, ManyRoutesShareTheTree) {
+    for (int i = 0; i < 500; ++i) {
+        ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/v1/resource" + std::to_string(i) + "/:id", i));
+    }
+
+    for (int i = 0; i < 500; i += 37) {
+        std::string path = "/v1/resource" + std::to_string(i) + "/abc";
+        ASSERT_TRUE(router.find(HttpRequest::Method::GET, path, match)) << path;
+        EXPECT_EQ(match.value, i);
+        EXPECT_EQ(param(match, path, 0), "abc");
+    }
+}
+
+TEST_F(RouterTest, RequestExposesParametersAsViews) {
+    HttpRequest request("GET /users/17 HTTP/1.1\r\n\r\n");
+    ASSERT_TRUE(router.add(HttpRequest::Method::GET, "/users/:id", 0));
+    ASSERT_TRUE(router.find(request.getMethod(), request.getPath(), match));
+
+    request.setRouteParams(match.params, match.param_count);
+    EXPECT_EQ(request.getParam("id"), "17");
+    EXPECT_EQ(request.getParam("id").data(), request.getPath().data() + 7);
+    EXPECT_EQ(request.getParam("missing").data(), nullptr);
+}
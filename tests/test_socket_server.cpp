@@ -1,7 +1,14 @@
 #include <gtest/gtest.h>
 #include "socket_server.h"
 
+#include <cstdlib>
+#include <string>
+#include <vector>
+
 #ifndef BUILD_WASM
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 class SocketServerTest : public ::testing::Test {
 protected:
@@ -77,6 +84,93 @@ TEST_F(SocketServerTest, MultipleBindAttempts) {
     EXPECT_FALSE(server2->bind(9995, "127.0.0.1"));
 }
 
+TEST_F(SocketServerTest, ReusePortListenersShareAPort) {
+    server->setReusePort(true);
+    server->setDeferAccept(1);
+    server->setFastOpen(16);
+    EXPECT_TRUE(server->bind(0, "127.0.0.1"));
+    EXPECT_TRUE(server->listen());
+    
+    // Port 0 resolves to the kernel's choice, which a second listener can join
+    int port = server->getPort();
+    EXPECT_GT(port, 0);
+    
+    auto server2 = std::make_unique<SocketServer>();
+    server2->setReusePort(true);
+    EXPECT_TRUE(server2->bind(port, "127.0.0.1"));
+    EXPECT_TRUE(server2->listen());
+    
+    // A listener without the option is still refused
+    auto server3 = std::make_unique<SocketServer>();
+    EXPECT_FALSE(server3->bind(port, "127.0.0.1"));
+}
+
+TEST_F(SocketServerTest, AdoptsAListeningSocket) {
+    EXPECT_TRUE(server->bind(0, "127.0.0.1"));
+    
+    // Bound but not listening yet: not something to serve on
+    SocketServer successor;
+    EXPECT_FALSE(successor.adopt(server->getSocket()));
+    EXPECT_FALSE(successor.adopt(-1));
+    
+    EXPECT_TRUE(server->listen());
+    int socket = dup(server->getSocket());
+    ASSERT_GE(socket, 0);
+    EXPECT_TRUE(successor.adopt(socket));
+    EXPECT_TRUE(successor.isRunning());
+    EXPECT_EQ(successor.getSocket(), socket);
+    EXPECT_EQ(successor.getPort(), server->getPort());
+    EXPECT_EQ(successor.getHost(), "127.0.0.1");
+}
+
+TEST_F(SocketServerTest, HandsSocketsOverAUnixChannel) {
+    EXPECT_TRUE(server->bind(0, "127.0.0.1"));
+    EXPECT_TRUE(server->listen());
+    SocketServer second;
+    EXPECT_TRUE(second.bind(0, "127.0.0.1"));
+    EXPECT_TRUE(second.listen());
+    
+    int channel[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+    EXPECT_TRUE(SocketServer::sendSockets(channel[0], {server->getSocket(), second.getSocket()}));
+    EXPECT_FALSE(SocketServer::sendSockets(channel[0], {}));
+    
+    std::vector<int> received;
+    EXPECT_TRUE(SocketServer::receiveSockets(channel[1], received));
+    ASSERT_EQ(received.size(), 2u);
+    
+    // New descriptors for the same listeners, not inherited across exec
+    SocketServer first_copy;
+    SocketServer second_copy;
+    EXPECT_NE(received[0], server->getSocket());
+    EXPECT_EQ(fcntl(received[0], F_GETFD) & FD_CLOEXEC, FD_CLOEXEC);
+    EXPECT_TRUE(first_copy.adopt(received[0]));
+    EXPECT_TRUE(second_copy.adopt(received[1]));
+    EXPECT_EQ(first_copy.getPort(), server->getPort());
+    EXPECT_EQ(second_copy.getPort(), second.getPort());
+    
+    // A closed channel delivers nothing
+    close(channel[0]);
+    EXPECT_FALSE(SocketServer::receiveSockets(channel[1], received));
+    EXPECT_EQ(received.size(), 2u);
+    close(channel[1]);
+}
+
+TEST_F(SocketServerTest, SystemdSocketsNeedTheirPid) {
+    // Meant for another process: left alone
+    setenv("LISTEN_PID", std::to_string(getpid() + 1).c_str(), 1);
+    setenv("LISTEN_FDS", "1", 1);
+    EXPECT_TRUE(SocketServer::systemdSockets().empty());
+    EXPECT_NE(getenv("LISTEN_FDS"), nullptr);
+    
+    // Ours: taken, and the variables cleared for any children
+    setenv("LISTEN_PID", std::to_string(getpid()).c_str(), 1);
+    setenv("LISTEN_FDS", "0", 1);
+    EXPECT_TRUE(SocketServer::systemdSockets().empty());
+    EXPECT_EQ(getenv("LISTEN_PID"), nullptr);
+    EXPECT_EQ(getenv("LISTEN_FDS"), nullptr);
+}
+
 // Note: Testing the accept() method would require a more complex setup
 // with actual client connections, which is better suited for integration tests
 
@@ -180,6 +180,32 @@ TEST_F(ThreadPoolTest, StopWithPendingTasks) {
     EXPECT_FALSE(pool->isRunning());
 }
 
+TEST_F(ThreadPoolTest, DrainRunsQueuedTasks) {
+    std::atomic<int> counter{0};
+    pool->start();
+    
+    // Workers are busy long enough for the rest to still be queued
+    for (int i = 0; i < 4; ++i) {
+        pool->enqueue([]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        });
+    }
+    for (int i = 0; i < 100; ++i) {
+        pool->enqueue([this, &counter]() {
+            counter++;
+            // Follow-up work a task submits is run too
+            pool->enqueue([&counter]() {
+                counter++;
+            });
+        });
+    }
+    
+    pool->drain();
+    EXPECT_FALSE(pool->isRunning());
+    EXPECT_EQ(counter.load(), 200);
+    EXPECT_EQ(pool->getQueueSize(), 0u);
+}
+
 TEST_F(ThreadPoolTest, EnqueueWhenStopped) {
     std::atomic<int> counter{0};
     
@@ -195,4 +221,59 @@ TEST_F(ThreadPoolTest, EnqueueWhenStopped) {
     EXPECT_EQ(counter.load(), 0);
 }
 
+TEST_F(ThreadPoolTest, TasksSubmittedByWorkersAreShared) {
+    std::atomic<int> counter{0};
+    
+    pool->start();
+    
+    // One task fans out onto its worker's own deque; idle peers steal from it
+    pool->enqueue([this, &counter]() {
+        for (int i = 0; i < 64; ++i) {
+            pool->enqueue([&counter]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                counter++;
+            });
+        }
+    });
+    
+    for (int i = 0; i < 200 && counter.load() < 64; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    
+    EXPECT_EQ(counter.load(), 64);
+    EXPECT_GT(pool->getStealCount(), 0u);
+    EXPECT_EQ(pool->getQueueSize(), 0u);
+}
+
+TEST_F(ThreadPoolTest, BurstBeyondInjectionCapacity) {
+    std::atomic<int> counter{0};
+    const int task_count = static_cast<int>(ThreadPool::kInjectionCapacity) * 2 + 5;
+    
+    // Queued before start(), so the overflow list has to hold the excess
+    for (int i = 0; i < task_count; ++i) {
+        pool->enqueue([&counter]() { counter++; });
+    }
+    EXPECT_EQ(pool->getQueueSize(), static_cast<size_t>(task_count));
+    
+    pool->start();
+    for (int i = 0; i < 200 && counter.load() < task_count; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    
+    EXPECT_EQ(counter.load(), task_count);
+}
+
+TEST_F(ThreadPoolTest, PinnedWorkersRunTasks) {
+    std::atomic<int> counter{0};
+    
+    pool->setCpuPinning(true);
+    pool->start();
+    for (int i = 0; i < 8; ++i) {
+        pool->enqueue([&counter]() { counter++; });
+    }
+    
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(counter.load(), 8);
+}
+
 #endif // BUILD_WASM
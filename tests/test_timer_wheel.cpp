@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "timer_wheel.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    using Clock = TimerWheel::Clock;
+    const Clock::time_point start_ = Clock::now();
+
+    Clock::time_point at(long long ms) const { return start_ + std::chrono::milliseconds(ms); }
+};
+
+TEST_F(TimerWheelTest, ExpiresTimersAtTheirDeadline) {
+    TimerWheel wheel(std::chrono::milliseconds(10), start_);
+    TimerWheel::Timer soon(1);
+    TimerWheel::Timer later(2);
+    wheel.arm(soon, at(25));
+    wheel.arm(later, at(40));
+    EXPECT_TRUE(soon.isArmed());
+
+    std::vector<uint64_t> expired;
+    wheel.advance(at(29), expired);
+    EXPECT_TRUE(expired.empty()); // rounded up to the 30 ms tick
+
+    wheel.advance(at(30), expired);
+    EXPECT_EQ(expired, std::vector<uint64_t>({1}));
+    EXPECT_FALSE(soon.isArmed());
+
+    expired.clear();
+    wheel.advance(at(100), expired);
+    EXPECT_EQ(expired, std::vector<uint64_t>({2}));
+
+    // An overdue deadline fires at the next tick
+    expired.clear();
+    wheel.arm(soon, at(0));
+    wheel.advance(at(109), expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(at(110), expired);
+    EXPECT_EQ(expired, std::vector<uint64_t>({1}));
+}
+
+TEST_F(TimerWheelTest, CancelledAndRearmedTimersMove) {
+    TimerWheel wheel(std::chrono::milliseconds(1), start_);
+    TimerWheel::Timer cancelled(1);
+    TimerWheel::Timer moved(2);
+    wheel.arm(cancelled, at(5));
+    wheel.arm(moved, at(5));
+    wheel.cancel(cancelled);
+    wheel.arm(moved, at(500));
+
+    std::vector<uint64_t> expired;
+    wheel.advance(at(499), expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(at(500), expired);
+    EXPECT_EQ(expired, std::vector<uint64_t>({2}));
+
+    // Destroying an armed timer takes it out of the wheel
+    expired.clear();
+    {
+        TimerWheel::Timer dropped(3);
+        wheel.arm(dropped, at(600));
+    }
+    wheel.advance(at(1000), expired);
+    EXPECT_TRUE(expired.empty());
+}
+
+TEST_F(TimerWheelTest, CascadesLongDelaysThroughEveryLevel) {
+    TimerWheel wheel(std::chrono::milliseconds(1), start_);
+
+    // Deadlines on both sides of each level's span, and beyond the wheel's
+    const long long deadlines[] = {1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 262145, 16777214, 100000000};
+    std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+    for (size_t i = 0; i < sizeof(deadlines) / sizeof(deadlines[0]); ++i) {
+        timers.push_back(std::make_unique<TimerWheel::Timer>(i));
+        wheel.arm(*timers.back(), at(deadlines[i]));
+    }
+
+    std::vector<uint64_t> expired;
+    for (size_t i = 0; i + 1 < sizeof(deadlines) / sizeof(deadlines[0]); ++i) {
+        wheel.advance(at(deadlines[i] - 1), expired);
+        EXPECT_EQ(expired.size(), i) << deadlines[i];
+        wheel.advance(at(deadlines[i]), expired);
+        ASSERT_EQ(expired.size(), i + 1) << deadlines[i];
+        EXPECT_EQ(expired.back(), i);
+    }
+
+    // Clamped to the span: 16777215 ticks after it was armed
+    EXPECT_TRUE(timers.back()->isArmed());
+    wheel.advance(at(16777214), expired);
+    EXPECT_EQ(expired.size(), 11u);
+    wheel.advance(at(16777215), expired);
+    ASSERT_EQ(expired.size(), 12u);
+    EXPECT_EQ(expired.back(), 11u);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include "tls_ticket_keys.h"
+
+#if defined(ENABLE_SSL) && !defined(BUILD_WASM)
+
+#include <cstring>
+
+class TicketKeyRingTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    TicketKeyRing ring{60, 2};
+};
+
+TEST_F(TicketKeyRingTest, CurrentKeyIsStableWithinInterval) {
+    TicketKeyRing::Key first;
+    TicketKeyRing::Key second;
+    ASSERT_TRUE(ring.current(1000, first));
+    ASSERT_TRUE(ring.current(1059, second));
+
+    EXPECT_EQ(std::memcmp(first.name, second.name, TicketKeyRing::kNameSize), 0);
+    EXPECT_EQ(ring.size(), 1u);
+    EXPECT_EQ(ring.getRotationCount(), 0u);
+}
+
+TEST_F(TicketKeyRingTest, RotatesOnceTheIntervalElapses) {
+    TicketKeyRing::Key old_key;
+    TicketKeyRing::Key new_key;
+    ASSERT_TRUE(ring.current(1000, old_key));
+    ASSERT_TRUE(ring.current(1060, new_key));
+
+    EXPECT_NE(std::memcmp(old_key.name, new_key.name, TicketKeyRing::kNameSize), 0);
+    EXPECT_EQ(ring.getRotationCount(), 1u);
+
+    // Tickets sealed with the old key still open, but ask for renewal
+    TicketKeyRing::Key found;
+    bool renew = false;
+    ASSERT_TRUE(ring.find(old_key.name, 1061, found, renew));
+    EXPECT_TRUE(renew);
+    EXPECT_EQ(std::memcmp(found.aes_key, old_key.aes_key, TicketKeyRing::kSecretSize), 0);
+
+    ASSERT_TRUE(ring.find(new_key.name, 1061, found, renew));
+    EXPECT_FALSE(renew);
+}
+
+TEST_F(TicketKeyRingTest, RetiredKeysExpire) {
+    TicketKeyRing::Key oldest;
+    ASSERT_TRUE(ring.current(0, oldest));
+    ASSERT_TRUE(ring.rotate(10));
+    ASSERT_TRUE(ring.rotate(20));
+    EXPECT_EQ(ring.size(), 3u);
+
+    TicketKeyRing::Key found;
+    bool renew = false;
+    EXPECT_TRUE(ring.find(oldest.name, 30, found, renew));
+
+    // A third rotation pushes the first key past the two retained ones
+    ASSERT_TRUE(ring.rotate(40));
+    EXPECT_EQ(ring.size(), 3u);
+    EXPECT_FALSE(ring.find(oldest.name, 50, found, renew));
+}
+
+TEST_F(TicketKeyRingTest, UnknownNameIsRejected) {
+    TicketKeyRing::Key key;
+    ASSERT_TRUE(ring.current(0, key));
+
+    unsigned char name[TicketKeyRing::kNameSize] = {};
+    bool renew = false;
+    EXPECT_FALSE(ring.find(name, 0, key, renew));
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+#include "mpmc_queue.h"
+#include "task.h"
+#include "work_stealing_deque.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class WorkStealingTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(WorkStealingTest, SmallTasksAreStoredInline) {
+    int calls = 0;
+    auto shared = std::make_shared<int>(7);
+    Task small([&calls, shared]() { calls += *shared; });
+    EXPECT_TRUE(small.isInline());
+
+    std::array<char, 256> payload{};
+    payload[0] = 1;
+    Task large([&calls, payload]() { calls += payload[0]; });
+    EXPECT_FALSE(large.isInline());
+
+    // Moving transfers the callable and leaves the source empty
+    Task moved = std::move(small);
+    EXPECT_FALSE(small);
+    ASSERT_TRUE(moved);
+    moved();
+    large();
+    EXPECT_EQ(calls, 8);
+
+    // Captures are destroyed with the task
+    moved.reset();
+    EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST_F(WorkStealingTest, MoveOnlyCallables) {
+    auto owned = std::make_unique<int>(42);
+    int seen = 0;
+    Task task([&seen, owned = std::move(owned)]() { seen = *owned; });
+    task();
+    EXPECT_EQ(seen, 42);
+}
+
+TEST_F(WorkStealingTest, DequeOwnerIsLifoThievesAreFifo) {
+    WorkStealingDeque<int> deque(2);
+    for (int i = 0; i < 10; ++i) {
+        deque.push(i); // grows past the initial capacity
+    }
+    EXPECT_EQ(deque.size(), 10u);
+
+    int value = -1;
+    ASSERT_TRUE(deque.pop(value));
+    EXPECT_EQ(value, 9);
+    ASSERT_TRUE(deque.steal(value));
+    EXPECT_EQ(value, 0);
+
+    int count = 0;
+    while (deque.pop(value)) {
+        ++count;
+    }
+    EXPECT_EQ(count, 8);
+    EXPECT_FALSE(deque.steal(value));
+    EXPECT_TRUE(deque.empty());
+}
+
+TEST_F(WorkStealingTest, EveryItemIsTakenExactlyOnce) {
+    constexpr int kItems = 200000;
+    WorkStealingDeque<int> deque(64);
+    std::vector<std::atomic<int>> taken(kItems);
+    std::atomic<bool> done{false};
+    std::atomic<int> total{0};
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; ++t) {
+        thieves.emplace_back([&]() {
+            int value;
+            while (!done.load() || !deque.empty()) {
+                if (deque.steal(value)) {
+                    taken[value].fetch_add(1);
+                    total.fetch_add(1);
+                }
+            }
+        });
+    }
+
+    int value;
+    for (int i = 0; i < kItems; ++i) {
+        deque.push(i);
+        if (i % 3 == 0 && deque.pop(value)) {
+            taken[value].fetch_add(1);
+            total.fetch_add(1);
+        }
+    }
+    while (deque.pop(value)) {
+        taken[value].fetch_add(1);
+        total.fetch_add(1);
+    }
+    done = true;
+    for (auto& thief : thieves) {
+        thief.join();
+    }
+
+    EXPECT_EQ(total.load(), kItems);
+    for (int i = 0; i < kItems; ++i) {
+        ASSERT_EQ(taken[i].load(), 1) << "item " << i;
+    }
+}
+
+TEST_F(WorkStealingTest, MpmcQueueIsBoundedAndFifo) {
+    MpmcQueue<int> queue(4);
+    EXPECT_EQ(queue.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) {
+        int item = i;
+        EXPECT_TRUE(queue.tryPush(std::move(item)));
+    }
+    int extra = 99;
+    EXPECT_FALSE(queue.tryPush(std::move(extra)));
+
+    int value;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.tryPop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.tryPop(value));
+}
+
+TEST_F(WorkStealingTest, MpmcQueueUnderContention) {
+    constexpr int kProducers = 4;
+    constexpr int kPerProducer = 50000;
+    MpmcQueue<Task> queue(1024);
+    std::atomic<int> executed{0};
+    std::atomic<int> producers_left{kProducers};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < kProducers; ++p) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < kPerProducer; ++i) {
+                Task task([&executed]() { executed.fetch_add(1); });
+                while (!queue.tryPush(std::move(task))) {
+                    std::this_thread::yield();
+                }
+            }
+            producers_left.fetch_sub(1);
+        });
+    }
+    for (int c = 0; c < 2; ++c) {
+        threads.emplace_back([&]() {
+            Task task;
+            while (true) {
+                if (queue.tryPop(task)) {
+                    task();
+                    continue;
+                }
+                if (producers_left.load() == 0) {
+                    while (queue.tryPop(task)) {
+                        task();
+                    }
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(executed.load(), kProducers * kPerProducer);
+}